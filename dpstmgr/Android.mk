@@ -8,12 +8,60 @@ LOCAL_SRC_FILES:= \
 	dpstmgr.c
 
 LOCAL_SHARED_LIBRARIES := \
-	liblog \
-	libdm_dpst
+	liblog
+
+# the in-tree engine only runs in dpst_replay on the host. Its netlink
+# payloads are a model, not the driver's dispmgr ABI, and must not reach
+# a real kernel before they're taken from the driver's header
+ifeq ($(INTEL_DPST_ENGINE),true)
+$(error INTEL_DPST_ENGINE: the DPST engine payloads don't match the driver yet)
+endif
+LOCAL_SHARED_LIBRARIES += libdm_dpst
+
 LOCAL_MODULE:= dpstmgr
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_EXECUTABLE)
+
+# the engine's dpstmgr, only talks to dpst_simkernel on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	dpstmgr.c \
+	dpst_engine.c \
+	dpst_netlink.c
+
+LOCAL_CFLAGS += -DDPST_USE_ENGINE
+LOCAL_STATIC_LIBRARIES := liblog
+
+LOCAL_MODULE:= dpstmgr_sim
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# replays recorded histograms through the engine on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	dpst_engine.c \
+	tools/dpst_replay.c
+
+LOCAL_MODULE:= dpst_replay
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# stands in for the kernel side of the netlink channel on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	tools/dpst_simkernel.c
+
+LOCAL_MODULE:= dpst_simkernel
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
 include $(LOCAL_PATH)/lib/Android.mk
 
 endif
@@ -0,0 +1,211 @@
+/*
+ * Display power saving technology (DPST) engine.
+ *
+ * For every luma histogram the engine finds the level below which all but
+ * a small fraction of the pixels sit, lowers the backlight to that level
+ * and boosts the pixels by the inverse ratio through the DIET curve, so
+ * the image looks the same with less backlight power. The backlight moves
+ * towards its target in small steps to avoid visible flicker; brightening
+ * is faster than dimming so highlights are never clipped for long.
+ *
+ * All math is fixed point, the curve is computed 8 points at a time with
+ * SSE2 when available.
+ */
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "dpst_engine.h"
+
+#define BL_FULL		10000	/* 100 % in 1/100 % */
+
+/* fraction of pixels allowed to clip, 1/10000, per aggressiveness */
+static const uint32_t clip_fraction[DPST_AGGRESSIVENESS_MAX + 1] = {
+	0, 50, 100, 200, 300,
+};
+
+/* lowest backlight, 1/100 %, per aggressiveness */
+static const uint32_t min_backlight[DPST_AGGRESSIVENESS_MAX + 1] = {
+	BL_FULL, 9000, 8000, 7000, 6000,
+};
+
+static uint32_t hist_total(const uint32_t *bins)
+{
+	uint32_t total = 0;
+	int i = 0;
+
+#ifdef __SSE2__
+	__m128i sum = _mm_setzero_si128();
+
+	for (; i + 4 <= DPST_HIST_BINS; i += 4)
+		sum = _mm_add_epi32(sum,
+			_mm_loadu_si128((const __m128i *)(bins + i)));
+	sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+	sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+	total = (uint32_t)_mm_cvtsi128_si32(sum);
+#endif
+	for (; i < DPST_HIST_BINS; i++)
+		total += bins[i];
+
+	return total;
+}
+
+static uint32_t compute_target(const struct dpst_engine *engine,
+			       const uint32_t *bins)
+{
+	int level = engine->config.aggressiveness;
+	uint32_t total, allowed, above = 0, bl;
+	int top;
+
+	total = hist_total(bins);
+	if (!level || !total)
+		return BL_FULL;
+
+	/* brightest bin once the allowed clipped pixels are left out */
+	allowed = (uint32_t)(((uint64_t)total * clip_fraction[level]) / 10000);
+	for (top = DPST_HIST_BINS - 1; top > 0; top--) {
+		above += bins[top];
+		if (above > allowed)
+			break;
+	}
+
+	bl = (uint32_t)(top + 1) * BL_FULL / DPST_HIST_BINS;
+	if (bl < min_backlight[level])
+		bl = min_backlight[level];
+
+	return bl;
+}
+
+/*
+ * Output level of each input point, x * gain saturated to full scale.
+ * x is Q16, gain Q14 so the product fits unsigned 16 bit lanes.
+ */
+static void compute_diet(uint32_t bl, uint32_t *diet)
+{
+	uint16_t x[40], y[40];
+	uint16_t gain;
+	int i;
+
+	gain = (uint16_t)(((uint32_t)BL_FULL << 14) / bl);
+	for (i = 0; i < 40; i++)
+		x[i] = i < DPST_DIET_POINTS - 1 ?
+			(uint16_t)(i << 16 >> 5) : 0xffff;
+
+	i = 0;
+#ifdef __SSE2__
+	{
+		__m128i g = _mm_set1_epi16((short)gain);
+
+		for (; i + 8 <= 40; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+
+			/* (x * gain) >> 16, then * 4 with saturation */
+			v = _mm_mulhi_epu16(v, g);
+			v = _mm_adds_epu16(v, v);
+			v = _mm_adds_epu16(v, v);
+			_mm_storeu_si128((__m128i *)(y + i), v);
+		}
+	}
+#endif
+	for (; i < 40; i++) {
+		uint32_t v = ((uint32_t)x[i] * gain) >> 16;
+
+		y[i] = v >= 0x4000 ? 0xffff : (uint16_t)(v << 2);
+	}
+
+	for (i = 0; i < DPST_DIET_POINTS - 1; i++)
+		diet[i] = y[i] == 0xffff ? 0x10000 : y[i];
+	diet[DPST_DIET_POINTS - 1] = 0x10000;
+}
+
+static int update_output(struct dpst_engine *engine,
+			 struct dpst_engine_output *out)
+{
+	uint32_t smooth = engine->smooth_bl;
+	uint32_t target = engine->target_bl << 8;
+	int shift = engine->config.smooth_shift;
+	uint32_t bl, delta, step;
+	int flags = 0;
+
+	if (smooth > target) {
+		/* dim slowly */
+		step = (smooth - target) >> shift;
+		smooth -= step ? step : 1;
+	} else if (smooth < target) {
+		/* brighten twice as fast, content could clip meanwhile */
+		step = (target - smooth) >> (shift > 1 ? shift - 1 : 0);
+		smooth += step ? step : 1;
+	}
+	engine->smooth_bl = smooth;
+
+	bl = (smooth + 0x80) >> 8;
+	delta = bl > engine->sent_bl ? bl - engine->sent_bl : engine->sent_bl - bl;
+
+	/* small changes are batched until they add up or the target is hit */
+	if (delta >= (uint32_t)engine->config.min_bl_delta ||
+	    (delta && bl == engine->target_bl)) {
+		engine->sent_bl = bl;
+		out->backlight = bl;
+		flags |= DPST_OUT_BL;
+	}
+
+	if ((flags & DPST_OUT_BL) && engine->diet_bl != bl) {
+		compute_diet(bl, out->diet);
+		engine->diet_bl = bl;
+		flags |= DPST_OUT_DIET;
+	}
+
+	return flags;
+}
+
+void dpst_engine_init(struct dpst_engine *engine,
+		      const struct dpst_engine_config *config)
+{
+	memset(engine, 0, sizeof(*engine));
+	engine->config = *config;
+	if (engine->config.aggressiveness < 0)
+		engine->config.aggressiveness = 0;
+	if (engine->config.aggressiveness > DPST_AGGRESSIVENESS_MAX)
+		engine->config.aggressiveness = DPST_AGGRESSIVENESS_MAX;
+	if (engine->config.min_bl_delta < 1)
+		engine->config.min_bl_delta = 1;
+
+	engine->target_bl = BL_FULL;
+	engine->smooth_bl = BL_FULL << 8;
+	engine->sent_bl = BL_FULL;
+	engine->diet_bl = BL_FULL;
+}
+
+void dpst_engine_set_aggressiveness(struct dpst_engine *engine, int level)
+{
+	if (level < 0)
+		level = 0;
+	if (level > DPST_AGGRESSIVENESS_MAX)
+		level = DPST_AGGRESSIVENESS_MAX;
+	engine->config.aggressiveness = level;
+	if (!level)
+		engine->target_bl = BL_FULL;
+}
+
+int dpst_engine_process(struct dpst_engine *engine, const uint32_t *bins,
+			struct dpst_engine_output *out)
+{
+	engine->events++;
+	engine->target_bl = compute_target(engine, bins);
+
+	return update_output(engine, out);
+}
+
+int dpst_engine_step(struct dpst_engine *engine,
+		     struct dpst_engine_output *out)
+{
+	if (!dpst_engine_busy(engine))
+		return 0;
+
+	return update_output(engine, out);
+}
+
+int dpst_engine_busy(const struct dpst_engine *engine)
+{
+	return engine->sent_bl != engine->target_bl;
+}
@@ -0,0 +1,46 @@
+#ifndef H_DPST_ENGINE_H
+#define H_DPST_ENGINE_H
+
+#include <stdint.h>
+#include "dpstmgr.h"
+
+#define DPST_AGGRESSIVENESS_MAX	4
+
+/* engine output flags, commands which need to go to the kernel */
+#define DPST_OUT_BL		(1 << 0)
+#define DPST_OUT_DIET		(1 << 1)
+
+struct dpst_engine_config {
+	int aggressiveness;	/* 0 (off) .. DPST_AGGRESSIVENESS_MAX */
+	int smooth_shift;	/* dimming speed, 1/2^n of the gap per step */
+	int min_bl_delta;	/* smallest backlight change sent, 1/100 % */
+};
+
+struct dpst_engine_output {
+	uint32_t backlight;			/* 1/100 % of the user level */
+	uint32_t diet[DPST_DIET_POINTS];	/* output level per input point, Q16 */
+};
+
+struct dpst_engine {
+	struct dpst_engine_config config;
+	uint32_t target_bl;	/* 1/100 % */
+	uint32_t smooth_bl;	/* 1/100 % << 8 */
+	uint32_t sent_bl;	/* 1/100 % */
+	uint32_t diet_bl;	/* backlight the sent curve compensates */
+	unsigned int events;
+};
+
+void dpst_engine_init(struct dpst_engine *engine,
+		      const struct dpst_engine_config *config);
+void dpst_engine_set_aggressiveness(struct dpst_engine *engine, int level);
+
+/* new histogram from the kernel, returns DPST_OUT_* flags */
+int dpst_engine_process(struct dpst_engine *engine, const uint32_t *bins,
+			struct dpst_engine_output *out);
+/* next smoothing step without a new histogram, returns DPST_OUT_* flags */
+int dpst_engine_step(struct dpst_engine *engine,
+		     struct dpst_engine_output *out);
+/* backlight still moving towards the target */
+int dpst_engine_busy(const struct dpst_engine *engine);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef H_DPST_HINT_H
+#define H_DPST_HINT_H
+
+/*
+ * Content hints from the hardware composer. Datagrams of struct dpst_hint
+ * sent to an abstract unix socket, only when the content changes.
+ */
+#define DPST_HINT_SOCKET	"dpstmgr.hint"
+#define DPST_HINT_VERSION	1
+
+enum dpst_content_enum {
+	DPST_CONTENT_UI,		/* GLES composed UI */
+	DPST_CONTENT_VIDEO,		/* video on the overlay plane */
+	DPST_CONTENT_STATIC,		/* screen is not being updated */
+	DPST_CONTENT_PROTECTED,		/* protected video on the overlay */
+	DPST_CONTENT_NUM,
+};
+
+struct dpst_hint {
+	unsigned int version;
+	unsigned int content;		/* dpst_content_enum */
+	unsigned int fps;		/* frames posted during the last second */
+	unsigned int fullscreen;	/* video fills the screen */
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * Netlink transport to the display manager in the kernel.
+ *
+ * Every message is a netlink header followed by a dpstmgr_cmd_hdr and its
+ * data. Commands are batched: all of them are sent in one datagram by
+ * dpst_nl_flush(), the kernel walks the messages in order.
+ *
+ * For host testing the same datagrams can go over a unix socket to a
+ * simulated kernel (tools/dpst_simkernel).
+ */
+#define LOG_TAG "dpstmgr"
+
+#include <cutils/log.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+#include "dpst_netlink.h"
+
+int dpst_nl_open(struct dpst_nl *nl)
+{
+	struct sockaddr_nl addr;
+
+	memset(nl, 0, sizeof(*nl));
+
+	nl->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			NETLINK_DISPMGR);
+	if (nl->fd < 0) {
+		ALOGE("Failed to create netlink socket, error %d\n", errno);
+		return -errno;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_pid = getpid();
+	if (bind(nl->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		int err = errno;
+
+		ALOGE("Failed to bind netlink socket, error %d\n", err);
+		close(nl->fd);
+		nl->fd = -1;
+		return -err;
+	}
+
+	return 0;
+}
+
+static socklen_t abstract_addr(struct sockaddr_un *addr, const char *name,
+			       const char *suffix)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	/* sun_path[0] stays 0, abstract namespace */
+	snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "%s%s",
+		 name, suffix);
+	return offsetof(struct sockaddr_un, sun_path) + 1 +
+		strlen(addr->sun_path + 1);
+}
+
+int dpst_nl_open_sim(struct dpst_nl *nl, const char *name)
+{
+	struct sockaddr_un addr;
+	socklen_t len;
+	int err;
+
+	memset(nl, 0, sizeof(*nl));
+	nl->sim = 1;
+
+	nl->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (nl->fd < 0) {
+		ALOGE("Failed to create simulation socket, error %d\n", errno);
+		return -errno;
+	}
+
+	len = abstract_addr(&addr, name, ".mgr");
+	if (bind(nl->fd, (struct sockaddr *)&addr, len) < 0)
+		goto err;
+
+	len = abstract_addr(&addr, name, "");
+	if (connect(nl->fd, (struct sockaddr *)&addr, len) < 0)
+		goto err;
+
+	return 0;
+err:
+	err = errno;
+	ALOGE("Failed to connect to simulated kernel %s, error %d\n", name, err);
+	close(nl->fd);
+	nl->fd = -1;
+	return -err;
+}
+
+void dpst_nl_close(struct dpst_nl *nl)
+{
+	if (nl->fd >= 0)
+		close(nl->fd);
+	nl->fd = -1;
+}
+
+int dpst_nl_queue(struct dpst_nl *nl, unsigned int cmd,
+		  const void *data, unsigned int size)
+{
+	unsigned int len = NLMSG_SPACE(sizeof(struct dpstmgr_cmd_hdr) + size);
+	struct nlmsghdr *nlh;
+	struct dpstmgr_cmd_hdr *hdr;
+	int ret;
+
+	if (len > DPST_NL_BATCH_SIZE)
+		return -EINVAL;
+
+	if (nl->batch_len + len > DPST_NL_BATCH_SIZE) {
+		ret = dpst_nl_flush(nl);
+		if (ret)
+			return ret;
+	}
+
+	nlh = (struct nlmsghdr *)(nl->batch + nl->batch_len);
+	memset(nlh, 0, len);
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(*hdr) + size);
+	nlh->nlmsg_flags = NLM_F_REQUEST;
+	nlh->nlmsg_seq = ++nl->seq;
+	nlh->nlmsg_pid = getpid();
+
+	hdr = (struct dpstmgr_cmd_hdr *)NLMSG_DATA(nlh);
+	hdr->module = DISPMGR_MOD_DPST;
+	hdr->cmd = cmd;
+	hdr->data_size = size;
+	if (size)
+		memcpy(hdr + 1, data, size);
+
+	nl->batch_len += len;
+	nl->batch_cmds++;
+	return 0;
+}
+
+int dpst_nl_flush(struct dpst_nl *nl)
+{
+	struct sockaddr_nl kernel;
+	struct iovec iov;
+	struct msghdr msg;
+	ssize_t ret;
+
+	if (!nl->batch_len)
+		return 0;
+
+	memset(&kernel, 0, sizeof(kernel));
+	kernel.nl_family = AF_NETLINK;
+
+	iov.iov_base = nl->batch;
+	iov.iov_len = nl->batch_len;
+
+	memset(&msg, 0, sizeof(msg));
+	if (!nl->sim) {
+		msg.msg_name = &kernel;
+		msg.msg_namelen = sizeof(kernel);
+	}
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	do {
+		ret = sendmsg(nl->fd, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		ALOGE("Failed to send %u commands, error %d\n",
+		      nl->batch_cmds, errno);
+		ret = -errno;
+	} else {
+		nl->sent_datagrams++;
+		nl->sent_cmds += nl->batch_cmds;
+		ret = 0;
+	}
+
+	nl->batch_len = 0;
+	nl->batch_cmds = 0;
+	return ret;
+}
+
+int dpst_nl_recv(struct dpst_nl *nl, dpst_nl_handler handler, void *arg)
+{
+	char buf[DPST_NL_BATCH_SIZE];
+	struct nlmsghdr *nlh;
+	ssize_t len;
+	int count = 0;
+
+	for (;;) {
+		len = recv(nl->fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			ALOGE("Failed to receive from kernel, error %d\n", errno);
+			return -errno;
+		}
+
+		for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, (unsigned int)len);
+		     nlh = NLMSG_NEXT(nlh, len)) {
+			const struct dpstmgr_cmd_hdr *hdr;
+			unsigned int payload = NLMSG_PAYLOAD(nlh, 0);
+
+			if (payload < sizeof(*hdr))
+				continue;
+
+			hdr = (const struct dpstmgr_cmd_hdr *)NLMSG_DATA(nlh);
+			if (hdr->module != DISPMGR_MOD_DPST ||
+			    hdr->data_size > payload - sizeof(*hdr))
+				continue;
+
+			handler(hdr->cmd, hdr + 1, hdr->data_size, arg);
+			nl->recv_msgs++;
+			count++;
+		}
+	}
+
+	return count;
+}
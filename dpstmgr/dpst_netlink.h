@@ -0,0 +1,38 @@
+#ifndef H_DPST_NETLINK_H
+#define H_DPST_NETLINK_H
+
+#include "dpstmgr.h"
+
+#define DPST_NL_BATCH_SIZE	1024
+
+/* one message from the kernel */
+typedef void (*dpst_nl_handler)(unsigned int cmd, const void *data,
+				unsigned int size, void *arg);
+
+struct dpst_nl {
+	int fd;
+	int sim;		/* talking to a simulated kernel */
+	/* commands queued for the next datagram */
+	char batch[DPST_NL_BATCH_SIZE];
+	unsigned int batch_len;
+	unsigned int batch_cmds;
+	unsigned int seq;
+	/* statistics */
+	unsigned int sent_datagrams;
+	unsigned int sent_cmds;
+	unsigned int recv_msgs;
+};
+
+int dpst_nl_open(struct dpst_nl *nl);
+/* simulated kernel listening on the abstract unix socket name */
+int dpst_nl_open_sim(struct dpst_nl *nl, const char *name);
+void dpst_nl_close(struct dpst_nl *nl);
+/* add a DPST command to the batch, flushes first when it is full */
+int dpst_nl_queue(struct dpst_nl *nl, unsigned int cmd,
+		  const void *data, unsigned int size);
+/* send all queued commands in one datagram */
+int dpst_nl_flush(struct dpst_nl *nl);
+/* handle all pending kernel messages, returns their number or -errno */
+int dpst_nl_recv(struct dpst_nl *nl, dpst_nl_handler handler, void *arg);
+
+#endif
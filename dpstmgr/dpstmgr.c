@@ -1,8 +1,15 @@
+#define LOG_TAG "dpstmgr"
+
 #include <cutils/log.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "dpstmgr.h"
 
+#ifndef DPST_USE_ENGINE
+
 int main(int argc, char** argv)
 {
 	int ret = 0;
@@ -20,3 +27,396 @@ int main(int argc, char** argv)
 
 	return 0;
 }
+
+#else
+
+#include <stddef.h>
+#include <time.h>
+#include <private/android_filesystem_config.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include "dpst_engine.h"
+#include "dpst_hint.h"
+#include "dpst_netlink.h"
+
+/* smoothing step period while the backlight is moving, 2 frames */
+#define DPST_STEP_NS		33333333
+
+/* how the content shown changes the processing */
+struct dpst_policy {
+	int aggressiveness;	/* added to the configured level */
+	int fullscreen_boost;	/* added again when the video fills the screen */
+	int64_t min_interval_ns; /* histograms closer than this are dropped */
+	int histogram;		/* histogram interrupts wanted at all */
+};
+
+static const struct dpst_policy policies[DPST_CONTENT_NUM] = {
+	/* UI: follow every change, text and icons clip badly */
+	[DPST_CONTENT_UI] = { 0, 0, 0, 1 },
+	/* video: dark scenes save a lot, a few samples a second do */
+	[DPST_CONTENT_VIDEO] = { 1, 1, 100000000LL, 1 },
+	/* static: keep the current backlight, nothing to measure */
+	[DPST_CONTENT_STATIC] = { 0, 0, 0, 0 },
+	[DPST_CONTENT_PROTECTED] = { 1, 1, 100000000LL, 1 },
+};
+
+struct dpstmgr {
+	struct dpst_nl nl;
+	struct dpst_engine engine;
+	int epoll_fd;
+	int timer_fd;
+	int hint_fd;
+	FILE *record;
+	int base_aggressiveness;
+	/* current content hint */
+	struct dpst_hint hint;
+	const struct dpst_policy *policy;
+	int histogram;
+	int64_t last_hist_ns;
+	unsigned int hist_dropped;
+	unsigned int hints_rejected;
+};
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void queue_output(struct dpstmgr *mgr, int flags,
+			 const struct dpst_engine_output *out)
+{
+	if (flags & DPST_OUT_DIET) {
+		struct dpst_diet_data diet;
+		int i;
+
+		for (i = 0; i < DPST_DIET_POINTS; i++)
+			diet.level[i] = out->diet[i];
+		dpst_nl_queue(&mgr->nl, DISPMGR_DPST_GAMMA_SET,
+			      &diet, sizeof(diet));
+	}
+
+	if (flags & DPST_OUT_BL) {
+		struct dpst_bl_data bl;
+
+		bl.level = out->backlight;
+		dpst_nl_queue(&mgr->nl, DISPMGR_DPST_BL_SET, &bl, sizeof(bl));
+	}
+}
+
+static void arm_timer(struct dpstmgr *mgr)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (dpst_engine_busy(&mgr->engine))
+		its.it_value.tv_nsec = DPST_STEP_NS;
+	timerfd_settime(mgr->timer_fd, 0, &its, NULL);
+}
+
+static void handle_kernel_msg(unsigned int cmd, const void *data,
+			      unsigned int size, void *arg)
+{
+	struct dpstmgr *mgr = (struct dpstmgr *)arg;
+	const struct dpst_hist_data *hist;
+	struct dpst_engine_output out;
+	int64_t now;
+	int i, flags;
+
+	if (cmd != DISPMGR_DPST_HIST_DATA || size < sizeof(*hist))
+		return;
+
+	/* static content or sampled down by the content policy */
+	now = now_ns();
+	if (!mgr->histogram ||
+	    now - mgr->last_hist_ns < mgr->policy->min_interval_ns) {
+		mgr->hist_dropped++;
+		return;
+	}
+	mgr->last_hist_ns = now;
+
+	hist = (const struct dpst_hist_data *)data;
+	if (mgr->record) {
+		for (i = 0; i < DPST_HIST_BINS; i++)
+			fprintf(mgr->record, i ? " %u" : "%u", hist->bins[i]);
+		fputc('\n', mgr->record);
+	}
+
+	flags = dpst_engine_process(&mgr->engine, hist->bins, &out);
+	queue_output(mgr, flags, &out);
+}
+
+static int handle_timer(struct dpstmgr *mgr)
+{
+	struct dpst_engine_output out;
+	uint64_t expired;
+	int flags;
+
+	if (read(mgr->timer_fd, &expired, sizeof(expired)) < 0)
+		return -errno;
+
+	flags = dpst_engine_step(&mgr->engine, &out);
+	queue_output(mgr, flags, &out);
+	return 0;
+}
+
+static void apply_hint(struct dpstmgr *mgr, const struct dpst_hint *hint)
+{
+	const struct dpst_policy *policy;
+	unsigned int enable;
+	int level;
+
+	if (hint->version != DPST_HINT_VERSION ||
+	    hint->content >= DPST_CONTENT_NUM)
+		return;
+
+	policy = &policies[hint->content];
+	level = mgr->base_aggressiveness + policy->aggressiveness;
+	if (hint->fullscreen)
+		level += policy->fullscreen_boost;
+	/* DPST stays off when it is configured off */
+	if (!mgr->base_aggressiveness)
+		level = 0;
+
+	ALOGD("content %u, %u fps%s, aggressiveness %d\n", hint->content,
+	      hint->fps, hint->fullscreen ? ", fullscreen" : "", level);
+
+	dpst_engine_set_aggressiveness(&mgr->engine, level);
+	mgr->hint = *hint;
+	mgr->policy = policy;
+
+	if (policy->histogram != mgr->histogram) {
+		mgr->histogram = policy->histogram;
+		enable = policy->histogram;
+		dpst_nl_queue(&mgr->nl, DISPMGR_DPST_HIST_ENABLE,
+			      &enable, sizeof(enable));
+	}
+}
+
+/* the abstract socket is open to every app, only the composer may hint */
+static int hint_sender_allowed(struct msghdr *msg)
+{
+	struct cmsghdr *cmsg;
+	const struct ucred *cred;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_CREDENTIALS)
+			continue;
+		cred = (const struct ucred *)CMSG_DATA(cmsg);
+		return cred->uid == AID_SYSTEM || cred->uid == AID_GRAPHICS;
+	}
+
+	return 0;
+}
+
+static void handle_hints(struct dpstmgr *mgr)
+{
+	struct dpst_hint hint;
+	char control[CMSG_SPACE(sizeof(struct ucred))];
+	struct iovec iov;
+	struct msghdr msg;
+	ssize_t len;
+
+	/* only the latest hint matters */
+	for (;;) {
+		iov.iov_base = &hint;
+		iov.iov_len = sizeof(hint);
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		len = recvmsg(mgr->hint_fd, &msg, 0);
+		if (len < 0)
+			break;
+
+		if (!hint_sender_allowed(&msg)) {
+			if (!mgr->hints_rejected++)
+				ALOGW("Ignoring hints from an unprivileged sender\n");
+			continue;
+		}
+		if (len == sizeof(hint))
+			apply_hint(mgr, &hint);
+	}
+}
+
+static int open_hint_socket(void)
+{
+	struct sockaddr_un addr;
+	socklen_t len;
+	int on = 1;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	/* every hint carries the credentials of its sender */
+	if (setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) < 0) {
+		int err = errno;
+
+		close(fd);
+		return -err;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path + 1, DPST_HINT_SOCKET);
+	len = offsetof(struct sockaddr_un, sun_path) + 1 +
+		strlen(DPST_HINT_SOCKET);
+	if (bind(fd, (struct sockaddr *)&addr, len) < 0) {
+		int err = errno;
+
+		close(fd);
+		return -err;
+	}
+
+	return fd;
+}
+
+static int setup(struct dpstmgr *mgr, const char *sim_kernel)
+{
+	struct epoll_event ev;
+	unsigned int enable = 1;
+	int ret;
+
+	if (sim_kernel)
+		ret = dpst_nl_open_sim(&mgr->nl, sim_kernel);
+	else
+		ret = dpst_nl_open(&mgr->nl);
+	if (ret)
+		return ret;
+
+	/* runs without hints, as plain UI, if the socket is unavailable */
+	mgr->hint_fd = open_hint_socket();
+	if (mgr->hint_fd < 0)
+		ALOGE("Failed to open hint socket, error %d\n", -mgr->hint_fd);
+
+	mgr->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	mgr->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+				       TFD_NONBLOCK | TFD_CLOEXEC);
+	if (mgr->epoll_fd < 0 || mgr->timer_fd < 0) {
+		ALOGE("Failed to create epoll/timer fd, error %d\n", errno);
+		return -errno;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = mgr->nl.fd;
+	if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_ADD, mgr->nl.fd, &ev))
+		return -errno;
+	ev.data.fd = mgr->timer_fd;
+	if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_ADD, mgr->timer_fd, &ev))
+		return -errno;
+	if (mgr->hint_fd >= 0) {
+		ev.data.fd = mgr->hint_fd;
+		if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_ADD, mgr->hint_fd, &ev))
+			return -errno;
+	}
+
+	/* register with the kernel and start the histogram interrupts */
+	dpst_nl_queue(&mgr->nl, DISPMGR_DPST_INIT_COMM, NULL, 0);
+	dpst_nl_queue(&mgr->nl, DISPMGR_DPST_HIST_ENABLE,
+		      &enable, sizeof(enable));
+	dpst_nl_queue(&mgr->nl, DISPMGR_DPST_DIET_ENABLE, NULL, 0);
+	return dpst_nl_flush(&mgr->nl);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-a aggressiveness] [-r histogram record file]"
+		" [-k simulated kernel socket]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+	struct dpst_engine_config config;
+	struct dpstmgr mgr;
+	const char *sim_kernel = NULL;
+	int ret, opt;
+
+	memset(&mgr, 0, sizeof(mgr));
+	mgr.epoll_fd = -1;
+	mgr.timer_fd = -1;
+	mgr.hint_fd = -1;
+	mgr.policy = &policies[DPST_CONTENT_UI];
+	mgr.histogram = 1;
+
+	config.aggressiveness = 2;
+	config.smooth_shift = 3;
+	config.min_bl_delta = 100;
+
+	while ((opt = getopt(argc, argv, "a:r:k:")) != -1) {
+		switch (opt) {
+		case 'a':
+			config.aggressiveness = atoi(optarg);
+			break;
+		case 'r':
+			mgr.record = fopen(optarg, "w");
+			if (!mgr.record)
+				ALOGE("Failed to open %s, error %d\n", optarg, errno);
+			break;
+		case 'k':
+			sim_kernel = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return -EINVAL;
+		}
+	}
+
+	/* the payloads are the engine's model, not the driver's ABI yet */
+	if (!sim_kernel) {
+		ALOGE("The DPST engine only runs against a simulated kernel\n");
+		usage(argv[0]);
+		return -EINVAL;
+	}
+
+	dpst_engine_init(&mgr.engine, &config);
+	mgr.base_aggressiveness = mgr.engine.config.aggressiveness;
+
+	ret = setup(&mgr, sim_kernel);
+	if (ret) {
+		ALOGE("Init netlink socket FAILD!\n");
+		return -EFAULT;
+	}
+
+	while (1) {
+		struct epoll_event events[3];
+		int i, n;
+
+		n = epoll_wait(mgr.epoll_fd, events, 3, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			ALOGE("epoll_wait failed, error %d\n", errno);
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.fd == mgr.nl.fd)
+				dpst_nl_recv(&mgr.nl, handle_kernel_msg, &mgr);
+			else if (events[i].data.fd == mgr.timer_fd)
+				handle_timer(&mgr);
+			else if (events[i].data.fd == mgr.hint_fd)
+				handle_hints(&mgr);
+		}
+
+		/* everything produced by this wakeup goes out together */
+		dpst_nl_flush(&mgr.nl);
+		arm_timer(&mgr);
+	}
+
+	if (mgr.record)
+		fclose(mgr.record);
+	dpst_nl_close(&mgr.nl);
+	return 0;
+}
+
+#endif
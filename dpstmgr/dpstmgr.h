@@ -27,6 +27,31 @@ enum dispmgr_module_enum {
 	DISPMGR_MOD_DPST,
 };
 
+#define NETLINK_DISPMGR		20
+
+/*
+ * Payloads of the in-tree engine. The driver's layouts aren't visible
+ * here, these are the engine's own model of them and only travel
+ * between dpst_replay, dpst_simkernel and the engine on the host.
+ */
+#define DPST_HIST_BINS		32
+#define DPST_DIET_POINTS	(DPST_HIST_BINS + 1)
+
+/* DISPMGR_DPST_HIST_DATA payload, luma histogram of the last frame */
+struct dpst_hist_data {
+	unsigned int bins[DPST_HIST_BINS];
+};
+
+/* DISPMGR_DPST_BL_SET payload */
+struct dpst_bl_data {
+	unsigned int level;		/* 1/100 % of the user backlight */
+};
+
+/* DISPMGR_DPST_GAMMA_SET payload, DIET curve */
+struct dpst_diet_data {
+	unsigned int level[DPST_DIET_POINTS];	/* output per input point, Q16 */
+};
+
 int dpst_netlink_init(void);
 void dpst_recv_from_kernel(void* cmd_hdr);
 
@@ -0,0 +1,148 @@
+/*
+ * Replays recorded DPST histograms (dpstmgr -r) through the engine on the
+ * host and reports the CPU time per event and the backlight saving.
+ *
+ * Input: one histogram per line, DPST_HIST_BINS numbers, '#' comments.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../dpst_engine.h"
+
+static uint64_t cpu_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int parse_line(char *line, uint32_t *bins)
+{
+	char *p = line, *end;
+	int i;
+
+	for (i = 0; i < DPST_HIST_BINS; i++) {
+		unsigned long v = strtoul(p, &end, 0);
+
+		if (end == p)
+			return -EINVAL;
+		bins[i] = (uint32_t)v;
+		p = end;
+	}
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-a aggressiveness] [-s smooth shift] "
+		"[-d min backlight delta] [-v] file\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	struct dpst_engine_config config;
+	struct dpst_engine engine;
+	struct dpst_engine_output out;
+	uint32_t bins[DPST_HIST_BINS];
+	char line[1024];
+	uint64_t total_ns = 0, max_ns = 0, bl_sum = 0;
+	unsigned int events = 0, bl_cmds = 0, diet_cmds = 0, lineno = 0;
+	uint32_t bl = 10000;
+	int verbose = 0, opt;
+	FILE *f;
+
+	config.aggressiveness = 2;
+	config.smooth_shift = 3;
+	config.min_bl_delta = 100;
+
+	while ((opt = getopt(argc, argv, "a:s:d:v")) != -1) {
+		switch (opt) {
+		case 'a':
+			config.aggressiveness = atoi(optarg);
+			break;
+		case 's':
+			config.smooth_shift = atoi(optarg);
+			break;
+		case 'd':
+			config.min_bl_delta = atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	f = fopen(argv[optind], "r");
+	if (!f) {
+		fprintf(stderr, "can't open %s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+
+	dpst_engine_init(&engine, &config);
+
+	while (fgets(line, sizeof(line), f)) {
+		uint64_t start, ns;
+		int flags;
+
+		lineno++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (parse_line(line, bins)) {
+			fprintf(stderr, "%s:%u: expected %d bins\n",
+				argv[optind], lineno, DPST_HIST_BINS);
+			continue;
+		}
+
+		start = cpu_time_ns();
+		flags = dpst_engine_process(&engine, bins, &out);
+		ns = cpu_time_ns() - start;
+
+		total_ns += ns;
+		if (ns > max_ns)
+			max_ns = ns;
+		if (flags & DPST_OUT_BL) {
+			bl = out.backlight;
+			bl_cmds++;
+		}
+		if (flags & DPST_OUT_DIET)
+			diet_cmds++;
+		bl_sum += bl;
+		events++;
+
+		if (verbose)
+			printf("%u: backlight %u.%02u%%%s%s, %llu ns\n", events,
+			       bl / 100, bl % 100,
+			       flags & DPST_OUT_BL ? " [bl]" : "",
+			       flags & DPST_OUT_DIET ? " [diet]" : "",
+			       (unsigned long long)ns);
+	}
+	fclose(f);
+
+	if (!events) {
+		fprintf(stderr, "no histograms in %s\n", argv[optind]);
+		return 1;
+	}
+
+	/* backlight power is roughly linear in the PWM duty cycle */
+	printf("events %u, commands: backlight %u, diet %u\n",
+	       events, bl_cmds, diet_cmds);
+	printf("cpu time per event: avg %llu ns, max %llu ns\n",
+	       (unsigned long long)(total_ns / events),
+	       (unsigned long long)max_ns);
+	printf("average backlight %.2f%%, estimated backlight power saving %.2f%%\n",
+	       bl_sum / (events * 100.0), 100.0 - bl_sum / (events * 100.0));
+	return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * Simulated display manager kernel side for host testing of dpstmgr.
+ *
+ * Start "dpstmgr_sim -k <name>" once this runs, then the script is played:
+ *   hint <content> <fps> <fullscreen>	content hint, as sent by the HWC
+ *   hist <b0> ... <b31>		histogram event
+ *   flat <top bin>			histogram with bins 0..top filled
+ *   sleep <ms>
+ * Every command dpstmgr sends back is printed with its time.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+#include "../dpstmgr.h"
+#include "../dpst_hint.h"
+
+static const char *cmd_names[] = {
+	"UNKNOWN", "INIT_COMM", "UPDATE_GUARD", "HIST_ENABLE", "HIST_DATA",
+	"BL_SET", "GAMMA_SET", "DIET_ENABLE", "DIET_DISABLE", "GET_MODE",
+};
+
+static struct timespec start;
+
+static long elapsed_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec - start.tv_sec) * 1000 +
+		(ts.tv_nsec - start.tv_nsec) / 1000000;
+}
+
+static socklen_t abstract_addr(struct sockaddr_un *addr, const char *name,
+			       const char *suffix)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "%s%s",
+		 name, suffix);
+	return offsetof(struct sockaddr_un, sun_path) + 1 +
+		strlen(addr->sun_path + 1);
+}
+
+static void print_cmd(const struct dpstmgr_cmd_hdr *hdr, const void *data)
+{
+	const char *name = hdr->cmd < sizeof(cmd_names) / sizeof(cmd_names[0]) ?
+		cmd_names[hdr->cmd] : "?";
+
+	printf("%6ld ms  %-12s", elapsed_ms(), name);
+	if (hdr->cmd == DISPMGR_DPST_BL_SET &&
+	    hdr->data_size >= sizeof(struct dpst_bl_data)) {
+		const struct dpst_bl_data *bl = data;
+
+		printf(" %u.%02u%%", bl->level / 100, bl->level % 100);
+	} else if (hdr->cmd == DISPMGR_DPST_GAMMA_SET &&
+		   hdr->data_size >= sizeof(struct dpst_diet_data)) {
+		const struct dpst_diet_data *diet = data;
+
+		printf(" mid %u top %u", diet->level[DPST_DIET_POINTS / 2],
+		       diet->level[DPST_DIET_POINTS - 2]);
+	} else if (hdr->cmd == DISPMGR_DPST_HIST_ENABLE && hdr->data_size >= 4) {
+		printf(" %u", *(const unsigned int *)data);
+	}
+	printf("\n");
+}
+
+/* print what dpstmgr sent during the next ms milliseconds */
+static void receive(int fd, int ms)
+{
+	long end = elapsed_ms() + ms;
+	char buf[4096];
+
+	for (;;) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		long left = end - elapsed_ms();
+		struct nlmsghdr *nlh;
+		ssize_t len;
+
+		if (left <= 0 || poll(&pfd, 1, (int)left) <= 0)
+			break;
+
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len <= 0)
+			continue;
+
+		for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, (unsigned int)len);
+		     nlh = NLMSG_NEXT(nlh, len)) {
+			const struct dpstmgr_cmd_hdr *hdr = NLMSG_DATA(nlh);
+
+			if (NLMSG_PAYLOAD(nlh, 0) >= sizeof(*hdr))
+				print_cmd(hdr, hdr + 1);
+		}
+	}
+}
+
+static void send_hist(int fd, const struct sockaddr_un *mgr, socklen_t mgr_len,
+		      const struct dpst_hist_data *hist)
+{
+	char buf[NLMSG_SPACE(sizeof(struct dpstmgr_cmd_hdr) +
+			     sizeof(struct dpst_hist_data))];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct dpstmgr_cmd_hdr *hdr;
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(*hdr) + sizeof(*hist));
+	hdr = NLMSG_DATA(nlh);
+	hdr->module = DISPMGR_MOD_DPST;
+	hdr->cmd = DISPMGR_DPST_HIST_DATA;
+	hdr->data_size = sizeof(*hist);
+	memcpy(hdr + 1, hist, sizeof(*hist));
+
+	if (sendto(fd, buf, nlh->nlmsg_len, 0,
+		   (const struct sockaddr *)mgr, mgr_len) < 0)
+		fprintf(stderr, "histogram not delivered: %s\n", strerror(errno));
+}
+
+static void send_hint(int fd, const struct dpst_hint *hint)
+{
+	struct sockaddr_un addr;
+	socklen_t len = abstract_addr(&addr, DPST_HINT_SOCKET, "");
+
+	printf("%6ld ms  > hint content %u, %u fps, fullscreen %u\n",
+	       elapsed_ms(), hint->content, hint->fps, hint->fullscreen);
+	if (sendto(fd, hint, sizeof(*hint), 0,
+		   (const struct sockaddr *)&addr, len) < 0)
+		fprintf(stderr, "hint not delivered: %s\n", strerror(errno));
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_un addr, mgr;
+	socklen_t len, mgr_len;
+	char line[1024];
+	FILE *script;
+	int fd;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s name [script]\n", argv[0]);
+		return 1;
+	}
+
+	script = argc > 2 ? fopen(argv[2], "r") : stdin;
+	if (!script) {
+		fprintf(stderr, "can't open %s: %s\n", argv[2], strerror(errno));
+		return 1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	len = abstract_addr(&addr, argv[1], "");
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, len) < 0) {
+		fprintf(stderr, "can't bind %s: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+	mgr_len = abstract_addr(&mgr, argv[1], ".mgr");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	/* dpstmgr registers first */
+	receive(fd, 2000);
+
+	while (fgets(line, sizeof(line), script)) {
+		struct dpst_hist_data hist;
+		struct dpst_hint hint;
+		char *p = line;
+		int i, n;
+
+		memset(&hist, 0, sizeof(hist));
+		if (!strncmp(line, "hint", 4)) {
+			hint.version = DPST_HINT_VERSION;
+			if (sscanf(line + 4, "%u %u %u", &hint.content, &hint.fps,
+				   &hint.fullscreen) == 3)
+				send_hint(fd, &hint);
+		} else if (!strncmp(line, "flat", 4)) {
+			n = atoi(line + 4);
+			for (i = 0; i <= n && i < DPST_HIST_BINS; i++)
+				hist.bins[i] = 1000;
+			send_hist(fd, &mgr, mgr_len, &hist);
+		} else if (!strncmp(line, "hist", 4)) {
+			p += 4;
+			for (i = 0; i < DPST_HIST_BINS; i++)
+				hist.bins[i] = strtoul(p, &p, 0);
+			send_hist(fd, &mgr, mgr_len, &hist);
+		} else if (!strncmp(line, "sleep", 5)) {
+			receive(fd, atoi(line + 5));
+			continue;
+		}
+		/* let dpstmgr react before the next line */
+		receive(fd, 5);
+	}
+
+	receive(fd, 1000);
+	return 0;
+}
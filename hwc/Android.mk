@@ -27,18 +27,26 @@ LOCAL_COPY_HEADERS := \
     IntelBufferManager.h \
     IntelDisplayPlaneManager.h \
     IntelHWCUEventObserver.h \
+    IntelUEventDispatcher.h \
     IntelHWComposer.h \
     IntelHWComposerDrm.h \
     IntelHWComposerDump.h \
     IntelHWComposerLayer.h \
+    IntelMemoryTracker.h \
     IntelOverlayContext.h \
     IntelOverlayHW.h \
     IntelOverlayPlane.h \
     IntelOverlayUtil.h \
+    IntelPlaneArbiter.h \
+    IntelPrepareScheduler.h \
+    IntelSeqlock.h \
     IntelWsbm.h \
     IntelWsbmWrapper.h \
     IntelUtility.h \
-    RotationBufferProvider.h
+    IntelPerfHud.h \
+    IntelHDMIVideoPlanner.h \
+    IntelDisplayStat.h \
+    VideoProcessor.h
 ifeq ($(TARGET_HAS_MULTIPLE_DISPLAY),true)
 LOCAL_COPY_HEADERS += IntelExternalDisplayMonitor.h
 endif
@@ -66,10 +74,19 @@ LOCAL_SRC_FILES := IntelHWComposerModule.cpp \
                    IntelWsbm.cpp \
                    IntelWsbmWrapper.c \
                    IntelHWCUEventObserver.cpp \
+                   IntelUEventDispatcher.cpp \
                    IntelVsyncEventHandler.cpp \
                    IntelFakeVsyncEvent.cpp \
+                   IntelRefreshRateGovernor.cpp \
+                   IntelInitScheduler.cpp \
+                   IntelPrepareScheduler.cpp \
+                   IntelPlaneArbiter.cpp \
+                   IntelMemoryTracker.cpp \
                    IntelUtility.cpp \
-                   RotationBufferProvider.cpp
+                   IntelPerfHud.cpp \
+                   IntelHDMIVideoPlanner.cpp \
+                   IntelDisplayStat.cpp \
+                   VideoProcessor.cpp
 LOCAL_MODULE_TAGS := eng
 LOCAL_MODULE := hwcomposer.$(TARGET_BOARD_PLATFORM)
 LOCAL_CFLAGS:= -DLOG_TAG=\"hwcomposer\" -DLINUX
@@ -103,9 +120,22 @@ ifeq ($(TARGET_HAS_MULTIPLE_DISPLAY),true)
 endif
 
 ifeq ($(INTEL_WIDI), true)
-    LOCAL_SHARED_LIBRARIES += libhwcwidi
+    LOCAL_SHARED_LIBRARIES += libhwcwidi libsync
+    LOCAL_C_INCLUDES += system/core/libsync
     LOCAL_CFLAGS += -DINTEL_WIDI
-    LOCAL_SRC_FILES += WidiDisplayDevice.cpp
+    LOCAL_SRC_FILES += WidiDisplayDevice.cpp \
+                       WidiCscPipeline.cpp \
+                       WidiHeldBufferTable.cpp \
+                       WidiRateController.cpp
+endif
+
+# content hints are only read by the in-tree DPST engine
+ifeq ($(INTEL_DPST),true)
+ifeq ($(INTEL_DPST_ENGINE),true)
+    LOCAL_CFLAGS += -DINTEL_DPST
+    LOCAL_C_INCLUDES += $(LOCAL_PATH)/../dpstmgr
+    LOCAL_SRC_FILES += IntelDpstHint.cpp
+endif
 endif
 
 ifeq ($(BOARD_OVERLAY_USE_SECONDARY_GAMMA),true)
@@ -114,4 +144,9 @@ endif
 
 include $(BUILD_SHARED_LIBRARY)
 
+# host model checks, off by default
+ifeq ($(INTEL_HWC_HOST_TESTS),true)
+include $(LOCAL_PATH)/tests/host/Android.mk
+endif
+
 endif
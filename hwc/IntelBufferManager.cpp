@@ -47,6 +47,7 @@
 #include <IntelHWComposerCfg.h>
 #include <IntelOverlayUtil.h>
 #include <IntelOverlayHW.h>
+#include <IntelPrepareScheduler.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <cutils/log.h>
@@ -230,6 +231,9 @@ IntelDisplayBuffer* IntelTTMBufferManager::map(uint32_t handle)
         return 0;
     }
 
+    // buffer mappings are shared by all displays
+    IntelPrepareScheduler::waitTurn();
+
     void *wsbmBufferObject;
     bool ret = mWsbm->wrapTTMBuffer(handle, &wsbmBufferObject);
     if (ret == false) {
@@ -260,6 +264,9 @@ void IntelTTMBufferManager::unmap(IntelDisplayBuffer *buffer)
         ALOGE("%s: no wsbm found\n", __func__);
         return;
     }
+
+    IntelPrepareScheduler::waitTurn();
+
     mWsbm->unreferenceTTMBuffer(buffer->getBufferObject());
     // destroy it
     delete buffer;
@@ -549,6 +556,9 @@ IntelDisplayBuffer* IntelPVRBufferManager::map(uint32_t handle)
         return 0;
     }
 
+    // buffer mappings are shared by all displays
+    IntelPrepareScheduler::waitTurn();
+
     if (!handle) {
         ALOGE("%s: invalid buffer handle\n", __func__);
         return 0;
@@ -596,6 +606,8 @@ void IntelPVRBufferManager::unmap(IntelDisplayBuffer *buffer)
         return;
     }
 
+    IntelPrepareScheduler::waitTurn();
+
     if (!buffer) {
         ALOGE("%s: invalid buffer\n", __func__);
         return;
@@ -702,6 +714,16 @@ bool IntelPVRBufferManager::updateCursorReg(int count, IntelDisplayBuffer *curso
 }
 
 IntelDisplayBuffer* IntelPVRBufferManager::curAlloc(int w, int h)
+{
+    // one image per digit
+    IntelDisplayBuffer *buffer = curAlloc(w, h, 16);
+
+    if (buffer && buffer->getCpuAddr())
+        drawSingleDigital((uint8_t *)buffer->getCpuAddr(), w, h, w, w * h * 4);
+    return buffer;
+}
+
+IntelDisplayBuffer* IntelPVRBufferManager::curAlloc(int w, int h, int slots)
 {
     if (!mPVR2DHandle) {
         ALOGE("%s: PVR wasn't initialized\n", __func__);
@@ -709,7 +731,7 @@ IntelDisplayBuffer* IntelPVRBufferManager::curAlloc(int w, int h)
     }
     PVR2D_ULONG uFlags = 0;
     PVR2DMEMINFO *pvr2dMemInfo;
-    int fb_size = w * h * 4 * 16;
+    int fb_size = w * h * 4 * slots;
     /*buffer size should align to page size*/
     fb_size = align_to(fb_size, 4096);
     PVR2DERROR err = PVR2DMemAlloc(mPVR2DHandle,
@@ -719,6 +741,7 @@ IntelDisplayBuffer* IntelPVRBufferManager::curAlloc(int w, int h)
                                &(pvr2dMemInfo));
     if (err != PVR2D_OK) {
        ALOGE("%s: failed to map handle %p\n", __func__, mPVR2DHandle);
+       return 0;
     }
     void *virtAddr = pvr2dMemInfo->pBase;
     uint32_t size = pvr2dMemInfo->ui32MemSize;
@@ -734,9 +757,8 @@ IntelDisplayBuffer* IntelPVRBufferManager::curAlloc(int w, int h)
     ALOGD_IF(ALLOW_BUFFER_PRINT,
            "%s: mapped handle %p, gtt %d\n", __func__, pvr2dMemInfo,
          gttOffsetInPage);
-   if (virtAddr){
-      drawSingleDigital((uint8_t *)(virtAddr), w, h, w, w * h * 4);
-   }
+   if (virtAddr)
+      memset(virtAddr, 0, size);
    IntelDisplayBuffer *buffer = new IntelDisplayBuffer(pvr2dMemInfo,
                                                         virtAddr,
                                                         gttOffsetInPage,
@@ -1224,6 +1246,9 @@ IntelDisplayBuffer* IntelGraphicBufferManager::map(uint32_t handle)
     if (!initCheck())
         return 0;
 
+    // buffer mappings are shared by all displays
+    IntelPrepareScheduler::waitTurn();
+
     res = PVRSRVMapDeviceMemory2(&mDevData,
                                 handle,
                                 mGeneralHeap,
@@ -1266,6 +1291,8 @@ void IntelGraphicBufferManager::unmap(IntelDisplayBuffer *buffer)
     if (!initCheck())
         return;
 
+    IntelPrepareScheduler::waitTurn();
+
     memInfo = (PVRSRV_CLIENT_MEM_INFO*)buffer->getBufferObject();
 
     if (!memInfo)
@@ -182,6 +182,8 @@ public:
     virtual bool updateCursorReg(int count, IntelDisplayBuffer *cursorDataBuffer,
                         int x, int y, int w, int h, bool isEnable) {return false;}
     virtual IntelDisplayBuffer* curAlloc(int w, int h) {return 0;}
+    // @slots cleared w x h ARGB cursor images, selected by updateCursorReg
+    virtual IntelDisplayBuffer* curAlloc(int w, int h, int slots) {return 0;}
     virtual void curFree(IntelDisplayBuffer *buffer) {}
     bool initCheck() const { return mInitialized; }
     int getDrmFd() const { return mDrmFd; }
@@ -283,6 +285,7 @@ public:
     bool updateCursorReg(int count, IntelDisplayBuffer *cursorDataBuffer,
                          int x, int y, int w, int h, bool isEnable);
     IntelDisplayBuffer* curAlloc(int w, int h);
+    IntelDisplayBuffer* curAlloc(int w, int h, int slots);
     void curFree(IntelDisplayBuffer *buffer);
 };
 
@@ -41,22 +41,41 @@ IntelDisplayDevice::IntelDisplayDevice(IntelDisplayPlaneManager *pm,
        :  IntelHWComposerDump(), mWsbm(NULL),
           mPlaneManager(pm), mDrm(drm), mBufferManager(bm),
           mGrallocBufferManager(gm), mLayerList(0),
-          mRotationBufProvider(NULL),
+          mVideoProcessor(NULL), mRotationIdleFrames(0),
           mDisplayIndex(index), mForceSwapBuffer(false),
           mHotplugEvent(false), mIsConnected(false),
           mInitialized(false), mIsScreenshotActive(false),
-          mIsBlank(false), mVideoSeekingActive(false)
+          mIsBlank(false), mVideoSeekingActive(false),
+          mLayersDataFrames(0), mLayersDataTime(0), mLayersDataMax(0)
 {
    ALOGD_IF(ALLOW_HWC_PRINT, "%s\n", __func__);
-   initializeRotationBufProvider();
+   // video processor is created on first use
    memset(mFBBuffers, 0, sizeof(mFBBuffers));
    mNextBuffer = 0;
+   IntelMemoryTracker::getInstance().registerTrimmable(
+       IntelMemoryTracker::MEM_ROTATION, this);
 }
 
 IntelDisplayDevice::IntelDisplayDevice::~IntelDisplayDevice()
 {
     ALOGD_IF(ALLOW_HWC_PRINT, "%s\n", __func__);
-    destroyRotationBufProvider();
+    IntelMemoryTracker::getInstance().unregisterTrimmable(this);
+    destroyVideoProcessor();
+}
+
+uint32_t IntelDisplayDevice::trimMemory(int category)
+{
+    uint32_t freed;
+
+    // the last processed buffer may be on screen till the next vblank
+    if (category != IntelMemoryTracker::MEM_ROTATION ||
+        !mVideoProcessor || mRotationIdleFrames < 2)
+        return 0;
+
+    freed = mVideoProcessor->getBufferBytes();
+    if (freed)
+        mVideoProcessor->deinitialize();
+    return freed;
 }
 
 
@@ -153,6 +172,81 @@ bool IntelDisplayDevice::isVideoPutInWindow(int output, hwc_layer_1_t *layer) {
     return inWindow;
 }
 
+// Video layers are composed on overlays, GLES composition of them is what
+// the overlay planes save and what the displays compete for
+bool IntelDisplayDevice::isVideoLayer(hwc_layer_1_t *layer)
+{
+    IMG_native_handle_t *grallocHandle =
+        (IMG_native_handle_t*)layer->handle;
+
+    if (!grallocHandle || (layer->flags & HWC_SKIP_LAYER) ||
+        layer->compositionType == HWC_FRAMEBUFFER_TARGET)
+        return false;
+
+    switch (grallocHandle->iFormat) {
+    case HAL_PIXEL_FORMAT_YV12:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12_VED:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_YUY2:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_UYVY:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_I420:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12_TILE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Video wider than one overlay fetches is shown by two overlays
+bool IntelDisplayDevice::isSplitVideoLayer(hwc_layer_1_t *layer)
+{
+    IMG_native_handle_t *grallocHandle =
+        (IMG_native_handle_t*)layer->handle;
+    int srcWidth = (int)(layer->sourceCropf.right - layer->sourceCropf.left);
+
+    if (!isVideoLayer(layer))
+        return false;
+
+    return IntelOverlayPlane::needsSplit(grallocHandle->iFormat, srcWidth);
+}
+
+void IntelDisplayDevice::addPlaneDemand(int type, int index,
+                                        hwc_layer_1_t *layer)
+{
+    drmModeModeInfoPtr mode = mDrm->getOutputMode(mDisplayIndex);
+    uint32_t refresh = (mode && mode->vrefresh) ? mode->vrefresh : 60;
+    int planes = 1;
+
+    if (type == IntelDisplayPlane::DISPLAY_PLANE_OVERLAY &&
+        isSplitVideoLayer(layer))
+        planes = INTEL_OVERLAY_STRIPE_NUM;
+
+    mPlaneManager->addPlaneDemand(mDisplayIndex, type, index, layer,
+                                  refresh, planes);
+}
+
+// Takes the overlay for the right stripe of a split video layer, the
+// overlay of the left stripe is reclaimed if there's none
+bool IntelDisplayDevice::splitOverlayPrepare(IntelOverlayPlane *overlay,
+                                             hwc_layer_1_t *layer)
+{
+    IntelDisplayPlane *plane;
+
+    if (!isSplitVideoLayer(layer))
+        return true;
+
+    plane = mPlaneManager->getOverlayPlane(mDisplayIndex);
+    if (!plane) {
+        ALOGD_IF(ALLOW_HWC_PRINT, "%s: no overlay for the right stripe\n",
+                 __func__);
+        mPlaneManager->reclaimPlane(overlay);
+        return false;
+    }
+
+    overlay->setSplitPlane(reinterpret_cast<IntelOverlayPlane*>(plane));
+    return true;
+}
+
 bool IntelDisplayDevice::rgbOverlayPrepare(int index,
                                             hwc_layer_1_t *layer, int flags)
 {
@@ -162,7 +256,7 @@ bool IntelDisplayDevice::rgbOverlayPrepare(int index,
     }
 
     // allocate overlay plane
-    IntelDisplayPlane *plane = mPlaneManager->getRGBOverlayPlane();
+    IntelDisplayPlane *plane = mPlaneManager->getRGBOverlayPlane(mDisplayIndex);
     if (!plane) {
         ALOGE("%s: failed to create RGB overlay plane\n", __func__);
         return false;
@@ -193,7 +287,7 @@ bool IntelDisplayDevice::spritePrepare(int index, hwc_layer_1_t *layer, int flag
     }
 
     // allocate sprite plane
-    IntelDisplayPlane *plane = mPlaneManager->getSpritePlane();
+    IntelDisplayPlane *plane = mPlaneManager->getSpritePlane(mDisplayIndex);
     if (!plane) {
         ALOGE("%s: failed to create sprite plane\n", __func__);
         return false;
@@ -600,6 +694,20 @@ bool IntelDisplayDevice::dump(char *buff,
     return true;
 }
 
+void IntelDisplayDevice::dumpLayersData()
+{
+    if (!mLayersDataFrames)
+        return;
+
+    dumpPrintf("  + layers data: %d frames, avg %lld us, max %lld us\n",
+               mLayersDataFrames,
+               mLayersDataTime / mLayersDataFrames / 1000,
+               mLayersDataMax / 1000);
+    dumpPrintf("  + layer state: %d buffer changes in %d checks\n",
+               mLayerList->getStateRevalidations(),
+               mLayerList->getStateChecks());
+}
+
 void IntelDisplayDevice::onHotplugEvent(bool hpd)
 {
     // go through layer list and call plane's onModeChange()
@@ -612,10 +720,26 @@ void IntelDisplayDevice::onHotplugEvent(bool hpd)
     mHotplugEvent = hpd;
     if (hpd && mDrm->isOverlayOff()) {
         if (mPlaneManager->hasReclaimedOverlays())
-            mPlaneManager->disableReclaimedPlanes(IntelDisplayPlane::DISPLAY_PLANE_OVERLAY);
+            mPlaneManager->disableReclaimedPlanes(
+                IntelDisplayPlane::DISPLAY_PLANE_OVERLAY, true);
     }
 }
 
+void IntelDisplayDevice::getPlaneMix(int& overlays, int& sprites,
+                                     int& framebuffer) const
+{
+    overlays = sprites = framebuffer = 0;
+
+    if (!mLayerList)
+        return;
+
+    // primary planes count as sprites
+    overlays = mLayerList->getAttachedOverlayCount();
+    sprites = mLayerList->getAttachedPlanesCount() - overlays;
+    framebuffer = mLayerList->getLayersCount() -
+                  mLayerList->getAttachedPlanesCount();
+}
+
 bool IntelDisplayDevice::blank(int blank)
 {
     bool ret=false;
@@ -655,6 +779,11 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
     if (!list)
 	    return false;
 
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (mRotationIdleFrames < 2)
+        mRotationIdleFrames++;
+
     for (size_t i=0 ; i<(size_t)mLayerList->getLayersCount(); i++) {
         hwc_layer_1_t *layer = &list->hwLayers[i];
         // layer safety check
@@ -668,12 +797,17 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
         if (!plane)
             continue;
 
-        // get layer parameter
+        // get layer parameter, derived on geometry changes
+        const IntelHWComposerLayer::layer_state *state =
+            mLayerList->revalidateLayerState(i, layer);
+        if (!state)
+            continue;
+
         int bobDeinterlace;
-        int srcX = (int)(layer->sourceCropf.left);
-        int srcY = (int)(layer->sourceCropf.top);
-        int srcWidth = (int)(layer->sourceCropf.right - layer->sourceCropf.left);
-        int srcHeight = (int)(layer->sourceCropf.bottom - layer->sourceCropf.top);
+        int srcX = state->srcX;
+        int srcY = state->srcY;
+        int srcWidth = state->srcWidth;
+        int srcHeight = state->srcHeight;
         int planeType = plane->getPlaneType();
 
         if(srcHeight == 1 || srcWidth == 1) {
@@ -706,10 +840,10 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
             continue;
         }
 
-        int bufferWidth = grallocHandle->iWidth;
-        int bufferHeight = grallocHandle->iHeight;
-        uint32_t bufferHandle = grallocHandle->fd[0];
-        int format = grallocHandle->iFormat;
+        int bufferWidth = state->bufferWidth;
+        int bufferHeight = state->bufferHeight;
+        uint32_t bufferHandle = state->bufferHandle;
+        int format = state->format;
         uint32_t transform = layer->transform;
 
         if (planeType == IntelDisplayPlane::DISPLAY_PLANE_OVERLAY) {
@@ -737,6 +871,7 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
             }
 #endif
             // check if can switch to overlay
+            uint32_t vppOps = 0;
             bool useOverlay = useOverlayRotation(layer, i,
                                                  bufferHandle,
                                                  bufferWidth,
@@ -745,7 +880,8 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
                                                  srcY,
                                                  srcWidth,
                                                  srcHeight,
-                                                 transform);
+                                                 transform,
+                                                 vppOps);
 
             if (!useOverlay) {
                 ALOGD_IF(ALLOW_HWC_PRINT,
@@ -764,7 +900,10 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
                 continue;
             }
 
-            bobDeinterlace = isBobDeinterlace(layer);
+            // a deinterlacing pass left a progressive frame, a scaling one
+            // mixed the fields
+            bobDeinterlace = !(vppOps & (VPP_OP_DEINTERLACE | VPP_OP_SCALE)) &&
+                             isBobDeinterlace(layer);
             if (bobDeinterlace) {
                 flags |= IntelDisplayPlane::BOB_DEINTERLACE;
             } else {
@@ -775,9 +914,10 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
             // switch to overlay
             layer->compositionType = HWC_OVERLAY;
 
-            // transformed buffer not from gralloc, can't use it's stride directly
-            uint32_t grallocStride = !transform ? grallocHandle->iStride : align_to(bufferWidth, 32);
-            int format = grallocHandle->iFormat;
+            // transformed or processed buffer not from gralloc, can't use it's
+            // stride directly
+            bool ttmBuffer = transform || vppOps;
+            uint32_t grallocStride = !ttmBuffer ? state->stride : align_to(bufferWidth, 32);
 
             dataBuffer->setFormat(format);
             dataBuffer->setStride(grallocStride);
@@ -787,7 +927,7 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
             dataBuffer->setDeinterlaceType(bobDeinterlace);
             // set the data buffer back to plane
             ret = ((IntelOverlayPlane*)plane)->setDataBuffer(bufferHandle,
-                                                             transform,
+                                                             ttmBuffer,
                                                              grallocHandle);
             if (!ret) {
                 ALOGE("%s: failed to update overlay data buffer\n", __func__);
@@ -801,10 +941,13 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
         } else if (planeType == IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY) {
             IntelRGBOverlayPlane *rgbOverlayPlane =
                 reinterpret_cast<IntelRGBOverlayPlane*>(plane);
+            // convert by a video processing pass when VA can
+            VideoProcessor *vpp =
+                initializeVideoProcessor() ? mVideoProcessor : 0;
             uint32_t yuvBufferHandle =
                 rgbOverlayPlane->convert((uint32_t)grallocHandle,
                                           srcWidth, srcHeight,
-                                          srcX, srcY);
+                                          srcX, srcY, vpp);
             if (!yuvBufferHandle) {
                 ALOGE("updateLayersData: failed to convert\n");
                 continue;
@@ -837,21 +980,8 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
         } else if (planeType == IntelDisplayPlane::DISPLAY_PLANE_SPRITE ||
                    planeType == IntelDisplayPlane::DISPLAY_PLANE_PRIMARY) {
 
-            // adjust the buffer format if no blending is needed
-            // some test cases would fail due to a weird format!
-            if (layer->blending == HWC_BLENDING_NONE) {
-                switch (format) {
-                case HAL_PIXEL_FORMAT_BGRA_8888:
-                    format = HAL_PIXEL_FORMAT_BGRX_8888;
-                    break;
-                case HAL_PIXEL_FORMAT_RGBA_8888:
-                    format = HAL_PIXEL_FORMAT_RGBX_8888;
-                    break;
-                }
-            }
-
             // set data buffer format
-            dataBuffer->setFormat(format);
+            dataBuffer->setFormat(state->planeFormat);
             dataBuffer->setWidth(bufferWidth);
             dataBuffer->setHeight(bufferHeight);
             dataBuffer->setCrop(srcX, srcY, srcWidth, srcHeight);
@@ -878,6 +1008,12 @@ bool IntelDisplayDevice::updateLayersData(hwc_display_contents_1_t *list)
         }
     }
 
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    mLayersDataFrames++;
+    mLayersDataTime += elapsed;
+    if (elapsed > mLayersDataMax)
+        mLayersDataMax = elapsed;
+
     return handled;
 }
 
@@ -913,9 +1049,12 @@ void IntelDisplayDevice::revisitLayerList(hwc_display_contents_1_t *list,
         updateZorderConfig();
 }
 
-bool IntelDisplayDevice::initializeRotationBufProvider()
+bool IntelDisplayDevice::initializeVideoProcessor()
 {
     bool ret = false;
+    if (mVideoProcessor)
+        return true;
+
     if (!mBufferManager) {
         return false;
     }
@@ -940,26 +1079,28 @@ bool IntelDisplayDevice::initializeRotationBufProvider()
         return false;
     }
 
-    mRotationBufProvider = new RotationBufferProvider(mWsbm);
-    if (mRotationBufProvider == NULL) {
-        ALOGE("failed to new RotationBufferProvider");
+    mVideoProcessor = new VideoProcessor(mWsbm);
+    if (mVideoProcessor == NULL) {
+        ALOGE("failed to new VideoProcessor");
+        destroyVideoProcessor();
         return false;
     }
 
-    if (!mRotationBufProvider->initialize()) {
-        ALOGE("failed to initialize RotationBufferProvider");
+    if (!mVideoProcessor->initialize()) {
+        ALOGE("failed to initialize VideoProcessor");
+        destroyVideoProcessor();
         return false;
     }
 
     return true;
 }
 
-void IntelDisplayDevice::destroyRotationBufProvider()
+void IntelDisplayDevice::destroyVideoProcessor()
 {
-    if (mRotationBufProvider) {
-        mRotationBufProvider->deinitialize();
-        delete mRotationBufProvider;
-        mRotationBufProvider = NULL;
+    if (mVideoProcessor) {
+        mVideoProcessor->deinitialize();
+        delete mVideoProcessor;
+        mVideoProcessor = NULL;
     }
 
     if (mWsbm) {
@@ -987,12 +1128,28 @@ void IntelDisplayDevice::updateZorderConfig()
     mPlaneManager->setZOrderConfig(zOrderConfig, 0);
 }
 
+// Is the source downscaled more than the overlay scaler can take
+bool IntelDisplayDevice::isOverlayDownscaleLimited(
+                const IntelHWComposerLayer::layer_state *state,
+                uint32_t transform)
+{
+    int rotated = (transform == HAL_TRANSFORM_ROT_90 ||
+                   transform == HAL_TRANSFORM_ROT_270);
+
+    // factors worked out on the geometry change
+    return state->downscaleX[rotated] > PVR_OVERLAY_MAX_SCALING_RATIO ||
+           state->downscaleY[rotated] > PVR_OVERLAY_MAX_SCALING_RATIO;
+}
+
 // This function performs:
 // 1) update layer's transform to data buffer's payload buffer, so that video
 //    driver can get the latest transform info of this layer
 // 2) if rotation is needed, video driver would setup the rotated buffer, then
 //    update buffer's payload to inform HWC rotation buffer is available.
 // 3) HWC would keep using ST till all rotation buffers are ready.
+// 4) a source the overlay can't downscale is scaled (and rotated) by a
+//    video processing pass into a buffer of the display frame size,
+//    @vppOps tells what the pass did.
 // Return: false if HWC is NOT ready to switch to overlay, otherwise true.
 bool IntelDisplayDevice::useOverlayRotation(hwc_layer_1_t *layer,
                                          int index,
@@ -1000,7 +1157,8 @@ bool IntelDisplayDevice::useOverlayRotation(hwc_layer_1_t *layer,
                                          int& w, int& h,
                                          int& srcX, int& srcY,
                                          int& srcW, int& srcH,
-                                         uint32_t &transform)
+                                         uint32_t &transform,
+                                         uint32_t &vppOps)
 {
     bool useOverlay = false;
     uint32_t hwcLayerTransform;
@@ -1048,35 +1206,101 @@ bool IntelDisplayDevice::useOverlayRotation(hwc_layer_1_t *layer,
             transform = metadata_transform;
         }
 
-        if (!transform) {
+        const IntelHWComposerLayer::layer_state *state =
+            mLayerList->getLayerState(index);
+        bool downscale = state && isOverlayDownscaleLimited(state, transform);
+        bool hwcRotation = transform &&
+                           transform != uint32_t(payload->client_transform);
+
+        if (!transform && !downscale) {
             ALOGD_IF(ALLOW_HWC_PRINT,
                     "%s: use overlay to display original buffer.", __func__);
             return true;
         }
 
-        if (transform != uint32_t(payload->client_transform)) {
+        if (hwcRotation) {
             payload->hwc_timestamp = systemTime();
             payload->layer_transform = transform;
 
             ALOGD_IF(ALLOW_HWC_PRINT,
                     "%s: rotation buffer was not prepared by client! ui64Stamp = %llu", __func__, grallocHandle->ui64Stamp);
 
-            if ( payload->force_output_method == OUTPUT_FORCE_OVERLAY ||
-                payload->surface_protected) {
-                bool ret = false;
-                if (!mRotationBufProvider) {
-                    ALOGE("failed to initialize RotationBufProvider");
-                    return false;
-                }
-                ret = mRotationBufProvider->setupRotationBuffer(payload, transform);
-                if (ret == false) {
-                    ALOGE("failed to provider the rotation buffer");
-                    return false;
-                }
-            } else
+            if (payload->force_output_method != OUTPUT_FORCE_OVERLAY &&
+                !payload->surface_protected)
                 return false;
         }
 
+        if (hwcRotation || downscale) {
+            VppRequest request;
+            VppOutput output;
+
+            if (payload->format != VA_FOURCC_NV12 ||
+                payload->width == 0 || payload->height == 0) {
+                ALOGE("%s: payload data is not correct", __func__);
+                return false;
+            }
+
+            if (!initializeVideoProcessor()) {
+                ALOGE("failed to initialize VideoProcessor");
+                return false;
+            }
+
+            memset(&request, 0, sizeof(request));
+            request.source.memory = VPP_MEMORY_KERNEL;
+            request.source.handle = payload->khandle;
+            request.source.fourcc = payload->format;
+            request.source.width = payload->width;
+            request.source.height = payload->height;
+            request.source.stride =
+                VideoProcessor::getStride(false, payload->width);
+            request.source.tiling = payload->tiling;
+            request.source.cropWidth = payload->crop_width;
+            request.source.cropHeight = payload->crop_height;
+            request.transform = transform;
+            request.deinterlace = (payload->bob_deinterlace == 1);
+
+            if (downscale) {
+                request.crop.x = srcX;
+                request.crop.y = srcY;
+                request.crop.width = srcW;
+                request.crop.height = srcH;
+                request.width = align_to(layer->displayFrame.right -
+                                         layer->displayFrame.left, 2);
+                request.height = align_to(layer->displayFrame.bottom -
+                                          layer->displayFrame.top, 2);
+            } else if (transform == HAL_TRANSFORM_ROT_180) {
+                request.width = payload->width;
+                request.height = payload->height;
+            } else {
+                request.width = payload->height;
+                request.height = payload->width;
+            }
+
+            if (!mVideoProcessor->process(request, output)) {
+                ALOGE("failed to process the video buffer");
+                return false;
+            }
+            mRotationIdleFrames = 0;
+            vppOps = output.ops;
+
+            if (downscale) {
+                // the whole buffer is the scaled crop
+                handle = output.khandle;
+                w = output.stride;
+                h = output.height;
+                srcX = 0;
+                srcY = 0;
+                srcW = request.width;
+                srcH = request.height;
+                return true;
+            }
+
+            // Populate payload fields so that overlayPlane can flip the buffer
+            payload->rotated_width = output.stride;
+            payload->rotated_height = output.height;
+            payload->rotated_buffer_handle = output.khandle;
+        }
+
         // update handle, w & h to rotation buffer
         handle = payload->rotated_buffer_handle;
         w = payload->rotated_width;
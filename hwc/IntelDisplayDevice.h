@@ -34,7 +34,9 @@
 #include <IntelBufferManager.h>
 #include <IntelHWComposerLayer.h>
 #include <IntelHWComposerDump.h>
-#include "RotationBufferProvider.h"
+#include <IntelMemoryTracker.h>
+#include "VideoProcessor.h"
+#include <IntelHDMIVideoPlanner.h>
 
 class IntelDisplayConfig {
 private:
@@ -66,7 +68,8 @@ struct WidiExtendedModeInfo {
     bool videoSentToWidi;
 };
 
-class IntelDisplayDevice : public IntelHWComposerDump {
+class IntelDisplayDevice : public IntelHWComposerDump,
+                           public IntelMemoryTrimmable {
 private:
     IntelWsbm *mWsbm;
 protected:
@@ -76,7 +79,9 @@ protected:
     IntelBufferManager *mBufferManager;
     IntelBufferManager *mGrallocBufferManager;
     IntelHWComposerLayerList *mLayerList;
-    RotationBufferProvider *mRotationBufProvider;
+    VideoProcessor *mVideoProcessor;
+    // frames prepared since the processed buffers were last used
+    int mRotationIdleFrames;
     uint32_t mDisplayIndex;
     bool mForceSwapBuffer;
     bool mHotplugEvent;
@@ -100,6 +105,11 @@ protected:
     } mFBBuffers[NUM_FB_BUFFERS];
     int mNextBuffer;
 
+    // time spent updating the layers data each frame
+    uint32_t mLayersDataFrames;
+    nsecs_t mLayersDataTime;
+    nsecs_t mLayersDataMax;
+
 protected:
     virtual bool isHWCUsage(int usage);
     virtual bool isHWCFormat(int format);
@@ -108,6 +118,10 @@ protected:
     virtual bool isHWCLayer(hwc_layer_1_t *layer);
     virtual bool areLayersIntersecting(hwc_layer_1_t *top, hwc_layer_1_t* bottom);
     virtual bool isLayerSandwiched(int index, hwc_display_contents_1_t *list);
+    bool isVideoLayer(hwc_layer_1_t *layer);
+    bool isSplitVideoLayer(hwc_layer_1_t *layer);
+    void addPlaneDemand(int type, int index, hwc_layer_1_t *layer);
+    bool splitOverlayPrepare(IntelOverlayPlane *overlay, hwc_layer_1_t *layer);
 
     virtual bool isOverlayLayer(hwc_display_contents_1_t *list,
                         int index,
@@ -140,18 +154,25 @@ protected:
     bool updateLayersData(hwc_display_contents_1_t *list);
     void revisitLayerList(hwc_display_contents_1_t *list,
                                               bool isGeometryChanged);
+    bool initializeVideoProcessor();
+    void dumpLayersData();
 private:
-    bool initializeRotationBufProvider();
-    void destroyRotationBufProvider();
+    void destroyVideoProcessor();
     void updateZorderConfig();
     bool isBobDeinterlace(hwc_layer_1_t *layer);
     bool useOverlayRotation(hwc_layer_1_t *layer, int index, uint32_t& handle,
                            int& w, int& h,
-                           int& srcX, int& srcY, int& srcW, int& srcH, uint32_t& transform);
+                           int& srcX, int& srcY, int& srcW, int& srcH,
+                           uint32_t& transform, uint32_t& vppOps);
+    bool isOverlayDownscaleLimited(
+                const IntelHWComposerLayer::layer_state *state,
+                uint32_t transform);
 
 public:
     virtual bool initCheck() { return mInitialized; }
     virtual bool prepare(hwc_display_contents_1_t *hdc) {return true;}
+    // tells the plane manager which planes this frame would use
+    virtual void collectPlaneDemands(hwc_display_contents_1_t *hdc) {}
     virtual bool commit(hwc_display_contents_1_t *hdc, buffer_handle_t *bh,
                         int* acqureFenceFd, int** releaseFenceFd,
                         int &numBuffers) { return true; }
@@ -159,6 +180,9 @@ public:
     virtual bool dump(char *buff, int buff_len, int *cur_len);
     virtual bool blank(int blank);
     virtual void onHotplugEvent(bool hpd);
+    virtual uint32_t trimMemory(int category);
+    // planes the layers of the last prepare went to
+    void getPlaneMix(int& overlays, int& sprites, int& framebuffer) const;
 
     virtual bool getDisplayConfig(uint32_t* configs, size_t* numConfigs);
     virtual bool getDisplayAttributes(uint32_t config,
@@ -177,6 +201,8 @@ class IntelMIPIDisplayDevice : public IntelDisplayDevice {
 protected:
     WidiExtendedModeInfo *mExtendedModeInfo;
     bool mVideoSentToWidi;
+    // video player state seen by the last prepare
+    bool mVideoPrepared;
 
 
     buffer_handle_t mLastHandles[5];
@@ -221,6 +247,7 @@ public:
                            uint32_t index);
     ~IntelMIPIDisplayDevice();
     virtual bool prepare(hwc_display_contents_1_t *hdc);
+    virtual void collectPlaneDemands(hwc_display_contents_1_t *hdc);
     virtual bool commit(hwc_display_contents_1_t *hdc, buffer_handle_t *bh,
                         int* acqureFenceFd, int** releaseFenceFd, int &numBuffers);
     virtual bool dump(char *buff, int buff_len, int *cur_len);
@@ -242,8 +269,8 @@ private:
                                     buffer_handle_t *bh,
                                     int &numBuffers,int*acqureFenceFd,int**releaseFenceFd);
     bool needFlipOverlay(hwc_display_contents_1_t *list);
-    bool determineGraphicVisibilityInExtendMode(hwc_display_contents_1_t *list,int index);
     void enableHDMIGraphicPlane(bool enable);
+    void restoreComposition(hwc_display_contents_1_t *list);
 public:
     IntelHDMIDisplayDevice(IntelBufferManager *bm,
                        IntelBufferManager *gm,
@@ -253,15 +280,23 @@ public:
 
     ~IntelHDMIDisplayDevice();
     virtual bool prepare(hwc_display_contents_1_t *hdc);
+    virtual void collectPlaneDemands(hwc_display_contents_1_t *hdc);
     virtual bool commit(hwc_display_contents_1_t *hdc, buffer_handle_t *bh,
                         int* acqureFenceFd, int** releaseFenceFd, int &numBuffers);
     virtual bool dump(char *buff, int buff_len, int *cur_len);
 
+    virtual bool blank(int blank);
     virtual void onHotplugEvent(bool hpd);
     virtual bool getDisplayConfig(uint32_t* configs, size_t* numConfigs);
     virtual bool getDisplayAttributes(uint32_t config,
             const uint32_t* attributes, int32_t* values);
 private:
     bool mGraphicPlaneVisible;
+    // plane B state unknown after a mode set or a blank, the next toggle
+    // goes out
+    bool mGraphicPlaneKnown;
+    // layers other than the video are left out of the FB target
+    bool mCompositionSkipped;
+    IntelHDMIVideoPlanner mPlanner;
 };
 #endif /*__INTEL__DISPLAY_DEVICE__*/
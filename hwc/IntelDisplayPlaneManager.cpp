@@ -42,7 +42,10 @@
  *    Jackie Li <yaodong.li@intel.com>
  *
  */
+#include <poll.h>
+#include <unistd.h>
 #include <IntelDisplayPlaneManager.h>
+#include <IntelPrepareScheduler.h>
 
 IntelDisplayPlaneManager::IntelDisplayPlaneManager(int fd,
                                                    IntelBufferManager *bm,
@@ -52,6 +55,8 @@ IntelDisplayPlaneManager::IntelDisplayPlaneManager(int fd,
       mFreeSpritePlanes(0), mFreePrimaryPlanes(0), mFreeOverlayPlanes(0),
       mReclaimedSpritePlanes(0), mReclaimedPrimaryPlanes(0),
       mReclaimedOverlayPlanes(0),
+      mDisabledOverlays(0), mReusedOverlays(0), mForcedDisables(0),
+      mDisableLatencyTotal(0), mDisableLatencyMax(0),
       mDrmFd(fd), mBufferManager(bm), mGrallocBufferManager(gm),
       mInitialized(false)
 {
@@ -62,6 +67,19 @@ IntelDisplayPlaneManager::IntelDisplayPlaneManager(int fd,
     // detect display plane usage. Hopefully throw DRM ioctl
     detect();
 
+    memset(mSpriteOwners, 0xff, sizeof(mSpriteOwners));
+    memset(mOverlayOwners, 0xff, sizeof(mOverlayOwners));
+    memset(mOverlayLifecycle, 0, sizeof(mOverlayLifecycle));
+    memset(mFrames, 0, sizeof(mFrames));
+    memset((void*)mVsyncCount, 0, sizeof(mVsyncCount));
+    memset(mLatches, 0, sizeof(mLatches));
+    for (int disp = 0; disp < IntelPlaneArbiter::DISPLAY_MAX; disp++) {
+        for (int f = 0; f < FRAME_TRACK_DEPTH; f++)
+            mFrames[disp].frames[f].fence = -1;
+    }
+    mArbiter.setCapacity(IntelPlaneArbiter::POOL_SPRITE, mSpritePlaneCount);
+    mArbiter.setCapacity(IntelPlaneArbiter::POOL_OVERLAY, mOverlayPlaneCount);
+
     // allocate plane context
     mContextLength = sizeof(struct mdfld_plane_contexts);
 
@@ -272,6 +290,14 @@ IntelDisplayPlaneManager::~IntelDisplayPlaneManager()
     if (mZOrderConfigs)
         free(mZOrderConfigs);
 
+    // drop fences of frames still in flight
+    for (int disp = 0; disp < IntelPlaneArbiter::DISPLAY_MAX; disp++) {
+        for (int f = 0; f < FRAME_TRACK_DEPTH; f++) {
+            if (mFrames[disp].frames[f].fence >= 0)
+                close(mFrames[disp].frames[f].fence);
+        }
+    }
+
     mInitialized = false;
 }
 
@@ -303,71 +329,85 @@ void IntelDisplayPlaneManager::detect()
                  mSpritePlaneCount, mPrimaryPlaneCount, mOverlayPlaneCount);
 }
 
-int IntelDisplayPlaneManager::getPlane(uint32_t& mask)
+int IntelDisplayPlaneManager::getPlane(volatile int32_t *mask)
 {
-    if (!mask)
-        return -1;
+    int32_t old;
+    int index;
+
+    do {
+        old = android_atomic_acquire_load(mask);
+        if (!old)
+            return -1;
 
-    for (int i = 0; i < 32; i++) {
-	int bit = (1 << i);
-        if (bit & mask) {
-            mask &= ~bit;
-            return i;
+        for (index = 0; index < 32; index++) {
+            if (old & (1 << index))
+                break;
         }
-    }
+    } while (android_atomic_cmpxchg(old, old & ~(1 << index), mask));
 
-    return -1;
+    return index;
 }
 
-void IntelDisplayPlaneManager::putPlane(int index, uint32_t& mask)
+void IntelDisplayPlaneManager::putPlane(int index, volatile int32_t *mask)
 {
     if (index < 0 || index >= 32)
         return;
 
     int bit = (1 << index);
 
-    if (bit & mask) {
+    if (android_atomic_or(bit, mask) & bit)
         ALOGW("%s: bit %d was set\n", __func__, index);
-        return;
-    }
-
-    mask |= bit;
 }
 
-int IntelDisplayPlaneManager::getPlane(uint32_t& mask, int index)
+int IntelDisplayPlaneManager::getPlane(volatile int32_t *mask, int index)
 {
-    if (!mask || index < 0 || index > mTotalPlaneCount)
+    int32_t old;
+
+    if (index < 0 || index >= 32 || index > mTotalPlaneCount)
         return -1;
 
     int bit = (1 << index);
-    if (bit & mask) {
-        mask &= ~bit;
-        return index;
-    }
+    do {
+        old = android_atomic_acquire_load(mask);
+        if (!(old & bit))
+            return -1;
+    } while (android_atomic_cmpxchg(old, old & ~bit, mask));
 
-    return -1;
+    return index;
 }
 
-IntelDisplayPlane* IntelDisplayPlaneManager::getSpritePlane()
+IntelDisplayPlane* IntelDisplayPlaneManager::getSpritePlane(int disp)
 {
     if (!initCheck()) {
         ALOGE("%s: plane manager was not initialized\n", __func__);
         return 0;
     }
 
+    IntelPrepareScheduler::waitTurn();
+
+    if (!mayTake(IntelPlaneArbiter::POOL_SPRITE, disp)) {
+        ALOGD_IF(ALLOW_PLANE_PRINT, "%s: sprites granted to other displays\n",
+                 __func__);
+        return 0;
+    }
+
     int freePlaneIndex;
 
     // check reclaimed overlay planes
-    freePlaneIndex = getPlane(mReclaimedSpritePlanes);
-    if (freePlaneIndex >= 0)
-        return mSpritePlanes[freePlaneIndex];
+    freePlaneIndex = getPlane(&mReclaimedSpritePlanes);
+    if (freePlaneIndex < 0) {
+        // check free overlay planes
+        freePlaneIndex = getPlane(&mFreeSpritePlanes);
+    }
 
-    // check free overlay planes
-    freePlaneIndex = getPlane(mFreeSpritePlanes);
-    if (freePlaneIndex >= 0)
-        return mSpritePlanes[freePlaneIndex];
-    ALOGE("%s: failed to get a sprite plane\n", __func__);
-    return 0;
+    if (freePlaneIndex < 0) {
+        mArbiter.onStarved(disp);
+        ALOGE("%s: failed to get a sprite plane\n", __func__);
+        return 0;
+    }
+
+    mSpriteOwners[freePlaneIndex] = disp;
+    return mSpritePlanes[freePlaneIndex];
 }
 
 IntelDisplayPlane* IntelDisplayPlaneManager::getPrimaryPlane(int pipe)
@@ -377,82 +417,154 @@ IntelDisplayPlane* IntelDisplayPlaneManager::getPrimaryPlane(int pipe)
         return 0;
     }
 
+    IntelPrepareScheduler::waitTurn();
+
     int freePlaneIndex;
 
     // check reclaimed primary planes
-    freePlaneIndex = getPlane(mReclaimedPrimaryPlanes, pipe);
+    freePlaneIndex = getPlane(&mReclaimedPrimaryPlanes, pipe);
     if (freePlaneIndex >= 0)
         return mPrimaryPlanes[freePlaneIndex];
 
     // check free overlay planes
-    freePlaneIndex = getPlane(mFreePrimaryPlanes, pipe);
+    freePlaneIndex = getPlane(&mFreePrimaryPlanes, pipe);
     if (freePlaneIndex >= 0)
         return mPrimaryPlanes[freePlaneIndex];
     ALOGE("%s: failed to get a primary plane\n", __func__);
     return 0;
 }
 
-IntelDisplayPlane* IntelDisplayPlaneManager::getOverlayPlane()
+IntelDisplayPlane* IntelDisplayPlaneManager::getOverlayPlane(int disp)
 {
     if (!initCheck()) {
         ALOGE("%s: plane manager was not initialized\n", __func__);
         return 0;
     }
 
+    IntelPrepareScheduler::waitTurn();
+
+    if (!mayTake(IntelPlaneArbiter::POOL_OVERLAY, disp)) {
+        ALOGD_IF(ALLOW_PLANE_PRINT, "%s: overlays granted to other displays\n",
+                 __func__);
+        return 0;
+    }
+
     int freePlaneIndex;
 
     // check reclaimed overlay planes
-    freePlaneIndex = getPlane(mReclaimedOverlayPlanes);
+    freePlaneIndex = getPlane(&mReclaimedOverlayPlanes);
     if (freePlaneIndex < 0) {
        // check free overlay planes
-       freePlaneIndex = getPlane(mFreeOverlayPlanes);
+       freePlaneIndex = getPlane(&mFreeOverlayPlanes);
     }
 
     if (freePlaneIndex < 0) {
+       mArbiter.onStarved(disp);
        ALOGE("%s: failed to get a overlay plane\n", __func__);
        return 0;
     }
 
+    mOverlayOwners[freePlaneIndex] = disp;
+    setOverlayActive(freePlaneIndex);
     return mOverlayPlanes[freePlaneIndex];
 }
 
-IntelDisplayPlane* IntelDisplayPlaneManager::getRGBOverlayPlane()
+IntelDisplayPlane* IntelDisplayPlaneManager::getRGBOverlayPlane(int disp)
 {
     if (!initCheck()) {
         ALOGE("%s: plane manager was not initialized\n", __func__);
         return 0;
     }
 
+    IntelPrepareScheduler::waitTurn();
+
+    if (!mayTake(IntelPlaneArbiter::POOL_OVERLAY, disp)) {
+        ALOGD_IF(ALLOW_PLANE_PRINT, "%s: overlays granted to other displays\n",
+                 __func__);
+        return 0;
+    }
+
     int freePlaneIndex;
 
     // check reclaimed overlay planes
-    freePlaneIndex = getPlane(mReclaimedOverlayPlanes);
+    freePlaneIndex = getPlane(&mReclaimedOverlayPlanes);
     if (freePlaneIndex < 0) {
        // check free overlay planes
-       freePlaneIndex = getPlane(mFreeOverlayPlanes);
+       freePlaneIndex = getPlane(&mFreeOverlayPlanes);
     }
 
     if (freePlaneIndex < 0) {
+       mArbiter.onStarved(disp);
        ALOGE("%s: failed to get a RGB overlay plane\n", __func__);
        return 0;
     }
 
+    mOverlayOwners[freePlaneIndex] = disp;
+    setOverlayActive(freePlaneIndex);
     return mRGBOverlayPlanes[freePlaneIndex];
 }
 
-bool IntelDisplayPlaneManager::hasFreeSprites()
+int IntelDisplayPlaneManager::countOwned(const int *owners,
+                                         int count, int disp) const
+{
+    int owned = 0;
+
+    for (int i = 0; i < count && i < 32; i++) {
+        if (owners[i] == disp)
+            owned++;
+    }
+    return owned;
+}
+
+bool IntelDisplayPlaneManager::mayTake(int pool, int disp)
+{
+    int limit = mArbiter.getLimit(disp, pool);
+
+    if (limit < 0)
+        return true;
+
+    if (pool == IntelPlaneArbiter::POOL_SPRITE)
+        return countOwned(mSpriteOwners, mSpritePlaneCount, disp) < limit;
+    return countOwned(mOverlayOwners, mOverlayPlaneCount, disp) < limit;
+}
+
+void IntelDisplayPlaneManager::setOwner(IntelDisplayPlane *plane, int disp)
+{
+    int index = plane->mIndex;
+
+    if (index < 0 || index >= 32)
+        return;
+
+    if (plane->mType == IntelDisplayPlane::DISPLAY_PLANE_OVERLAY ||
+        plane->mType == IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY)
+        mOverlayOwners[index] = disp;
+    else if (plane->mType == IntelDisplayPlane::DISPLAY_PLANE_SPRITE)
+        mSpriteOwners[index] = disp;
+}
+
+bool IntelDisplayPlaneManager::hasFreeSprites(int disp)
 {
     if (!initCheck())
         return false;
 
+    IntelPrepareScheduler::waitTurn();
+
+    if (!mayTake(IntelPlaneArbiter::POOL_SPRITE, disp))
+        return false;
+
     return (mFreeSpritePlanes || mReclaimedSpritePlanes) ? true : false;
 }
 
-bool IntelDisplayPlaneManager::hasFreeOverlays()
+bool IntelDisplayPlaneManager::hasFreeOverlays(int disp)
 {
     if (!initCheck())
         return false;
 
+    IntelPrepareScheduler::waitTurn();
+
+    if (!mayTake(IntelPlaneArbiter::POOL_OVERLAY, disp))
+        return false;
+
     return (mFreeOverlayPlanes || mReclaimedOverlayPlanes) ? true : false;
 }
 
@@ -461,12 +573,14 @@ bool IntelDisplayPlaneManager::hasReclaimedOverlays()
     if (!initCheck())
         return false;
 
+    IntelPrepareScheduler::waitTurn();
+
     return (mReclaimedOverlayPlanes) ? true : false;
 }
 
-bool IntelDisplayPlaneManager::hasFreeRGBOverlays()
+bool IntelDisplayPlaneManager::hasFreeRGBOverlays(int disp)
 {
-	return hasFreeOverlays();
+	return hasFreeOverlays(disp);
 }
 
 bool IntelDisplayPlaneManager::primaryAvailable(int pipe)
@@ -474,6 +588,8 @@ bool IntelDisplayPlaneManager::primaryAvailable(int pipe)
     if (!initCheck())
         return false;
 
+    IntelPrepareScheduler::waitTurn();
+
     return ((mFreePrimaryPlanes & (1 << pipe)) ||
             (mReclaimedPrimaryPlanes & (1 << pipe))) ? true : false;
 }
@@ -488,34 +604,70 @@ void IntelDisplayPlaneManager::reclaimPlane(IntelDisplayPlane *plane)
         return;
     }
 
+    IntelPrepareScheduler::waitTurn();
+
     int index = plane->mIndex;
 
     ALOGD_IF(ALLOW_PLANE_PRINT, "%s: reclaimPlane %d\n", __func__, index);
 
+    // the layer shows up in the next framebuffer frame of its display
+    if ((plane->mType == IntelDisplayPlane::DISPLAY_PLANE_OVERLAY ||
+         plane->mType == IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY) &&
+        index >= 0 && index < 32) {
+        int disp = mOverlayOwners[index];
+        if (disp < 0 || disp >= IntelPlaneArbiter::DISPLAY_MAX)
+            disp = HWC_DISPLAY_PRIMARY;
+
+        android::Mutex::Autolock _l(mFrameLock);
+        struct plane_lifecycle& lc = mOverlayLifecycle[index];
+        lc.state = PLANE_RECLAIMED;
+        lc.disp = disp;
+        lc.frame = mFrames[disp].posted + 1;
+        lc.idleTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+
+    setOwner(plane, -1);
+
+    // the overlay showing the other stripe goes with it
+    if (plane->mType == IntelDisplayPlane::DISPLAY_PLANE_OVERLAY) {
+        IntelOverlayPlane *overlay = static_cast<IntelOverlayPlane*>(plane);
+        IntelOverlayPlane *split = overlay->getSplitPlane();
+        if (split) {
+            overlay->setSplitPlane(0);
+            reclaimPlane(split);
+        }
+    }
+
     if (plane->mType == IntelDisplayPlane::DISPLAY_PLANE_OVERLAY ||
         plane->mType == IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY)
-        putPlane(index, mReclaimedOverlayPlanes);
+        putPlane(index, &mReclaimedOverlayPlanes);
     else if (plane->mType == IntelDisplayPlane::DISPLAY_PLANE_SPRITE)
-        putPlane(index, mReclaimedSpritePlanes);
+        putPlane(index, &mReclaimedSpritePlanes);
     else if (plane->mType == IntelDisplayPlane::DISPLAY_PLANE_PRIMARY)
-        putPlane(index, mReclaimedPrimaryPlanes);
+        putPlane(index, &mReclaimedPrimaryPlanes);
     else
         ALOGE("%s: invalid plane type %d\n", __func__, plane->mType);
 }
 
-void IntelDisplayPlaneManager::disableReclaimedPlanes(int type)
+void IntelDisplayPlaneManager::disableReclaimedPlanes(int type, bool force)
 {
+    int32_t reclaimed;
+
     if (!initCheck()) {
         ALOGE("%s: plane manager is not initialized\n", __func__);
         return;
     }
 
-    // disable reclaimed sprite planes
-    if (type == IntelDisplayPlane::DISPLAY_PLANE_SPRITE &&
-        mSpritePlanes && mReclaimedSpritePlanes) {
-        for (int i = 0; i < mSpritePlaneCount; i++) {
+    IntelPrepareScheduler::waitTurn();
+
+    // disable reclaimed sprite planes, their disables go out with the
+    // plane contexts of the next post and flip along with the frame
+    if (type == IntelDisplayPlane::DISPLAY_PLANE_SPRITE && mSpritePlanes) {
+        // take the reclaimed planes, a racing reclaim lands in the next pass
+        reclaimed = android_atomic_and(0, &mReclaimedSpritePlanes);
+        for (int i = 0; reclaimed && i < mSpritePlaneCount; i++) {
             int bit = (1 << i);
-            if (mReclaimedSpritePlanes & bit) {
+            if (reclaimed & bit) {
                 if (mSpritePlanes[i]) {
                     // disable plane
                     mSpritePlanes[i]->disable();
@@ -525,16 +677,16 @@ void IntelDisplayPlaneManager::disableReclaimedPlanes(int type)
             }
         }
         // merge into free sprite bitmap
-        mFreeSpritePlanes |= mReclaimedSpritePlanes;
-        mReclaimedSpritePlanes = 0;
+        if (reclaimed)
+            android_atomic_or(reclaimed, &mFreeSpritePlanes);
     }
 
     // disable reclaimed primary planes
-    if (type == IntelDisplayPlane::DISPLAY_PLANE_PRIMARY &&
-        mPrimaryPlanes && mReclaimedPrimaryPlanes) {
-        for (int i = 0; i < mPrimaryPlaneCount; i++) {
+    if (type == IntelDisplayPlane::DISPLAY_PLANE_PRIMARY && mPrimaryPlanes) {
+        reclaimed = android_atomic_and(0, &mReclaimedPrimaryPlanes);
+        for (int i = 0; reclaimed && i < mPrimaryPlaneCount; i++) {
             int bit = (1 << i);
-            if (mReclaimedPrimaryPlanes & bit) {
+            if (reclaimed & bit) {
                 if (mPrimaryPlanes[i]) {
                     // disable plane
                     mPrimaryPlanes[i]->disable();
@@ -544,41 +696,272 @@ void IntelDisplayPlaneManager::disableReclaimedPlanes(int type)
             }
         }
         // merge into free sprite bitmap
-        mFreePrimaryPlanes |= mReclaimedPrimaryPlanes;
-        mReclaimedPrimaryPlanes = 0;
+        if (reclaimed)
+            android_atomic_or(reclaimed, &mFreePrimaryPlanes);
     }
 
-    // disable reclaimed overlay planes
+    // disable reclaimed overlay planes. Overlay disables hit the
+    // hardware at once while the framebuffer frame now holding the
+    // layer flips later, so wait for that frame to scan out
     if ((type == IntelDisplayPlane::DISPLAY_PLANE_OVERLAY ||
          type == IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY) &&
-        mOverlayPlanes && mRGBOverlayPlanes && mReclaimedOverlayPlanes) {
-        for (int i = 0; i < mOverlayPlaneCount; i++) {
-            int bit = (1 << i);
-            if (mReclaimedOverlayPlanes & bit) {
-                if (mOverlayPlanes[i]) {
-                    mOverlayPlanes[i]->disable();
-                    mOverlayPlanes[i]->waitForFlipCompletion();
-                    mOverlayPlanes[i]->invalidateDataBuffer();
-                }
+        mOverlayPlanes && mRGBOverlayPlanes) {
+        int32_t ready = 0;
+
+        reclaimed = android_atomic_acquire_load(&mReclaimedOverlayPlanes);
+        if (!reclaimed)
+            return;
+
+        {
+            android::Mutex::Autolock _l(mFrameLock);
+            for (int disp = 0; disp < IntelPlaneArbiter::DISPLAY_MAX; disp++)
+                updateShownFrames(disp);
+
+            for (int i = 0; i < mOverlayPlaneCount; i++) {
+                if (!(reclaimed & (1 << i)))
+                    continue;
+                if (!force && !overlayReady(i))
+                    continue;
+                // a racing prepare may have taken it back
+                if (getPlane(&mReclaimedOverlayPlanes, i) < 0)
+                    continue;
+                if (force && (mOverlayLifecycle[i].state == PLANE_RECLAIMED ||
+                     mOverlayLifecycle[i].state == PLANE_DISABLE_PENDING))
+                    mForcedDisables++;
+                ready |= (1 << i);
             }
+        }
 
-            if (mRGBOverlayPlanes[i]) {
-                mRGBOverlayPlanes[i]->disable();
-                mRGBOverlayPlanes[i]->waitForFlipCompletion();
-                mRGBOverlayPlanes[i]->invalidateDataBuffer();
-            }
+        for (int i = 0; ready && i < mOverlayPlaneCount; i++) {
+            if (ready & (1 << i))
+                disableOverlay(i);
         }
         // merge into free overlay bitmap
-        mFreeOverlayPlanes |= mReclaimedOverlayPlanes;
-        mReclaimedOverlayPlanes = 0;
+        if (ready)
+            android_atomic_or(ready, &mFreeOverlayPlanes);
+    }
+}
+
+bool IntelDisplayPlaneManager::hasOverlaysToDisable()
+{
+    int32_t reclaimed;
+
+    if (!initCheck())
+        return false;
+
+    reclaimed = android_atomic_acquire_load(&mReclaimedOverlayPlanes);
+    if (!reclaimed)
+        return false;
+
+    // overlays of every display, their frames latch on their own fences
+    android::Mutex::Autolock _l(mFrameLock);
+    for (int disp = 0; disp < IntelPlaneArbiter::DISPLAY_MAX; disp++)
+        updateShownFrames(disp);
+
+    for (int i = 0; i < mOverlayPlaneCount; i++) {
+        if ((reclaimed & (1 << i)) && overlayReady(i))
+            return true;
+    }
+    return false;
+}
+
+void IntelDisplayPlaneManager::setOverlayActive(int index)
+{
+    if (index < 0 || index >= 32)
+        return;
+
+    android::Mutex::Autolock _l(mFrameLock);
+    struct plane_lifecycle& lc = mOverlayLifecycle[index];
+    if (lc.state == PLANE_RECLAIMED || lc.state == PLANE_DISABLE_PENDING)
+        mReusedOverlays++;
+    lc.state = PLANE_ACTIVE;
+}
+
+// mFrameLock held
+void IntelDisplayPlaneManager::updateShownFrames(int disp)
+{
+    struct frame_track& track = mFrames[disp];
+    int32_t vsync = android_atomic_acquire_load(&mVsyncCount[disp]);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t timeout = milliseconds_to_nanoseconds(FRAME_LATCH_TIMEOUT_MS);
+
+    for (int f = 0; f < FRAME_TRACK_DEPTH; f++) {
+        int latch = -1;
+
+        if (!track.frames[f].frame)
+            continue;
+
+        // release fence of the framebuffer target signals once the
+        // next frame took over the scanout
+        if (track.frames[f].fence >= 0) {
+            struct pollfd fds;
+            fds.fd = track.frames[f].fence;
+            fds.events = POLLIN;
+            fds.revents = 0;
+            if (poll(&fds, 1, 0) > 0)
+                latch = LATCH_FENCE;
+        }
+
+        // SGX may flip late, count vsyncs only for frames without fence
+        if (latch < 0 && track.frames[f].fence < 0 &&
+            vsync - track.frames[f].vsync >= FRAME_LATCH_VSYNCS)
+            latch = LATCH_VSYNC;
+
+        if (latch < 0 && now - track.frames[f].time >= timeout)
+            latch = LATCH_TIMEOUT;
+
+        if (latch < 0)
+            continue;
+
+        if ((int32_t)(track.frames[f].frame - track.shown) > 0)
+            track.shown = track.frames[f].frame;
+        mLatches[latch]++;
+    }
+
+    // frames older than the newest shown one are done as well
+    for (int f = 0; f < FRAME_TRACK_DEPTH; f++) {
+        if (!track.frames[f].frame)
+            continue;
+        if ((int32_t)(track.frames[f].frame - track.shown) > 0)
+            continue;
+        if (track.frames[f].fence >= 0)
+            close(track.frames[f].fence);
+        track.frames[f].fence = -1;
+        track.frames[f].frame = 0;
     }
 }
 
+// mFrameLock held
+bool IntelDisplayPlaneManager::overlayReady(int index)
+{
+    struct plane_lifecycle& lc = mOverlayLifecycle[index];
+    struct frame_track& track = mFrames[lc.disp];
+
+    if (lc.state == PLANE_RECLAIMED &&
+        (int32_t)(track.posted - lc.frame) >= 0)
+        lc.state = PLANE_DISABLE_PENDING;
+
+    if (lc.state == PLANE_DISABLE_PENDING &&
+        (int32_t)(track.shown - lc.frame) >= 0)
+        return true;
+
+    // no frame to wait for
+    return lc.state == PLANE_ACTIVE || lc.state == PLANE_DISABLED;
+}
+
+void IntelDisplayPlaneManager::disableOverlay(int index)
+{
+    if (mOverlayPlanes[index]) {
+        mOverlayPlanes[index]->disable();
+        mOverlayPlanes[index]->waitForFlipCompletion();
+        mOverlayPlanes[index]->invalidateDataBuffer();
+    }
+
+    if (mRGBOverlayPlanes[index]) {
+        mRGBOverlayPlanes[index]->disable();
+        mRGBOverlayPlanes[index]->waitForFlipCompletion();
+        mRGBOverlayPlanes[index]->invalidateDataBuffer();
+    }
+
+    android::Mutex::Autolock _l(mFrameLock);
+    struct plane_lifecycle& lc = mOverlayLifecycle[index];
+    if (lc.state != PLANE_DISABLED && lc.idleTime) {
+        nsecs_t latency = systemTime(SYSTEM_TIME_MONOTONIC) - lc.idleTime;
+        mDisabledOverlays++;
+        mDisableLatencyTotal += latency;
+        if (latency > mDisableLatencyMax)
+            mDisableLatencyMax = latency;
+        ALOGD_IF(ALLOW_PLANE_PRINT,
+                 "%s: overlay %d disabled %lld us after going idle\n",
+                 __func__, index, latency / 1000);
+    }
+    lc.state = PLANE_DISABLED;
+    lc.idleTime = 0;
+}
+
+void IntelDisplayPlaneManager::onFramePosted(int disp, int fence)
+{
+    if (disp < 0 || disp >= IntelPlaneArbiter::DISPLAY_MAX)
+        return;
+
+    android::Mutex::Autolock _l(mFrameLock);
+    struct frame_track& track = mFrames[disp];
+    int f = track.next;
+
+    // oldest frame still in flight, newer ones cover it
+    if (track.frames[f].fence >= 0)
+        close(track.frames[f].fence);
+
+    track.posted++;
+    track.frames[f].frame = track.posted;
+    track.frames[f].fence = (fence >= 0) ? dup(fence) : -1;
+    track.frames[f].vsync = android_atomic_acquire_load(&mVsyncCount[disp]);
+    track.frames[f].time = systemTime(SYSTEM_TIME_MONOTONIC);
+    track.next = (f + 1) % FRAME_TRACK_DEPTH;
+}
+
+void IntelDisplayPlaneManager::onVsync(int disp)
+{
+    if (disp < 0 || disp >= IntelPlaneArbiter::DISPLAY_MAX)
+        return;
+
+    android_atomic_inc(&mVsyncCount[disp]);
+}
+
 void IntelDisplayPlaneManager::resetPlaneContexts()
 {
     memset(mPlaneContexts, 0, mContextLength);
 }
 
+void IntelDisplayPlaneManager::beginPlaneDemands()
+{
+    mArbiter.begin();
+}
+
+void IntelDisplayPlaneManager::addPlaneDemand(int disp, int type, int index,
+                                              hwc_layer_1_t *layer,
+                                              uint32_t refresh, int planes)
+{
+    if (type == IntelDisplayPlane::DISPLAY_PLANE_OVERLAY ||
+        type == IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY)
+        mArbiter.addDemand(disp, IntelPlaneArbiter::POOL_OVERLAY,
+                           index, layer, refresh, planes);
+    else if (type == IntelDisplayPlane::DISPLAY_PLANE_SPRITE)
+        mArbiter.addDemand(disp, IntelPlaneArbiter::POOL_SPRITE,
+                           index, layer, refresh);
+}
+
+void IntelDisplayPlaneManager::arbitratePlanes()
+{
+    if (!initCheck())
+        return;
+
+    mArbiter.arbitrate();
+}
+
+bool IntelDisplayPlaneManager::needsReplan(int disp)
+{
+    bool replan;
+    int limit;
+
+    if (!initCheck() || disp < 0)
+        return false;
+
+    replan = mArbiter.takeReplan(disp);
+
+    // planes granted to another display are released on replanning
+    limit = mArbiter.getLimit(disp, IntelPlaneArbiter::POOL_OVERLAY);
+    if (limit >= 0 &&
+        countOwned(mOverlayOwners, mOverlayPlaneCount, disp) > limit)
+        replan = true;
+    limit = mArbiter.getLimit(disp, IntelPlaneArbiter::POOL_SPRITE);
+    if (limit >= 0 &&
+        countOwned(mSpriteOwners, mSpritePlaneCount, disp) > limit)
+        replan = true;
+
+    return replan;
+}
+
 void* IntelDisplayPlaneManager::getPlaneContexts() const
 {
     return mPlaneContexts;
@@ -601,6 +984,8 @@ int IntelDisplayPlaneManager::setZOrderConfig(int config, int pipe)
     if (pipe > 2 || pipe < 0)
         return -1;
 
+    IntelPrepareScheduler::waitTurn();
+
     if (mZOrderConfigs[pipe] == config)
         return -1;
 
@@ -659,8 +1044,22 @@ bool IntelDisplayPlaneManager::dump(char *buff,
     dumpPrintf("     free primary plane : 0x%x\n", mFreePrimaryPlanes);
     dumpPrintf("     free overlay count : 0x%x\n", mFreeOverlayPlanes);
     dumpPrintf("     plane zOrder: %d\n", mZOrderConfigs[0]);
+    {
+        android::Mutex::Autolock _l(mFrameLock);
+        nsecs_t avg = mDisabledOverlays ?
+            mDisableLatencyTotal / mDisabledOverlays : 0;
+        dumpPrintf("     overlay idle to disable: %u disabled, "
+                   "avg %lld us, max %lld us\n",
+                   mDisabledOverlays, avg / 1000, mDisableLatencyMax / 1000);
+        dumpPrintf("     overlay disables: %u reused, %u forced, "
+                   "latched by fence %u, vsync %u, timeout %u\n",
+                   mReusedOverlays, mForcedDisables, mLatches[LATCH_FENCE],
+                   mLatches[LATCH_VSYNC], mLatches[LATCH_TIMEOUT]);
+    }
     dumpPrintf("-------------End of Plane Infos-----------\n");
 
+    mArbiter.dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+
     *cur_len = mDumpLen;
 
     return ret;
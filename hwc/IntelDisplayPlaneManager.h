@@ -48,6 +48,8 @@
 #include <cutils/log.h>
 #include <cutils/atomic.h>
 #include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
 #include <hardware/hardware.h>
 #include <hardware/gralloc.h>
 #include <hal_public.h>
@@ -55,6 +57,9 @@
 #include <IntelHWComposerDump.h>
 #include <IntelBufferManager.h>
 #include <IntelOverlayHW.h>
+#include <IntelSeqlock.h>
+#include <IntelMemoryTracker.h>
+#include <IntelPlaneArbiter.h>
 #include <IntelHWComposerCfg.h>
 
 #include <linux/psb_drm.h>
@@ -64,6 +69,8 @@ typedef struct intel_overlay_context overlay_plane_context_t;
 typedef struct intel_sprite_context intel_sprite_context_t;
 typedef struct mdfld_plane_contexts mdfld_plane_contexts_t;
 
+class VideoProcessor;
+
 class IntelDisplayPlaneContext {
 public:
     IntelDisplayPlaneContext() {}
@@ -192,7 +199,13 @@ typedef enum {
     OVERLAY_ORIENTATION_LANDSCAPE,
 } intel_overlay_orientation_t;
 
+// bump when the shared context layout changes
+#define INTEL_OVERLAY_CONTEXT_LAYOUT 2
+
 typedef struct {
+    // checked by clients opening the context
+    uint32_t layout;
+
     // back buffer info
     uint32_t back_buffer_handle;
     uint32_t gtt_offset_in_page;
@@ -211,9 +224,8 @@ typedef struct {
     // power info
     intel_overlay_state_t state;
 
-    // ashmem related
-    pthread_mutex_t lock;
-    pthread_mutexattr_t attr;
+    // ashmem related, readers copy the fields they need lock free
+    intel_seqlock_t seqlock;
     volatile int32_t refCount;
 } intel_overlay_context_t;
 
@@ -238,8 +250,14 @@ protected:
     int yStride;
     int uvStride;
     bool mOnTop;
+    // stripe of a split source this overlay shows
+    int mStripeIndex;
+    int mStripeCount;
+    int mStripeStep;
+    intel_overlay_stripe_t mStripe;
 
     bool backBufferInit();
+    bool stripeSetup(IntelDisplayDataBuffer& buf);
     bool bufferOffsetSetup(IntelDisplayDataBuffer& buf);
     uint32_t calculateSWidthSW(uint32_t offset, uint32_t width);
     bool coordinateSetup(IntelDisplayDataBuffer& buf);
@@ -255,6 +273,8 @@ protected:
 
     void lock();
     void unlock();
+    void sharedWriteBegin();
+    void sharedWriteEnd();
 public:
     IntelOverlayContext(int drmFd, IntelBufferManager *bufferManager = NULL)
         :mHandle(0),
@@ -262,14 +282,16 @@ public:
          mOverlayBackBuffer(0),
          mBackBuffer(0),
          mSize(0), mDrmFd(drmFd),
-         mBufferManager(bufferManager) {}
+         mBufferManager(bufferManager),
+         mStripeIndex(0), mStripeCount(1), mStripeStep(0) {}
     IntelOverlayContext()
         :mHandle(0),
          mContext(0),
          mOverlayBackBuffer(0),
          mBackBuffer(0),
          mSize(0),
-         mOnTop(false) {}
+         mOnTop(false),
+         mStripeIndex(0), mStripeCount(1), mStripeStep(0) {}
 
     ~IntelOverlayContext();
 
@@ -294,6 +316,8 @@ public:
     // interfaces for control device
     void setRotation(int rotation);
     void setPosition(int x, int y, int w, int h);
+    // show stripe index of count side by side stripes of the source
+    void setStripe(int index, int count);
 
     // interfaces for both data & control devices
     bool flush(uint32_t flags);
@@ -324,7 +348,8 @@ public:
     bool flush_bottom_field(uint32_t flags);
 };
 
-class IntelOverlayPlane : public IntelDisplayPlane {
+class IntelOverlayPlane : public IntelDisplayPlane,
+                          public IntelMemoryTrimmable {
 private:
     enum {
         //BZ 33017. Don't hold too many buffers in GTT for advoiding reach GTT max size(128M).
@@ -341,6 +366,15 @@ private:
         int grallocBuffFd;
     } mDataBuffers[OVERLAY_DATA_BUFFER_NUM_MAX];
     int mNextBuffer;
+    // slots of the last two posted buffers, kept on trimming
+    int mCurrentSlot;
+    int mPrevSlot;
+    // overlay showing the right stripe of a source too wide for one
+    IntelOverlayPlane *mSplitPlane;
+private:
+    void releaseDataBuffer(int index);
+    void setCurrentSlot(int index);
+    bool setSplitDataBuffer(IntelDisplayDataBuffer& buffer);
 
 public:
     IntelOverlayPlane(int fd, int index, IntelBufferManager *bufferManager);
@@ -359,12 +393,20 @@ public:
     virtual void forceBottom(bool bottom);
     virtual uint32_t onDrmModeChange();
     virtual bool setOverlayOnTop(bool isOnTop);
+    virtual uint32_t trimMemory(int category);
+
+    // split presentation with a second overlay, 0 to stop it
+    void setSplitPlane(IntelOverlayPlane *plane);
+    IntelOverlayPlane* getSplitPlane() const { return mSplitPlane; }
+    static bool needsSplit(int format, int srcWidth);
 };
 
 class IntelRGBOverlayPlane : public IntelOverlayPlane {
 public:
-	virtual uint32_t convert(uint32_t handle, int w, int h, int x, int y);
+	virtual uint32_t convert(uint32_t handle, int w, int h, int x, int y,
+                             VideoProcessor *vpp = 0);
 	virtual bool invalidateDataBuffer();
+	virtual uint32_t trimMemory(int category);
 public:
 	IntelRGBOverlayPlane(int fd, int index,
                             IntelBufferManager *bufferManager);
@@ -375,13 +417,27 @@ private:
         PixelFormatConverter();
         ~PixelFormatConverter();
         bool initialize();
-        uint32_t convertBuffer(uint32_t handle, int w, int h, int x, int y);
+        uint32_t convertBuffer(uint32_t handle, int w, int h, int x, int y,
+                               VideoProcessor *vpp);
         void reset();
+        // free the buffers not posted by the last two conversions
+        uint32_t trim();
+    private:
+        void freeBuffer(uint32_t yuvBuffer);
+        bool processBuffer(IMG_native_handle_t *rgbBuffer,
+                           buffer_handle_t yuvBuffer,
+                           int w, int h, int x, int y, VideoProcessor *vpp);
     private:
         IMG_gralloc_module_public_t *mGrallocModule;
         alloc_device_t *mAllocDev;
         android::KeyedVector<uint64_t, uint32_t> mBufferMapping;
+        // bytes of each converted buffer
+        android::KeyedVector<uint32_t, uint32_t> mBufferSizes;
         uint32_t mCurrentBuffer;
+        uint32_t mCurrentYuv;
+        uint32_t mPrevYuv;
+        // video processing failed, Blit2 till the next reset
+        bool mVppFailed;
     };
 
     PixelFormatConverter *mPixelFormatConverter;
@@ -461,7 +517,51 @@ public:
         ZORDER_OaOcP,
         ZORDER_OcOaP,
     };
+    // lifecycle of an overlay plane after its layer left it
+    enum {
+        PLANE_ACTIVE = 0,
+        // layer went back to the framebuffer, frame not posted yet
+        PLANE_RECLAIMED,
+        // frame composing the layer posted, waiting for its scan out
+        PLANE_DISABLE_PENDING,
+        PLANE_DISABLED,
+    };
 private:
+    enum {
+        // posted frames waiting for their framebuffer release fence
+        FRAME_TRACK_DEPTH = 4,
+        // vsyncs after a post by which the frame surely scanned out
+        FRAME_LATCH_VSYNCS = 2,
+        // fallback when neither fences nor vsyncs come in
+        FRAME_LATCH_TIMEOUT_MS = 50,
+    };
+    enum {
+        LATCH_FENCE = 0,
+        LATCH_VSYNC,
+        LATCH_TIMEOUT,
+        LATCH_NUM,
+    };
+    struct plane_lifecycle {
+        int state;
+        // display whose framebuffer took over the layer
+        int disp;
+        // first frame of @disp composing the layer
+        uint32_t frame;
+        nsecs_t idleTime;
+    };
+    struct frame_track {
+        uint32_t posted;
+        // last frame known to be scanned out
+        uint32_t shown;
+        struct {
+            uint32_t frame;
+            int fence;
+            int32_t vsync;
+            nsecs_t time;
+        } frames[FRAME_TRACK_DEPTH];
+        int next;
+    };
+
     int mSpritePlaneCount;
     int mPrimaryPlaneCount;
     int mOverlayPlaneCount;
@@ -474,12 +574,33 @@ private:
     IntelDisplayPlane **mRGBOverlayPlanes;
 
     // Bitmap of free planes. Bit0 - plane A, bit 1 - plane B, etc.
-    uint32_t mFreeSpritePlanes;
-    uint32_t mFreePrimaryPlanes;
-    uint32_t mFreeOverlayPlanes;
-    uint32_t mReclaimedSpritePlanes;
-    uint32_t mReclaimedPrimaryPlanes;
-    uint32_t mReclaimedOverlayPlanes;
+    // Reserved and released with atomic ops, displays may prepare
+    // on different threads
+    volatile int32_t mFreeSpritePlanes;
+    volatile int32_t mFreePrimaryPlanes;
+    volatile int32_t mFreeOverlayPlanes;
+    volatile int32_t mReclaimedSpritePlanes;
+    volatile int32_t mReclaimedPrimaryPlanes;
+    volatile int32_t mReclaimedOverlayPlanes;
+
+    // display holding each sprite & overlay plane, -1 if none
+    int mSpriteOwners[32];
+    int mOverlayOwners[32];
+    IntelPlaneArbiter mArbiter;
+
+    // overlay lifecycle, guarded by mFrameLock with the frame tracks
+    struct plane_lifecycle mOverlayLifecycle[32];
+    struct frame_track mFrames[IntelPlaneArbiter::DISPLAY_MAX];
+    volatile int32_t mVsyncCount[IntelPlaneArbiter::DISPLAY_MAX];
+    android::Mutex mFrameLock;
+
+    // idle to disable latency of overlays
+    uint32_t mDisabledOverlays;
+    uint32_t mReusedOverlays;
+    uint32_t mForcedDisables;
+    uint32_t mLatches[LATCH_NUM];
+    nsecs_t mDisableLatencyTotal;
+    nsecs_t mDisableLatencyMax;
 
     int mDrmFd;
     IntelBufferManager *mBufferManager;
@@ -500,9 +621,16 @@ private:
 
     bool mInitialized;
 private:
-    int getPlane(uint32_t& mask);
-    int getPlane(uint32_t& mask, int index);
-    void putPlane(int index, uint32_t& mask);
+    int getPlane(volatile int32_t *mask);
+    int getPlane(volatile int32_t *mask, int index);
+    void putPlane(int index, volatile int32_t *mask);
+    int countOwned(const int *owners, int count, int disp) const;
+    bool mayTake(int pool, int disp);
+    void setOwner(IntelDisplayPlane *plane, int disp);
+    void setOverlayActive(int index);
+    void updateShownFrames(int disp);
+    bool overlayReady(int index);
+    void disableOverlay(int index);
 public:
     IntelDisplayPlaneManager(int fd,
                              IntelBufferManager *bm,
@@ -512,19 +640,39 @@ public:
     virtual void detect();
 
     // plane allocation & free
-    IntelDisplayPlane* getSpritePlane();
+    // @disp bounds the planes to what the arbiter granted the display,
+    // -1 takes any free plane
+    IntelDisplayPlane* getSpritePlane(int disp = -1);
     IntelDisplayPlane* getPrimaryPlane(int pipe);
-    IntelDisplayPlane* getOverlayPlane();
-    IntelDisplayPlane* getRGBOverlayPlane();
+    IntelDisplayPlane* getOverlayPlane(int disp = -1);
+    IntelDisplayPlane* getRGBOverlayPlane(int disp = -1);
 
-    bool hasFreeSprites();
-    bool hasFreeOverlays();
+    bool hasFreeSprites(int disp = -1);
+    bool hasFreeOverlays(int disp = -1);
     bool hasReclaimedOverlays();
-    bool hasFreeRGBOverlays();
+    bool hasFreeRGBOverlays(int disp = -1);
     bool primaryAvailable(int index);
 
+    // cross display arbitration, demands of all displays are added
+    // before arbitratePlanes() and before any display takes a plane
+    void beginPlaneDemands();
+    void addPlaneDemand(int disp, int type, int index,
+                        hwc_layer_1_t *layer, uint32_t refresh,
+                        int planes = 1);
+    void arbitratePlanes();
+    // @disp holds planes granted away or misses granted ones
+    bool needsReplan(int disp);
+
     void reclaimPlane(IntelDisplayPlane *plane);
-    void disableReclaimedPlanes(int type);
+    // reclaimed overlays stay on until the framebuffer frame showing
+    // their layers scanned out, @force disables them right away
+    void disableReclaimedPlanes(int type, bool force = false);
+    // any reclaimed overlay of any display whose frame scanned out
+    bool hasOverlaysToDisable();
+    // @fence is the framebuffer target release fence of the frame
+    // posted on @disp, -1 if the frame had none
+    void onFramePosted(int disp, int fence);
+    void onVsync(int disp);
     void *getPlaneContexts() const;
     void resetPlaneContexts();
     int getContextLength() const;
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <cutils/log.h>
+#include <linux/psb_drm.h>
+#include "xf86drm.h"
+#include <IntelHWComposerCfg.h>
+#include <IntelDisplayStat.h>
+
+IntelDisplayStat::IntelDisplayStat(int drmFd) :
+    mDrmFd(drmFd), mRequested(0), mCompleted(0), mDisplayAll(false),
+    mSubmits(0), mRegisters(0)
+{
+    memset(&mSnapshot, 0, sizeof(mSnapshot));
+}
+
+IntelDisplayStat::~IntelDisplayStat()
+{
+
+}
+
+int IntelDisplayStat::submit(struct drm_psb_register_rw_arg *arg)
+{
+    return drmCommandWriteRead(mDrmFd, DRM_PSB_REGISTER_RW,
+                               arg, sizeof(*arg));
+}
+
+int IntelDisplayStat::readVsync(struct drm_psb_vsync_set_arg *arg)
+{
+    return drmCommandWriteRead(mDrmFd, DRM_PSB_VSYNC_SET,
+                               arg, sizeof(*arg));
+}
+
+bool IntelDisplayStat::readRegisters(struct reg_read *reads, int count)
+{
+    struct drm_psb_register_rw_arg arg;
+    int i;
+
+    if (!reads || count <= 0)
+        return false;
+
+    // the kernel serves every read bit of one access
+    memset(&arg, 0, sizeof(struct drm_psb_register_rw_arg));
+    for (i = 0; i < count; i++) {
+        switch (reads[i].reg) {
+        case REG_PIPEA_STAT:
+            arg.display_read_mask |= REGRWBITS_PIPEASTAT;
+            break;
+        case REG_INT_MASK:
+            arg.display_read_mask |= REGRWBITS_INT_MASK;
+            break;
+        case REG_INT_ENABLE:
+            arg.display_read_mask |= REGRWBITS_INT_ENABLE;
+            break;
+        case REG_DISPLAY_ALL:
+            arg.display_read_mask |= REGRWBITS_DISPLAY_ALL;
+            break;
+        default:
+            ALOGE("%s: invalid register %d\n", __func__, reads[i].reg);
+            return false;
+        }
+    }
+
+    int ret = submit(&arg);
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mLock);
+        mSubmits++;
+        mRegisters += count;
+    }
+
+    if (ret) {
+        ALOGW("%s: failed to read display registers %d\n", __func__, ret);
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        switch (reads[i].reg) {
+        case REG_PIPEA_STAT:
+            reads[i].value = arg.display.pipestat_a;
+            break;
+        case REG_INT_MASK:
+            reads[i].value = arg.display.int_mask;
+            break;
+        case REG_INT_ENABLE:
+            reads[i].value = arg.display.int_enable;
+            break;
+        default:
+            reads[i].value = 0;
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool IntelDisplayStat::takeSnapshot(struct snapshot& snap, bool displayAll)
+{
+    struct drm_psb_vsync_set_arg vsync_arg;
+    struct reg_read reads[] = {
+        { REG_PIPEA_STAT, 0 },
+        { REG_INT_MASK, 0 },
+        { REG_INT_ENABLE, 0 },
+        // a full register log, kept last so it can be left out
+        { REG_DISPLAY_ALL, 0 },
+    };
+    int count = sizeof(reads) / sizeof(reads[0]) - (displayAll ? 0 : 1);
+
+    memset(&snap, 0, sizeof(snap));
+
+    memset(&vsync_arg, 0, sizeof(struct drm_psb_vsync_set_arg));
+    vsync_arg.vsync_operation_mask = GET_VSYNC_COUNT;
+    vsync_arg.vsync.pipe = 0;
+
+    int ret = readVsync(&vsync_arg);
+    if (ret) {
+        ALOGW("%s: failed to read vsync info %d\n", __func__, ret);
+        return false;
+    }
+
+    snap.vsyncCount = vsync_arg.vsync.vsync_count;
+    snap.vsyncTimestamp = vsync_arg.vsync.timestamp;
+
+    if (!readRegisters(reads, count))
+        return false;
+
+    snap.pipeAStat = reads[0].value;
+    snap.intMask = reads[1].value;
+    snap.intEnable = reads[2].value;
+    snap.valid = true;
+    return true;
+}
+
+bool IntelDisplayStat::refresh(nsecs_t timeout, bool displayAll)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + timeout;
+    uint32_t request = ++mRequested;
+    if (displayAll)
+        mDisplayAll = true;
+    mCondition.signal();
+
+    while ((int32_t)(mCompleted - request) < 0) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (now >= deadline ||
+            mDone.waitRelative(mLock, deadline - now) != android::NO_ERROR)
+            return false;
+    }
+
+    return true;
+}
+
+IntelDisplayStat::snapshot IntelDisplayStat::getSnapshot() const
+{
+    android::Mutex::Autolock _l(mLock);
+    return mSnapshot;
+}
+
+void IntelDisplayStat::stop()
+{
+    requestExit();
+    {
+        android::Mutex::Autolock _l(mLock);
+        mCondition.signal();
+    }
+    requestExitAndWait();
+}
+
+bool IntelDisplayStat::threadLoop()
+{
+    struct snapshot snap;
+    uint32_t request;
+    bool displayAll;
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mLock);
+        while (mCompleted == mRequested && !exitPending())
+            mCondition.wait(mLock);
+        if (exitPending())
+            return false;
+        request = mRequested;
+        displayAll = mDisplayAll;
+        mDisplayAll = false;
+    }
+
+    // register accesses happen outside of the lock
+    takeSnapshot(snap, displayAll);
+    snap.time = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    android::Mutex::Autolock _l(mLock);
+    mSnapshot = snap;
+    mCompleted = request;
+    mDone.broadcast();
+    return true;
+}
+
+bool IntelDisplayStat::dump(char *buff, int buff_len, int *cur_len)
+{
+    struct snapshot snap = getSnapshot();
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------Display Stat -------------------\n");
+    if (!snap.time) {
+        dumpPrintf("  + no snapshot yet\n");
+    } else if (!snap.valid) {
+        dumpPrintf("  + snapshot failed %lld ms ago\n",
+                   (systemTime(SYSTEM_TIME_MONOTONIC) - snap.time) / 1000000);
+    } else {
+        dumpPrintf("  + snapshot taken %lld ms ago\n",
+                   (systemTime(SYSTEM_TIME_MONOTONIC) - snap.time) / 1000000);
+        dumpPrintf("  + current vsync count: %d, timestamp %d ms \n",
+                   snap.vsyncCount, (int)(snap.vsyncTimestamp / 1000000));
+        dumpPrintf("  + PIPEA STAT: 0x%x \n", snap.pipeAStat);
+        dumpPrintf("  + INT_MASK_REG: 0x%x \n", snap.intMask);
+        dumpPrintf("  + INT_ENABLE_REG: 0x%x \n", snap.intEnable);
+    }
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mLock);
+        dumpPrintf("  + %u register reads in %u accesses\n",
+                   mRegisters, mSubmits);
+    }
+
+    *cur_len = mDumpLen;
+    return true;
+}
+
+android::status_t IntelDisplayStat::readyToRun()
+{
+    return android::NO_ERROR;
+}
+
+void IntelDisplayStat::onFirstRef()
+{
+    ALOGV("Display stat onFirstRef");
+
+    // take a first snapshot right away, dumpsys then has one to print
+    // even if its own refresh doesn't finish in time. it leaves out the
+    // register log, that one is only written when dumpsys asks
+    {
+        android::Mutex::Autolock _l(mLock);
+        mRequested++;
+    }
+    run("HWC Display Stat", android::PRIORITY_BACKGROUND);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_DISPLAY_STAT_H__
+#define __INTEL_DISPLAY_STAT_H__
+
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <IntelHWComposerDump.h>
+
+struct drm_psb_register_rw_arg;
+struct drm_psb_vsync_set_arg;
+
+/**
+ * Class: display register snapshot
+ * Reads display registers in batches: callers list the registers they
+ * want and the whole list goes to the kernel in one register access.
+ * A snapshot of the pipe and interrupt state is taken that way on a
+ * thread of its own when asked for, so dumpsys prints the last snapshot
+ * instead of doing register accesses itself. The kernel accesses are
+ * virtual so a fake register file can stand in for them on a host.
+ */
+class IntelDisplayStat : public android::Thread,
+                         public IntelHWComposerDump
+{
+public:
+    // registers a batch can read
+    enum {
+        REG_PIPEA_STAT = 0,
+        REG_INT_MASK,
+        REG_INT_ENABLE,
+        // driver prints all display registers to the kernel log, no value
+        REG_DISPLAY_ALL,
+        REG_NUM,
+    };
+    struct reg_read {
+        int reg;
+        uint32_t value;
+    };
+    struct snapshot {
+        // taken at, 0 if no snapshot was taken yet
+        nsecs_t time;
+        bool valid;
+        int vsyncCount;
+        uint64_t vsyncTimestamp;
+        uint32_t pipeAStat;
+        uint32_t intMask;
+        uint32_t intEnable;
+    };
+public:
+    IntelDisplayStat(int drmFd);
+    virtual ~IntelDisplayStat();
+    // reads the @count registers of @reads with one kernel access
+    bool readRegisters(struct reg_read *reads, int count);
+    // asks the thread for a new snapshot, waits at most @timeout for it
+    // @displayAll also has the driver log all display registers
+    bool refresh(nsecs_t timeout, bool displayAll);
+    struct snapshot getSnapshot() const;
+    // stops the thread, no refresh is served afterwards
+    void stop();
+    bool dump(char *buff, int buff_len, int *cur_len);
+protected:
+    // kernel accesses, return 0 or the ioctl error
+    virtual int submit(struct drm_psb_register_rw_arg *arg);
+    virtual int readVsync(struct drm_psb_vsync_set_arg *arg);
+private:
+    bool takeSnapshot(struct snapshot& snap, bool displayAll);
+    virtual bool threadLoop();
+    virtual android::status_t readyToRun();
+    virtual void onFirstRef();
+private:
+    mutable android::Mutex mLock;
+    android::Condition mCondition;
+    android::Condition mDone;
+    int mDrmFd;
+    struct snapshot mSnapshot;
+    // refreshes asked for and done
+    uint32_t mRequested;
+    uint32_t mCompleted;
+    // a pending refresh asked for the register log
+    bool mDisplayAll;
+    // kernel accesses and registers they read
+    uint32_t mSubmits;
+    uint32_t mRegisters;
+};
+
+#endif /*__INTEL_DISPLAY_STAT_H__*/
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <cutils/log.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
+#include <IntelHWComposerCfg.h>
+#include <IntelDpstHint.h>
+
+static const nsecs_t FPS_WINDOW = 1000000000LL;
+
+IntelDpstHint::IntelDpstHint() :
+    mHintValid(false), mIdleFrames(0), mWindowStart(0),
+    mWindowFrames(0), mFps(0), mSent(0), mFailed(0)
+{
+    memset(&mHint, 0, sizeof(mHint));
+
+    mSocket = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mSocket < 0)
+        ALOGE("%s: failed to create hint socket, error %d\n", __func__, errno);
+}
+
+IntelDpstHint::~IntelDpstHint()
+{
+    if (mSocket >= 0)
+        close(mSocket);
+}
+
+bool IntelDpstHint::send_l(const struct dpst_hint& hint)
+{
+    struct sockaddr_un addr;
+    socklen_t len;
+
+    if (mSocket < 0)
+        return false;
+
+    // abstract socket name, sun_path[0] stays 0
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path + 1, DPST_HINT_SOCKET);
+    len = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(DPST_HINT_SOCKET);
+
+    if (sendto(mSocket, &hint, sizeof(hint), MSG_DONTWAIT,
+               (struct sockaddr *)&addr, len) != sizeof(hint)) {
+        // dpstmgr not running or busy, retried with the next change
+        ALOGD_IF(ALLOW_HWC_PRINT, "%s: hint not sent, error %d\n",
+                 __func__, errno);
+        mFailed++;
+        return false;
+    }
+
+    mSent++;
+    return true;
+}
+
+void IntelDpstHint::onFrame(int content, bool fullscreen, bool idle)
+{
+    android::Mutex::Autolock _l(mLock);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    bool windowDone = false;
+    struct dpst_hint hint;
+
+    if (idle) {
+        mIdleFrames++;
+    } else {
+        mIdleFrames = 0;
+        mWindowFrames++;
+    }
+
+    if (now - mWindowStart >= FPS_WINDOW) {
+        mFps = mWindowStart ? mWindowFrames : 0;
+        mWindowFrames = 0;
+        mWindowStart = now;
+        windowDone = true;
+    }
+
+    // video keeps posting frames, only the UI goes static
+    if (content == DPST_CONTENT_UI && mIdleFrames >= STATIC_FRAMES)
+        content = DPST_CONTENT_STATIC;
+
+    memset(&hint, 0, sizeof(hint));
+    hint.version = DPST_HINT_VERSION;
+    hint.content = content;
+    hint.fps = mHint.fps;
+    hint.fullscreen = fullscreen ? 1 : 0;
+
+    if (windowDone) {
+        // the frame rate alone only matters once it moved noticeably
+        unsigned int delta = mFps > hint.fps ? mFps - hint.fps : hint.fps - mFps;
+        if (delta >= 5 || !mHintValid)
+            hint.fps = mFps;
+    } else if (!mHintValid ||
+               (hint.content == mHint.content &&
+                hint.fullscreen == mHint.fullscreen)) {
+        // failed sends are retried at the end of the window
+        return;
+    }
+
+    if (mHintValid && !memcmp(&hint, &mHint, sizeof(hint)))
+        return;
+
+    mHintValid = send_l(hint);
+    if (mHintValid)
+        mHint = hint;
+}
+
+bool IntelDpstHint::dump(char *buff, int buff_len, int *cur_len)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------DPST hint -------------\n");
+    dumpPrintf("  + content %d, %d fps%s, sent %u, failed %u\n",
+               mHint.content, mHint.fps, mHint.fullscreen ? ", fullscreen" : "",
+               mSent, mFailed);
+
+    *cur_len = mDumpLen;
+    return true;
+}
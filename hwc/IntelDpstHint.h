@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_DPST_HINT_H__
+#define __INTEL_DPST_HINT_H__
+
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <IntelHWComposerDump.h>
+#include <dpst_hint.h>
+
+/**
+ * Class: DPST content hint channel
+ * Tells dpstmgr what the primary display shows (UI, overlay video,
+ * protected video or a static screen), the posted frame rate and whether
+ * the video fills the screen, so it can pick its backlight policy and
+ * histogram sampling. Hints are datagrams sent without blocking and only
+ * when something changed; the frame rate is re-evaluated once a second.
+ */
+class IntelDpstHint : public IntelHWComposerDump
+{
+public:
+    enum {
+        // idle commits in a row before the screen counts as static
+        STATIC_FRAMES = 30,
+    };
+public:
+    IntelDpstHint();
+    virtual ~IntelDpstHint();
+    // one primary display commit, idle if nothing new was posted
+    void onFrame(int content, bool fullscreen, bool idle);
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    bool send_l(const struct dpst_hint& hint);
+private:
+    mutable android::Mutex mLock;
+    int mSocket;
+    struct dpst_hint mHint;
+    bool mHintValid;
+    int mIdleFrames;
+    nsecs_t mWindowStart;
+    unsigned int mWindowFrames;
+    unsigned int mFps;
+    unsigned int mSent;
+    unsigned int mFailed;
+};
+
+#endif /*__INTEL_DPST_HINT_H__*/
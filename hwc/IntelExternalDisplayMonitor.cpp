@@ -46,11 +46,6 @@
 #include <IntelHWComposerCfg.h>
 #include <binder/IServiceManager.h>
 #include <poll.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <sys/queue.h>
-#include <linux/netlink.h>
-#include <pthread.h>
 
 #include "IntelExternalDisplayMonitor.h"
 #include "IntelHWComposer.h"
@@ -179,6 +174,10 @@ bool IntelExternalDisplayMonitor::isOverlayOff()
 void IntelExternalDisplayMonitor::binderDied(const wp<IBinder>& who)
 {
     ALOGD_IF(ALLOW_MONITOR_PRINT, "External display monitor binderDied");
+
+    // the new service instance knows nothing about WiDi
+    mWidiOn = false;
+    IntelHWComposerDrm::getInstance().invalidateMdsState();
 }
 
 bool IntelExternalDisplayMonitor::notifyWidi(bool on)
@@ -228,24 +227,30 @@ bool IntelExternalDisplayMonitor::threadLoop()
     struct pollfd fds;
     int nr;
 
-    fds.fd = mUeventFd;
+    fds.fd = mDispatcher.getFd();
     fds.events = POLLIN;
     fds.revents = 0;
     nr = poll(&fds, 1, -1);
 
-    if(nr > 0 && fds.revents == POLLIN) {
-        int count = recv(mUeventFd, mUeventMessage, UEVENT_MSG_LEN - 2, 0);
-        if (count > 0)
-            mComposer->onUEvent(MSG_TYPE_UEVENT, mUeventMessage, UEVENT_MSG_LEN - 2);
-    }
+    if(nr > 0 && fds.revents == POLLIN)
+        mDispatcher.dispatch();
 
     return true;
 }
 
+bool IntelExternalDisplayMonitor::handleUEvent(const IntelUEvent& event)
+{
+    return mComposer->onUEvent(MSG_TYPE_UEVENT, (void*)&event, event.getLength());
+}
+
 status_t IntelExternalDisplayMonitor::readyToRun()
 {
     ALOGD_IF(ALLOW_MONITOR_PRINT, "External display monitor ready to run");
 
+    // runs on this thread, off the first frame path
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    IntelInitScheduler *init = mComposer->getInitScheduler();
+
     // get multi-display manager service, retry 10 seconds
     int retry = 10;
     do {
@@ -277,30 +282,17 @@ status_t IntelExternalDisplayMonitor::readyToRun()
         ALOGW("Failed to get %s service.try again...\n", INTEL_MDS_SERVICE_NAME);
     } while(--retry);
 
+    if (init)
+        init->record("mds connection", start, true);
+
     if (!retry && mMDClient == NULL) {
         ALOGW("Failed to get service %s, fall back uevent\n", INTEL_MDS_SERVICE_NAME);
-        struct sockaddr_nl addr;
-        int sz = 64*1024;
-
-        memset(&addr, 0, sizeof(addr));
-        addr.nl_family = AF_NETLINK;
-        addr.nl_pid =  pthread_self() | getpid();
-        addr.nl_groups = 0xffffffff;
-
-        mUeventFd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
-        if(mUeventFd < 0) {
+        if (!mDispatcher.open()) {
             ALOGD("%s: failed to open uevent socket\n", __func__);
             return TIMED_OUT;
         }
 
-        setsockopt(mUeventFd, SOL_SOCKET, SO_RCVBUFFORCE, &sz, sizeof(sz));
-
-        if(bind(mUeventFd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
-            close(mUeventFd);
-            return TIMED_OUT;
-        }
-
-        memset(mUeventMessage, 0, UEVENT_MSG_LEN);
+        mDispatcher.registerHandler(UEVENT_TYPE_HOTPLUG, this);
     } else {
         ALOGD_IF(ALLOW_MONITOR_PRINT, "Got MultiDisplay Service\n");
         if (mMDClient != NULL)
@@ -46,6 +46,7 @@
 #define __INTEL_EXTERNAL_DISPLAY_MONITOR_H__
 
 #include <utils/threads.h>
+#include <IntelUEventDispatcher.h>
 
 #include "display/IExtendDisplayListener.h"
 #include "display/IMultiDisplayComposer.h"
@@ -58,6 +59,7 @@ class IntelHWComposer;
 class IntelExternalDisplayMonitor :
     public android::intel::BnExtendDisplayListener,
     public android::IBinder::DeathRecipient,
+    public IntelUEventHandler,
     protected android::Thread
 {
 public:
@@ -70,10 +72,6 @@ public:
         MSG_TYPE_MDS_TIMING_DYNAMIC_SETTING,
     };
 
-    enum {
-        UEVENT_MSG_LEN = 4096,
-    };
-
 public:
     IntelExternalDisplayMonitor(IntelHWComposer *hwc);
     virtual ~IntelExternalDisplayMonitor();
@@ -93,6 +91,9 @@ public:
 private:
     //DeathReipient interface
     virtual void binderDied(const android::wp<android::IBinder>& who);
+private:
+    // IntelUEventHandler interface, used when MDS is not available
+    virtual bool handleUEvent(const IntelUEvent& event);
 private:
     virtual bool threadLoop();
     virtual android::status_t readyToRun();
@@ -112,8 +113,7 @@ private:
     bool mWidiOn;
     bool mInitialized;
     IntelHWComposer *mComposer;
-    char mUeventMessage[UEVENT_MSG_LEN];
-    int mUeventFd;
+    IntelUEventDispatcher mDispatcher;
     int mLastMsg;
 }; // IntelExternalDisplayMonitor
 
@@ -39,7 +39,9 @@ IntelHDMIDisplayDevice::IntelHDMIDisplayDevice(IntelBufferManager *bm,
                                     IntelHWComposerDrm *drm,
                                     uint32_t index)
                                   : IntelDisplayDevice(pm, drm, bm, gm, index),
-                                    mGraphicPlaneVisible(true)
+                                    mGraphicPlaneVisible(true),
+                                    mGraphicPlaneKnown(false),
+                                    mCompositionSkipped(false)
 {
     ALOGD_IF(ALLOW_HWC_PRINT, "%s\n", __func__);
 
@@ -98,7 +100,6 @@ void IntelHDMIDisplayDevice::onGeometryChanged(hwc_display_contents_1_t *list)
 {
      ALOGD_IF(ALLOW_HWC_PRINT, "%s\n", __func__);
 
-    bool isoverlay;
     // reclaim all planes
     bool ret = mLayerList->invalidatePlanes();
     if (!ret) {
@@ -108,14 +109,17 @@ void IntelHDMIDisplayDevice::onGeometryChanged(hwc_display_contents_1_t *list)
     //1.prepare graphic layer
     // update layer list with new list
     mLayerList->updateLayerList(list);
-    mGraphicPlaneVisible = true;
+    mCompositionSkipped = false;
 
     intel_overlay_mode_t mode = mDrm->getDisplayMode();
 
     bool graphicPlaneVisibility = (mode==OVERLAY_MIPI0)?false:true;
 
-    if (mode == OVERLAY_EXTEND) {
-        for (size_t i = 0; list && i < list->numHwLayers-1; i++) {
+    if (mode == OVERLAY_EXTEND && list) {
+        int candidates[IntelHDMIVideoPlanner::MAX_CANDIDATES];
+        int count = 0;
+
+        for (size_t i = 0; i + 1 < list->numHwLayers; i++) {
             /*When do HDMI extend mode, press power key will start ElectronBeam application. *
               * it will create a Dim layer to do GLES compostion. So mark the Dim layer to overlay *
               *to avoid do GLES  compostion. change for Bug82263      */
@@ -126,30 +130,47 @@ void IntelHDMIDisplayDevice::onGeometryChanged(hwc_display_contents_1_t *list)
                 list->hwLayers[i].compositionType = HWC_OVERLAY;
             }
             if (mLayerList->getLayerType(i) ==
-                    IntelHWComposerLayer::LAYER_TYPE_YUV) {
-                isoverlay = true ;
-		//In CTP when the overlay is in the middle, it maybe set to GLES, But need to check the layers' intersecting
-                if ( i > 0 && i < (mLayerList->getLayersCount()-1) ) {
-                        for (int index = i - 1; index >= 0; index--)
-                             if (areLayersIntersecting(&(list->hwLayers[i]), &(list->hwLayers[index])) ) {
-                                   isoverlay = false;
-                             }
-                }
+                    IntelHWComposerLayer::LAYER_TYPE_YUV &&
+                count < IntelHDMIVideoPlanner::MAX_CANDIDATES)
+                candidates[count++] = i;
+        }
 
-                if( isoverlay ){
-                        list->hwLayers[i].compositionType = HWC_OVERLAY ;
-                        list->hwLayers[i].hints = 0 ;
-                }else{
-                        continue ;
+        drmModeModeInfoPtr hdmiMode = mDrm->getOutputMode(OUTPUT_HDMI);
+        int modeWidth = hdmiMode ? hdmiMode->hdisplay : 0;
+        int modeHeight = hdmiMode ? hdmiMode->vdisplay : 0;
+        bool inWindow = count &&
+            isVideoPutInWindow(OUTPUT_HDMI, &list->hwLayers[candidates[0]]);
+
+        const IntelHDMIVideoPlanner::plan& plan =
+            mPlanner.update(list, candidates, count, inWindow,
+                            modeWidth, modeHeight);
+        int video = plan.video;
+
+        if (video >= 0) {
+            hwc_layer_1_t *layer = &list->hwLayers[video];
+            layer->compositionType = HWC_OVERLAY;
+            layer->hints = 0;
+
+            // If the seeking is active, ignore the following logic
+            if (mVideoSeekingActive) {
+                // keep the graphic plane
+            } else if (!overlayPrepare(video, layer, 0)) {
+                // overlay granted to another display
+                layer->compositionType = HWC_FRAMEBUFFER;
+                mPlanner.cancel();
+            } else {
+                graphicPlaneVisibility = !plan.graphicPlaneOff;
+
+                // nothing of the FB target would show
+                if (plan.skipComposition) {
+                    for (size_t i = 0; i + 1 < list->numHwLayers; i++) {
+                        if ((int)i == video)
+                            continue;
+                        list->hwLayers[i].compositionType = HWC_OVERLAY;
+                        list->hwLayers[i].hints = 0;
+                    }
+                    mCompositionSkipped = true;
                 }
-
-                // If the seeking is active, ignore the following logic
-                if (mVideoSeekingActive)
-                    continue;
-
-                overlayPrepare(i, &list->hwLayers[i],0);
-
-                graphicPlaneVisibility = determineGraphicVisibilityInExtendMode(list,i);
             }
         }
     }
@@ -157,31 +178,17 @@ void IntelHDMIDisplayDevice::onGeometryChanged(hwc_display_contents_1_t *list)
     enableHDMIGraphicPlane(graphicPlaneVisibility);
 }
 
-
-bool IntelHDMIDisplayDevice::determineGraphicVisibilityInExtendMode(hwc_display_contents_1_t *list,int index)
-{
-
-  bool result = true;
-
-   // Set graphic plane invisible when
-   // 1) the video is placed to a window
-   // 2) only video layer exists.(Exclude FramebufferTarget)
-   bool isVideoInWin = isVideoPutInWindow(OUTPUT_HDMI, &(list->hwLayers[index]));
-   if (isVideoInWin || list->numHwLayers == 2) {
-       ALOGD_IF(ALLOW_HWC_PRINT,
-               "%s: In window mode:%d layer num:%d",
-               __func__, isVideoInWin, list->numHwLayers);
-       // Disable graphic plane
-       result = false;
-   }
-   return result;
-}
-
+// Only toggles plane B when its state changes
 void IntelHDMIDisplayDevice::enableHDMIGraphicPlane(bool enable)
 {
+    if (mGraphicPlaneKnown && enable == mGraphicPlaneVisible)
+        return;
+
     ALOGD_IF(ALLOW_HWC_PRINT, "Enable GFX Plane, %d", enable);
     //set the flag
     mGraphicPlaneVisible = enable;
+    mGraphicPlaneKnown = true;
+    mPlanner.onGraphicPlaneToggled();
     //do the job
     int cmd = enable ? DRM_PSB_DISP_PLANEB_ENABLE : DRM_PSB_DISP_PLANEB_DISABLE;
     struct drm_psb_disp_ctrl dp_ctrl;
@@ -190,6 +197,21 @@ void IntelHDMIDisplayDevice::enableHDMIGraphicPlane(bool enable)
     drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_HDMI_FB_CMD, &dp_ctrl, sizeof(dp_ctrl));
 }
 
+// Hand the layers left out of the FB target back to SurfaceFlinger
+void IntelHDMIDisplayDevice::restoreComposition(hwc_display_contents_1_t *list)
+{
+    if (!mCompositionSkipped || !list)
+        return;
+
+    for (size_t i = 0; i + 1 < list->numHwLayers; i++) {
+        if (mLayerList->getPlane(i))
+            continue;
+        if (list->hwLayers[i].compositionType == HWC_OVERLAY)
+            list->hwLayers[i].compositionType = HWC_FRAMEBUFFER;
+    }
+    mCompositionSkipped = false;
+}
+
 
 bool IntelHDMIDisplayDevice::prepare(hwc_display_contents_1_t *list)
 {
@@ -205,11 +227,18 @@ bool IntelHDMIDisplayDevice::prepare(hwc_display_contents_1_t *list)
         return false;
     }
 
+    // clear force swap buffer flag
+    mForceSwapBuffer = false;
+
     int index = -1;
     bool findHint = (index >= 0);
     bool forceCheckingList = (findHint != mVideoSeekingActive);
     mVideoSeekingActive = findHint;
 
+    // overlay grants changed, attach planes again
+    if (mPlaneManager->needsReplan(mDisplayIndex))
+        forceCheckingList = true;
+
     if (!list || (list->flags & HWC_GEOMETRY_CHANGED) || forceCheckingList) {
         onGeometryChanged(list);
 
@@ -231,13 +260,35 @@ bool IntelHDMIDisplayDevice::prepare(hwc_display_contents_1_t *list)
         ALOGD_IF(ALLOW_HWC_PRINT, "prepare: revisiting layer list\n");
         revisitLayerList(list, false);
     }
-    if (mForceSwapBuffer && !mGraphicPlaneVisible) {
+    // video fell back to GLES for this frame, compose everything again
+    if (mForceSwapBuffer && (!mGraphicPlaneVisible || mCompositionSkipped)) {
         ALOGD_IF(ALLOW_HWC_PRINT, "Ebable HDMI gfx plane due to forcing swap buffer");
+        restoreComposition(list);
+        mPlanner.cancel();
         enableHDMIGraphicPlane(true);
     }
+
+    if (mDrm->getDisplayMode() == OVERLAY_EXTEND)
+        mPlanner.onFrame(mGraphicPlaneVisible, !mCompositionSkipped);
     return true;
 }
 
+void IntelHDMIDisplayDevice::collectPlaneDemands(hwc_display_contents_1_t *list)
+{
+    if (!initCheck() || mIsBlank || !list)
+        return;
+
+    // overlays are only used for video in extended mode
+    if (mDrm->getDisplayMode() != OVERLAY_EXTEND)
+        return;
+
+    for (size_t i = 0; i + 1 < list->numHwLayers; i++) {
+        if (isVideoLayer(&list->hwLayers[i]))
+            addPlaneDemand(IntelDisplayPlane::DISPLAY_PLANE_OVERLAY,
+                           i, &list->hwLayers[i]);
+    }
+}
+
 bool IntelHDMIDisplayDevice::commit(hwc_display_contents_1_t *list,
                                     buffer_handle_t *bh,
                                     int* acquireFenceFd,
@@ -419,9 +470,13 @@ bool IntelHDMIDisplayDevice::dump(char *buff,
        }
        dumpPrintf("-------------HDMI runtime parameters -------------\n");
        dumpPrintf("  + mHotplugEvent: %d \n", mHotplugEvent);
-
+       dumpLayersData();
     }
 
+    if (mVideoProcessor)
+        mVideoProcessor->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    mPlanner.dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+
     *cur_len = mDumpLen;
     return ret;
 }
@@ -483,10 +538,23 @@ bool IntelHDMIDisplayDevice::getDisplayAttributes(uint32_t config,
     return true;
 }
 
+bool IntelHDMIDisplayDevice::blank(int blank)
+{
+    bool ret = IntelDisplayDevice::blank(blank);
+
+    // DPMS switches plane B along with the pipe
+    mGraphicPlaneKnown = false;
+
+    return ret;
+}
+
 void IntelHDMIDisplayDevice::onHotplugEvent(bool hpd)
 {
     IntelDisplayDevice::onHotplugEvent(hpd);
 
+    // mode setting turns plane B back on
+    mGraphicPlaneKnown = false;
+
     if (mDrm->getDisplayMode() == OVERLAY_MIPI0) {
         mLayerList->invalidatePlanes();
         mLayerList->updateLayerList(NULL);
@@ -515,7 +583,7 @@ bool IntelHDMIDisplayDevice::overlayPrepare(int index, hwc_layer_1_t *layer, int
     }
     
     // allocate overlay plane
-    IntelDisplayPlane *plane = mPlaneManager->getOverlayPlane();
+    IntelDisplayPlane *plane = mPlaneManager->getOverlayPlane(mDisplayIndex);
     if (!plane) {
         ALOGE("%s: failed to create overlay plane\n", __func__);
         return false;
@@ -528,19 +596,26 @@ bool IntelHDMIDisplayDevice::overlayPrepare(int index, hwc_layer_1_t *layer, int
 
     IntelOverlayPlane *overlayP =
         reinterpret_cast<IntelOverlayPlane *>(plane);
+    if (!splitOverlayPrepare(overlayP, layer))
+        return false;
     if (mDrm->getDisplayMode() == OVERLAY_EXTEND) {
         // Put overlay on top if no other layers exist
         bool onTop = mLayerList->getLayersCount() == index + 1;
         overlayP->setOverlayOnTop(onTop);
 
 
-        // Check if the video is placed to a window
-        if (isVideoPutInWindow(OUTPUT_HDMI, layer)) {
+        // Check if the video is placed to a window, the planner gates
+        // the graphic plane then
+        if (mPlanner.getPlan().graphicPlaneOff)
             overlayP->setOverlayOnTop(true);
-            struct drm_psb_disp_ctrl dp_ctrl;
-            memset(&dp_ctrl, 0, sizeof(dp_ctrl));
-            dp_ctrl.cmd = DRM_PSB_DISP_PLANEB_DISABLE;
-            drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_HDMI_FB_CMD, &dp_ctrl, sizeof(dp_ctrl));
+
+        // aspect kept at the HDMI mode resolution
+        if (mPlanner.getPlan().video == index) {
+            const hwc_rect_t& dst = mPlanner.getPlan().dst;
+            dstLeft = dst.left;
+            dstTop = dst.top;
+            dstRight = dst.right;
+            dstBottom = dst.bottom;
         }
     }
 
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <cutils/log.h>
+#include <IntelHWComposerCfg.h>
+#include <IntelHDMIVideoPlanner.h>
+
+IntelHDMIVideoPlanner::IntelHDMIVideoPlanner() :
+    mModeWidth(0), mModeHeight(0), mSourceWidth(0), mSourceHeight(0),
+    mFrames(0), mGatedFrames(0), mSkippedCompositions(0), mToggles(0),
+    mScanoutBytes(0), mBaselineBytes(0)
+{
+    memset(&mPlan, 0, sizeof(mPlan));
+    mPlan.video = -1;
+}
+
+bool IntelHDMIVideoPlanner::intersects(const hwc_rect_t& a,
+                                       const hwc_rect_t& b)
+{
+    return !(b.right <= a.left || b.left >= a.right ||
+             b.top >= a.bottom || b.bottom <= a.top);
+}
+
+bool IntelHDMIVideoPlanner::contains(const hwc_rect_t& outer,
+                                     const hwc_rect_t& inner)
+{
+    return inner.left >= outer.left && inner.right <= outer.right &&
+           inner.top >= outer.top && inner.bottom <= outer.bottom;
+}
+
+// In between other layers the video must not overlap anything below
+bool IntelHDMIVideoPlanner::isEligible(hwc_display_contents_1_t *list,
+                                       int index) const
+{
+    int count = list->numHwLayers - 1;
+
+    if (index <= 0 || index >= count - 1)
+        return true;
+
+    for (int i = index - 1; i >= 0; i--) {
+        if (intersects(list->hwLayers[index].displayFrame,
+                       list->hwLayers[i].displayFrame))
+            return false;
+    }
+    return true;
+}
+
+// Transparent, or below the video and covered by it. Only an opaque
+// video covers, a blended or faded one lets the layers below through
+bool IntelHDMIVideoPlanner::isHidden(hwc_display_contents_1_t *list,
+                                     int index) const
+{
+    hwc_layer_1_t *layer = &list->hwLayers[index];
+    hwc_layer_1_t *video = &list->hwLayers[mPlan.video];
+
+    if (!layer->planeAlpha)
+        return true;
+
+    if (video->blending != HWC_BLENDING_NONE || video->planeAlpha != 0xff)
+        return false;
+
+    // the video only paints its letterboxed frame
+    return index < mPlan.video && contains(mPlan.dst, layer->displayFrame);
+}
+
+void IntelHDMIVideoPlanner::fitAspect(hwc_layer_1_t *layer)
+{
+    hwc_rect_t& dst = mPlan.dst;
+    int srcW = (int)(layer->sourceCropf.right - layer->sourceCropf.left);
+    int srcH = (int)(layer->sourceCropf.bottom - layer->sourceCropf.top);
+
+    dst = layer->displayFrame;
+    mSourceWidth = srcW;
+    mSourceHeight = srcH;
+
+    // frames reaching past the mode are cut by the pipe anyway
+    if (mModeWidth > 0 && mModeHeight > 0) {
+        if (dst.left < 0)
+            dst.left = 0;
+        if (dst.top < 0)
+            dst.top = 0;
+        if (dst.right > mModeWidth)
+            dst.right = mModeWidth;
+        if (dst.bottom > mModeHeight)
+            dst.bottom = mModeHeight;
+    }
+
+    if (layer->transform & HAL_TRANSFORM_ROT_90) {
+        int temp = srcW;
+        srcW = srcH;
+        srcH = temp;
+    }
+
+    int dstW = dst.right - dst.left;
+    int dstH = dst.bottom - dst.top;
+    if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0)
+        return;
+
+    // letterbox or pillarbox the source inside the frame, rounding
+    // differences of a pixel are left alone
+    int w = dstW;
+    int h = dstH;
+    if ((int64_t)srcW * dstH > (int64_t)dstW * srcH)
+        h = (int)((int64_t)dstW * srcH / srcW);
+    else
+        w = (int)((int64_t)dstH * srcW / srcH);
+
+    if (dstW - w > 1) {
+        dst.left += (dstW - w) / 2;
+        dst.right = dst.left + w;
+    }
+    if (dstH - h > 1) {
+        dst.top += (dstH - h) / 2;
+        dst.bottom = dst.top + h;
+    }
+}
+
+const IntelHDMIVideoPlanner::plan&
+IntelHDMIVideoPlanner::update(hwc_display_contents_1_t *list,
+                              const int *candidates, int count,
+                              bool inWindow, int modeWidth, int modeHeight)
+{
+    memset(&mPlan, 0, sizeof(mPlan));
+    mPlan.video = -1;
+    mModeWidth = modeWidth;
+    mModeHeight = modeHeight;
+    mSourceWidth = mSourceHeight = 0;
+
+    if (!list || !list->numHwLayers)
+        return mPlan;
+
+    for (int i = 0; i < count; i++) {
+        if (isEligible(list, candidates[i])) {
+            mPlan.video = candidates[i];
+            break;
+        }
+    }
+    if (mPlan.video < 0)
+        return mPlan;
+
+    fitAspect(&list->hwLayers[mPlan.video]);
+
+    int layers = list->numHwLayers - 1;
+    bool othersHidden = true;
+    bool skipLayers = false;
+    for (int i = 0; i < layers; i++) {
+        if (i == mPlan.video)
+            continue;
+        if (!isHidden(list, i))
+            othersHidden = false;
+        // left to SurfaceFlinger by contract
+        if (list->hwLayers[i].flags & HWC_SKIP_LAYER)
+            skipLayers = true;
+    }
+
+    mPlan.graphicPlaneOff = inWindow || othersHidden;
+    mPlan.skipComposition = mPlan.graphicPlaneOff && !skipLayers &&
+                            layers > 1;
+
+    ALOGD_IF(ALLOW_HWC_PRINT,
+             "%s: video %d at (%d, %d) - (%d, %d), plane %s, composition %s\n",
+             __func__, mPlan.video, mPlan.dst.left, mPlan.dst.top,
+             mPlan.dst.right, mPlan.dst.bottom,
+             mPlan.graphicPlaneOff ? "gated" : "on",
+             mPlan.skipComposition ? "skipped" : "kept");
+    return mPlan;
+}
+
+void IntelHDMIVideoPlanner::cancel()
+{
+    mPlan.graphicPlaneOff = false;
+    mPlan.skipComposition = false;
+}
+
+void IntelHDMIVideoPlanner::onFrame(bool graphicPlaneOn, bool composed)
+{
+    // plane B fetches the 32 bit framebuffer, the overlay an NV12 source
+    uint64_t graphic = (uint64_t)mModeWidth * mModeHeight * 4;
+    uint64_t video = 0;
+
+    if (mPlan.video >= 0)
+        video = (uint64_t)mSourceWidth * mSourceHeight * 3 / 2;
+
+    mFrames++;
+    mBaselineBytes += graphic + video;
+    mScanoutBytes += (graphicPlaneOn ? graphic : 0) + video;
+    if (!graphicPlaneOn)
+        mGatedFrames++;
+    if (!composed)
+        mSkippedCompositions++;
+}
+
+bool IntelHDMIVideoPlanner::dump(char *buff, int buff_len, int *cur_len)
+{
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------HDMI video planner -------------\n");
+    dumpPrintf("  + video layer %d at (%d, %d) - (%d, %d) on %dx%d, "
+               "plane %s, composition %s\n",
+               mPlan.video, mPlan.dst.left, mPlan.dst.top,
+               mPlan.dst.right, mPlan.dst.bottom, mModeWidth, mModeHeight,
+               mPlan.graphicPlaneOff ? "gated" : "on",
+               mPlan.skipComposition ? "skipped" : "kept");
+    dumpPrintf("  + %u frames, %u gated, %u compositions skipped, "
+               "%u plane toggles\n",
+               mFrames, mGatedFrames, mSkippedCompositions, mToggles);
+    dumpPrintf("  + scanout %llu MB, %llu MB with plane B always on\n",
+               mScanoutBytes >> 20, mBaselineBytes >> 20);
+
+    *cur_len = mDumpLen;
+    return true;
+}
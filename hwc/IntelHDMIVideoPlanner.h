@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_HDMI_VIDEO_PLANNER_H__
+#define __INTEL_HDMI_VIDEO_PLANNER_H__
+
+#include <stdint.h>
+#include <hardware/hwcomposer.h>
+#include <IntelHWComposerDump.h>
+
+/**
+ * Class: HDMI extended video planner
+ * Works out once per geometry how video shows on HDMI in extended mode:
+ * which video layer goes to the overlay and where, keeping the source
+ * aspect ratio inside the layer frame at the HDMI mode resolution;
+ * whether anything but the video is visible, otherwise the HDMI graphic
+ * plane can be gated; and whether the framebuffer target can skip
+ * composition since nothing of it would show.
+ * Frames are also run through a model of the HDMI pipe so the scanout
+ * bandwidth and compositions saved show up in the dump.
+ */
+class IntelHDMIVideoPlanner : public IntelHWComposerDump
+{
+public:
+    enum {
+        MAX_CANDIDATES = 4,
+    };
+    struct plan {
+        // layer shown on the overlay, -1 if the video goes through GLES
+        int video;
+        // overlay destination in HDMI mode pixels
+        hwc_rect_t dst;
+        // nothing but the video is visible, plane B can be gated
+        bool graphicPlaneOff;
+        // the other layers need not be composed into the FB target
+        bool skipComposition;
+    };
+public:
+    IntelHDMIVideoPlanner();
+    // @candidates are the video layers of @list in z order, @inWindow
+    // tells whether the app put the first eligible one into a window
+    const plan& update(hwc_display_contents_1_t *list,
+                       const int *candidates, int count,
+                       bool inWindow, int modeWidth, int modeHeight);
+    const plan& getPlan() const { return mPlan; }
+    // the video fell back to GLES, everything is composed again
+    void cancel();
+    // one frame through the HDMI pipe
+    void onFrame(bool graphicPlaneOn, bool composed);
+    void onGraphicPlaneToggled() { mToggles++; }
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    bool isEligible(hwc_display_contents_1_t *list, int index) const;
+    bool isHidden(hwc_display_contents_1_t *list, int index) const;
+    void fitAspect(hwc_layer_1_t *layer);
+    static bool intersects(const hwc_rect_t& a, const hwc_rect_t& b);
+    static bool contains(const hwc_rect_t& outer, const hwc_rect_t& inner);
+private:
+    struct plan mPlan;
+    int mModeWidth;
+    int mModeHeight;
+    int mSourceWidth;
+    int mSourceHeight;
+    // HDMI pipe model
+    uint32_t mFrames;
+    uint32_t mGatedFrames;
+    uint32_t mSkippedCompositions;
+    uint32_t mToggles;
+    uint64_t mScanoutBytes;
+    uint64_t mBaselineBytes;
+};
+
+#endif /*__INTEL_HDMI_VIDEO_PLANNER_H__*/
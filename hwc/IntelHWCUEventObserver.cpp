@@ -46,10 +46,6 @@
 #include <IntelHWComposerCfg.h>
 #include <cutils/log.h>
 #include <poll.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <sys/queue.h>
-#include <linux/netlink.h>
 
 IntelHWCUEventObserver::IntelHWCUEventObserver()
     : mReadyToRun(false)
@@ -93,54 +89,42 @@ bool IntelHWCUEventObserver::stopObserver()
 
 void *IntelHWCUEventObserver::threadLoop(void *data)
 {
-    char ueventMessage[UEVENT_MSG_LEN];
-    int fd = -1;
-    struct sockaddr_nl addr;
-    int sz = 64*1024;
-
-    memset(&addr, 0, sizeof(addr));
-    addr.nl_family = AF_NETLINK;
-    addr.nl_pid =  pthread_self() | getpid();
-    addr.nl_groups = 0xffffffff;
-
-    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
-    if(fd < 0) {
+    IntelHWCUEventObserver *observer =
+        static_cast<IntelHWCUEventObserver*>(data);
+    IntelUEventDispatcher& dispatcher = observer->mDispatcher;
+
+    if (!dispatcher.open()) {
         ALOGD("%s: failed to open uevent socket\n", __func__);
         return 0;
     }
 
-    setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &sz, sizeof(sz));
-
-    if(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
-        close(fd);
-        return 0;
-    }
-
-    memset(ueventMessage, 0, UEVENT_MSG_LEN);
-    IntelHWCUEventObserver *observer =
-        static_cast<IntelHWCUEventObserver*>(data);
+    dispatcher.registerHandler(UEVENT_TYPE_HOTPLUG, observer);
 
     do {
         struct pollfd fds;
         int nr;
 
-        fds.fd = fd;
+        fds.fd = dispatcher.getFd();
         fds.events = POLLIN;
         fds.revents = 0;
         nr = poll(&fds, 1, -1);
 
-        if(nr > 0 && fds.revents == POLLIN) {
-            int count = recv(fd, ueventMessage, UEVENT_MSG_LEN - 2, 0);
-            if (count > 0)
-                observer->onUEvent(0, ueventMessage, UEVENT_MSG_LEN - 2);
-        }
+        if(nr > 0 && fds.revents == POLLIN)
+            dispatcher.dispatch();
     } while (observer->isReadyToRun());
 
-thread_exit:
+    dispatcher.unregisterHandler(UEVENT_TYPE_HOTPLUG);
+    dispatcher.close();
+
     ALOGD("%s: observer exited\n", __func__);
     return NULL;
 }
 
+bool IntelHWCUEventObserver::handleUEvent(const IntelUEvent& event)
+{
+    return onUEvent(0, (void*)&event, event.getLength());
+}
+
 bool IntelHWCUEventObserver::onUEvent(int msgType, void* msg, int msgLen)
 {
     return true;
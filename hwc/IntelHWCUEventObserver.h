@@ -43,22 +43,22 @@
  *
  */
 #include <pthread.h>
+#include <IntelUEventDispatcher.h>
 
 #ifndef __INTEL_HWC_UEVENT_OBSERVER_H__
 #define __INTEL_HWC_UEVENT_OBSERVER_H__
 
-enum {
-    UEVENT_MSG_LEN = 4096,
-};
-
-class IntelHWCUEventObserver {
+class IntelHWCUEventObserver : public IntelUEventHandler {
 private:
     pthread_t mThread;
     bool mReadyToRun;
+    IntelUEventDispatcher mDispatcher;
 private:
     static void *threadLoop(void *data);
 protected:
+    // @msg is the parsed IntelUEvent, valid only during the call
     virtual bool onUEvent(int msgType, void* msg, int msgLen);
+    virtual bool handleUEvent(const IntelUEvent& event);
 public:
     IntelHWCUEventObserver();
     virtual ~IntelHWCUEventObserver();
@@ -50,6 +50,7 @@
 #include <IntelOverlayUtil.h>
 #include <IntelHWComposerCfg.h>
 #include <IntelUtility.h>
+#include <IntelMemoryTracker.h>
 
 #ifdef INTEL_WIDI
 #include <WidiDisplayDevice.h>
@@ -59,10 +60,28 @@ IntelHWComposer::~IntelHWComposer()
 {
     ALOGD_IF(ALLOW_HWC_PRINT, "%s\n", __func__);
 
+    // these threads call back into HWC, stop them before tearing down
+    if (mInitScheduler != 0)
+        mInitScheduler->stop();
+    if (mRefreshGovernor != 0)
+        mRefreshGovernor->stop();
+    if (mDisplayStat != 0)
+        mDisplayStat->stop();
+    IntelMemoryTracker::getInstance().stopTrimThread();
+    IntelMemoryTracker::getInstance().unregisterTrimmable(this);
+
+    delete mPrepareScheduler;
+    delete mPerfHud;
     delete mPlaneManager;
+    free(mLastPlaneContexts);
+    if (mLastReleaseFence >= 0)
+        close(mLastReleaseFence);
     delete mBufferManager;
     delete mGrallocBufferManager;
     delete mDrm;
+#ifdef INTEL_DPST
+    delete mDpstHint;
+#endif
 
     for (size_t i=0; i<DISPLAY_NUM; i++) {
         delete mDisplayDevice[i];
@@ -106,6 +125,15 @@ bool IntelHWComposer::handleDisplayModeChange()
     }
 
     mDrm->detectMDSModeChange();
+    invalidateFrameState();
+
+    if (mRefreshGovernor != 0) {
+        int width = 0, height = 0, fps = 0, interlace = 0;
+        if (!mDrm->isVideoPlaying() ||
+            !mDrm->getVideoInfo(&width, &height, &fps, &interlace))
+            fps = 0;
+        mRefreshGovernor->setVideoFrameRate(fps);
+    }
 
     if (needSwitchVsyncSrc())
         vsyncControl_l(1);
@@ -136,18 +164,22 @@ bool IntelHWComposer::handleHotplugEvent(int hpd, void *data)
         if (!mode)
             return false;
 
-        // alloc buffer;
-        mHDMIFBHandle.size = mode->vdisplay * align_to(mode->hdisplay * 4, 64);
-        ret = mGrallocBufferManager->alloc(mHDMIFBHandle.size,
-                                      &mHDMIFBHandle.umhandle,
-                                      &mHDMIFBHandle.kmhandle);
-        if (!ret)
-            return false;
+        mHotplugTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
-        // mode setting;
-        ret = mDrm->setDisplayDrmMode(OUTPUT_HDMI, mHDMIFBHandle.kmhandle, mode);
-        if (!ret)
-            return false;
+        { // scope for lock
+            android::Mutex::Autolock _l(mHDMIFBLock);
+            mHDMIFBIdleSince = 0;
+
+            // get framebuffer, reused if this mode size was used before
+            hdmi_fb_handler *fb = getHDMIFramebuffer(mode);
+            if (!fb)
+                return false;
+
+            // mode setting;
+            ret = mDrm->setDisplayDrmMode(OUTPUT_HDMI, fb->fbId, mode);
+            if (!ret)
+                return false;
+        }
 
         ALOGD("%s: detected hdmi hotplug event:%s\n", __func__, hpd?"IN":"OUT");
         handleDisplayModeChange();
@@ -173,19 +205,133 @@ bool IntelHWComposer::handleHotplugEvent(int hpd, void *data)
             mProcs->hotplug(mProcs, HWC_DISPLAY_EXTERNAL, hpd);
         }
         // TODO: here we need to wait for the plug-out take effect.
+        // the framebuffer is kept for the next plug-in
         waitForHpdCompletion();
-        // rm FB
-        mDrm->deleteDrmFb(OUTPUT_HDMI);
-        // release buffer;
-        ret = mGrallocBufferManager->dealloc(mHDMIFBHandle.umhandle);
-        if (!ret)
-            return false;
+        mHotplugTime = 0;
 
-        memset(&mHDMIFBHandle, 0, sizeof(mHDMIFBHandle));
+        android::Mutex::Autolock _l(mHDMIFBLock);
+        mHDMIFBIdleSince = systemTime(SYSTEM_TIME_MONOTONIC);
     }
     return true;
 }
 
+IntelHWComposer::hdmi_fb_handler*
+IntelHWComposer::getHDMIFramebuffer(drmModeModeInfoPtr mode)
+{
+    hdmi_fb_handler *fb = 0;
+    int i;
+
+    for (i = 0; i < HDMI_FB_CACHE_SIZE; i++) {
+        if (mHDMIFBCache[i].fbId &&
+            mHDMIFBCache[i].width == mode->hdisplay &&
+            mHDMIFBCache[i].height == mode->vdisplay) {
+            fb = &mHDMIFBCache[i];
+            mHDMIFBReused++;
+            goto out;
+        }
+    }
+
+    // take a free slot, or evict the least recently used one. The current
+    // scanout buffer is always the most recently used, so it is never evicted
+    fb = &mHDMIFBCache[0];
+    for (i = 0; i < HDMI_FB_CACHE_SIZE; i++) {
+        if (!mHDMIFBCache[i].fbId) {
+            fb = &mHDMIFBCache[i];
+            break;
+        }
+        if (mHDMIFBCache[i].lastUsed < fb->lastUsed)
+            fb = &mHDMIFBCache[i];
+    }
+    releaseHDMIFramebuffer(fb);
+
+    // alloc buffer;
+    fb->size = mode->vdisplay * align_to(mode->hdisplay * 4, 64);
+    if (!mGrallocBufferManager->alloc(fb->size, &fb->umhandle, &fb->kmhandle)) {
+        ALOGE("%s: failed to alloc HDMI framebuffer\n", __func__);
+        memset(fb, 0, sizeof(hdmi_fb_handler));
+        return 0;
+    }
+
+    fb->fbId = mDrm->addDrmFb(fb->kmhandle, mode);
+    if (!fb->fbId) {
+        mGrallocBufferManager->dealloc(fb->umhandle);
+        memset(fb, 0, sizeof(hdmi_fb_handler));
+        return 0;
+    }
+
+    fb->width = mode->hdisplay;
+    fb->height = mode->vdisplay;
+    IntelMemoryTracker::getInstance().add(IntelMemoryTracker::MEM_HDMI_FB,
+                                          fb->size);
+out:
+    fb->lastUsed = ++mHDMIFBSeq;
+    return fb;
+}
+
+void IntelHWComposer::releaseHDMIFramebuffer(hdmi_fb_handler *fb)
+{
+    if (!fb)
+        return;
+
+    if (fb->fbId) {
+        mDrm->removeDrmFb(fb->fbId);
+        IntelMemoryTracker::getInstance().remove(
+            IntelMemoryTracker::MEM_HDMI_FB, fb->size);
+    }
+    if (fb->umhandle)
+        mGrallocBufferManager->dealloc(fb->umhandle);
+
+    memset(fb, 0, sizeof(hdmi_fb_handler));
+}
+
+void IntelHWComposer::releaseIdleHDMIFramebuffers()
+{
+    // a replug within this time reuses the framebuffers
+    static const nsecs_t HDMI_FB_IDLE_TIMEOUT = 30000000000LL;
+
+    android::Mutex::Autolock _l(mHDMIFBLock);
+    if (!mHDMIFBIdleSince ||
+        systemTime(SYSTEM_TIME_MONOTONIC) - mHDMIFBIdleSince <
+            HDMI_FB_IDLE_TIMEOUT)
+        return;
+
+    ALOGD_IF(ALLOW_HWC_PRINT, "%s: HDMI unplugged, free framebuffers\n",
+             __func__);
+    for (int i = 0; i < HDMI_FB_CACHE_SIZE; i++)
+        releaseHDMIFramebuffer(&mHDMIFBCache[i]);
+    mHDMIFBIdleSince = 0;
+}
+
+uint32_t IntelHWComposer::trimMemory(int category)
+{
+    hdmi_fb_handler *current = 0;
+    uint32_t freed = 0;
+    int i;
+
+    if (category != IntelMemoryTracker::MEM_HDMI_FB)
+        return 0;
+
+    android::Mutex::Autolock _l(mHDMIFBLock);
+
+    // unless HDMI is unplugged, the most recently used one is scanned out
+    if (!mHDMIFBIdleSince) {
+        for (i = 0; i < HDMI_FB_CACHE_SIZE; i++) {
+            if (mHDMIFBCache[i].fbId &&
+                (!current || mHDMIFBCache[i].lastUsed > current->lastUsed))
+                current = &mHDMIFBCache[i];
+        }
+    }
+
+    for (i = 0; i < HDMI_FB_CACHE_SIZE; i++) {
+        if (&mHDMIFBCache[i] == current || !mHDMIFBCache[i].fbId)
+            continue;
+        freed += mHDMIFBCache[i].size;
+        releaseHDMIFramebuffer(&mHDMIFBCache[i]);
+    }
+
+    return freed;
+}
+
 bool IntelHWComposer::handleDynamicModeSetting(void *data)
 {
     bool ret = false;
@@ -237,27 +383,39 @@ bool IntelHWComposer::onUEvent(int msgType, void* msg, int msgLen)
     return ret;
 #endif
 
-    char* szMsg = (char*)msg;
-    if (strcmp(szMsg, "change@/devices/pci0000:00/0000:00:02.0/drm/card0"))
+    const IntelUEvent *event = (const IntelUEvent*)msg;
+    if (!event || event->getType() != UEVENT_TYPE_HOTPLUG)
         return true;
-    szMsg += strlen(szMsg) + 1;
 
-    do {
-        if (!strncmp(szMsg, "HOTPLUG_IN=1", strlen("HOTPLUG_IN=1"))) {
-            ALOGD("%s: detected hdmi hotplug event:%s\n", __func__, szMsg);
-            ret = handleHotplugEvent(1, NULL);
-            break;
-        } else if (!strncmp(szMsg, "HOTPLUG_OUT=1", strlen("HOTPLUG_OUT=1"))) {
+    const char *value = event->getValue("HOTPLUG_IN");
+    if (value && !strcmp(value, "1")) {
+        ALOGD("%s: detected hdmi hotplug event\n", __func__);
+        ret = handleHotplugEvent(1, NULL);
+    } else {
+        value = event->getValue("HOTPLUG_OUT");
+        if (value && !strcmp(value, "1"))
             ret = handleHotplugEvent(0, NULL);
-            break;
-        }
-
-        szMsg += strlen(szMsg) + 1;
-    } while (*szMsg);
+    }
 
     return ret;
 }
 
+bool IntelHWComposer::setRefreshRate(int rate)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    if (!mDrm || !mDrm->setDisplayRefreshRate(OUTPUT_MIPI0, rate))
+        return false;
+
+    // vsync events come from the pipe at the new rate. The fake vsync
+    // stays at the native rate, it paces SurfaceFlinger while MIPI is
+    // blanked and the panel rate means nothing then
+
+    // mode setting replaced the scanout buffer, post the next frame again
+    invalidateFrameState();
+    return true;
+}
+
 void IntelHWComposer::vsync(int64_t timestamp, int pipe)
 {
     if (mProcs && mProcs->vsync) {
@@ -267,14 +425,41 @@ void IntelHWComposer::vsync(int64_t timestamp, int pipe)
             mProcs->vsync(const_cast<hwc_procs_t*>(mProcs), 0, timestamp);
     }
     mLastVsync = timestamp;
+
+    // the one vsync source active paces the compositions the HUD counts
+    if (mPerfHud)
+        mPerfHud->onVsync(timestamp);
+
+    if (mPlaneManager) {
+        mPlaneManager->onVsync(pipe == VSYNC_SRC_HDMI ?
+                               HWC_DISPLAY_EXTERNAL : HWC_DISPLAY_PRIMARY);
+
+        // don't leave reclaimed overlays on till a next prepare, a running
+        // composition disables them itself
+        if (mPlaneManager->hasOverlaysToDisable() &&
+            mLock.tryLock() == android::NO_ERROR) {
+            disableReclaimedOverlays_l();
+            mLock.unlock();
+        }
+    }
+}
+
+void IntelHWComposer::disableReclaimedOverlays_l()
+{
+    // reclaimed overlays go off once the framebuffer frame holding
+    // their layers scanned out, SGX may flip it several cycles late
+    if (mPlaneManager->hasReclaimedOverlays()) {
+        mPlaneManager->disableReclaimedPlanes(IntelDisplayPlane::DISPLAY_PLANE_OVERLAY);
+        mPlaneManager->disableReclaimedPlanes(IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY);
+    }
 }
 
 uint32_t IntelHWComposer::disableUnusedVsyncs(uint32_t target)
 {
     uint32_t unusedVsyncs = mActiveVsyncs & (~target);
-    struct drm_psb_vsync_set_arg arg;
     uint32_t vsync;
-    int i, ret;
+    int i, disp;
+    bool ret;
 
     ALOGV("disableVsync: unusedVsyncs 0x%x\n", unusedVsyncs);
 
@@ -291,24 +476,18 @@ uint32_t IntelHWComposer::disableUnusedVsyncs(uint32_t target)
         if (i == VSYNC_SRC_FAKE)
             mFakeVsync->setEnabled(false, mLastVsync);
         else {
-            memset(&arg, 0, sizeof(struct drm_psb_vsync_set_arg));
-            arg.vsync_operation_mask = VSYNC_DISABLE | GET_VSYNC_COUNT;
+            uint64_t timestamp = mVsyncsTimestamp;
 
             // pipe select
-            if (i == VSYNC_SRC_HDMI)
-                arg.vsync.pipe = 1;
-            else
-                arg.vsync.pipe = 0;
-
-            ret = drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_VSYNC_SET,
-                                      &arg, sizeof(arg));
-            if (ret) {
-                ALOGW("%s: failed to enable/disable vsync %d\n", __func__, ret);
+            disp = (i == VSYNC_SRC_HDMI) ? OUTPUT_HDMI : OUTPUT_MIPI0;
+
+            ret = mDrm->setDisplayVsyncs(disp, false, &mVsyncsCount, &timestamp);
+            if (!ret) {
+                ALOGW("%s: failed to disable vsync %d\n", __func__, i);
                 continue;
             }
             mVsyncsEnabled = 0;
-            mVsyncsCount = arg.vsync.vsync_count;
-            mVsyncsTimestamp = arg.vsync.timestamp;
+            mVsyncsTimestamp = timestamp;
         }
 
         /*disabled successfully, remove it from unused vsyncs*/
@@ -321,9 +500,9 @@ disable_out:
 uint32_t IntelHWComposer::enableVsyncs(uint32_t target)
 {
     uint32_t enabledVsyncs = 0;
-    struct drm_psb_vsync_set_arg arg;
     uint32_t vsync;
-    int i, ret;
+    int i, disp;
+    bool ret;
 
     ALOGV("enableVsyn: enable vsyncs 0x%x\n", target);
 
@@ -349,24 +528,18 @@ uint32_t IntelHWComposer::enableVsyncs(uint32_t target)
         if (i == VSYNC_SRC_FAKE)
             mFakeVsync->setEnabled(true, mLastVsync);
         else {
-            memset(&arg, 0, sizeof(struct drm_psb_vsync_set_arg));
-            arg.vsync_operation_mask = VSYNC_ENABLE | GET_VSYNC_COUNT;
+            uint64_t timestamp = mVsyncsTimestamp;
 
             // pipe select
-            if (i == VSYNC_SRC_HDMI)
-                arg.vsync.pipe = 1;
-            else
-                arg.vsync.pipe = 0;
-
-            ret = drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_VSYNC_SET,
-                                      &arg, sizeof(arg));
-            if (ret) {
-                ALOGW("%s: failed to enable vsync %d\n", __func__, ret);
+            disp = (i == VSYNC_SRC_HDMI) ? OUTPUT_HDMI : OUTPUT_MIPI0;
+
+            ret = mDrm->setDisplayVsyncs(disp, true, &mVsyncsCount, &timestamp);
+            if (!ret) {
+                ALOGW("%s: failed to enable vsync %d\n", __func__, i);
                 continue;
             }
             mVsyncsEnabled = 1;
-            mVsyncsCount = arg.vsync.vsync_count;
-            mVsyncsTimestamp = arg.vsync.timestamp;
+            mVsyncsTimestamp = timestamp;
         }
 
         /*enabled successfully*/
@@ -422,6 +595,10 @@ bool IntelHWComposer::vsyncControl_l(int enabled)
     if (enabled != 0 && enabled != 1)
         return false;
 
+    // vsync requested again after being idle, i.e. touch or animation
+    if (enabled && !mActiveVsyncs && mRefreshGovernor != 0)
+        mRefreshGovernor->notifyActivity();
+
     // for disable vsync request, disable all active vsyncs
     if (!enabled) {
         targetVsyncs = 0;
@@ -440,6 +617,12 @@ disable_vsyncs:
     mActiveVsyncs = enabledVsyncs | activeVsyncs;
     mVsync->setActiveVsyncs(mActiveVsyncs);
 
+    // reclaimed overlays are disabled from vsyncs, ask for another frame
+    // rather than leave them on over a static screen
+    if (!mActiveVsyncs && mPlaneManager &&
+        mPlaneManager->hasReclaimedOverlays() && mProcs && mProcs->invalidate)
+        mProcs->invalidate(const_cast<hwc_procs_t*>(mProcs));
+
     ALOGV("vsyncControl: activeVsyncs 0x%x\n", mActiveVsyncs);
     return true;
 }
@@ -463,84 +646,25 @@ bool IntelHWComposer::release()
 
 bool IntelHWComposer::dumpDisplayStat()
 {
-    struct drm_psb_register_rw_arg arg;
-    struct drm_psb_vsync_set_arg vsync_arg;
-    int ret;
-
-    // dump vsync info
-    memset(&vsync_arg, 0, sizeof(struct drm_psb_vsync_set_arg));
-    vsync_arg.vsync_operation_mask = GET_VSYNC_COUNT;
-    vsync_arg.vsync.pipe = 0;
-
-    ret = drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_VSYNC_SET,
-                               &vsync_arg, sizeof(vsync_arg));
-    if (ret) {
-        ALOGW("%s: failed to dump vsync info %d\n", __func__, ret);
-        goto out;
-    }
-
-    dumpPrintf("-------------Display Stat -------------------\n");
-    dumpPrintf("  + last vsync count: %d, timestamp %d ms \n",
-                     mVsyncsCount, mVsyncsTimestamp/1000000);
-    dumpPrintf("  + current vsync count: %d, timestamp %d ms \n",
-                     vsync_arg.vsync.vsync_count,
-                     vsync_arg.vsync.timestamp/1000000);
-
-    // Read pipe stat register
-    memset(&arg, 0, sizeof(struct drm_psb_register_rw_arg));
-    arg.display_read_mask = REGRWBITS_PIPEASTAT;
-
-    ret = drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_REGISTER_RW,
-                              &arg, sizeof(arg));
-    if (ret) {
-        ALOGW("%s: failed to dump display registers %d\n", __func__, ret);
-        goto out;
-    }
+    // how long dumpsys waits for a new register snapshot, the background
+    // thread may wait behind busier ones for a few frames
+    static const nsecs_t DISPLAY_STAT_TIMEOUT = 100000000LL;
 
-    dumpPrintf("  + PIPEA STAT: 0x%x \n", arg.display.pipestat_a);
+    if (mDisplayStat == 0)
+        mDisplayStat = new IntelDisplayStat(mDrm->getDrmFd());
 
-    // Read interrupt mask register
-    memset(&arg, 0, sizeof(struct drm_psb_register_rw_arg));
-    arg.display_read_mask = REGRWBITS_INT_MASK;
+    // registers are read on the stat thread, an old snapshot is dumped
+    // if it doesn't finish in time. the driver logs all display registers
+    // for this one
+    bool ret = mDisplayStat->refresh(DISPLAY_STAT_TIMEOUT, true);
+    if (!ret)
+        ALOGW("%s: display stat snapshot timed out\n", __func__);
 
-    ret = drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_REGISTER_RW,
-                              &arg, sizeof(arg));
-    if (ret) {
-        ALOGW("%s: failed to dump display registers %d\n", __func__, ret);
-        goto out;
-    }
-
-    dumpPrintf("  + INT_MASK_REG: 0x%x \n", arg.display.int_mask);
-
-    // Read interrupt enable register
-    memset(&arg, 0, sizeof(struct drm_psb_register_rw_arg));
-    arg.display_read_mask = REGRWBITS_INT_ENABLE;
-
-    ret = drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_REGISTER_RW,
-                              &arg, sizeof(arg));
-    if (ret) {
-        ALOGW("%s: failed to dump display registers %d\n", __func__, ret);
-        goto out;
-    }
-
-    dumpPrintf("  + INT_ENABLE_REG: 0x%x \n", arg.display.int_enable);
-
-    // open this if need to dump all display registers.
-#if 1
-    // dump all display regs in driver
-    memset(&arg, 0, sizeof(struct drm_psb_register_rw_arg));
-    arg.display_read_mask = REGRWBITS_DISPLAY_ALL;
-
-    ret = drmCommandWriteRead(mDrm->getDrmFd(), DRM_PSB_REGISTER_RW,
-                              &arg, sizeof(arg));
-    if (ret) {
-        ALOGW("%s: failed to dump display registers %d\n", __func__, ret);
-        goto out;
-    }
-#endif
+    mDisplayStat->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    dumpPrintf("  + last vsync count: %d, timestamp %d ms \n",
+                     mVsyncsCount, mVsyncsTimestamp/1000000);
 
-out:
-    return (ret == 0) ? true : false;
+    return ret;
 }
 
 bool IntelHWComposer::dump(char *buff,
@@ -556,6 +680,41 @@ bool IntelHWComposer::dump(char *buff,
 
     dumpDisplayStat();
 
+    mDrm->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+
+    dumpPrintf("-------------HDMI hotplug -----------------------\n");
+    dumpPrintf("  + first frame latency: %lld us\n", mHotplugLatency / 1000);
+    mHDMIFBLock.lock();
+    for (i = 0; i < HDMI_FB_CACHE_SIZE; i++) {
+        if (!mHDMIFBCache[i].fbId)
+            continue;
+        dumpPrintf("  + fb %d: %dx%d, size %d\n",
+                   mHDMIFBCache[i].fbId,
+                   mHDMIFBCache[i].width,
+                   mHDMIFBCache[i].height,
+                   mHDMIFBCache[i].size);
+    }
+    mHDMIFBLock.unlock();
+    dumpPrintf("  + fb reused %u times\n", mHDMIFBReused);
+
+    dumpPrintf("-------------Frame post -------------------------\n");
+    dumpPrintf("  + posted %u, idle frames skipped %u\n",
+               mFramesPosted, mFramesSkipped);
+
+    if (mInitScheduler != 0)
+        mInitScheduler->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    if (mPrepareScheduler)
+        mPrepareScheduler->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    if (mRefreshGovernor != 0)
+        mRefreshGovernor->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    IntelMemoryTracker::getInstance().dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    if (mPerfHud)
+        mPerfHud->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+#ifdef INTEL_DPST
+    if (mDpstHint)
+        mDpstHint->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+#endif
+
     for (size_t i=0 ; i<DISPLAY_NUM ; i++) {
         if (mDisplayDevice[i])
             mDisplayDevice[i]->dump(mDumpBuf,  mDumpBuflen, &mDumpLen);
@@ -572,8 +731,15 @@ bool IntelHWComposer::initialize()
 
     //TODO: replace the hard code buffer type later
     int bufferType = IntelBufferManager::TTM_BUFFER;
+    nsecs_t start;
 
     ALOGD_IF(ALLOW_HWC_PRINT, "%s\n", __func__);
+
+    // times the components below and holds work deferred past the
+    // first frame
+    if (mInitScheduler == 0)
+        mInitScheduler = new IntelInitScheduler();
+
     if (hw_get_module(GRALLOC_HARDWARE_MODULE_ID,
             (const hw_module_t**)&mGrallocModule) != 0) {
         ALOGE("%s: failed to open IMG GRALLOC module\n", __func__);
@@ -582,6 +748,7 @@ bool IntelHWComposer::initialize()
 
     //create new DRM object if not exists
     if (!mDrm) {
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
         mDrm = &IntelHWComposerDrm::getInstance();
         if (!mDrm) {
             ALOGE("%s: Invalid DRM object\n", __func__);
@@ -593,15 +760,42 @@ bool IntelHWComposer::initialize()
             ALOGE("%s: failed to initialize DRM instance\n", __func__);
             goto drm_err;
         }
+        mInitScheduler->record("drm", start);
     }
 
     //create Vsync Event Handler
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
     mVsync = new IntelVsyncEventHandler(this, mDrm->getDrmFd());
 
     mFakeVsync = new IntelFakeVsyncEvent(this);
+    mInitScheduler->record("vsync", start);
+
+    // MIPI refresh rate governor, only for panels known to accept
+    // timings other than the native one
+    {
+        char drrs[PROPERTY_VALUE_MAX];
+        property_get("hwcomposer.drrs.enable", drrs, "0");
+        if (atoi(drrs))
+            mRefreshGovernor = new IntelRefreshRateGovernor(this);
+    }
+
+#ifdef INTEL_DPST
+    // content hints for the DPST backlight manager
+    if (!mDpstHint)
+        mDpstHint = new IntelDpstHint();
+#endif
+
+    // performance HUD on the cursor plane, shown on demand
+    if (!mPerfHud)
+        mPerfHud = new IntelPerfHud(mDrm->getDrmFd());
+
+    // display register snapshots for dumpsys, the first is taken now
+    if (mDisplayStat == 0)
+        mDisplayStat = new IntelDisplayStat(mDrm->getDrmFd());
 
     //create new buffer manager and initialize it
     if (!mBufferManager) {
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
         //mBufferManager = new IntelTTMBufferManager(mDrm->getDrmFd());
         mBufferManager = new IntelBCDBufferManager(mDrm->getDrmFd());
         if (!mBufferManager) {
@@ -614,10 +808,12 @@ bool IntelHWComposer::initialize()
             ALOGE("%s: Failed to initialize buffer manager\n", __func__);
             goto bm_err;
         }
+        mInitScheduler->record("buffer manager", start);
     }
 
     // create buffer manager for gralloc buffer
     if (!mGrallocBufferManager) {
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
         //mGrallocBufferManager = new IntelPVRBufferManager(mDrm->getDrmFd());
         mGrallocBufferManager = new IntelGraphicBufferManager(mDrm->getDrmFd());
         if (!mGrallocBufferManager) {
@@ -630,10 +826,12 @@ bool IntelHWComposer::initialize()
             ALOGE("%s: Failed to initialize Gralloc buffer manager\n", __func__);
             goto gralloc_bm_err;
         }
+        mInitScheduler->record("gralloc buffer manager", start);
     }
 
     // create new display plane manager
     if (!mPlaneManager) {
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
         mPlaneManager =
             new IntelDisplayPlaneManager(mDrm->getDrmFd(),
                                          mBufferManager, mGrallocBufferManager);
@@ -641,10 +839,22 @@ bool IntelHWComposer::initialize()
             ALOGE("%s: Failed to create plane manager\n", __func__);
             goto gralloc_bm_err;
         }
+        mInitScheduler->record("plane manager", start);
+    }
+
+    // copy of the last posted plane contexts
+    if (!mLastPlaneContexts) {
+        mLastPlaneContexts = malloc(mPlaneManager->getContextLength());
+        if (!mLastPlaneContexts) {
+            ALOGE("%s: Failed to allocate plane contexts\n", __func__);
+            goto pm_err;
+        }
     }
+    mLastFrameValid = false;
 
     // create display devices
     memset(mDisplayDevice, 0, sizeof(mDisplayDevice));
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
     for (size_t i=0; i<DISPLAY_NUM; i++) {
          if (i == HWC_DISPLAY_PRIMARY)
              mDisplayDevice[i] =
@@ -671,13 +881,28 @@ bool IntelHWComposer::initialize()
          }
     }
 
+    mInitScheduler->record("display devices", start);
+
+    // not fatal, displays are prepared one by one without it
+    if (!mPrepareScheduler) {
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
+        mPrepareScheduler = new IntelPrepareScheduler();
+        if (mPrepareScheduler && !mPrepareScheduler->initialize())
+            ALOGW("%s: displays will be prepared serially\n", __func__);
+        mInitScheduler->record("prepare scheduler", start);
+    }
+
     // init mHDMIBuffers
-    memset(&mHDMIFBHandle, 0, sizeof(mHDMIFBHandle));
+    memset(mHDMIFBCache, 0, sizeof(mHDMIFBCache));
     memset(&mExtendedModeInfo, 0, sizeof(mExtendedModeInfo));
 
-    // do mode setting in HWC if HDMI is connected when boot up
-    if (mDrm->detectDisplayConnection(OUTPUT_HDMI))
-        handleHotplugEvent(1, NULL);
+    // caches are trimmed off the composition thread, under mLock
+    IntelMemoryTracker::getInstance().registerTrimmable(
+        IntelMemoryTracker::MEM_HDMI_FB, this);
+    IntelMemoryTracker::getInstance().startTrimThread(&mLock);
+
+    // HDMI mode setting at boot is not needed for the first MIPI frame
+    mInitScheduler->defer("hdmi boot hotplug", bootHotplug, this);
 
     char value[PROPERTY_VALUE_MAX];
     property_get("hwcomposer.debug.dumpPost2", value, "0");
@@ -686,6 +911,7 @@ bool IntelHWComposer::initialize()
 
     // startObserver();
     mInitialized = true;
+    mInitScheduler->start();
 
     ALOGD_IF(ALLOW_HWC_PRINT, "%s: successfully\n", __func__);
     return true;
@@ -721,6 +947,18 @@ err:
     return false;
 }
 
+// deferred from initialize(), runs on the init scheduler thread
+bool IntelHWComposer::bootHotplug(void *data)
+{
+    IntelHWComposer *hwc = (IntelHWComposer*)data;
+
+    // do mode setting in HWC if HDMI is connected when boot up
+    if (!hwc->mDrm->detectDisplayConnection(OUTPUT_HDMI))
+        return true;
+
+    return hwc->handleHotplugEvent(1, NULL);
+}
+
 IMG_native_handle_t *IntelHWComposer::findVideoHandle(hwc_display_contents_1_t* list)
 {
     IMG_native_handle_t *foundHandle = NULL;
@@ -743,6 +981,42 @@ IMG_native_handle_t *IntelHWComposer::findVideoHandle(hwc_display_contents_1_t*
     return foundHandle;
 }
 
+#ifdef INTEL_DPST
+// what the primary display shows, as far as the backlight policy cares
+int IntelHWComposer::getDpstContent(hwc_display_contents_1_t* list,
+                                    bool& fullscreen)
+{
+    int content = DPST_CONTENT_UI;
+
+    fullscreen = false;
+    if (!list || !list->numHwLayers)
+        return content;
+
+    hwc_rect_t& screen = list->hwLayers[list->numHwLayers - 1].displayFrame;
+    for (size_t i = 0; i < list->numHwLayers - 1; i++) {
+        hwc_layer_1_t& layer = list->hwLayers[i];
+        if (layer.compositionType != HWC_OVERLAY || !layer.handle)
+            continue;
+
+        IMG_native_handle_t *grallocHandle = (IMG_native_handle_t*)layer.handle;
+        if (grallocHandle->iFormat != HAL_PIXEL_FORMAT_INTEL_HWC_NV12 &&
+            grallocHandle->iFormat != HAL_PIXEL_FORMAT_INTEL_HWC_NV12_VED &&
+            grallocHandle->iFormat != HAL_PIXEL_FORMAT_INTEL_HWC_NV12_TILE)
+            continue;
+
+        content = (grallocHandle->usage & GRALLOC_USAGE_PROTECTED) ?
+                  DPST_CONTENT_PROTECTED : DPST_CONTENT_VIDEO;
+        // letterboxed video still fills one dimension
+        hwc_rect_t& frame = layer.displayFrame;
+        fullscreen = (frame.right - frame.left == screen.right - screen.left) ||
+                     (frame.bottom - frame.top == screen.bottom - screen.top);
+        break;
+    }
+
+    return content;
+}
+#endif
+
 bool IntelHWComposer::checkPresentationMode(hwc_display_contents_1_t* primary_list,
                                                 hwc_display_contents_1_t* secondary_list)
 {
@@ -770,6 +1044,7 @@ bool IntelHWComposer::prepareDisplays(size_t numDisplays,
                                       hwc_display_contents_1_t** displays)
 {
     android::Mutex::Autolock _l(mLock);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
 
     mExtendedModeInfo.widiExtHandle = NULL;
 
@@ -801,21 +1076,92 @@ bool IntelHWComposer::prepareDisplays(size_t numDisplays,
         }
     }
 
+    // the others overlap, planes still go out in display order. Planes
+    // are granted across displays before any display takes one
+    IntelDisplayDevice *devices[DISPLAY_NUM];
+    hwc_display_contents_1_t *lists[DISPLAY_NUM];
+    int count = 0;
+    disableReclaimedOverlays_l();
+    mPlaneManager->beginPlaneDemands();
     for (size_t disp = 0; disp < numDisplays; disp++) {
         if (disp >= DISPLAY_NUM)
             break;
 
         hwc_display_contents_1_t *list = displays[disp];
-        if (list && mDisplayDevice[disp] && disp != HWC_DISPLAY_VIRTUAL)
-            mDisplayDevice[disp]->prepare(list);
+        if (list && mDisplayDevice[disp] && disp != HWC_DISPLAY_VIRTUAL) {
+            mDisplayDevice[disp]->collectPlaneDemands(list);
+            devices[count] = mDisplayDevice[disp];
+            lists[count] = list;
+            count++;
+        }
 
         if (disp == HWC_DISPLAY_EXTERNAL && !list)
             signalHpdCompletion();
     }
+    mPlaneManager->arbitratePlanes();
+
+    if (mPrepareScheduler)
+        mPrepareScheduler->prepare(devices, lists, count);
+    else {
+        for (int i = 0; i < count; i++)
+            devices[i]->prepare(lists[i]);
+    }
+
+    if (mPerfHud && mDisplayDevice[HWC_DISPLAY_PRIMARY]) {
+        int overlays, sprites, framebuffer;
+        mDisplayDevice[HWC_DISPLAY_PRIMARY]->getPlaneMix(overlays, sprites,
+                                                         framebuffer);
+        mPerfHud->onPrepared(systemTime(SYSTEM_TIME_MONOTONIC) - start,
+                             overlays, sprites, framebuffer);
+    }
 
     return true;
 }
 
+bool IntelHWComposer::isIdleFrame(void *context,
+                                  buffer_handle_t *bh, int numBuffers)
+{
+    if (!mLastFrameValid || numBuffers != mLastNumBuffers)
+        return false;
+
+    if (memcmp(bh, mLastBufferHandles, numBuffers * sizeof(buffer_handle_t)))
+        return false;
+
+    return !memcmp(context, mLastPlaneContexts,
+                   mPlaneManager->getContextLength());
+}
+
+void IntelHWComposer::saveFrameState(void *context,
+                                     buffer_handle_t *bh, int numBuffers,
+                                     int **releaseFenceFd)
+{
+    memcpy(mLastPlaneContexts, context, mPlaneManager->getContextLength());
+    memcpy(mLastBufferHandles, bh, numBuffers * sizeof(buffer_handle_t));
+    mLastNumBuffers = numBuffers;
+    mLastFrameValid = true;
+
+    // all buffers of a post share one kernel fence
+    if (mLastReleaseFence >= 0) {
+        close(mLastReleaseFence);
+        mLastReleaseFence = -1;
+    }
+    for (int i = 0; i < numBuffers; i++) {
+        if (releaseFenceFd[i] && *releaseFenceFd[i] >= 0) {
+            mLastReleaseFence = dup(*releaseFenceFd[i]);
+            break;
+        }
+    }
+}
+
+void IntelHWComposer::invalidateFrameState()
+{
+    mLastFrameValid = false;
+    if (mLastReleaseFence >= 0) {
+        close(mLastReleaseFence);
+        mLastReleaseFence = -1;
+    }
+}
+
 bool IntelHWComposer::commitDisplays(size_t numDisplays,
                                      hwc_display_contents_1_t** displays)
 {
@@ -825,6 +1171,7 @@ bool IntelHWComposer::commitDisplays(size_t numDisplays,
     }
 
     android::Mutex::Autolock _l(mLock);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
 
     mPlaneManager->resetPlaneContexts();
 
@@ -844,11 +1191,39 @@ bool IntelHWComposer::commitDisplays(size_t numDisplays,
             }
             mDisplayDevice[disp]->commit(list, bufferHandles,
                 acquireFenceFd, releaseFenceFd, numBuffers);
+
+            if (disp == HWC_DISPLAY_EXTERNAL && mHotplugTime) {
+                mHotplugLatency = systemTime(SYSTEM_TIME_MONOTONIC) - mHotplugTime;
+                mHotplugTime = 0;
+                ALOGD("%s: first HDMI frame %lld us after plug-in\n",
+                      __func__, mHotplugLatency / 1000);
+            }
         }
      }
 
     void *context = mPlaneManager->getPlaneContexts();
 
+    // nothing changed since the last post, e.g. static screen or repeated
+    // invalidates, skip the kernel submission. The buffers are still on
+    // screen, so they are released by the fence of the last post.
+    if (numBuffers && isIdleFrame(context, bufferHandles, numBuffers)) {
+        ALOGD_IF(ALLOW_HWC_PRINT, "%s: skip idle frame\n", __func__);
+        for (j = 0; j < numBuffers; j++) {
+            if (releaseFenceFd[j] && mLastReleaseFence >= 0)
+                *releaseFenceFd[j] = dup(mLastReleaseFence);
+        }
+        mFramesSkipped++;
+        numBuffers = 0;
+    }
+
+#ifdef INTEL_DPST
+    if (mDpstHint && displays[HWC_DISPLAY_PRIMARY]) {
+        bool fullscreen;
+        int content = getDpstContent(displays[HWC_DISPLAY_PRIMARY], fullscreen);
+        mDpstHint->onFrame(content, fullscreen, numBuffers == 0);
+    }
+#endif
+
     // commit plane contexts
     if (numBuffers) {
         ALOGD_IF(ALLOW_HWC_PRINT, "%s: commits %d buffers\n", __func__, numBuffers);
@@ -861,7 +1236,25 @@ bool IntelHWComposer::commitDisplays(size_t numDisplays,
                                               mPlaneManager->getContextLength());
         if (err) {
             ALOGE("%s: Post2 failed with errno %d\n", __func__, err);
+            invalidateFrameState();
             ret = false;
+        } else {
+            saveFrameState(context, bufferHandles, numBuffers, releaseFenceFd);
+            mFramesPosted++;
+            if (displays[HWC_DISPLAY_PRIMARY])
+                mInitScheduler->onFramePosted();
+        }
+
+        // new UI content on the primary display, video-only updates
+        // through the overlay leave the framebuffer target untouched
+        hwc_display_contents_1_t *primary = displays[HWC_DISPLAY_PRIMARY];
+        if (primary && primary->numHwLayers && mRefreshGovernor != 0) {
+            buffer_handle_t fbTarget =
+                primary->hwLayers[primary->numHwLayers - 1].handle;
+            if (fbTarget != mLastFBTarget) {
+                mLastFBTarget = fbTarget;
+                mRefreshGovernor->notifyActivity();
+            }
         }
     }
 
@@ -881,6 +1274,10 @@ bool IntelHWComposer::commitDisplays(size_t numDisplays,
                             break;
                         }
                     }
+                    // nothing was posted to dup a fence from
+                    if (list->hwLayers[i].releaseFenceFd ==
+                        LAYER_SAME_RGB_BUFFER_SKIP_RELEASEFENCEFD)
+                        list->hwLayers[i].releaseFenceFd = -1;
                 }
                 if (list->hwLayers[i].acquireFenceFd >= 0)
                     close(list->hwLayers[i].acquireFenceFd);
@@ -891,6 +1288,11 @@ bool IntelHWComposer::commitDisplays(size_t numDisplays,
                 close(list->outbufAcquireFenceFd);
                 list->outbufAcquireFenceFd = -1;
             }
+
+            // reclaimed overlays wait for this frame to scan out
+            if (numBuffers && ret && list->numHwLayers)
+                mPlaneManager->onFramePosted(disp,
+                    list->hwLayers[list->numHwLayers - 1].releaseFenceFd);
         }
     }
 
@@ -899,14 +1301,29 @@ bool IntelHWComposer::commitDisplays(size_t numDisplays,
         dumpLayerLists(numDisplays, displays);
     }
 
+    releaseIdleHDMIFramebuffers();
+
+    // trimmed on the trim thread once this post returns the lock, what
+    // it releases is off screen once this post flips
+    IntelMemoryTracker& mem = IntelMemoryTracker::getInstance();
+    if (mem.needsTrim())
+        mem.requestTrim();
+
+    if (mPerfHud)
+        mPerfHud->onCommitted(systemTime(SYSTEM_TIME_MONOTONIC) - start);
+
     return ret;
 }
 
 bool IntelHWComposer::blankDisplay(int disp, int blank)
 {
     if ((disp<DISPLAY_NUM) && mDisplayDevice[disp]) {
+        // no panel mode setting while MIPI is off
+        if (disp == HWC_DISPLAY_PRIMARY && mRefreshGovernor != 0)
+            mRefreshGovernor->setBlanked(blank == 1);
         mDisplayDevice[disp]->blank(blank);
         android::Mutex::Autolock _l(mLock);
+        invalidateFrameState();
         if (blank == 1)
             mDisplayDevice[disp]->release();
     }
@@ -971,6 +1388,9 @@ bool IntelHWComposer::setFramecount(int cmd, int count, int x, int y)
          break;
       case 1:
          if (!mCursorBufferManager) {
+            // keep the HUD off the cursor registers before they are taken
+            if (mPerfHud)
+               mPerfHud->setCursorBusy(true);
             mCursorBufferManager = new IntelPVRBufferManager(mDrm->getDrmFd());
             if (!mCursorBufferManager) {
                ALOGE("%s: Failed to create Cursor buffer manager\n", __func__);
@@ -1007,6 +1427,8 @@ bool IntelHWComposer::setFramecount(int cmd, int count, int x, int y)
            mCursorBufferManager->curFree(cursorDataBuffer);
            mCursorBufferManager = 0;
            delete mCursorBufferManager;
+           if (mPerfHud)
+              mPerfHud->setCursorBusy(false);
          }
          break;
     }
@@ -1014,6 +1436,8 @@ bool IntelHWComposer::setFramecount(int cmd, int count, int x, int y)
     gralloc_bm_err:
        mCursorBufferManager = 0;
        delete mCursorBufferManager;
+       if (mPerfHud)
+          mPerfHud->setCursorBusy(false);
        return false;
 }
 
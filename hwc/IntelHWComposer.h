@@ -56,11 +56,20 @@
 #include <IntelHWComposerDump.h>
 #include <IntelVsyncEventHandler.h>
 #include <IntelFakeVsyncEvent.h>
+#include <IntelRefreshRateGovernor.h>
+#include <IntelInitScheduler.h>
+#include <IntelPrepareScheduler.h>
+#include <IntelPerfHud.h>
+#include <IntelDisplayStat.h>
 #include <IntelDisplayDevice.h>
+#ifdef INTEL_DPST
+#include <IntelDpstHint.h>
+#endif
 #ifdef INTEL_RGB_OVERLAY
 #include <IntelHWCWrapper.h>
 #endif
-class IntelHWComposer : public hwc_composer_device_1_t, public IntelHWCUEventObserver, public IntelHWComposerDump  {
+class IntelHWComposer : public hwc_composer_device_1_t, public IntelHWCUEventObserver, public IntelHWComposerDump,
+                        public IntelMemoryTrimmable {
 public:
     enum {
         VSYNC_SRC_MIPI = 0,
@@ -71,6 +80,9 @@ public:
     enum {
         DISPLAY_NUM = 3,
     };
+    enum {
+        HDMI_FB_CACHE_SIZE = 2,
+    };
  enum {
         LAYER_SAME_RGB_BUFFER_SKIP_RELEASEFENCEFD = -2,
     };
@@ -86,12 +98,46 @@ private:
     hwc_procs_t const *mProcs;
     android::sp<IntelVsyncEventHandler> mVsync;
     android::sp<IntelFakeVsyncEvent> mFakeVsync;
+    android::sp<IntelRefreshRateGovernor> mRefreshGovernor;
+    android::sp<IntelInitScheduler> mInitScheduler;
+    IntelPrepareScheduler *mPrepareScheduler;
+    IntelPerfHud *mPerfHud;
+    // register snapshots for dumpsys, created on the first dump
+    android::sp<IntelDisplayStat> mDisplayStat;
+    buffer_handle_t mLastFBTarget;
     nsecs_t mLastVsync;
+    // HDMI framebuffers kept across hotplug, keyed by mode size
     struct hdmi_fb_handler {
         uint32_t umhandle;
         uint32_t kmhandle;
         uint32_t size;
-    } mHDMIFBHandle;
+        uint32_t width;
+        uint32_t height;
+        uint32_t fbId;
+        uint32_t lastUsed;
+    } mHDMIFBCache[HDMI_FB_CACHE_SIZE];
+    uint32_t mHDMIFBSeq;
+    uint32_t mHDMIFBReused;
+    // cache guarded against the commit path, and when HDMI went away
+    android::Mutex mHDMIFBLock;
+    nsecs_t mHDMIFBIdleSince;
+    // time from HDMI plug-in to the first external frame
+    nsecs_t mHotplugTime;
+    nsecs_t mHotplugLatency;
+
+    // last posted frame, a commit with identical plane contexts and
+    // buffers is not submitted to the kernel again
+    void *mLastPlaneContexts;
+    buffer_handle_t mLastBufferHandles[INTEL_DISPLAY_PLANE_NUM];
+    int mLastNumBuffers;
+    bool mLastFrameValid;
+    // release fence of the last post, handed out again for skipped frames
+    int mLastReleaseFence;
+    uint32_t mFramesPosted;
+    uint32_t mFramesSkipped;
+#ifdef INTEL_DPST
+    IntelDpstHint *mDpstHint;
+#endif
     WidiExtendedModeInfo mExtendedModeInfo;
 
     android::Mutex mLock;
@@ -116,9 +162,25 @@ private:
     uint32_t getTargetVsync();
     bool needSwitchVsyncSrc();
     bool vsyncControl_l(int enabled);
+    // disables reclaimed overlays of all displays whose frames scanned out
+    void disableReclaimedOverlays_l();
     void signalHpdCompletion();
     void waitForHpdCompletion();
+    hdmi_fb_handler* getHDMIFramebuffer(drmModeModeInfoPtr mode);
+    void releaseHDMIFramebuffer(hdmi_fb_handler *fb);
+    // frees the cache once HDMI stayed unplugged for a while
+    void releaseIdleHDMIFramebuffers();
+    // drops the HDMI framebuffers not scanned out
+    virtual uint32_t trimMemory(int category);
+    bool isIdleFrame(void *context, buffer_handle_t *bh, int numBuffers);
+    void saveFrameState(void *context, buffer_handle_t *bh, int numBuffers,
+                        int **releaseFenceFd);
+    void invalidateFrameState();
     static IMG_native_handle_t *findVideoHandle(hwc_display_contents_1_t* list);
+    static bool bootHotplug(void *data);
+#ifdef INTEL_DPST
+    static int getDpstContent(hwc_display_contents_1_t* list, bool& fullscreen);
+#endif
 
     bool mForceDumpPostBuffer;
     int dumpPost2Buffers(int num, buffer_handle_t* buffer);
@@ -127,6 +189,8 @@ private:
 public:
     bool onUEvent(int msgType, void* msg, int msgLen);
     void vsync(int64_t timestamp, int pipe);
+    bool setRefreshRate(int rate);
+    IntelInitScheduler* getInitScheduler() { return mInitScheduler.get(); }
 public:
     bool initCheck() { return mInitialized; }
     bool initialize();
@@ -150,7 +214,19 @@ public:
           mDrm(0), mBufferManager(0), mGrallocBufferManager(0),
           mCursorBufferManager(0), cursorDataBuffer(0),
           mPlaneManager(0),mProcs(0), mVsync(0), mFakeVsync(0),
-          mLastVsync(0), mInitialized(false),
+          mRefreshGovernor(0), mInitScheduler(0), mPrepareScheduler(0),
+          mPerfHud(0), mDisplayStat(0),
+          mLastFBTarget(0),
+          mLastVsync(0), mHDMIFBSeq(0), mHDMIFBReused(0),
+          mHDMIFBIdleSince(0),
+          mHotplugTime(0), mHotplugLatency(0),
+          mLastPlaneContexts(0), mLastNumBuffers(0), mLastFrameValid(false),
+          mLastReleaseFence(-1),
+          mFramesPosted(0), mFramesSkipped(0),
+#ifdef INTEL_DPST
+          mDpstHint(0),
+#endif
+          mInitialized(false),
           mActiveVsyncs(0), mHpdCompletion(true), mForceDumpPostBuffer(false) {}
     ~IntelHWComposer();
 };
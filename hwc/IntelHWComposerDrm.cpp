@@ -218,8 +218,15 @@ bool IntelHWComposerDrm::isHdmiConnected()
 bool IntelHWComposerDrm::notifyWidi(bool on)
 {
 #ifdef TARGET_HAS_MULTIPLE_DISPLAY
-    if (mMonitor != NULL)
-        return mMonitor->notifyWidi(on);
+    if (mMonitor != NULL) {
+        android::Mutex::Autolock _l(mShadowLock);
+        if (!needShadowWrite_l(DRM_CTRL_NOTIFY_WIDI, on))
+            return true;
+
+        bool ret = mMonitor->notifyWidi(on);
+        updateShadowState_l(DRM_CTRL_NOTIFY_WIDI, on, ret);
+        return ret;
+    }
 #endif
     return false;
 }
@@ -227,8 +234,15 @@ bool IntelHWComposerDrm::notifyWidi(bool on)
 bool IntelHWComposerDrm::notifyMipi(bool on)
 {
 #ifdef TARGET_HAS_MULTIPLE_DISPLAY
-    if (mMonitor != NULL)
-        return mMonitor->notifyMipi(on);
+    if (mMonitor != NULL) {
+        android::Mutex::Autolock _l(mShadowLock);
+        if (!needShadowWrite_l(DRM_CTRL_NOTIFY_MIPI, on))
+            return true;
+
+        bool ret = mMonitor->notifyMipi(on);
+        updateShadowState_l(DRM_CTRL_NOTIFY_MIPI, on, ret);
+        return ret;
+    }
 #endif
     return false;
 }
@@ -450,6 +464,17 @@ IntelHWComposerDrm::getConnector(int disp)
             return NULL;
     }
 
+    // HDMI connector id is known after the first lookup
+    if (disp == OUTPUT_HDMI && mHotplugCache.connector_id) {
+        drmModeConnectorPtr cached =
+            drmModeGetConnector(mDrmFd, mHotplugCache.connector_id);
+        if (cached && cached->connector_type == req_connector_type)
+            return cached;
+        if (cached)
+            drmModeFreeConnector(cached);
+        mHotplugCache.connector_id = 0;
+    }
+
     drmModeResPtr resources = drmModeGetResources(mDrmFd);
     if (!resources || !resources->connectors) {
         ALOGE("%s: fail to get drm resources. %s\n", __func__, strerror(errno));
@@ -478,6 +503,8 @@ IntelHWComposerDrm::getConnector(int disp)
 
     if (connector == NULL)
         ALOGW("%s: fail to get required connector\n", __func__);
+    else if (disp == OUTPUT_HDMI)
+        mHotplugCache.connector_id = connector->connector_id;
 
     return connector;
 }
@@ -574,6 +601,9 @@ uint32_t IntelHWComposerDrm::getCrtcId(int disp)
     uint32_t crtc_id = 0;
     int i = 0;
 
+    if (disp == OUTPUT_HDMI && mHotplugCache.crtc_id)
+        return mHotplugCache.crtc_id;
+
     if ((encoder = getEncoder(disp)) == NULL)
         return 0;
 
@@ -604,6 +634,9 @@ uint32_t IntelHWComposerDrm::getCrtcId(int disp)
         }
     }
 
+    if (disp == OUTPUT_HDMI)
+        mHotplugCache.crtc_id = crtc_id;
+
     return crtc_id;
 }
 
@@ -645,13 +678,21 @@ IntelHWComposerDrm::selectDisplayDrmMode(int disp, intel_display_mode_t *display
         return NULL;
     }
 
-    mode = getSelectMode(displayMode, connector);
+    // a known monitor without an explicit request gets its last mode back
+    mHotplugCache.monitor_id = getMonitorId(connector);
+    mode = NULL;
+    if (!displayMode)
+        mode = getCachedMode(mHotplugCache.monitor_id, connector);
+    if (!mode)
+        mode = getSelectMode(displayMode, connector);
 
     if (!mode) {
         ALOGW("%s: fail to get selected mode or any other mode! \n", __func__);
         return NULL;
     }
 
+    cacheMonitorMode(mHotplugCache.monitor_id, mode);
+
     // update current mode to be selected
     setOutputMode(OUTPUT_HDMI, mode, 1);
 
@@ -714,6 +755,95 @@ IntelHWComposerDrm::getSelectMode(intel_display_mode_t *displayMode,
     return &connector->modes[index];
 }
 
+uint32_t IntelHWComposerDrm::getMonitorId(drmModeConnectorPtr connector)
+{
+    drmModePropertyPtr props = NULL;
+    drmModePropertyBlobPtr edid = NULL;
+    uint32_t id = 2166136261U;
+
+    if (!connector)
+        return 0;
+
+    for (int i = 0; i < connector->count_props && !edid; i++) {
+        props = drmModeGetProperty(mDrmFd, connector->props[i]);
+        if (!props)
+            continue;
+
+        if ((props->flags & DRM_MODE_PROP_BLOB) && !strcmp(props->name, "EDID"))
+            edid = drmModeGetPropertyBlob(mDrmFd, connector->prop_values[i]);
+        drmModeFreeProperty(props);
+    }
+
+    if (!edid)
+        return 0;
+
+    // FNV-1a over the raw EDID, 0 is reserved for "unknown monitor"
+    const uint8_t *data = (const uint8_t *)edid->data;
+    for (uint32_t i = 0; i < edid->length; i++) {
+        id ^= data[i];
+        id *= 16777619U;
+    }
+    drmModeFreePropertyBlob(edid);
+
+    return id ? id : 1;
+}
+
+drmModeModeInfoPtr
+IntelHWComposerDrm::getCachedMode(uint32_t monitor, drmModeConnectorPtr connector)
+{
+    if (!monitor || !connector)
+        return NULL;
+
+    for (int i = 0; i < DRM_MONITOR_CACHE_SIZE; i++) {
+        drmModeModeInfoPtr cached = &mHotplugCache.monitors[i].mode;
+        if (mHotplugCache.monitors[i].id != monitor)
+            continue;
+
+        // validate against the modes the monitor reports right now
+        for (int j = 0; j < connector->count_modes; j++) {
+            drmModeModeInfoPtr mode = &connector->modes[j];
+            if (mode->clock == cached->clock &&
+                mode->hdisplay == cached->hdisplay &&
+                mode->vdisplay == cached->vdisplay &&
+                mode->vrefresh == cached->vrefresh &&
+                mode->flags == cached->flags) {
+                mHotplugCache.hits++;
+                ALOGD_IF(ALLOW_MONITOR_PRINT, "%s: monitor 0x%x, use cached mode\n",
+                         __func__, monitor);
+                return mode;
+            }
+        }
+        break;
+    }
+
+    mHotplugCache.misses++;
+    return NULL;
+}
+
+void IntelHWComposerDrm::cacheMonitorMode(uint32_t monitor, drmModeModeInfoPtr mode)
+{
+    intel_drm_monitor_entry_t *entry = NULL;
+
+    if (!monitor || !mode)
+        return;
+
+    for (int i = 0; i < DRM_MONITOR_CACHE_SIZE; i++) {
+        if (mHotplugCache.monitors[i].id == monitor) {
+            entry = &mHotplugCache.monitors[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        entry = &mHotplugCache.monitors[mHotplugCache.next_monitor];
+        mHotplugCache.next_monitor =
+            (mHotplugCache.next_monitor + 1) % DRM_MONITOR_CACHE_SIZE;
+    }
+
+    entry->id = monitor;
+    memcpy(&entry->mode, mode, sizeof(drmModeModeInfo));
+}
+
 bool IntelHWComposerDrm::isModeChanged(drmModeModeInfoPtr mode,
                                        intel_display_mode_t *displayMode)
 {
@@ -754,18 +884,17 @@ bool IntelHWComposerDrm::isDrmModeFlagsMatched(drmModeModeInfoPtr mode, intel_di
     return false;
 }
 
-bool IntelHWComposerDrm::setupDrmFb(int disp,
-                                    uint32_t fb_handler,
-                                    drmModeModeInfoPtr mode)
+uint32_t IntelHWComposerDrm::addDrmFb(uint32_t fb_handler,
+                                      drmModeModeInfoPtr mode)
 {
     if (mDrmFd < 0) {
         ALOGE("%s: invalid drm FD\n", __func__);
-        return false;
+        return 0;
     }
 
     if (!mode) {
         ALOGW("%s: invalid mode !\n", __func__);
-        return false;
+        return 0;
     }
 
     int width = mode->hdisplay;
@@ -778,9 +907,23 @@ bool IntelHWComposerDrm::setupDrmFb(int disp,
                   stride, (uint32_t)(fb_handler), &fb_id);
     if (ret) {
         ALOGE("%s: Failed to add fb !", __func__);
-        return false;
+        return 0;
     }
 
+    return fb_id;
+}
+
+void IntelHWComposerDrm::removeDrmFb(uint32_t fb_id)
+{
+    if (mDrmFd < 0 || !fb_id)
+        return;
+
+    ALOGD_IF(ALLOW_MONITOR_PRINT, "%s: rm FB %d\n", __func__, fb_id);
+    drmModeRmFB(mDrmFd, fb_id);
+}
+
+bool IntelHWComposerDrm::setupDrmFb(int disp, uint32_t fb_id)
+{
     // add to local output structure
     drmModeFBPtr fbInfo = drmModeGetFB(mDrmFd, fb_id);
     if (!fbInfo) {
@@ -810,6 +953,8 @@ void IntelHWComposerDrm::deleteDrmFb(int disp)
 
 bool IntelHWComposerDrm::handleDisplayDisConnection(int disp)
 {
+    invalidateShadowState(disp);
+
     if (disp == OUTPUT_HDMI) {
         if (mHdmiConnector != NULL) {
             drmModeFreeConnector(mHdmiConnector);
@@ -861,20 +1006,19 @@ bool IntelHWComposerDrm::detectDisplayConnection(int disp)
 }
 
 bool IntelHWComposerDrm::setDisplayDrmMode(int disp,
-                                           uint32_t fb_handler,
+                                           uint32_t fb_id,
                                            drmModeModeInfoPtr mode)
 {
     drmModeConnectorPtr connector = NULL;
     uint32_t crtc_id = 0;
-    uint32_t fb_id = 0;
 
     if (mDrmFd < 0) {
         ALOGE("%s: invalid drm FD\n", __func__);
         return false;
     }
 
-    if (!fb_handler) {
-        ALOGE("%s: invalid fb handler\n", __func__);
+    if (!fb_id || !mode) {
+        ALOGE("%s: invalid fb id or mode\n", __func__);
         return false;
     }
     if (disp != OUTPUT_HDMI)
@@ -893,12 +1037,8 @@ bool IntelHWComposerDrm::setDisplayDrmMode(int disp,
         return false;
     }
 
-    // get fb_id
-    if (setupDrmFb(OUTPUT_HDMI, fb_handler, mode))
-        fb_id = getOutputFBId(OUTPUT_HDMI);
-
-    if (!fb_id) {
-        ALOGW("%s: fail to get drm fb id\n", __func__);
+    if (!setupDrmFb(OUTPUT_HDMI, fb_id)) {
+        ALOGW("%s: fail to get drm fb info\n", __func__);
         freeConnector(connector);
         return false;
     }
@@ -911,11 +1051,17 @@ bool IntelHWComposerDrm::setDisplayDrmMode(int disp,
         return false;
     }
 
+    // a mode set powers the pipe up again, forget what we knew about it
+    invalidateShadowState(OUTPUT_HDMI);
+
     // crtc mode setting
     int ret = drmModeSetCrtc(mDrmFd, crtc_id, fb_id, 0, 0,
                    &connector->connector_id, 1, mode);
     if (ret) {
         ALOGW("drm Mode Set Crtc Error: 0x%x!\n", ret);
+        // topology may have changed under us, look it up again next time
+        mHotplugCache.connector_id = 0;
+        mHotplugCache.crtc_id = 0;
         freeConnector(connector);
         return false;
     }
@@ -923,10 +1069,73 @@ bool IntelHWComposerDrm::setDisplayDrmMode(int disp,
     return true;
 }
 
+// Refresh rate
+bool IntelHWComposerDrm::setDisplayRefreshRate(int disp, int rate)
+{
+    drmModeConnectorPtr connector = NULL;
+    drmModeModeInfoPtr native;
+    drmModeModeInfo mode;
+    uint32_t crtc_id = 0;
+    uint32_t fb_id = 0;
+
+    if (mDrmFd < 0) {
+        ALOGE("%s: invalid drm FD\n", __func__);
+        return false;
+    }
+
+    if (disp != OUTPUT_MIPI0 || rate <= 0 || !isValidOutputMode(disp))
+        return false;
+
+    native = getOutputMode(disp);
+    if (!native->vrefresh)
+        return false;
+
+    // keep the native blanking, scale the pixel clock
+    memcpy(&mode, native, sizeof(drmModeModeInfo));
+    mode.clock = native->clock * rate / native->vrefresh;
+    mode.vrefresh = rate;
+
+    fb_id = getOutputFBId(disp);
+    crtc_id = getCrtcId(disp);
+    if (!fb_id || !crtc_id) {
+        ALOGW("%s: fail to get drm fb/crtc id\n", __func__);
+        return false;
+    }
+
+    connector = getConnector(disp);
+    if (!connector) {
+        ALOGW("%s: fail to get drm connector\n", __func__);
+        return false;
+    }
+
+    // a mode set powers the pipe up again, forget what we knew about it
+    invalidateShadowState(disp);
+
+    int ret = drmModeSetCrtc(mDrmFd, crtc_id, fb_id, 0, 0,
+                   &connector->connector_id, 1, &mode);
+    freeConnector(connector);
+    if (ret) {
+        ALOGW("%s: failed to set %dHz, ret %d\n", __func__, rate, ret);
+        return false;
+    }
+
+    ALOGD_IF(ALLOW_MONITOR_PRINT, "%s: display %d at %dHz, clock %d\n",
+             __func__, disp, rate, mode.clock);
+    return true;
+}
+
 // DPMS
 bool IntelHWComposerDrm::setDisplayDpms(int disp, bool blank)
 {
     int ret=0;
+    int ctrl = (disp == OUTPUT_HDMI) ? DRM_CTRL_DPMS_HDMI : DRM_CTRL_DPMS_MIPI0;
+
+    if (disp != OUTPUT_MIPI0 && disp != OUTPUT_HDMI)
+        return true;
+
+    android::Mutex::Autolock _l(mShadowLock);
+    if (!needShadowWrite_l(ctrl, blank))
+        return true;
 
     if (disp == OUTPUT_MIPI0) {
         // Set MIPI On/Off
@@ -981,8 +1190,14 @@ bool IntelHWComposerDrm::setDisplayDpms(int disp, bool blank)
         goto err;
     }
 
+    updateShadowState_l(ctrl, blank, true);
+
+    // power transition resets vsync interrupts of this pipe
+    invalidateShadowState_l((disp == OUTPUT_HDMI) ?
+                            DRM_CTRL_VSYNC_HDMI : DRM_CTRL_VSYNC_MIPI0);
     return true;
 err:
+    updateShadowState_l(ctrl, blank, false);
     return false;
 }
 
@@ -1001,7 +1216,41 @@ bool IntelHWComposerDrm::setHDMIPowerOff()
 }
 
 // Vsync
-bool IntelHWComposerDrm::setDisplayVsyncs(int disp, bool on) {
+bool IntelHWComposerDrm::setDisplayVsyncs(int disp, bool on,
+                                          uint32_t *count, uint64_t *timestamp)
+{
+    struct drm_psb_vsync_set_arg arg;
+    int ctrl = (disp == OUTPUT_HDMI) ? DRM_CTRL_VSYNC_HDMI : DRM_CTRL_VSYNC_MIPI0;
+    int ret;
+
+    if (mDrmFd < 0) {
+        ALOGE("%s: invalid drm FD\n", __func__);
+        return false;
+    }
+
+    android::Mutex::Autolock _l(mShadowLock);
+    if (!needShadowWrite_l(ctrl, on))
+        return true;
+
+    memset(&arg, 0, sizeof(struct drm_psb_vsync_set_arg));
+    arg.vsync_operation_mask = (on ? VSYNC_ENABLE : VSYNC_DISABLE) |
+                               GET_VSYNC_COUNT;
+    // pipe select
+    arg.vsync.pipe = (disp == OUTPUT_HDMI) ? 1 : 0;
+
+    ret = drmCommandWriteRead(mDrmFd, DRM_PSB_VSYNC_SET, &arg, sizeof(arg));
+    updateShadowState_l(ctrl, on, ret == 0);
+    if (ret) {
+        ALOGW("%s: failed to %s vsync %d\n", __func__,
+              on ? "enable" : "disable", ret);
+        return false;
+    }
+
+    if (count)
+        *count = arg.vsync.vsync_count;
+    if (timestamp)
+        *timestamp = arg.vsync.timestamp;
+
     return true;
 }
 
@@ -1014,6 +1263,8 @@ bool IntelHWComposerDrm::setDisplayIed(bool on)
 {
     int ret;
 
+    // sent with every protected frame, the kernel turns IED off on its
+    // own when the island powers down or the protected session ends
     ret = drmCommandNone(mDrmFd, DRM_PSB_HDCP_DISPLAY_IED_ON);
 
     return (ret == 0) ? true : false;
@@ -1037,3 +1288,104 @@ bool IntelHWComposerDrm::onlyHdmiHasVideo() {
         ALOGD_IF(ALLOW_MONITOR_PRINT, "Only HDMI has video layer");
     return mOnlyHdmiHasVideo;
 }
+
+// Returns false if @value matches the last value written to @ctrl, in
+// which case the write is counted as elided and must be skipped.
+bool IntelHWComposerDrm::needShadowWrite_l(int ctrl, int value)
+{
+    if (ctrl < 0 || ctrl >= DRM_CTRL_MAX)
+        return true;
+
+    if (mShadowState.value[ctrl] == value) {
+        mShadowState.elided[ctrl]++;
+        return false;
+    }
+
+    return true;
+}
+
+void IntelHWComposerDrm::updateShadowState_l(int ctrl, int value, bool success)
+{
+    if (ctrl < 0 || ctrl >= DRM_CTRL_MAX)
+        return;
+
+    mShadowState.issued[ctrl]++;
+    // on failure we cannot tell what state the kernel is in
+    mShadowState.value[ctrl] = success ? value : DRM_CTRL_VALUE_UNKNOWN;
+}
+
+void IntelHWComposerDrm::invalidateShadowState_l(int ctrl)
+{
+    if (ctrl < 0 || ctrl >= DRM_CTRL_MAX)
+        return;
+
+    mShadowState.value[ctrl] = DRM_CTRL_VALUE_UNKNOWN;
+}
+
+void IntelHWComposerDrm::invalidateShadowState(int disp)
+{
+    android::Mutex::Autolock _l(mShadowLock);
+
+    ALOGD_IF(ALLOW_MONITOR_PRINT, "%s: display %d\n", __func__, disp);
+
+    // MDS state follows any connection change
+    invalidateShadowState_l(DRM_CTRL_NOTIFY_WIDI);
+    invalidateShadowState_l(DRM_CTRL_NOTIFY_MIPI);
+
+    if (disp == OUTPUT_HDMI) {
+        invalidateShadowState_l(DRM_CTRL_DPMS_HDMI);
+        invalidateShadowState_l(DRM_CTRL_VSYNC_HDMI);
+    } else if (disp == OUTPUT_MIPI0) {
+        invalidateShadowState_l(DRM_CTRL_DPMS_MIPI0);
+        invalidateShadowState_l(DRM_CTRL_VSYNC_MIPI0);
+    }
+}
+
+void IntelHWComposerDrm::invalidateMdsState()
+{
+    android::Mutex::Autolock _l(mShadowLock);
+
+    ALOGD_IF(ALLOW_MONITOR_PRINT, "%s\n", __func__);
+
+    // a restarted MDS starts from its defaults
+    invalidateShadowState_l(DRM_CTRL_NOTIFY_WIDI);
+    invalidateShadowState_l(DRM_CTRL_NOTIFY_MIPI);
+}
+
+bool IntelHWComposerDrm::dump(char *buff, int buff_len, int *cur_len)
+{
+    static const char *ctrlNames[DRM_CTRL_MAX] = {
+        "notify WiDi",
+        "notify MIPI",
+        "DPMS MIPI0",
+        "DPMS HDMI",
+        "vsync MIPI0",
+        "vsync HDMI",
+    };
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    android::Mutex::Autolock _l(mShadowLock);
+
+    dumpPrintf("-------------DRM ioctl shadow state -------------\n");
+    for (int i = 0; i < DRM_CTRL_MAX; i++) {
+        dumpPrintf("  + %-12s: value %2d, issued %u, elided %u\n",
+                   ctrlNames[i],
+                   mShadowState.value[i],
+                   mShadowState.issued[i],
+                   mShadowState.elided[i]);
+    }
+
+    dumpPrintf("-------------HDMI hotplug cache -----------------\n");
+    dumpPrintf("  + connector %d, crtc %d, monitor 0x%x\n",
+               mHotplugCache.connector_id,
+               mHotplugCache.crtc_id,
+               mHotplugCache.monitor_id);
+    dumpPrintf("  + cached mode hits %u, misses %u\n",
+               mHotplugCache.hits, mHotplugCache.misses);
+
+    *cur_len = mDumpLen;
+    return true;
+}
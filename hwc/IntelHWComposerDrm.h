@@ -47,9 +47,11 @@
 
 #include <IntelBufferManager.h>
 #include <IntelHWCUEventObserver.h>
+#include <IntelHWComposerDump.h>
 #include <linux/psb_drm.h>
 #include <pthread.h>
 #include <pvr2d.h>
+#include <utils/threads.h>
 #ifdef TARGET_HAS_MULTIPLE_DISPLAY
 #include <IntelExternalDisplayMonitor.h>
 #endif
@@ -97,6 +99,51 @@ typedef struct {
     intel_overlay_mode_t old_display_mode;
 } intel_drm_output_state_t;
 
+// DRM/MDS controls shadowed by IntelHWComposerDrm. A write whose value
+// matches the last value written is elided instead of going to the kernel.
+// IED isn't one of them, the kernel drops it without telling HWC.
+typedef enum {
+    DRM_CTRL_NOTIFY_WIDI = 0,
+    DRM_CTRL_NOTIFY_MIPI,
+    DRM_CTRL_DPMS_MIPI0,
+    DRM_CTRL_DPMS_HDMI,
+    DRM_CTRL_VSYNC_MIPI0,
+    DRM_CTRL_VSYNC_HDMI,
+    DRM_CTRL_MAX,
+} intel_drm_ctrl_t;
+
+enum {
+    DRM_CTRL_VALUE_UNKNOWN = -1,
+};
+
+typedef struct {
+    int value[DRM_CTRL_MAX];
+    uint32_t issued[DRM_CTRL_MAX];
+    uint32_t elided[DRM_CTRL_MAX];
+} intel_drm_shadow_state_t;
+
+// HDMI topology and per-monitor mode cache. Connector and CRTC ids do not
+// change across hotplug on this platform, and a monitor (identified by a
+// hash of its EDID) is brought up again in the mode it last used.
+enum {
+    DRM_MONITOR_CACHE_SIZE = 4,
+};
+
+typedef struct {
+    uint32_t id;
+    drmModeModeInfo mode;
+} intel_drm_monitor_entry_t;
+
+typedef struct {
+    uint32_t connector_id;
+    uint32_t crtc_id;
+    uint32_t monitor_id;
+    intel_drm_monitor_entry_t monitors[DRM_MONITOR_CACHE_SIZE];
+    int next_monitor;
+    uint32_t hits;
+    uint32_t misses;
+} intel_drm_hotplug_cache_t;
+
 // this structure must match MDSHDMITiming
 typedef struct {
     uint32_t vrefresh;
@@ -115,11 +162,14 @@ class IntelHWComposer;
  * FIXME: overlayHAL should contact to the h/w to track the overlay h/w
  * state.
  */
-class IntelHWComposerDrm {
+class IntelHWComposerDrm : public IntelHWComposerDump {
 private:
     int mDrmFd;
     drmModeConnectorPtr mHdmiConnector;
     intel_drm_output_state_t mDrmOutputsState;
+    intel_drm_shadow_state_t mShadowState;
+    android::Mutex mShadowLock;
+    intel_drm_hotplug_cache_t mHotplugCache;
     static IntelHWComposerDrm *mInstance;
     bool mIsPresentation;
     bool mOnlyHdmiHasVideo;
@@ -134,11 +184,21 @@ private:
 #endif
     {
         memset(&mDrmOutputsState, 0, sizeof(intel_drm_output_state_t));
+        memset(&mShadowState, 0, sizeof(intel_drm_shadow_state_t));
+        memset(&mHotplugCache, 0, sizeof(intel_drm_hotplug_cache_t));
+        for (int i = 0; i < DRM_CTRL_MAX; i++)
+            mShadowState.value[i] = DRM_CTRL_VALUE_UNKNOWN;
     }
     IntelHWComposerDrm(const IntelHWComposerDrm&);
     bool drmInit();
     void drmDestroy();
 
+private:
+    // shadow state, must be called with mShadowLock held
+    bool needShadowWrite_l(int ctrl, int value);
+    void updateShadowState_l(int ctrl, int value, bool success);
+    void invalidateShadowState_l(int ctrl);
+
 private:
      // basic function set
     drmModeConnectorPtr getConnector(int disp);
@@ -158,7 +218,13 @@ private:
     bool isModeChanged(drmModeModeInfoPtr mode, intel_display_mode_t *displayMode);
     drmModeModeInfoPtr getSelectMode(intel_display_mode_t *displayMode,
                                     drmModeConnectorPtr connector);
-    bool setupDrmFb(int disp, uint32_t fb_handler, drmModeModeInfoPtr mode);
+    bool setupDrmFb(int disp, uint32_t fb_id);
+
+    // hotplug cache
+    uint32_t getMonitorId(drmModeConnectorPtr connector);
+    drmModeModeInfoPtr getCachedMode(uint32_t monitor,
+                                     drmModeConnectorPtr connector);
+    void cacheMonitorMode(uint32_t monitor, drmModeModeInfoPtr mode);
 
 public:
     ~IntelHWComposerDrm();
@@ -179,7 +245,7 @@ public:
     // Connection and Mode setting
     bool detectDisplayConnection(int disp);
     drmModeModeInfoPtr selectDisplayDrmMode(int disp, intel_display_mode_t *displayMode);
-    bool setDisplayDrmMode(int disp, uint32_t fb_handler, drmModeModeInfoPtr mode);
+    bool setDisplayDrmMode(int disp, uint32_t fb_id, drmModeModeInfoPtr mode);
     bool handleDisplayDisConnection(int disp);
     bool detectMDSModeChange();
 
@@ -187,9 +253,12 @@ public:
     bool setDisplayDpms(int disp, bool blank);
     bool setHDMIPowerOff();
     // Vsync
-    bool setDisplayVsyncs(int disp, bool on);
+    bool setDisplayVsyncs(int disp, bool on,
+                          uint32_t *count = 0, uint64_t *timestamp = 0);
     // Scaling
     bool setDisplayScaling(int disp, int type);
+    // Refresh rate, timings are scaled from the detected native mode
+    bool setDisplayRefreshRate(int disp, int rate);
 
     // DRM output states
     void setOutputConnection(const int output, drmModeConnection connection);
@@ -213,11 +282,19 @@ public:
     bool isDrmModeChanged(intel_display_mode_t* displayMode);
     bool isDrmModeFlagsMatched(drmModeModeInfoPtr mode, intel_display_mode_t* displayMode);
     void deleteDrmFb(int disp);
+    uint32_t addDrmFb(uint32_t fb_handler, drmModeModeInfoPtr mode);
+    void removeDrmFb(uint32_t fb_id);
     bool setDisplayIed(bool on);
     void setPresentationMode(bool isPresentationMode);
     bool isPresentationMode();
     void setOnlyHdmiHasVideo(bool only);
     bool onlyHdmiHasVideo();
+
+    // drop shadowed values of a display after hotplug or power transitions
+    void invalidateShadowState(int disp);
+    // drop shadowed MDS notifications once the service went away
+    void invalidateMdsState();
+    bool dump(char *buff, int buff_len, int *cur_len);
 };
 
 #endif /*__INTEL_HWCOMPOSER_DRM_H__*/
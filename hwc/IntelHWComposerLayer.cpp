@@ -48,7 +48,7 @@
 IntelHWComposerLayer::IntelHWComposerLayer()
     : mHWCLayer(0), mPlane(0), mFlags(0)
 {
-
+    memset(&mState, 0, sizeof(mState));
 }
 
 IntelHWComposerLayer::IntelHWComposerLayer(hwc_layer_1_t *layer,
@@ -57,7 +57,7 @@ IntelHWComposerLayer::IntelHWComposerLayer(hwc_layer_1_t *layer,
     : mHWCLayer(layer), mPlane(plane), mFlags(flags), mForceOverlay(false),
       mLayerType(0), mFormat(0), mIsProtected(false)
 {
-
+    memset(&mState, 0, sizeof(mState));
 }
 
 IntelHWComposerLayer::~IntelHWComposerLayer()
@@ -73,7 +73,9 @@ IntelHWComposerLayerList::IntelHWComposerLayerList(IntelDisplayPlaneManager *pm)
       mNumYUVLayers(0),
       mAttachedSpritePlanes(0),
       mAttachedOverlayPlanes(0),
-      mNumAttachedPlanes(0)
+      mNumAttachedPlanes(0),
+      mStateChecks(0),
+      mStateRevalidations(0)
 {
     if (!mPlaneManager)
         mInitialized = false;
@@ -150,6 +152,7 @@ void IntelHWComposerLayerList::updateLayerList(hwc_display_contents_1_t *layerLi
         mLayerList[i].mLayerType = IntelHWComposerLayer::LAYER_TYPE_INVALID;
         mLayerList[i].mFormat = 0;
         mLayerList[i].mIsProtected = false;
+        setupLayerState(mLayerList[i], &layerList->hwLayers[i]);
 
         // update layer format
         IMG_native_handle_t *grallocHandle =
@@ -190,6 +193,68 @@ void IntelHWComposerLayerList::updateLayerList(hwc_display_contents_1_t *layerLi
     mNumAttachedPlanes = 0;
 }
 
+void IntelHWComposerLayerList::setupLayerState(IntelHWComposerLayer& layer,
+                                               hwc_layer_1_t *hwcLayer)
+{
+    IntelHWComposerLayer::layer_state& state = layer.mState;
+
+    memset(&state, 0, sizeof(state));
+
+    state.srcX = (int)(hwcLayer->sourceCropf.left);
+    state.srcY = (int)(hwcLayer->sourceCropf.top);
+    state.srcWidth =
+        (int)(hwcLayer->sourceCropf.right - hwcLayer->sourceCropf.left);
+    state.srcHeight =
+        (int)(hwcLayer->sourceCropf.bottom - hwcLayer->sourceCropf.top);
+
+    // same integer scale factor the overlay context computes
+    int dstW = hwcLayer->displayFrame.right - hwcLayer->displayFrame.left;
+    int dstH = hwcLayer->displayFrame.bottom - hwcLayer->displayFrame.top;
+    if (dstW > 0 && dstH > 0) {
+        state.downscaleX[0] = (state.srcWidth - 1) / dstW;
+        state.downscaleY[0] = (state.srcHeight - 1) / dstH;
+        state.downscaleX[1] = (state.srcHeight - 1) / dstW;
+        state.downscaleY[1] = (state.srcWidth - 1) / dstH;
+    }
+
+    updateBufferState(layer, hwcLayer);
+}
+
+void IntelHWComposerLayerList::updateBufferState(IntelHWComposerLayer& layer,
+                                                 hwc_layer_1_t *hwcLayer)
+{
+    IntelHWComposerLayer::layer_state& state = layer.mState;
+    IMG_native_handle_t *grallocHandle =
+        (IMG_native_handle_t*)hwcLayer->handle;
+
+    state.handle = hwcLayer->handle;
+    if (!grallocHandle) {
+        state.ui64Stamp = 0;
+        return;
+    }
+
+    state.ui64Stamp = grallocHandle->ui64Stamp;
+    state.bufferHandle = grallocHandle->fd[0];
+    state.bufferWidth = grallocHandle->iWidth;
+    state.bufferHeight = grallocHandle->iHeight;
+    state.stride = grallocHandle->iStride;
+    state.format = grallocHandle->iFormat;
+
+    // adjust the buffer format if no blending is needed
+    // some test cases would fail due to a weird format!
+    state.planeFormat = state.format;
+    if (hwcLayer->blending == HWC_BLENDING_NONE) {
+        switch (state.format) {
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+            state.planeFormat = HAL_PIXEL_FORMAT_BGRX_8888;
+            break;
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+            state.planeFormat = HAL_PIXEL_FORMAT_RGBX_8888;
+            break;
+        }
+    }
+}
+
 bool IntelHWComposerLayerList::invalidatePlanes()
 {
     if (!initCheck())
@@ -387,3 +452,35 @@ int IntelHWComposerLayerList::getYUVLayerCount() const
 
     return mNumYUVLayers;
 }
+
+const IntelHWComposerLayer::layer_state*
+IntelHWComposerLayerList::revalidateLayerState(int index, hwc_layer_1_t *layer)
+{
+    if (!initCheck() || index < 0 || index >= mNumLayers || !layer) {
+        ALOGE("%s: Invalid parameters\n", __func__);
+        return 0;
+    }
+
+    IntelHWComposerLayer::layer_state& state = mLayerList[index].mState;
+    IMG_native_handle_t *grallocHandle = (IMG_native_handle_t*)layer->handle;
+
+    mStateChecks++;
+    if (layer->handle != state.handle ||
+        (grallocHandle && grallocHandle->ui64Stamp != state.ui64Stamp)) {
+        updateBufferState(mLayerList[index], layer);
+        mStateRevalidations++;
+    }
+
+    return &state;
+}
+
+const IntelHWComposerLayer::layer_state*
+IntelHWComposerLayerList::getLayerState(int index) const
+{
+    if (!initCheck() || index < 0 || index >= mNumLayers) {
+        ALOGE("%s: Invalid parameters\n", __func__);
+        return 0;
+    }
+
+    return &mLayerList[index].mState;
+}
@@ -59,6 +59,31 @@ public:
         LAYER_TYPE_YUV,
     };
 
+    // layer state derived once per geometry, the buffer fields are read
+    // again only when the layer holds another buffer
+    struct layer_state {
+        // source crop in buffer coordinates
+        int srcX;
+        int srcY;
+        int srcWidth;
+        int srcHeight;
+        // integer downscale factors of the crop into the display frame,
+        // [1] for a source rotated by 90 or 270 degrees
+        int downscaleX[2];
+        int downscaleY[2];
+        // buffer the fields below were read from
+        buffer_handle_t handle;
+        unsigned long long ui64Stamp;
+        uint32_t bufferHandle;
+        int bufferWidth;
+        int bufferHeight;
+        int stride;
+        int format;
+        // format for sprite and primary planes, alpha dropped if the
+        // layer doesn't blend
+        int planeFormat;
+    };
+
 private:
     hwc_layer_1_t *mHWCLayer;
     IntelDisplayPlane *mPlane;
@@ -70,6 +95,7 @@ private:
     int mLayerType;
     int mFormat;
     bool mIsProtected;
+    struct layer_state mState;
 public:
     IntelHWComposerLayer();
     IntelHWComposerLayer(hwc_layer_1_t *layer,
@@ -91,6 +117,12 @@ private:
     int mAttachedOverlayPlanes;
     int mNumAttachedPlanes;
     bool mInitialized;
+    // per frame buffer checks and how many found a new buffer
+    uint32_t mStateChecks;
+    uint32_t mStateRevalidations;
+private:
+    void setupLayerState(IntelHWComposerLayer& layer, hwc_layer_1_t *hwcLayer);
+    void updateBufferState(IntelHWComposerLayer& layer, hwc_layer_1_t *hwcLayer);
 public:
     IntelHWComposerLayerList(IntelDisplayPlaneManager *pm);
     ~IntelHWComposerLayerList();
@@ -109,6 +141,13 @@ public:
     int getLayerType(int index) const;
     int getLayerFormat(int index) const;
     bool isProtectedLayer(int index) const;
+    // re-reads the buffer fields of the layer state if @layer holds a new
+    // buffer since the last frame, returns the state
+    const IntelHWComposerLayer::layer_state* revalidateLayerState(int index,
+                                                   hwc_layer_1_t *layer);
+    const IntelHWComposerLayer::layer_state* getLayerState(int index) const;
+    uint32_t getStateChecks() const { return mStateChecks; }
+    uint32_t getStateRevalidations() const { return mStateRevalidations; }
     int getLayersCount() const { return mNumLayers; }
     int getRGBLayerCount() const;
     int getYUVLayerCount() const;
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include <cutils/log.h>
+#include <IntelHWComposerCfg.h>
+#include <IntelInitScheduler.h>
+
+// deferred work starts at the latest this long after initialization
+static const nsecs_t DEFER_TIMEOUT = 3000000000LL;
+
+IntelInitScheduler::IntelInitScheduler() :
+    mFirstFrameTime(0), mFirstFramePosted(false),
+    mComponentCount(0), mDeferredCount(0)
+{
+    ALOGV("Init scheduler created");
+    mStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+IntelInitScheduler::~IntelInitScheduler()
+{
+
+}
+
+void IntelInitScheduler::record(const char *name, nsecs_t start,
+                                bool background)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    ALOGD_IF(ALLOW_HWC_PRINT, "%s: %s took %lld us\n",
+             __func__, name, (now - start) / 1000);
+
+    android::Mutex::Autolock _l(mLock);
+    if (mComponentCount >= COMPONENT_MAX)
+        return;
+
+    struct component& c = mComponents[mComponentCount++];
+    c.name = name;
+    c.start = start;
+    c.duration = now - start;
+    c.background = background;
+}
+
+bool IntelInitScheduler::defer(const char *name, Task task, void *data)
+{
+    android::Mutex::Autolock _l(mLock);
+    if (mDeferredCount >= DEFERRED_MAX) {
+        ALOGE("%s: too many deferred tasks, %s dropped\n", __func__, name);
+        return false;
+    }
+
+    struct deferred_task& t = mDeferred[mDeferredCount++];
+    t.name = name;
+    t.task = task;
+    t.data = data;
+    return true;
+}
+
+void IntelInitScheduler::onFramePosted()
+{
+    // only the commit thread sets it
+    if (mFirstFramePosted)
+        return;
+
+    android::Mutex::Autolock _l(mLock);
+    mFirstFrameTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mFirstFramePosted = true;
+    mCondition.signal();
+
+    ALOGI("%s: first frame %lld us after HWC initialization started\n",
+          __func__, (mFirstFrameTime - mStartTime) / 1000);
+}
+
+bool IntelInitScheduler::threadLoop()
+{
+    struct deferred_task tasks[DEFERRED_MAX];
+    int count;
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mLock);
+        if (exitPending())
+            return false;
+
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (!mFirstFramePosted && now < mStartTime + DEFER_TIMEOUT) {
+            mCondition.waitRelative(mLock, mStartTime + DEFER_TIMEOUT - now);
+            return true;
+        }
+
+        if (!mFirstFramePosted)
+            ALOGW("%s: no frame posted yet, starting deferred work\n",
+                  __func__);
+
+        count = mDeferredCount;
+        memcpy(tasks, mDeferred, sizeof(tasks[0]) * count);
+        mDeferredCount = 0;
+    }
+
+    // tasks take HWC locks of their own
+    for (int i = 0; i < count; i++) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (!tasks[i].task(tasks[i].data))
+            ALOGW("%s: deferred %s failed\n", __func__, tasks[i].name);
+        record(tasks[i].name, start, true);
+    }
+
+    // done, deferred tasks queued from now on are never run
+    return false;
+}
+
+bool IntelInitScheduler::dump(char *buff, int buff_len, int *cur_len)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------Initialization ---------------------\n");
+    for (int i = 0; i < mComponentCount; i++) {
+        struct component& c = mComponents[i];
+        dumpPrintf("  + %-24s at %8lld us, took %8lld us%s\n",
+                   c.name, (c.start - mStartTime) / 1000, c.duration / 1000,
+                   c.background ? " (background)" : "");
+    }
+    if (mFirstFramePosted)
+        dumpPrintf("  + first frame at %lld us\n",
+                   (mFirstFrameTime - mStartTime) / 1000);
+    else
+        dumpPrintf("  + no frame posted yet\n");
+
+    *cur_len = mDumpLen;
+    return true;
+}
+
+android::status_t IntelInitScheduler::readyToRun()
+{
+    return android::NO_ERROR;
+}
+
+bool IntelInitScheduler::start()
+{
+    // started only after all deferred tasks were queued
+    return run("HWC Init Scheduler", android::PRIORITY_BACKGROUND) ==
+           android::NO_ERROR;
+}
+
+void IntelInitScheduler::stop()
+{
+    requestExit();
+    {
+        android::Mutex::Autolock _l(mLock);
+        mCondition.signal();
+    }
+    requestExitAndWait();
+}
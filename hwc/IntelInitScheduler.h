@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_INIT_SCHEDULER_H__
+#define __INTEL_INIT_SCHEDULER_H__
+
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <IntelHWComposerDump.h>
+
+/**
+ * Class: HWC initialization scheduler
+ * Records how long each component took to come up and how long it took
+ * from the start of initialization to the first primary frame. Work that
+ * is not needed for that frame (e.g. HDMI mode setting at boot) is
+ * deferred to a background thread which starts it once the first primary
+ * frame has been posted, or after DEFER_TIMEOUT if no frame comes, so a
+ * boot with the panel off still brings up external displays.
+ */
+class IntelInitScheduler : public android::Thread,
+                           public IntelHWComposerDump
+{
+public:
+    enum {
+        COMPONENT_MAX = 16,
+        DEFERRED_MAX = 4,
+    };
+    typedef bool (*Task)(void *data);
+public:
+    IntelInitScheduler();
+    virtual ~IntelInitScheduler();
+    // component started at @start is up, @background if it did not
+    // hold up initialization
+    void record(const char *name, nsecs_t start, bool background = false);
+    // run @task in the background once the first frame is out
+    bool defer(const char *name, Task task, void *data);
+    // starts the background thread, call after queuing deferred tasks
+    bool start();
+    // drops the deferred tasks not run yet and waits for a running one
+    void stop();
+    // a primary frame was posted, called on every post
+    void onFramePosted();
+    nsecs_t getStartTime() const { return mStartTime; }
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    virtual bool threadLoop();
+    virtual android::status_t readyToRun();
+private:
+    struct component {
+        const char *name;
+        nsecs_t start;
+        nsecs_t duration;
+        bool background;
+    };
+    struct deferred_task {
+        const char *name;
+        Task task;
+        void *data;
+    };
+    mutable android::Mutex mLock;
+    android::Condition mCondition;
+    nsecs_t mStartTime;
+    nsecs_t mFirstFrameTime;
+    bool mFirstFramePosted;
+    struct component mComponents[COMPONENT_MAX];
+    int mComponentCount;
+    struct deferred_task mDeferred[DEFERRED_MAX];
+    int mDeferredCount;
+};
+
+#endif /*__INTEL_INIT_SCHEDULER_H__*/
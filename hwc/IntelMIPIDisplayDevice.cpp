@@ -42,7 +42,8 @@ IntelMIPIDisplayDevice::IntelMIPIDisplayDevice(IntelBufferManager *bm,
                                        uint32_t index)
                                      : IntelDisplayDevice(pm, drm, bm, gm, index),
                                        mExtendedModeInfo(extinfo),
-                                       mVideoSentToWidi(false)
+                                       mVideoSentToWidi(false),
+                                       mVideoPrepared(false)
 {
     ALOGD_IF(ALLOW_HWC_PRINT, "%s\n", __func__);
 
@@ -525,8 +526,8 @@ void IntelMIPIDisplayDevice::onGeometryChanged(hwc_display_contents_1_t *list)
         // further check whether a layer can be handle by overlay/sprite
         int flags = 0;
         //bool hasOverlay = mPlaneManager->hasFreeOverlays();
-        bool hasRGBOverlay = mPlaneManager->hasFreeRGBOverlays();
-        bool hasSprite = mPlaneManager->hasFreeSprites();
+        bool hasRGBOverlay = mPlaneManager->hasFreeRGBOverlays(mDisplayIndex);
+        bool hasSprite = mPlaneManager->hasFreeSprites(mDisplayIndex);
 
         if (/*hasOverlay &&*/ isOverlayLayer(list, i, &list->hwLayers[i], flags)) {
             ret = overlayPrepare(i, &list->hwLayers[i], flags);
@@ -579,16 +580,6 @@ bool IntelMIPIDisplayDevice::prepare(hwc_display_contents_1_t *list)
         return false;
     }
 
-    // FIXME: it is tricky here to wait for cycles to disable reclaim overlay;
-    // As processFlip cmd schedule in SGX maybe delayed more than one cycle,
-    // especially under the case of high quality video rotation.
-    static int cnt = 0;
-    if (mPlaneManager->hasReclaimedOverlays() && (!mIsScreenshotActive || ++cnt == 3)) {
-        mPlaneManager->disableReclaimedPlanes(IntelDisplayPlane::DISPLAY_PLANE_OVERLAY);
-        mPlaneManager->disableReclaimedPlanes(IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY);
-        cnt = 0;
-    }
-
     // clear force swap buffer flag
     mForceSwapBuffer = false;
 
@@ -596,15 +587,18 @@ bool IntelMIPIDisplayDevice::prepare(hwc_display_contents_1_t *list)
     bool forceCheckingList = ((index >= 0) != mVideoSeekingActive);
     mVideoSeekingActive = (index >= 0);
 
+    // overlay grants changed, attach planes again
+    if (mPlaneManager->needsReplan(mDisplayIndex))
+        forceCheckingList = true;
+
     // check whether video player status changed and then
     // determine whether traversing the layer list and
     // disable or enable RGBOverlay
-    static bool isVideoPrepared = false;
     bool isPlayerStatusChanged =
-                (isVideoPrepared != mDrm->isVideoPrepared()) ? true : false;
+                (mVideoPrepared != mDrm->isVideoPrepared()) ? true : false;
 
     if (isPlayerStatusChanged)
-        isVideoPrepared = mDrm->isVideoPrepared();
+        mVideoPrepared = mDrm->isVideoPrepared();
 
     // handle geometry changing. attach display planes to layers
     // which can be handled by HWC.
@@ -654,6 +648,29 @@ bool IntelMIPIDisplayDevice::prepare(hwc_display_contents_1_t *list)
     return true;
 }
 
+void IntelMIPIDisplayDevice::collectPlaneDemands(hwc_display_contents_1_t *list)
+{
+    if (!initCheck() || mIsBlank || !list)
+        return;
+
+    // video is hidden here in extended mode, HDMI shows it
+    if (mDrm->getDisplayMode() == OVERLAY_EXTEND)
+        return;
+
+    for (size_t i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_1_t *layer = &list->hwLayers[i];
+        if (!isVideoLayer(layer))
+            continue;
+
+        // video sent to widi takes no plane here
+        if (mExtendedModeInfo->widiExtHandle != NULL &&
+            mExtendedModeInfo->widiExtHandle == (IMG_native_handle_t*)layer->handle)
+            continue;
+
+        addPlaneDemand(IntelDisplayPlane::DISPLAY_PLANE_OVERLAY, i, layer);
+    }
+}
+
 void IntelMIPIDisplayDevice::handleSmartComposition(hwc_display_contents_1_t *list)
 {
     int i;
@@ -933,8 +950,12 @@ bool IntelMIPIDisplayDevice::dump(char *buff,
        dumpPrintf("  + mForceSwapBuffer: %d \n", mForceSwapBuffer);
        dumpPrintf("  + mForceSwapBuffer: %d \n", mForceSwapBuffer);
        dumpPrintf("  + Display Mode: %d \n", mDrm->getDisplayMode());
+       dumpLayersData();
     }
 
+    if (mVideoProcessor)
+        mVideoProcessor->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+
     *cur_len = mDumpLen;
     return ret;
 }
@@ -1019,14 +1040,14 @@ bool IntelMIPIDisplayDevice::overlayPrepare(int index, hwc_layer_1_t *layer, int
 
     //external not prepared
 
-    bool hasOverlay = mPlaneManager->hasFreeOverlays();
+    bool hasOverlay = mPlaneManager->hasFreeOverlays(mDisplayIndex);
     if(!hasOverlay){
         return false;
     }
 
     // has overlay and haveOverlay.
     // allocate overlay plane
-    IntelDisplayPlane *plane = mPlaneManager->getOverlayPlane();
+    IntelDisplayPlane *plane = mPlaneManager->getOverlayPlane(mDisplayIndex);
     if (!plane) {
         ALOGE("%s: failed to create overlay plane\n", __func__);
         return false;
@@ -1039,6 +1060,8 @@ bool IntelMIPIDisplayDevice::overlayPrepare(int index, hwc_layer_1_t *layer, int
 
     IntelOverlayPlane *overlayP =
         reinterpret_cast<IntelOverlayPlane *>(plane);
+    if (!splitOverlayPrepare(overlayP, layer))
+        return false;
 
     // setup plane parameters
     overlayP->setPosition(dstLeft, dstTop, dstRight, dstBottom);
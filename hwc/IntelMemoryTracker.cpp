@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cutils/log.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <utils/Timers.h>
+#include <IntelHWComposerCfg.h>
+#include <IntelMemoryTracker.h>
+
+// least time between two trims caused by an exceeded budget
+static const nsecs_t TRIM_INTERVAL = 1000000000LL;
+
+// cheapest to rebuild first, overlay back buffers are never trimmed.
+// Unused HDMI framebuffers cost nothing until the next mode switch
+static const int sTrimOrder[] = {
+    IntelMemoryTracker::MEM_HDMI_FB,
+    IntelMemoryTracker::MEM_RGB_CONVERTER,
+    IntelMemoryTracker::MEM_WIDI_CSC,
+    IntelMemoryTracker::MEM_ROTATION,
+    IntelMemoryTracker::MEM_GTT_MAPPING,
+};
+
+static const char *sBudgetProperties[IntelMemoryTracker::MEM_CATEGORY_NUM] = {
+    "hwcomposer.mem.budget.overlay",
+    "hwcomposer.mem.budget.gtt",
+    "hwcomposer.mem.budget.rotation",
+    "hwcomposer.mem.budget.rgb",
+    "hwcomposer.mem.budget.widi",
+    "hwcomposer.mem.budget.hdmi",
+};
+
+IntelMemoryTracker *IntelMemoryTracker::mInstance = 0;
+static pthread_once_t sInstanceOnce = PTHREAD_ONCE_INIT;
+
+static int32_t getBudgetProperty(const char *name)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(name, value, "0");
+    return atoi(value) * 1024;
+}
+
+IntelMemoryTracker::IntelMemoryTracker()
+    : mCompositionLock(0), mTrimRequested(false), mTrimExit(false),
+      mPressure(0), mTrimmableCount(0), mTrimCount(0), mTrimmedBytes(0),
+      mLastTrim(0)
+{
+    memset((void*)mBytes, 0, sizeof(mBytes));
+    memset((void*)mPeakBytes, 0, sizeof(mPeakBytes));
+
+    mTotalBudget = getBudgetProperty("hwcomposer.mem.budget");
+    for (int i = 0; i < MEM_CATEGORY_NUM; i++)
+        mBudget[i] = getBudgetProperty(sBudgetProperties[i]);
+}
+
+void IntelMemoryTracker::createInstance()
+{
+    mInstance = new IntelMemoryTracker();
+}
+
+IntelMemoryTracker& IntelMemoryTracker::getInstance()
+{
+    pthread_once(&sInstanceOnce, createInstance);
+    return *mInstance;
+}
+
+const char* IntelMemoryTracker::getCategoryName(int category)
+{
+    switch (category) {
+    case MEM_OVERLAY_BACK_BUFFER:
+        return "overlay back buffer";
+    case MEM_GTT_MAPPING:
+        return "gtt mapping";
+    case MEM_ROTATION:
+        return "rotation";
+    case MEM_RGB_CONVERTER:
+        return "rgb converter";
+    case MEM_WIDI_CSC:
+        return "widi csc";
+    case MEM_HDMI_FB:
+        return "hdmi fb";
+    default:
+        return "unknown";
+    }
+}
+
+void IntelMemoryTracker::add(int category, uint32_t bytes)
+{
+    if (category < 0 || category >= MEM_CATEGORY_NUM || !bytes)
+        return;
+
+    int32_t current = android_atomic_add(bytes, &mBytes[category]) + bytes;
+    int32_t peak = android_atomic_acquire_load(&mPeakBytes[category]);
+    while (current > peak &&
+           android_atomic_cmpxchg(peak, current, &mPeakBytes[category]))
+        peak = android_atomic_acquire_load(&mPeakBytes[category]);
+}
+
+void IntelMemoryTracker::remove(int category, uint32_t bytes)
+{
+    if (category < 0 || category >= MEM_CATEGORY_NUM || !bytes)
+        return;
+
+    android_atomic_add(-(int32_t)bytes, &mBytes[category]);
+}
+
+void IntelMemoryTracker::registerTrimmable(int category,
+                                           IntelMemoryTrimmable *trimmable)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    if (mTrimmableCount >= TRIMMABLE_MAX) {
+        ALOGW("%s: too many trimmable caches\n", __func__);
+        return;
+    }
+
+    mTrimmables[mTrimmableCount].category = category;
+    mTrimmables[mTrimmableCount].trimmable = trimmable;
+    mTrimmableCount++;
+}
+
+void IntelMemoryTracker::unregisterTrimmable(IntelMemoryTrimmable *trimmable)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    for (int i = 0; i < mTrimmableCount; i++) {
+        if (mTrimmables[i].trimmable != trimmable)
+            continue;
+        mTrimmables[i] = mTrimmables[--mTrimmableCount];
+        i--;
+    }
+}
+
+void IntelMemoryTracker::notifyPressure()
+{
+    android_atomic_release_store(1, &mPressure);
+    requestTrim();
+}
+
+void IntelMemoryTracker::requestTrim()
+{
+    android::Mutex::Autolock _l(mTrimLock);
+    mTrimRequested = true;
+    mTrimCondition.signal();
+}
+
+bool IntelMemoryTracker::startTrimThread(android::Mutex *compositionLock)
+{
+    android::Mutex::Autolock _l(mTrimLock);
+
+    if (mTrimThread != 0)
+        return true;
+
+    mCompositionLock = compositionLock;
+    mTrimExit = false;
+    mTrimThread = new TrimThread(this);
+    // it holds the composition lock while trimming, not a background thread
+    if (mTrimThread->run("HWC Memory Trim", android::PRIORITY_NORMAL) !=
+        android::NO_ERROR) {
+        ALOGE("%s: failed to start trim thread\n", __func__);
+        mTrimThread = 0;
+        return false;
+    }
+    return true;
+}
+
+void IntelMemoryTracker::stopTrimThread()
+{
+    android::sp<TrimThread> thread;
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mTrimLock);
+        thread = mTrimThread;
+        mTrimThread = 0;
+        mTrimExit = true;
+        mTrimCondition.signal();
+    }
+
+    if (thread != 0)
+        thread->requestExitAndWait();
+}
+
+bool IntelMemoryTracker::trimThreadLoop()
+{
+    android::Mutex *compositionLock;
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mTrimLock);
+        while (!mTrimRequested && !mTrimExit)
+            mTrimCondition.wait(mTrimLock);
+        if (mTrimExit)
+            return false;
+        mTrimRequested = false;
+        compositionLock = mCompositionLock;
+    }
+
+    // the caches are only touched by prepare and commit otherwise
+    android::Mutex::Autolock _l(*compositionLock);
+    if (needsTrim())
+        trim();
+    return true;
+}
+
+bool IntelMemoryTracker::overBudget(int category) const
+{
+    int32_t total = 0;
+
+    if (mBudget[category] &&
+        android_atomic_acquire_load(&mBytes[category]) > mBudget[category])
+        return true;
+
+    if (!mTotalBudget)
+        return false;
+
+    for (int i = 0; i < MEM_CATEGORY_NUM; i++)
+        total += android_atomic_acquire_load(&mBytes[i]);
+    return total > mTotalBudget;
+}
+
+bool IntelMemoryTracker::needsTrim() const
+{
+    if (android_atomic_acquire_load(&mPressure))
+        return true;
+
+    if (systemTime(SYSTEM_TIME_MONOTONIC) - mLastTrim < TRIM_INTERVAL)
+        return false;
+
+    for (int i = 0; i < MEM_CATEGORY_NUM; i++) {
+        if (overBudget(i))
+            return true;
+    }
+    return false;
+}
+
+uint32_t IntelMemoryTracker::trim()
+{
+    android::Mutex::Autolock _l(mLock);
+    bool critical = android_atomic_acquire_load(&mPressure) != 0;
+    uint32_t freed = 0;
+
+    for (size_t i = 0; i < sizeof(sTrimOrder) / sizeof(sTrimOrder[0]); i++) {
+        int category = sTrimOrder[i];
+        if (!critical && !overBudget(category))
+            continue;
+
+        for (int j = 0; j < mTrimmableCount; j++) {
+            if (mTrimmables[j].category == category)
+                freed += mTrimmables[j].trimmable->trimMemory(category);
+        }
+    }
+
+    android_atomic_release_store(0, &mPressure);
+    mLastTrim = systemTime(SYSTEM_TIME_MONOTONIC);
+    mTrimCount++;
+    mTrimmedBytes += freed;
+
+    ALOGD_IF(ALLOW_HWC_PRINT, "%s: %s trim freed %u KB\n",
+             __func__, critical ? "critical" : "budget", freed / 1024);
+    return freed;
+}
+
+bool IntelMemoryTracker::dump(char *buff, int buff_len, int *cur_len)
+{
+    android::Mutex::Autolock _l(mLock);
+    int32_t total = 0;
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------Memory -----------------------------\n");
+    for (int i = 0; i < MEM_CATEGORY_NUM; i++) {
+        int32_t bytes = android_atomic_acquire_load(&mBytes[i]);
+        total += bytes;
+        dumpPrintf("  + %-20s %6d KB, peak %6d KB, budget %d KB\n",
+                   getCategoryName(i), bytes / 1024,
+                   android_atomic_acquire_load(&mPeakBytes[i]) / 1024,
+                   mBudget[i] / 1024);
+    }
+    dumpPrintf("  + total %d KB, budget %d KB, %u trims freed %u KB\n",
+               total / 1024, mTotalBudget / 1024,
+               mTrimCount, mTrimmedBytes / 1024);
+
+    *cur_len = mDumpLen;
+    return true;
+}
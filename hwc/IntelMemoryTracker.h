@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_MEMORY_TRACKER_H__
+#define __INTEL_MEMORY_TRACKER_H__
+
+#include <stdint.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <IntelHWComposerDump.h>
+
+/**
+ * Cache which can give back memory when the HWC is over budget or
+ * short of memory. Called on the trim thread with the composition lock
+ * held, so no frame is being prepared or posted meanwhile.
+ */
+class IntelMemoryTrimmable {
+public:
+    virtual ~IntelMemoryTrimmable() {}
+    // drop what the frames on screen don't need from the cache of
+    // @category, returns bytes freed
+    virtual uint32_t trimMemory(int category) = 0;
+};
+
+/**
+ * Class: HWC memory tracker
+ * Counts the GPU visible memory held by the HWC per category: overlay
+ * back buffers, GTT mappings of the plane buffer caches, rotation
+ * buffers, RGB overlay converter buffers, WiDi CSC buffers and the HDMI
+ * framebuffer cache. Budgets in KB come from the hwcomposer.mem.budget
+ * property (total) and hwcomposer.mem.budget.<category>, 0 means no
+ * limit. When a budget is exceeded or an allocation failed, a worker
+ * thread trims the registered caches, cheapest to rebuild first, so the
+ * composition thread never pays for the unmapping and freeing.
+ */
+class IntelMemoryTracker : public IntelHWComposerDump {
+public:
+    enum {
+        MEM_OVERLAY_BACK_BUFFER = 0,
+        MEM_GTT_MAPPING,
+        MEM_ROTATION,
+        MEM_RGB_CONVERTER,
+        MEM_WIDI_CSC,
+        MEM_HDMI_FB,
+        MEM_CATEGORY_NUM,
+    };
+    enum {
+        TRIMMABLE_MAX = 16,
+    };
+public:
+    static IntelMemoryTracker& getInstance();
+    void add(int category, uint32_t bytes);
+    void remove(int category, uint32_t bytes);
+    void registerTrimmable(int category, IntelMemoryTrimmable *trimmable);
+    void unregisterTrimmable(IntelMemoryTrimmable *trimmable);
+    // an allocation failed, trim everything as soon as possible
+    void notifyPressure();
+    // cheap check, call with the composition lock held
+    bool needsTrim() const;
+    // wakes the trim thread, e.g. when needsTrim() after a post
+    void requestTrim();
+    // the trim thread takes @compositionLock around each trim
+    bool startTrimThread(android::Mutex *compositionLock);
+    // waits for a running trim, call before the trimmables go away
+    void stopTrimThread();
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    class TrimThread : public android::Thread {
+    public:
+        TrimThread(IntelMemoryTracker *tracker) : mTracker(tracker) {}
+    private:
+        virtual bool threadLoop() { return mTracker->trimThreadLoop(); }
+    private:
+        IntelMemoryTracker *mTracker;
+    };
+private:
+    IntelMemoryTracker();
+    static void createInstance();
+    bool overBudget(int category) const;
+    bool trimThreadLoop();
+    // trim the caches in priority order, returns bytes freed
+    uint32_t trim();
+    static const char* getCategoryName(int category);
+private:
+    static IntelMemoryTracker *mInstance;
+    mutable android::Mutex mLock;
+    // guards the trim thread state below, never held while trimming
+    android::Mutex mTrimLock;
+    android::Condition mTrimCondition;
+    android::sp<TrimThread> mTrimThread;
+    android::Mutex *mCompositionLock;
+    bool mTrimRequested;
+    bool mTrimExit;
+    volatile int32_t mBytes[MEM_CATEGORY_NUM];
+    volatile int32_t mPeakBytes[MEM_CATEGORY_NUM];
+    int32_t mBudget[MEM_CATEGORY_NUM];
+    int32_t mTotalBudget;
+    volatile int32_t mPressure;
+    struct {
+        int category;
+        IntelMemoryTrimmable *trimmable;
+    } mTrimmables[TRIMMABLE_MAX];
+    int mTrimmableCount;
+    uint32_t mTrimCount;
+    uint32_t mTrimmedBytes;
+    nsecs_t mLastTrim;
+};
+
+#endif /*__INTEL_MEMORY_TRACKER_H__*/
@@ -127,4 +127,102 @@ typedef struct {
     uint8_t exponent;
 } coeffRec, *coeffPtr;
 
+/**
+ * Split presentation
+ * A planar NV12 source wider than one overlay fetches is shown by two
+ * overlays side by side, each scanning one vertical stripe of it. Both
+ * stripes keep the step of the unsplit source so the seam needs no
+ * rescaling, the right stripe starts with the phase the unsplit scaler
+ * would have reached at the seam. Each stripe fetches OVERLAP source
+ * pixels beyond the seam so the 5 tap Y and 3 tap UV filters see real
+ * pixels on both sides of it instead of replicated edges.
+ *
+ * Phases are in 1/4096 source pixels like the scale factors. The
+ * fraction goes to HORZ_PH (Y in 15:0, UV in 31:16), the integer part
+ * to the horizontal fields of INIT_PHS (Y in 7:4, UV in 3:0).
+ */
+#define INTEL_OVERLAY_STRIPE_NUM        2
+#define INTEL_OVERLAY_STRIPE_OVERLAP    8
+#define INTEL_OVERLAY_STRIPE_MAX_WIDTH  (INTEL_OVERLAY_MAX_WIDTH - 1)
+/*
+ * Widest source two stripes show at any scale the overlay takes. Each
+ * stripe fetches half of it plus the overlap and UV pairing, plus up to
+ * one scaling ratio of source pixels as the seam is rounded to an even
+ * window pixel.
+ */
+#define INTEL_OVERLAY_STRIPE_MAX_SRC_WIDTH \
+    (INTEL_OVERLAY_STRIPE_NUM * (INTEL_OVERLAY_STRIPE_MAX_WIDTH - \
+     INTEL_OVERLAY_STRIPE_OVERLAP - 2 - PVR_OVERLAY_MAX_SCALING_RATIO))
+
+#define OVERLAY_HORZ_PH(y, uv) \
+    ((((uv) & 0xfff) << 16) | ((y) & 0xfff))
+#define OVERLAY_INIT_PHS_HORZ_MASK      0xff
+#define OVERLAY_INIT_PHS_HORZ(y, uv) \
+    (((((y) >> 12) & 0xf) << 4) | (((uv) >> 12) & 0xf))
+
+typedef struct {
+    int srcX;        /* first fetched pixel, relative to the source crop */
+    int srcWidth;    /* fetched pixels */
+    int dstX;        /* first window pixel, relative to the whole window */
+    int dstWidth;
+    int phaseY;      /* initial horizontal phase */
+    int phaseUV;
+} intel_overlay_stripe_t;
+
+/*
+ * Horizontal Y step of a source scaled to a window, a multiple of the
+ * UV ratio so the UV step stays exact.
+ */
+static inline int intel_overlay_xstep(int srcWidth, int dstWidth)
+{
+    if (srcWidth == dstWidth)
+        return 1 << 12;
+    return ((((srcWidth - 1) << 12) / dstWidth) / 2) * 2;
+}
+
+/*
+ * Compute stripe @index of a source @srcWidth pixels wide shown in a
+ * window @dstWidth pixels wide with Y step @step. Returns 0 if the
+ * stripe doesn't fit an overlay.
+ */
+static inline int intel_overlay_stripe_setup(int index, int srcWidth,
+                                             int dstWidth, int step,
+                                             intel_overlay_stripe_t *stripe)
+{
+    /* even, so the UV samples of both stripes stay paired, and the
+     * nearest such to the middle so neither stripe fetches much more */
+    int seam = ((dstWidth + 2) / 4) * 2;
+    int pos;
+
+    if (!stripe || seam <= 0 || index < 0 || index >= INTEL_OVERLAY_STRIPE_NUM)
+        return 0;
+
+    if (index == 0) {
+        /* last source pixel the left stripe samples */
+        pos = ((seam - 1) * step) >> 12;
+        stripe->srcX = 0;
+        stripe->srcWidth = (pos + 1 + INTEL_OVERLAY_STRIPE_OVERLAP + 1) & ~1;
+        if (stripe->srcWidth > srcWidth)
+            stripe->srcWidth = srcWidth;
+        stripe->dstX = 0;
+        stripe->dstWidth = seam;
+        stripe->phaseY = 0;
+        stripe->phaseUV = 0;
+    } else {
+        /* first source pixel the right stripe samples */
+        pos = (seam * step) >> 12;
+        stripe->srcX = (pos - INTEL_OVERLAY_STRIPE_OVERLAP) & ~1;
+        if (stripe->srcX < 0)
+            stripe->srcX = 0;
+        stripe->srcWidth = srcWidth - stripe->srcX;
+        stripe->dstX = seam;
+        stripe->dstWidth = dstWidth - seam;
+        stripe->phaseY = seam * step - (stripe->srcX << 12);
+        stripe->phaseUV = seam * (step / 2) - ((stripe->srcX / 2) << 12);
+    }
+
+    return stripe->srcWidth > 0 && stripe->dstWidth > 0 &&
+           stripe->srcWidth <= INTEL_OVERLAY_STRIPE_MAX_WIDTH;
+}
+
 #endif /*__INTEL_OVERLAY_HW_H__*/
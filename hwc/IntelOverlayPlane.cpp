@@ -49,6 +49,7 @@
 #include <IntelHWComposerDrm.h>
 #include <IntelOverlayPlane.h>
 #include <IntelOverlayUtil.h>
+#include <VideoProcessor.h>
 
 IntelOverlayContext::~IntelOverlayContext()
 {
@@ -82,23 +83,12 @@ bool IntelOverlayContext::create()
     }
 
     memset(mContext, 0, size);
+    mContext->layout = INTEL_OVERLAY_CONTEXT_LAYOUT;
     mContext->refCount = 1;
 
-    if (pthread_mutexattr_init(&mContext->attr)) {
-        ALOGE("%s: Initialize overlay mutex attr failed\n", __func__);
-        goto mutexattr_init_err;
-    }
-
-    if (pthread_mutexattr_setpshared(&mContext->attr,
-                                     PTHREAD_PROCESS_SHARED)) {
-        ALOGE("%s: set pshared error\n", __func__);
-        goto pshared_err;
-    }
-
-
-    if (pthread_mutex_init(&mContext->lock, &mContext->attr)) {
+    if (!intel_seqlock_init(&mContext->seqlock)) {
         ALOGE("%s: shared block lock init failed\n", __func__);
-        goto mutex_init_err;
+        goto lock_init_err;
     }
 
     // allocate back buffer
@@ -106,11 +96,13 @@ bool IntelOverlayContext::create()
     backBuffer = mBufferManager->get(backBufferSize, 64 * 1024);
     if (!backBuffer) {
         ALOGE("%s: failed to allocate back buffer\n", __func__);
-        goto mutex_init_err;
+        goto back_buffer_err;
     }
 
     mContext->gtt_offset_in_page = backBuffer->getGttOffsetInPage();
     mContext->back_buffer_handle = backBuffer->getHandle();
+    IntelMemoryTracker::getInstance().add(
+        IntelMemoryTracker::MEM_OVERLAY_BACK_BUFFER, backBuffer->getSize());
 
     mSize = size;
     mOverlayBackBuffer = (intel_overlay_back_buffer_t*)backBuffer->getCpuAddr();
@@ -120,10 +112,9 @@ bool IntelOverlayContext::create()
 
     return true;
 
-mutex_init_err:
-pshared_err:
-    pthread_mutexattr_destroy(&mContext->attr);
-mutexattr_init_err:
+back_buffer_err:
+    intel_seqlock_destroy(&mContext->seqlock);
+lock_init_err:
     munmap(mContext, size);
 mmap_err:
     close(mDrmFd);
@@ -156,6 +147,16 @@ bool IntelOverlayContext::open(int handle, int size)
 
     if (mContext == MAP_FAILED || !mContext) {
         ALOGE("%s: map shared context failed\n", __func__);
+        mContext = 0;
+        return false;
+    }
+
+    // created by a HWC built with another layout
+    if (size < (int)sizeof(intel_overlay_context_t) ||
+        mContext->layout != INTEL_OVERLAY_CONTEXT_LAYOUT) {
+        ALOGE("%s: shared context layout mismatch\n", __func__);
+        munmap(mContext, size);
+        mContext = 0;
         return false;
     }
 
@@ -200,15 +201,7 @@ bool IntelOverlayContext::destroy()
     if (android_atomic_dec(&mContext->refCount) == 1) {
         ALOGD_IF(ALLOW_OVERLAY_PRINT,
                "%s: refcount = 0, destroy mutex\n", __func__);
-        if (pthread_mutex_destroy(&mContext->lock)) {
-            ALOGE("%s: destroy share context lock failed\n", __func__);
-            ret = false;
-        }
-
-        if (pthread_mutexattr_destroy(&mContext->attr)) {
-            ALOGE("%s: destroy mutex attr failed\n", __func__);
-            ret = false;
-        }
+        intel_seqlock_destroy(&mContext->seqlock);
 
         closeFd = true;
     }
@@ -220,6 +213,8 @@ bool IntelOverlayContext::destroy()
 
     // destory back buffer;
     if (mBufferManager && mBackBuffer) {
+        IntelMemoryTracker::getInstance().remove(
+            IntelMemoryTracker::MEM_OVERLAY_BACK_BUFFER, mBackBuffer->getSize());
         mBufferManager->put(mBackBuffer);
         mBackBuffer = 0;
         mBufferManager = 0;
@@ -255,12 +250,26 @@ void IntelOverlayContext::unlock()
     //    pthread_mutex_unlock(&mContext->lock);
 }
 
+// short sections updating the shared context fields, never nested
+void IntelOverlayContext::sharedWriteBegin()
+{
+    intel_seqlock_write_lock(&mContext->seqlock);
+}
+
+void IntelOverlayContext::sharedWriteEnd()
+{
+    intel_seqlock_write_unlock(&mContext->seqlock);
+}
+
 void IntelOverlayContext::setBackBufferGttOffset(const uint32_t gttOffset)
 {
     lock();
 
-    if (mContext)
+    if (mContext) {
+        sharedWriteBegin();
         mContext->gtt_offset_in_page = gttOffset;
+        sharedWriteEnd();
+    }
 
     unlock();
 }
@@ -442,6 +451,10 @@ bool IntelOverlayContext::bufferOffsetSetup(IntelDisplayDataBuffer &buf)
     uint32_t srcX= buf.getSrcX();
     uint32_t srcY= buf.getSrcY();
 
+    // fetch from where this overlay's stripe starts
+    if (mStripeCount > 1)
+        srcX += mStripe.srcX;
+
     ALOGV("%s: yStride is %d and uvStride is %d\n", __func__, yStride, uvStride);
     // clear original format setting
     mOverlayBackBuffer->OCMD &= ~(0xf << 10);
@@ -564,11 +577,13 @@ bool IntelOverlayContext::coordinateSetup(IntelDisplayDataBuffer& buf)
 
     ALOGD_IF(ALLOW_OVERLAY_PRINT, "%s: setting up coordinates...\n", __func__);
 
-    if (buf.isFlags(IntelDisplayDataBuffer::SIZE_CHANGE) == false)
+    // a stripe width follows the window position too
+    if ((buf.isFlags(IntelDisplayDataBuffer::SIZE_CHANGE) == false) &&
+        (mStripeCount == 1))
         return true;
 
     uint32_t format = buf.getFormat();
-    uint32_t width = buf.getSrcWidth();
+    uint32_t width = (mStripeCount > 1) ? mStripe.srcWidth : buf.getSrcWidth();
     uint32_t height = buf.getSrcHeight();
     uint32_t yStride = buf.getYStride();
     uint32_t uvStride = buf.getUVStride();
@@ -753,23 +768,33 @@ bool IntelOverlayContext::scalingSetup(IntelDisplayDataBuffer& buffer)
     int i, j, pos;
     bool scaleChanged = false;
     int x, y, w, h;
+    bool positionChanged, interlaced;
+    int32_t seq;
     if (buffer.mBobDeinterlace) {
         deinterlace_factor = 2;
     } else {
         deinterlace_factor = 1;
     }
 
+    // consistent copy of the position set by the control side
+    do {
+        seq = intel_seqlock_read_begin(&mContext->seqlock);
+        positionChanged = mContext->position_changed;
+        interlaced = mContext->is_interlaced;
+        x = mContext->position.x;
+        y = mContext->position.y;
+        w = mContext->position.w;
+        h = mContext->position.h;
+    } while (intel_seqlock_read_retry(&mContext->seqlock, seq));
+
     if ((buffer.isFlags(IntelDisplayDataBuffer::SIZE_CHANGE) == false) &&
-        (mContext->position_changed == false) &&
-        (mContext->is_interlaced == buffer.mBobDeinterlace))
+        (positionChanged == false) &&
+        (interlaced == buffer.mBobDeinterlace))
         return true;
 
+    sharedWriteBegin();
     mContext->is_interlaced = buffer.mBobDeinterlace;
-
-    x = mContext->position.x;
-    y = mContext->position.y;
-    w = mContext->position.w;
-    h = mContext->position.h;
+    sharedWriteEnd();
 
     // check position
     checkPosition(x, y, w, h, buffer);
@@ -781,6 +806,12 @@ bool IntelOverlayContext::scalingSetup(IntelDisplayDataBuffer& buffer)
          return false;
     }
 
+    // a stripe covers its part of the window
+    if (mStripeCount > 1) {
+        x += mStripe.dstX;
+        w = mStripe.dstWidth;
+    }
+
     // setup dst position
     mOverlayBackBuffer->DWINPOS = (y << 16) | x;
     mOverlayBackBuffer->DWINSZ = (h << 16) | w;
@@ -805,6 +836,10 @@ bool IntelOverlayContext::scalingSetup(IntelDisplayDataBuffer& buffer)
         yscaleFract = ((srcHeight - 1) << 12) / (dstHeight * deinterlace_factor);
     }
 
+    // stripes keep the step of the whole source so the seam matches
+    if (mStripeCount > 1)
+        xscaleFract = mStripeStep;
+
     /* Calculate the UV scaling factor. */
     xscaleFractUV = xscaleFract / uvratio;
     yscaleFractUV = yscaleFract / uvratio;
@@ -855,6 +890,16 @@ bool IntelOverlayContext::scalingSetup(IntelDisplayDataBuffer& buffer)
         mOverlayBackBuffer->UVSCALEV = newval;
     }
 
+    // start the right stripe where the unsplit scaler would be at the seam
+    mOverlayBackBuffer->INIT_PHS &= ~OVERLAY_INIT_PHS_HORZ_MASK;
+    if (mStripeCount > 1) {
+        mOverlayBackBuffer->HORZ_PH =
+            OVERLAY_HORZ_PH(mStripe.phaseY, mStripe.phaseUV);
+        mOverlayBackBuffer->INIT_PHS |=
+            OVERLAY_INIT_PHS_HORZ(mStripe.phaseY, mStripe.phaseUV);
+    } else
+        mOverlayBackBuffer->HORZ_PH = 0;
+
     /* Recalculate coefficients if the scaling changed. */
     /*
      * Only Horizontal coefficients so far.
@@ -904,6 +949,54 @@ bool IntelOverlayContext::scalingSetup(IntelDisplayDataBuffer& buffer)
     return true;
 }
 
+bool IntelOverlayContext::stripeSetup(IntelDisplayDataBuffer& buf)
+{
+    int x, y, w, h;
+    int32_t seq;
+
+    if (mStripeCount == 1)
+        return true;
+
+    // only NV12 offsets advance by whole pixels in both planes
+    switch (buf.getFormat()) {
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12_VED:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12_TILE:
+        break;
+    default:
+        ALOGE("%s: can't split format 0x%x\n", __func__, buf.getFormat());
+        return false;
+    }
+
+    do {
+        seq = intel_seqlock_read_begin(&mContext->seqlock);
+        x = mContext->position.x;
+        y = mContext->position.y;
+        w = mContext->position.w;
+        h = mContext->position.h;
+    } while (intel_seqlock_read_retry(&mContext->seqlock, seq));
+
+    checkPosition(x, y, w, h, buf);
+    if (w <= 0) {
+        ALOGE("%s: Invalid dst width", __func__);
+        return false;
+    }
+
+    mStripeStep = intel_overlay_xstep(buf.getSrcWidth(), w);
+    if (!intel_overlay_stripe_setup(mStripeIndex, buf.getSrcWidth(), w,
+                                    mStripeStep, &mStripe)) {
+        ALOGE("%s: stripe %d of %d to %d pixels doesn't fit\n", __func__,
+              mStripeIndex, buf.getSrcWidth(), w);
+        return false;
+    }
+
+    ALOGD_IF(ALLOW_OVERLAY_PRINT,
+             "%s: stripe %d src %d+%d dst %d+%d phase 0x%x 0x%x\n", __func__,
+             mStripeIndex, mStripe.srcX, mStripe.srcWidth,
+             mStripe.dstX, mStripe.dstWidth, mStripe.phaseY, mStripe.phaseUV);
+    return true;
+}
+
 bool IntelOverlayContext::setDataBuffer(IntelDisplayDataBuffer& buffer)
 {
     if (!mContext || !mOverlayBackBuffer) {
@@ -913,6 +1006,12 @@ bool IntelOverlayContext::setDataBuffer(IntelDisplayDataBuffer& buffer)
 
     lock();
 
+    if (stripeSetup(buffer) == false) {
+        ALOGE("%s: failed to set up stripe\n", __func__);
+        unlock();
+        return false;
+    }
+
     bool ret = bufferOffsetSetup(buffer);
     if (ret == false) {
         ALOGE("%s: failed to set up buffer offsets\n", __func__);
@@ -953,7 +1052,9 @@ bool IntelOverlayContext::setDataBuffer(IntelDisplayDataBuffer& buffer)
         mOverlayBackBuffer->OCMD |= BUFFER0;
     }
     buffer.clearFlags();
+    sharedWriteBegin();
     mContext->position_changed = false;
+    sharedWriteEnd();
 
     unlock();
 
@@ -974,7 +1075,9 @@ intel_overlay_state_t IntelOverlayContext::getOverlayState() const
 void IntelOverlayContext::setOverlayState(intel_overlay_state_t state)
 {
     if (mContext) {
+        sharedWriteBegin();
         mContext->state = state;
+        sharedWriteEnd();
     }
 }
 
@@ -985,6 +1088,7 @@ void IntelOverlayContext::setRotation(int rotation)
 
     /*lock shared context*/
     lock();
+    sharedWriteBegin();
 
 #ifdef INTEL_OVERLAY_ROTATION_SUPPORT
     intel_overlay_rotation_t newRotation;
@@ -1024,6 +1128,7 @@ void IntelOverlayContext::setRotation(int rotation)
     mContext->rotation = OVERLAY_ROTATE_0;
     mContext->orientation = OVERLAY_ORIENTATION_PORTRAINT;
 #endif
+    sharedWriteEnd();
     unlock();
 }
 
@@ -1104,6 +1209,7 @@ void IntelOverlayContext::setPosition(int x, int y, int w, int h)
 
     // update context and overlay back buffer
     lock();
+    sharedWriteBegin();
 
     if ((x != mContext->position.x) || (y != mContext->position.y) ||
         (w != mContext->position.w) || (h != mContext->position.h))
@@ -1114,6 +1220,28 @@ void IntelOverlayContext::setPosition(int x, int y, int w, int h)
     mContext->position.w = w;
     mContext->position.h = h;
 
+    sharedWriteEnd();
+    unlock();
+}
+
+void IntelOverlayContext::setStripe(int index, int count)
+{
+    ALOGD_IF(ALLOW_OVERLAY_PRINT, "%s: %d of %d\n", __func__, index, count);
+
+    if (!mContext)
+        return;
+
+    lock();
+
+    // scaling is set up again on the next data buffer
+    if ((index != mStripeIndex) || (count != mStripeCount)) {
+        mStripeIndex = index;
+        mStripeCount = count;
+        sharedWriteBegin();
+        mContext->position_changed = true;
+        sharedWriteEnd();
+    }
+
     unlock();
 }
 
@@ -1212,6 +1340,7 @@ void IntelOverlayContext::setPipe(intel_display_pipe_t pipe)
         return;
 
     lock();
+    sharedWriteBegin();
 
     // clear pipe bits, this will use MIPI0 by default
     mContext->pipe &= ~(0x3 << 6);
@@ -1236,6 +1365,7 @@ void IntelOverlayContext::setPipe(intel_display_pipe_t pipe)
         break;
     default:
 	ALOGW("%s: invalid display pipe %d\n", __func__, pipe);
+	sharedWriteEnd();
 	unlock();
 	return;
     }
@@ -1243,6 +1373,7 @@ void IntelOverlayContext::setPipe(intel_display_pipe_t pipe)
     // need check position
     mContext->position_changed = true;
 
+    sharedWriteEnd();
     unlock();
 }
 
@@ -1432,7 +1563,8 @@ bool IntelOverlayContextMfld::flush_frame_or_top_field(uint32_t flags)
 }
 
 IntelOverlayPlane::IntelOverlayPlane(int fd, int index, IntelBufferManager *bm)
-    : IntelDisplayPlane(fd, IntelDisplayPlane::DISPLAY_PLANE_OVERLAY, index, bm)
+    : IntelDisplayPlane(fd, IntelDisplayPlane::DISPLAY_PLANE_OVERLAY, index, bm),
+      mSplitPlane(0)
 {
     bool ret;
     ALOGD_IF(ALLOW_OVERLAY_PRINT, "%s\n", __func__);
@@ -1462,11 +1594,16 @@ IntelOverlayPlane::IntelOverlayPlane(int fd, int index, IntelBufferManager *bm)
     // clear up overlay buffers
     memset(mDataBuffers, 0, sizeof(mDataBuffers));
     mNextBuffer = 0;
+    mCurrentSlot = -1;
+    mPrevSlot = -1;
 
     // initialized successfully
     mDataBuffer = dataBuffer;
     mContext = overlayContext;
     mInitialized = true;
+
+    IntelMemoryTracker::getInstance().registerTrimmable(
+        IntelMemoryTracker::MEM_GTT_MAPPING, this);
     return;
 overlay_init_err:
     delete overlayContext;
@@ -1476,6 +1613,8 @@ overlay_create_err:
 
 IntelOverlayPlane::~IntelOverlayPlane()
 {
+    IntelMemoryTracker::getInstance().unregisterTrimmable(this);
+
     if (initCheck()) {
 	IntelOverlayContext *overlayContext =
 	    reinterpret_cast<IntelOverlayContext*>(mContext);
@@ -1506,6 +1645,53 @@ void IntelOverlayPlane::setPosition(int left, int top, int right, int bottom)
             reinterpret_cast<IntelOverlayContext*>(mContext);
         overlayContext->setPosition(left, top, (right - left), (bottom - top));
     }
+
+    if (mSplitPlane)
+        mSplitPlane->setPosition(left, top, right, bottom);
+}
+
+void IntelOverlayPlane::setSplitPlane(IntelOverlayPlane *plane)
+{
+    if (!initCheck() || plane == mSplitPlane || plane == this)
+        return;
+
+    IntelOverlayContext *overlayContext =
+        reinterpret_cast<IntelOverlayContext*>(mContext);
+
+    if (mSplitPlane && mSplitPlane->initCheck()) {
+        IntelOverlayContext *splitContext =
+            reinterpret_cast<IntelOverlayContext*>(mSplitPlane->mContext);
+        splitContext->setStripe(0, 1);
+    }
+
+    mSplitPlane = (plane && plane->initCheck()) ? plane : 0;
+
+    if (mSplitPlane) {
+        IntelOverlayContext *splitContext =
+            reinterpret_cast<IntelOverlayContext*>(mSplitPlane->mContext);
+        overlayContext->setStripe(0, INTEL_OVERLAY_STRIPE_NUM);
+        splitContext->setStripe(1, INTEL_OVERLAY_STRIPE_NUM);
+    } else
+        overlayContext->setStripe(0, 1);
+
+    ALOGD_IF(ALLOW_OVERLAY_PRINT, "%s: overlay %d split with %d\n", __func__,
+             mIndex, mSplitPlane ? mSplitPlane->mIndex : -1);
+}
+
+bool IntelOverlayPlane::needsSplit(int format, int srcWidth)
+{
+    if (srcWidth <= INTEL_OVERLAY_STRIPE_MAX_WIDTH)
+        return false;
+
+    switch (format) {
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12_VED:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12_TILE:
+        // each stripe fetches a little more than half the source
+        return srcWidth <= INTEL_OVERLAY_STRIPE_MAX_SRC_WIDTH;
+    default:
+        return false;
+    }
 }
 
 bool IntelOverlayPlane::setDataBuffer(uint32_t handle, uint32_t flags,
@@ -1576,7 +1762,8 @@ bool IntelOverlayPlane::setDataBuffer(uint32_t handle, uint32_t flags,
         ALOGW("%s: planar YUV stride %d is too big, switch to ST",
              __func__, yStride);
         return false;
-    } else if ((grallocHeight > 2047) || (grallocWidth > 2047)) {
+    } else if ((grallocHeight > 2047) ||
+               ((grallocWidth > 2047) && !mSplitPlane)) {
         ALOGW("%s: source width or height (%dx%d) is too big, switch to ST",
              __func__, grallocWidth, grallocHeight);
         return false;
@@ -1599,6 +1786,7 @@ bool IntelOverlayPlane::setDataBuffer(uint32_t handle, uint32_t flags,
             mDataBuffers[i].handle == handle &&
             mDataBuffers[i].bufferType == bufferType) {
             buffer = mDataBuffers[i].buffer;
+            setCurrentSlot(i);
             mNextBuffer = (i + 1) % OVERLAY_DATA_BUFFER_NUM_MAX;
             break;
         }
@@ -1617,13 +1805,7 @@ bool IntelOverlayPlane::setDataBuffer(uint32_t handle, uint32_t flags,
         {
             ALOGD_IF(ALLOW_OVERLAY_PRINT,
                     "%s: releasing buffer %d...\n", __func__, mNextBuffer);
-            if (mDataBuffers[index].bufferType ==
-                IntelBufferManager::TTM_BUFFER)
-                mBufferManager->unwrap(mDataBuffers[index].buffer);
-            else
-                mBufferManager->unmap(mDataBuffers[index].buffer);
-
-            memset(&mDataBuffers[index], 0, sizeof(mDataBuffers[index]));
+            releaseDataBuffer(index);
         }
 
         if (bufferType == IntelBufferManager::TTM_BUFFER)
@@ -1636,6 +1818,10 @@ bool IntelOverlayPlane::setDataBuffer(uint32_t handle, uint32_t flags,
             ALOGW("%s: Avail memory is low...", __func__);
             break;
         }
+
+        // the other HWC caches are trimmed after this frame
+        if (buffer == NULL)
+            IntelMemoryTracker::getInstance().notifyPressure();
     }
 
     if (buffer == NULL) {
@@ -1651,6 +1837,9 @@ bool IntelOverlayPlane::setDataBuffer(uint32_t handle, uint32_t flags,
         mDataBuffers[mNextBuffer].buffer = buffer;
         mDataBuffers[mNextBuffer].bufferType = bufferType;
         mDataBuffers[mNextBuffer].grallocBuffFd = grallocBuffFd;
+        IntelMemoryTracker::getInstance().add(
+            IntelMemoryTracker::MEM_GTT_MAPPING, buffer->getSize());
+        setCurrentSlot(mNextBuffer);
 
         // move mNextBuffer pointer
         mNextBuffer = (mNextBuffer + 1) % OVERLAY_DATA_BUFFER_NUM_MAX;
@@ -1660,10 +1849,32 @@ bool IntelOverlayPlane::setDataBuffer(uint32_t handle, uint32_t flags,
 
     mDataBufferHandle = (uint32_t)nHandle;
 
+    if (mSplitPlane && !setSplitDataBuffer(*overlayDataBuffer))
+        return false;
+
     // set data buffer :-)
     return setDataBuffer(*overlayDataBuffer);
 }
 
+bool IntelOverlayPlane::setSplitDataBuffer(IntelDisplayDataBuffer& buffer)
+{
+    IntelDisplayDataBuffer *splitDataBuffer =
+        reinterpret_cast<IntelDisplayDataBuffer*>(mSplitPlane->mDataBuffer);
+
+    // the right stripe scans the buffer mapped here
+    splitDataBuffer->setFormat(buffer.getFormat());
+    splitDataBuffer->setWidth(buffer.getWidth());
+    splitDataBuffer->setHeight(buffer.getHeight());
+    splitDataBuffer->setStride(buffer.getYStride(), buffer.getUVStride());
+    splitDataBuffer->setCrop(buffer.getSrcX(), buffer.getSrcY(),
+                             buffer.getSrcWidth(), buffer.getSrcHeight());
+    splitDataBuffer->setDeinterlaceType(buffer.mBobDeinterlace);
+    splitDataBuffer->setBuffer(buffer.getBuffer());
+    mSplitPlane->mDataBufferHandle = mDataBufferHandle;
+
+    return mSplitPlane->setDataBuffer(*splitDataBuffer);
+}
+
 bool IntelOverlayPlane::setDataBuffer(IntelDisplayBuffer& buffer)
 {
     bool ret = true;
@@ -1691,24 +1902,70 @@ bool IntelOverlayPlane::invalidateDataBuffer()
     if (!initCheck())
         return false;
     ALOGD_IF(ALLOW_OVERLAY_PRINT, "invalidate overlay data buffer");
-    for (int i = 0; i < OVERLAY_DATA_BUFFER_NUM_MAX; i++) {
-        if (mDataBuffers[i].bufferType == IntelBufferManager::TTM_BUFFER)
-            mBufferManager->unwrap(mDataBuffers[i].buffer);
-        else
-            mBufferManager->unmap(mDataBuffers[i].buffer);
-    }
+    for (int i = 0; i < OVERLAY_DATA_BUFFER_NUM_MAX; i++)
+        releaseDataBuffer(i);
 
     // clear data buffers
-    memset(mDataBuffers, 0, sizeof(mDataBuffers));
     memset(mDataBuffer, 0, sizeof(*mDataBuffer));
     mNextBuffer = 0;
+    mCurrentSlot = -1;
+    mPrevSlot = -1;
 
     return true;
 }
 
+void IntelOverlayPlane::releaseDataBuffer(int index)
+{
+    IntelDisplayBuffer *buffer = mDataBuffers[index].buffer;
+
+    if (buffer)
+        IntelMemoryTracker::getInstance().remove(
+            IntelMemoryTracker::MEM_GTT_MAPPING, buffer->getSize());
+
+    if (mDataBuffers[index].bufferType == IntelBufferManager::TTM_BUFFER)
+        mBufferManager->unwrap(buffer);
+    else
+        mBufferManager->unmap(buffer);
+
+    memset(&mDataBuffers[index], 0, sizeof(mDataBuffers[index]));
+}
+
+void IntelOverlayPlane::setCurrentSlot(int index)
+{
+    if (index == mCurrentSlot)
+        return;
+
+    mPrevSlot = mCurrentSlot;
+    mCurrentSlot = index;
+}
+
+uint32_t IntelOverlayPlane::trimMemory(int category)
+{
+    uint32_t freed = 0;
+
+    if (!initCheck() || category != IntelMemoryTracker::MEM_GTT_MAPPING)
+        return 0;
+
+    // the previous buffer may be scanned out till the next vblank
+    for (int i = 0; i < OVERLAY_DATA_BUFFER_NUM_MAX; i++) {
+        if (i == mCurrentSlot || i == mPrevSlot || !mDataBuffers[i].buffer)
+            continue;
+
+        freed += mDataBuffers[i].buffer->getSize();
+        releaseDataBuffer(i);
+    }
+
+    ALOGD_IF(ALLOW_OVERLAY_PRINT, "%s: freed %u bytes\n", __func__, freed);
+    return freed;
+}
+
 bool IntelOverlayPlane::flip(void *contexts, uint32_t flags)
 {
     bool ret = true;
+
+    if (mSplitPlane)
+        mSplitPlane->flip(contexts, flags);
+
     if (initCheck()) {
         IntelOverlayContextMfld *overlayContext =
             reinterpret_cast<IntelOverlayContextMfld*>(mContext);
@@ -1765,6 +2022,9 @@ void IntelOverlayPlane::waitForFlipCompletion()
             if (ret == false)
                 ALOGE("%s: failed to do overlay flip\n", __func__);
     }
+
+    if (mSplitPlane)
+        mSplitPlane->waitForFlipCompletion();
 }
 
 bool IntelOverlayPlane::reset()
@@ -1779,6 +2039,9 @@ bool IntelOverlayPlane::reset()
             ALOGE("%s: failed to reset overlay\n", __func__);
     }
 
+    if (mSplitPlane)
+        mSplitPlane->reset();
+
     return ret;
 }
 
@@ -1794,6 +2057,9 @@ bool IntelOverlayPlane::disable()
             ALOGE("%s: failed to disable overlay\n", __func__);
     }
 
+    if (mSplitPlane)
+        mSplitPlane->disable();
+
     return ret;
 }
 
@@ -1804,6 +2070,9 @@ void IntelOverlayPlane::setPipe(intel_display_pipe_t pipe)
             reinterpret_cast<IntelOverlayContext*>(mContext);
         overlayContext->setPipe(pipe);
     }
+
+    if (mSplitPlane)
+        mSplitPlane->setPipe(pipe);
 }
 
 void IntelOverlayPlane::setPipeByMode(intel_overlay_mode_t displayMode)
@@ -1813,6 +2082,9 @@ void IntelOverlayPlane::setPipeByMode(intel_overlay_mode_t displayMode)
             reinterpret_cast<IntelOverlayContext*>(mContext);
         overlayContext->setPipeByMode(displayMode);
     }
+
+    if (mSplitPlane)
+        mSplitPlane->setPipeByMode(displayMode);
 }
 
 void IntelOverlayPlane::forceBottom(bool bottom)
@@ -1837,6 +2109,10 @@ bool IntelOverlayPlane::setOverlayOnTop(bool isOnTop)
 {
     IntelOverlayContext *overlayContext =
         reinterpret_cast<IntelOverlayContext*>(mContext);
+
+    if (mSplitPlane)
+        mSplitPlane->setOverlayOnTop(isOnTop);
+
     return (uint32_t)overlayContext->setOverlayOnTop(isOnTop);
 }
 
@@ -1873,20 +2149,26 @@ IntelRGBOverlayPlane::IntelRGBOverlayPlane(int fd, int index,
 	// update plane type
     mType = IntelDisplayPlane::DISPLAY_PLANE_RGB_OVERLAY;
 
-    // create pixel format converter
-    PixelFormatConverter *converter = new PixelFormatConverter();
-    bool ret = converter->initialize();
-    if (ret == false) {
-        ALOGW("IntelOverlayPlane: failed to initialize converter\n");
-        mInitialized = false;
-    }
+    // create pixel format converter, it opens its gralloc device on
+    // the first conversion
+    mPixelFormatConverter = new PixelFormatConverter();
 
-    mPixelFormatConverter = converter;
+    if (initCheck())
+        IntelMemoryTracker::getInstance().registerTrimmable(
+            IntelMemoryTracker::MEM_RGB_CONVERTER, this);
 }
 
 IntelRGBOverlayPlane::~IntelRGBOverlayPlane()
 {
+    IntelMemoryTracker::getInstance().unregisterTrimmable(this);
+}
+
+uint32_t IntelRGBOverlayPlane::trimMemory(int category)
+{
+    if (category == IntelMemoryTracker::MEM_RGB_CONVERTER)
+        return mPixelFormatConverter->trim();
 
+    return IntelOverlayPlane::trimMemory(category);
 }
 
 // override invalidateDataBuffer
@@ -1901,13 +2183,15 @@ bool IntelRGBOverlayPlane::invalidateDataBuffer()
 
 uint32_t IntelRGBOverlayPlane::convert(uint32_t handle,
                                            int w, int h,
-                                           int x, int y)
+                                           int x, int y,
+                                           VideoProcessor *vpp)
 {
-    return mPixelFormatConverter->convertBuffer(handle, w, h, x, y);
+    return mPixelFormatConverter->convertBuffer(handle, w, h, x, y, vpp);
 }
 
 IntelRGBOverlayPlane::PixelFormatConverter::PixelFormatConverter()
-    : mGrallocModule(0), mAllocDev(0), mCurrentBuffer(0)
+    : mGrallocModule(0), mAllocDev(0), mCurrentBuffer(0),
+      mCurrentYuv(0), mPrevYuv(0), mVppFailed(false)
 {
     // NOTE: maintain 3 buffers in case that triple buffering is active
     mBufferMapping.setCapacity(3);
@@ -1951,10 +2235,61 @@ bool IntelRGBOverlayPlane::PixelFormatConverter::initialize()
     return true;
 }
 
+// convert the RGB crop into the NV12 buffer by a video processing pass
+bool
+IntelRGBOverlayPlane::PixelFormatConverter::processBuffer(IMG_native_handle_t *rgbBuffer,
+                                                         buffer_handle_t yuvBuffer,
+                                                         int w, int h,
+                                                         int x, int y,
+                                                         VideoProcessor *vpp)
+{
+    IMG_native_handle_t *yuvHandle = (IMG_native_handle_t*)yuvBuffer;
+    VppRequest request;
+    VppSurface target;
+
+    if (!vpp || mVppFailed)
+        return false;
+
+    memset(&request, 0, sizeof(request));
+    request.source.memory = VPP_MEMORY_GRALLOC;
+    request.source.handle = (uint32_t)rgbBuffer;
+    request.source.fourcc = VideoProcessor::getFourcc(rgbBuffer->iFormat);
+    request.source.width = rgbBuffer->iWidth;
+    request.source.height = rgbBuffer->iHeight;
+    request.source.stride = rgbBuffer->iStride;
+    request.source.cropWidth = rgbBuffer->iWidth;
+    request.source.cropHeight = rgbBuffer->iHeight;
+    request.crop.x = x;
+    request.crop.y = y;
+    request.crop.width = w;
+    request.crop.height = h;
+    request.width = w;
+    request.height = h;
+
+    memset(&target, 0, sizeof(target));
+    target.memory = VPP_MEMORY_GRALLOC;
+    target.handle = (uint32_t)yuvBuffer;
+    target.fourcc = VideoProcessor::getFourcc(yuvHandle->iFormat);
+    target.width = yuvHandle->iWidth;
+    target.height = yuvHandle->iHeight;
+    target.stride = yuvHandle->iStride;
+    target.cropWidth = w;
+    target.cropHeight = h;
+
+    if (!request.source.fourcc || !vpp->process(request, target)) {
+        ALOGW("convertBuffer: video processing failed, use Blit2");
+        mVppFailed = true;
+        return false;
+    }
+
+    return true;
+}
+
 uint32_t
 IntelRGBOverlayPlane::PixelFormatConverter::convertBuffer(uint32_t handle,
                                                          int w, int h,
-                                                         int x, int y)
+                                                         int x, int y,
+                                                         VideoProcessor *vpp)
 {
     int err = 0;
     int yStride;
@@ -1965,6 +2300,11 @@ IntelRGBOverlayPlane::PixelFormatConverter::convertBuffer(uint32_t handle,
         return 0;
     }
 
+    if (!mAllocDev && !initialize()) {
+        ALOGE("convertBuffer: failed to initialize converter\n");
+        return 0;
+    }
+
     IMG_native_handle_t* rgbBufferHandle =
         (IMG_native_handle_t*)handle;
 
@@ -1990,15 +2330,21 @@ IntelRGBOverlayPlane::PixelFormatConverter::convertBuffer(uint32_t handle,
                            &yStride);
     if (err) {
         ALOGE("convertBuffer: failed to allocate YUV buffer\n");
+        IntelMemoryTracker::getInstance().notifyPressure();
         return 0;
     }
 
+    mBufferSizes.add((uint32_t)yuvBufferHandle, yStride * h * 3 / 2);
+    IntelMemoryTracker::getInstance().add(
+        IntelMemoryTracker::MEM_RGB_CONVERTER, yStride * h * 3 / 2);
+
     // update bufferMapping
     mBufferMapping.add((uint32_t)rgbBufferHandle->ui64Stamp,
                        (uint32_t)yuvBufferHandle);
 
 blit_out:
-    if (mCurrentBuffer != handle) {
+    if (mCurrentBuffer != handle &&
+        !processBuffer(rgbBufferHandle, yuvBufferHandle, w, h, x, y, vpp)) {
         // kick off a RGB to YUV Blit
         err = mGrallocModule->Blit2(mGrallocModule,
                                     (buffer_handle_t)rgbBufferHandle,
@@ -2008,27 +2354,64 @@ blit_out:
             ALOGE("convertBuffer: failed to kick off converting");
             goto err_out;
         }
+    }
+    mCurrentBuffer = handle;
 
-        mCurrentBuffer = handle;
+    if ((uint32_t)yuvBufferHandle != mCurrentYuv) {
+        mPrevYuv = mCurrentYuv;
+        mCurrentYuv = (uint32_t)yuvBufferHandle;
     }
 
     return (uint32_t)yuvBufferHandle;
 err_out:
-    mAllocDev->free(mAllocDev, yuvBufferHandle);
+    freeBuffer((uint32_t)yuvBufferHandle);
     mBufferMapping.removeItem(rgbBufferHandle->ui64Stamp);
     return 0;
 }
 
+void IntelRGBOverlayPlane::PixelFormatConverter::freeBuffer(uint32_t yuvBuffer)
+{
+    ssize_t index = mBufferSizes.indexOfKey(yuvBuffer);
+    if (index >= 0) {
+        IntelMemoryTracker::getInstance().remove(
+            IntelMemoryTracker::MEM_RGB_CONVERTER, mBufferSizes.valueAt(index));
+        mBufferSizes.removeItemsAt(index);
+    }
+
+    mAllocDev->free(mAllocDev, (buffer_handle_t)yuvBuffer);
+}
+
+uint32_t IntelRGBOverlayPlane::PixelFormatConverter::trim()
+{
+    uint32_t freed = 0;
+
+    // the buffer before the current one may still be scanned out
+    for (ssize_t i = mBufferMapping.size() - 1; i >= 0; i--) {
+        uint32_t yuvBuffer = mBufferMapping.valueAt(i);
+        if (yuvBuffer == mCurrentYuv || yuvBuffer == mPrevYuv)
+            continue;
+
+        ssize_t index = mBufferSizes.indexOfKey(yuvBuffer);
+        if (index >= 0)
+            freed += mBufferSizes.valueAt(index);
+        freeBuffer(yuvBuffer);
+        mBufferMapping.removeItemsAt(i);
+    }
+
+    ALOGD_IF(ALLOW_OVERLAY_PRINT, "PixelFormatConverter: trimmed %u bytes", freed);
+    return freed;
+}
+
 void IntelRGBOverlayPlane::PixelFormatConverter::reset()
 {
     ALOGD_IF(ALLOW_OVERLAY_PRINT,"PixelFormatConverter: reset");
 
     // free allocated buffer
-    for (uint32_t i = 0; i < mBufferMapping.size(); i++) {
-        buffer_handle_t yuvBufferHandle =
-            (buffer_handle_t)mBufferMapping.valueAt(i);
-        mAllocDev->free(mAllocDev, yuvBufferHandle);
-    }
+    for (uint32_t i = 0; i < mBufferMapping.size(); i++)
+        freeBuffer(mBufferMapping.valueAt(i));
     mCurrentBuffer = 0;
+    mCurrentYuv = 0;
+    mPrevYuv = 0;
+    mVppFailed = false;
     mBufferMapping.clear();
 }
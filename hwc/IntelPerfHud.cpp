@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <IntelHWComposerCfg.h>
+#include <IntelPerfHud.h>
+
+static const nsecs_t HUD_WINDOW = 1000000000LL;
+// commit gaps longer than this are an idle screen, not missed vsyncs
+static const nsecs_t HUD_IDLE_GAP = 100000000LL;
+static const nsecs_t HUD_DEFAULT_PERIOD = 16666667LL;
+
+// 5x7 glyphs from ' ' to 'Z', one byte per column, bit 0 at the top
+static const uint8_t hudFont[][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5f, 0x00, 0x00},
+    {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7f, 0x14, 0x7f, 0x14},
+    {0x24, 0x2a, 0x7f, 0x2a, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},
+    {0x00, 0x1c, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1c, 0x00},
+    {0x08, 0x2a, 0x1c, 0x2a, 0x08}, {0x08, 0x08, 0x3e, 0x08, 0x08},
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08},
+    {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},
+    {0x3e, 0x51, 0x49, 0x45, 0x3e}, {0x00, 0x42, 0x7f, 0x40, 0x00},
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4b, 0x31},
+    {0x18, 0x14, 0x12, 0x7f, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39},
+    {0x3c, 0x4a, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1e},
+    {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},
+    {0x00, 0x08, 0x14, 0x22, 0x41}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x41, 0x22, 0x14, 0x08, 0x00}, {0x02, 0x01, 0x51, 0x09, 0x06},
+    {0x32, 0x49, 0x79, 0x41, 0x3e}, {0x7e, 0x11, 0x11, 0x11, 0x7e},
+    {0x7f, 0x49, 0x49, 0x49, 0x36}, {0x3e, 0x41, 0x41, 0x41, 0x22},
+    {0x7f, 0x41, 0x41, 0x22, 0x1c}, {0x7f, 0x49, 0x49, 0x49, 0x41},
+    {0x7f, 0x09, 0x09, 0x01, 0x01}, {0x3e, 0x41, 0x41, 0x51, 0x32},
+    {0x7f, 0x08, 0x08, 0x08, 0x7f}, {0x00, 0x41, 0x7f, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3f, 0x01}, {0x7f, 0x08, 0x14, 0x22, 0x41},
+    {0x7f, 0x40, 0x40, 0x40, 0x40}, {0x7f, 0x02, 0x04, 0x02, 0x7f},
+    {0x7f, 0x04, 0x08, 0x10, 0x7f}, {0x3e, 0x41, 0x41, 0x41, 0x3e},
+    {0x7f, 0x09, 0x09, 0x09, 0x06}, {0x3e, 0x41, 0x51, 0x21, 0x5e},
+    {0x7f, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},
+    {0x01, 0x01, 0x7f, 0x01, 0x01}, {0x3f, 0x40, 0x40, 0x40, 0x3f},
+    {0x1f, 0x20, 0x40, 0x20, 0x1f}, {0x7f, 0x20, 0x18, 0x20, 0x7f},
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x03, 0x04, 0x78, 0x04, 0x03},
+    {0x61, 0x51, 0x49, 0x45, 0x43},
+};
+
+enum {
+    // glyphs drawn at twice their size
+    HUD_SCALE = 2,
+    HUD_ADVANCE = 6 * HUD_SCALE,
+    HUD_LINE = 8 * HUD_SCALE,
+    HUD_MARGIN = 4,
+    HUD_LINES = 5,
+};
+
+// ARGB
+static const uint32_t HUD_TEXT_COLOR = 0xffffffff;
+static const uint32_t HUD_BACK_COLOR = 0xa0000000;
+
+// tenths of a millisecond, capped to fit a HUD line
+static unsigned int toTenthMs(nsecs_t t)
+{
+    nsecs_t tenths = t / 100000;
+    return tenths > 999 ? 999 : (unsigned int)tenths;
+}
+
+IntelPerfHud::IntelPerfHud(int drmFd) :
+    mDrmFd(drmFd), mCursorManager(0), mSurface(0), mFront(0),
+    mShown(false), mCursorBusy(false), mWindowStart(0), mFrames(0),
+    mPrepares(0), mPrepareTotal(0), mPrepareMax(0), mCommitTotal(0),
+    mCommitMax(0), mMissed(0), mLastCommit(0), mLastVsync(0),
+    mVsyncPeriod(HUD_DEFAULT_PERIOD),
+    mOverlays(0), mSprites(0), mFramebuffer(0),
+    mFps10(0), mPrepareAvg(0), mPrepareWorst(0), mCommitAvg(0),
+    mCommitWorst(0), mWindowMissed(0), mRenders(0), mRenderTime(0)
+{
+}
+
+IntelPerfHud::~IntelPerfHud()
+{
+    android::Mutex::Autolock _l(mLock);
+    hide_l(true);
+}
+
+bool IntelPerfHud::show_l()
+{
+    mCursorManager = new IntelPVRBufferManager(mDrmFd);
+    if (!mCursorManager || !mCursorManager->initialize()) {
+        ALOGE("%s: failed to initialize cursor buffer manager\n", __func__);
+        goto err;
+    }
+
+    mSurface = mCursorManager->curAlloc(HUD_WIDTH, HUD_HEIGHT, HUD_SURFACES);
+    if (!mSurface || !mSurface->getCpuAddr()) {
+        ALOGE("%s: failed to allocate cursor surfaces\n", __func__);
+        goto err;
+    }
+
+    mFront = 0;
+    mShown = true;
+    return true;
+err:
+    hide_l(false);
+    return false;
+}
+
+void IntelPerfHud::hide_l(bool disable)
+{
+    if (mCursorManager && mSurface) {
+        // cursor registers taken over by the frame count path stay
+        if (disable && mShown)
+            mCursorManager->updateCursorReg(mFront, mSurface,
+                                            HUD_WIDTH, HUD_HEIGHT,
+                                            HUD_WIDTH, HUD_HEIGHT, false);
+        mCursorManager->curFree(mSurface);
+        delete mSurface;
+    }
+    delete mCursorManager;
+    mCursorManager = 0;
+    mSurface = 0;
+    mShown = false;
+}
+
+void IntelPerfHud::drawText_l(uint32_t *pixels, int line, const char *text)
+{
+    int x0 = HUD_MARGIN;
+    int y0 = HUD_MARGIN + line * HUD_LINE;
+
+    for (; *text && x0 + HUD_ADVANCE <= HUD_WIDTH; text++, x0 += HUD_ADVANCE) {
+        int c = *text;
+        if (c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        if (c < ' ' || c > 'Z')
+            c = '?';
+
+        const uint8_t *glyph = hudFont[c - ' '];
+        for (int col = 0; col < 5; col++) {
+            for (int row = 0; row < 7; row++) {
+                if (!(glyph[col] & (1 << row)))
+                    continue;
+                for (int dy = 0; dy < HUD_SCALE; dy++) {
+                    uint32_t *p = pixels +
+                        (y0 + row * HUD_SCALE + dy) * HUD_WIDTH +
+                        x0 + col * HUD_SCALE;
+                    for (int dx = 0; dx < HUD_SCALE; dx++)
+                        p[dx] = HUD_TEXT_COLOR;
+                }
+            }
+        }
+    }
+}
+
+void IntelPerfHud::render_l(uint32_t *pixels)
+{
+    int backHeight = HUD_MARGIN * 2 + HUD_LINES * HUD_LINE;
+    unsigned int prepareAvg = toTenthMs(mPrepareAvg);
+    unsigned int prepareMax = toTenthMs(mPrepareWorst);
+    unsigned int commitAvg = toTenthMs(mCommitAvg);
+    unsigned int commitMax = toTenthMs(mCommitWorst);
+    char text[16];
+
+    // text on a dim box, the rest of the cursor stays transparent
+    for (int i = 0; i < HUD_WIDTH * backHeight; i++)
+        pixels[i] = HUD_BACK_COLOR;
+    memset(pixels + HUD_WIDTH * backHeight, 0,
+           HUD_WIDTH * (HUD_HEIGHT - backHeight) * sizeof(uint32_t));
+
+    snprintf(text, sizeof(text), "FPS %u.%u", mFps10 / 10, mFps10 % 10);
+    drawText_l(pixels, 0, text);
+    snprintf(text, sizeof(text), "P %u.%u/%u.%u",
+             prepareAvg / 10, prepareAvg % 10, prepareMax / 10, prepareMax % 10);
+    drawText_l(pixels, 1, text);
+    snprintf(text, sizeof(text), "C %u.%u/%u.%u",
+             commitAvg / 10, commitAvg % 10, commitMax / 10, commitMax % 10);
+    drawText_l(pixels, 2, text);
+    snprintf(text, sizeof(text), "O%d S%d G%d",
+             mOverlays > 9 ? 9 : mOverlays, mSprites > 9 ? 9 : mSprites,
+             mFramebuffer > 9 ? 9 : mFramebuffer);
+    drawText_l(pixels, 3, text);
+    snprintf(text, sizeof(text), "MISS %u",
+             mWindowMissed > 99999 ? 99999 : mWindowMissed);
+    drawText_l(pixels, 4, text);
+}
+
+void IntelPerfHud::onPrepared(nsecs_t latency, int overlays, int sprites,
+                              int framebuffer)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    mPrepares++;
+    mPrepareTotal += latency;
+    if (latency > mPrepareMax)
+        mPrepareMax = latency;
+    mOverlays = overlays;
+    mSprites = sprites;
+    mFramebuffer = framebuffer;
+}
+
+void IntelPerfHud::onCommitted(nsecs_t latency)
+{
+    android::Mutex::Autolock _l(mLock);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    // a stall within continuous updates, idle screens don't count
+    if (mLastCommit) {
+        nsecs_t interval = now - mLastCommit;
+        if (interval > mVsyncPeriod * 3 / 2 && interval < HUD_IDLE_GAP)
+            mMissed += (interval + mVsyncPeriod / 2) / mVsyncPeriod - 1;
+    }
+    mLastCommit = now;
+
+    mFrames++;
+    mCommitTotal += latency;
+    if (latency > mCommitMax)
+        mCommitMax = latency;
+
+    if (!mWindowStart)
+        mWindowStart = now;
+}
+
+void IntelPerfHud::setCursorBusy(bool busy)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    mCursorBusy = busy;
+
+    // the registers are the frame count path's now, only drop the surface
+    if (busy && mShown)
+        hide_l(false);
+}
+
+void IntelPerfHud::onVsync(nsecs_t timestamp)
+{
+    android::Mutex::Autolock _l(mLock);
+    nsecs_t delta = timestamp - mLastVsync;
+    nsecs_t now;
+    char value[PROPERTY_VALUE_MAX];
+
+    // smoothed period, gaps from vsync being switched off are skipped
+    if (mLastVsync && delta > 5000000LL && delta < 50000000LL)
+        mVsyncPeriod = (mVsyncPeriod * 7 + delta) / 8;
+    mLastVsync = timestamp;
+
+    // the window closes here rather than in a commit, so drawing the
+    // HUD and reading the property stay off the composition path
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (!mWindowStart || now - mWindowStart < HUD_WINDOW)
+        return;
+
+    nsecs_t window = now - mWindowStart;
+    mFps10 = (unsigned int)(mFrames * 10 * HUD_WINDOW / window);
+    mPrepareAvg = mPrepares ? mPrepareTotal / mPrepares : 0;
+    mPrepareWorst = mPrepareMax;
+    mCommitAvg = mFrames ? mCommitTotal / mFrames : 0;
+    mCommitWorst = mCommitMax;
+    mWindowMissed = mMissed;
+    mWindowStart = now;
+    mFrames = 0;
+    mPrepares = 0;
+    mPrepareTotal = mPrepareMax = 0;
+    mCommitTotal = mCommitMax = 0;
+    mMissed = 0;
+
+    property_get("hwcomposer.debug.perfhud", value, "0");
+    if (!atoi(value) || mCursorBusy) {
+        if (mShown)
+            hide_l(!mCursorBusy);
+        return;
+    }
+
+    if (!mShown && !show_l())
+        return;
+
+    // draw the image off screen, the cursor flips to it at the next vsync
+    int back = mFront ^ 1;
+    uint32_t *pixels = (uint32_t *)mSurface->getCpuAddr() +
+                       back * HUD_WIDTH * HUD_HEIGHT;
+    render_l(pixels);
+    if (mCursorManager->updateCursorReg(back, mSurface,
+                                        HUD_WIDTH, HUD_HEIGHT,
+                                        HUD_WIDTH, HUD_HEIGHT, true))
+        mFront = back;
+
+    mRenders++;
+    mRenderTime = systemTime(SYSTEM_TIME_MONOTONIC) - now;
+}
+
+bool IntelPerfHud::dump(char *buff, int buff_len, int *cur_len)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------Perf HUD -------------\n");
+    dumpPrintf("  + %s, %u.%u fps, missed vsyncs %u\n",
+               mShown ? "shown" : "hidden", mFps10 / 10, mFps10 % 10,
+               mWindowMissed);
+    dumpPrintf("  + prepare avg %lld us max %lld us, "
+               "commit avg %lld us max %lld us\n",
+               mPrepareAvg / 1000, mPrepareWorst / 1000,
+               mCommitAvg / 1000, mCommitWorst / 1000);
+    dumpPrintf("  + planes: overlay %d, sprite %d, framebuffer %d\n",
+               mOverlays, mSprites, mFramebuffer);
+    dumpPrintf("  + rendered %u times, last %lld us\n",
+               mRenders, mRenderTime / 1000);
+
+    *cur_len = mDumpLen;
+    return true;
+}
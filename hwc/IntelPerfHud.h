@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_PERF_HUD_H__
+#define __INTEL_PERF_HUD_H__
+
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <IntelHWComposerDump.h>
+#include <IntelBufferManager.h>
+
+/**
+ * Class: performance HUD on the cursor plane
+ * Shows the composition frame rate, average and worst prepare/commit
+ * latency, the planes the primary display layers went to and missed
+ * vsyncs. The figures are drawn by the CPU into one of two cursor images
+ * once a second on the vsync thread, the cursor plane then flips to it
+ * with the next vsync. The HUD never enters a layer list so it costs no
+ * GLES pass and nothing on the prepare/commit path.
+ * Toggled at runtime through hwcomposer.debug.perfhud, the cursor buffer
+ * is only allocated while the HUD shows.
+ */
+class IntelPerfHud : public IntelHWComposerDump
+{
+public:
+    enum {
+        HUD_WIDTH = 128,
+        HUD_HEIGHT = 128,
+        // cursor images, one scanned out while the other is drawn
+        HUD_SURFACES = 2,
+    };
+public:
+    IntelPerfHud(int drmFd);
+    virtual ~IntelPerfHud();
+    // primary display planes after one prepare
+    void onPrepared(nsecs_t latency, int overlays, int sprites,
+                    int framebuffer);
+    void onCommitted(nsecs_t latency);
+    // the frame count debug path takes the cursor plane, once this returns
+    // the HUD doesn't touch the cursor registers till it is given back
+    void setCursorBusy(bool busy);
+    // closes the window, redraws the HUD and checks the toggle
+    void onVsync(nsecs_t timestamp);
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    bool show_l();
+    void hide_l(bool disable);
+    void render_l(uint32_t *pixels);
+    void drawText_l(uint32_t *pixels, int line, const char *text);
+private:
+    mutable android::Mutex mLock;
+    int mDrmFd;
+    IntelBufferManager *mCursorManager;
+    IntelDisplayBuffer *mSurface;
+    int mFront;
+    bool mShown;
+    // cursor held by the frame count path
+    bool mCursorBusy;
+    // current one second window
+    nsecs_t mWindowStart;
+    unsigned int mFrames;
+    unsigned int mPrepares;
+    nsecs_t mPrepareTotal;
+    nsecs_t mPrepareMax;
+    nsecs_t mCommitTotal;
+    nsecs_t mCommitMax;
+    unsigned int mMissed;
+    nsecs_t mLastCommit;
+    nsecs_t mLastVsync;
+    nsecs_t mVsyncPeriod;
+    int mOverlays;
+    int mSprites;
+    int mFramebuffer;
+    // figures of the last complete window
+    unsigned int mFps10;
+    nsecs_t mPrepareAvg;
+    nsecs_t mPrepareWorst;
+    nsecs_t mCommitAvg;
+    nsecs_t mCommitWorst;
+    unsigned int mWindowMissed;
+    unsigned int mRenders;
+    nsecs_t mRenderTime;
+};
+
+#endif /*__INTEL_PERF_HUD_H__*/
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <hardware/gralloc.h>
+#include <hal_public.h>
+#include <IntelHWComposerCfg.h>
+#include <IntelPlaneArbiter.h>
+
+static const char *sPoolNames[IntelPlaneArbiter::POOL_NUM] = {
+    "overlay",
+    "sprite",
+};
+
+IntelPlaneArbiter::IntelPlaneArbiter()
+    : mEnabled(true), mActive(false), mDemandCount(0),
+      mFrames(0), mGrantChanges(0), mReplans(0),
+      mSavedPixels(0), mLostPixels(0)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    memset(mCapacity, 0, sizeof(mCapacity));
+    memset(mHistory, 0, sizeof(mHistory));
+    memset(mGrants, 0, sizeof(mGrants));
+    memset(mReplanBudget, 0, sizeof(mReplanBudget));
+    memset(mStarved, 0, sizeof(mStarved));
+    memset(mReplan, 0, sizeof(mReplan));
+
+    property_get("hwcomposer.plane.arbiter", value, "1");
+    mEnabled = atoi(value) ? true : false;
+}
+
+void IntelPlaneArbiter::setCapacity(int pool, int count)
+{
+    if (pool < 0 || pool >= POOL_NUM)
+        return;
+
+    mCapacity[pool] = count;
+}
+
+void IntelPlaneArbiter::begin()
+{
+    mDemandCount = 0;
+}
+
+void IntelPlaneArbiter::addDemand(int disp, int pool, int index,
+                                  hwc_layer_1_t *layer, uint32_t refresh,
+                                  int planes)
+{
+    if (!mEnabled || !layer)
+        return;
+
+    if (disp < 0 || disp >= DISPLAY_MAX || pool < 0 || pool >= POOL_NUM ||
+        index < 0 || index >= LAYER_MAX || planes <= 0)
+        return;
+
+    // nothing to share
+    if (mCapacity[pool] < planes)
+        return;
+
+    if (mDemandCount >= DEMAND_MAX) {
+        ALOGW("%s: too many plane demands\n", __func__);
+        return;
+    }
+
+    IMG_native_handle_t *grallocHandle = (IMG_native_handle_t*)layer->handle;
+    struct history& h = mHistory[disp][index];
+    struct demand& d = mDemands[mDemandCount++];
+    int w = layer->displayFrame.right - layer->displayFrame.left;
+    int hgt = layer->displayFrame.bottom - layer->displayFrame.top;
+
+    // content update rate, averaged over the last few frames
+    h.rate = (h.rate * 3 + ((h.handle != layer->handle) ? 256 : 0)) / 4;
+    h.handle = layer->handle;
+
+    d.disp = disp;
+    d.pool = pool;
+    d.pixels = (w > 0 && hgt > 0) ? w * hgt : 0;
+    // static content is still composed once in a while
+    d.fps = (refresh * h.rate) >> 8;
+    if (!d.fps)
+        d.fps = 1;
+    d.planes = planes;
+    d.isProtected = grallocHandle &&
+                    (grallocHandle->usage & GRALLOC_USAGE_PROTECTED);
+    d.incumbent = false;
+    d.score = (uint64_t)d.pixels * d.fps;
+}
+
+uint64_t IntelPlaneArbiter::getWeightedScore(const struct demand& d) const
+{
+    if (d.incumbent)
+        return d.score * HYSTERESIS_PERCENT / 100;
+    return d.score;
+}
+
+void IntelPlaneArbiter::sortDemands(bool weighted)
+{
+    // a handful of demands, insertion sort keeps equal demands in order
+    for (int i = 1; i < mDemandCount; i++) {
+        struct demand d = mDemands[i];
+        uint64_t score = weighted ? getWeightedScore(d) : d.score;
+        int j = i - 1;
+        while (j >= 0) {
+            struct demand& o = mDemands[j];
+            uint64_t other = weighted ? getWeightedScore(o) : o.score;
+            // protected content cannot be composed by GLES at all
+            if (o.isProtected > d.isProtected ||
+                (o.isProtected == d.isProtected && other >= score))
+                break;
+            mDemands[j + 1] = o;
+            j--;
+        }
+        mDemands[j + 1] = d;
+    }
+}
+
+void IntelPlaneArbiter::arbitrate()
+{
+    int oldGrants[POOL_NUM][DISPLAY_MAX];
+    int served[POOL_NUM][DISPLAY_MAX];
+    int oldLimits[POOL_NUM][DISPLAY_MAX];
+
+    mActive = mEnabled;
+    if (!mActive)
+        return;
+
+    for (int p = 0; p < POOL_NUM; p++) {
+        for (int disp = 0; disp < DISPLAY_MAX; disp++)
+            oldLimits[p][disp] = getLimit(disp, p);
+    }
+    memcpy(oldGrants, mGrants, sizeof(oldGrants));
+    memset(served, 0, sizeof(served));
+    memset(mGrants, 0, sizeof(mGrants));
+
+    // the best demands of a display that were served last frame
+    // defend their planes with a bonus
+    sortDemands(false);
+    for (int i = 0; i < mDemandCount; i++) {
+        struct demand& d = mDemands[i];
+        if (served[d.pool][d.disp] + d.planes <= oldGrants[d.pool][d.disp]) {
+            d.incumbent = true;
+            served[d.pool][d.disp] += d.planes;
+        }
+    }
+    sortDemands(true);
+
+    mSavedPixels = 0;
+    mLostPixels = 0;
+    int granted[POOL_NUM] = { 0 };
+    for (int i = 0; i < mDemandCount; i++) {
+        struct demand& d = mDemands[i];
+        if (granted[d.pool] + d.planes <= mCapacity[d.pool]) {
+            granted[d.pool] += d.planes;
+            mGrants[d.pool][d.disp] += d.planes;
+            mSavedPixels += d.score;
+        } else
+            mLostPixels += d.score;
+    }
+
+    // a display allowed more planes than before attaches them again,
+    // one allowed fewer is told by the plane manager
+    for (int disp = 0; disp < DISPLAY_MAX; disp++) {
+        bool changed = false;
+        for (int p = 0; p < POOL_NUM; p++) {
+            if (mGrants[p][disp] != oldGrants[p][disp])
+                changed = true;
+            if (oldLimits[p][disp] >= 0 &&
+                getLimit(disp, p) > oldLimits[p][disp])
+                mReplan[disp] = true;
+        }
+        if (changed) {
+            mGrantChanges++;
+            mReplanBudget[disp] = REPLAN_MAX;
+            ALOGD_IF(ALLOW_PLANE_PRINT,
+                     "%s: display %d granted %d overlays, %d sprites\n",
+                     __func__, disp, mGrants[POOL_OVERLAY][disp],
+                     mGrants[POOL_SPRITE][disp]);
+        }
+    }
+
+    mFrames++;
+}
+
+int IntelPlaneArbiter::getLimit(int disp, int pool) const
+{
+    int limit;
+
+    if (!mActive || disp < 0 || disp >= DISPLAY_MAX ||
+        pool < 0 || pool >= POOL_NUM)
+        return -1;
+
+    limit = mCapacity[pool];
+    for (int i = 0; i < DISPLAY_MAX; i++) {
+        if (i != disp)
+            limit -= mGrants[pool][i];
+    }
+    return limit;
+}
+
+void IntelPlaneArbiter::onStarved(int disp)
+{
+    if (disp < 0 || disp >= DISPLAY_MAX)
+        return;
+
+    mStarved[disp] = true;
+}
+
+bool IntelPlaneArbiter::takeReplan(int disp)
+{
+    bool replan = false;
+
+    if (!mActive || disp < 0 || disp >= DISPLAY_MAX)
+        return false;
+
+    // the holder of a plane granted away may release it a frame later
+    if (mReplan[disp])
+        replan = true;
+    else if (mStarved[disp] && mReplanBudget[disp] > 0) {
+        mReplanBudget[disp]--;
+        replan = true;
+    }
+    mReplan[disp] = false;
+    mStarved[disp] = false;
+
+    // displays prepare on different threads
+    if (replan)
+        android_atomic_inc(&mReplans);
+    return replan;
+}
+
+bool IntelPlaneArbiter::dump(char *buff, int buff_len, int *cur_len)
+{
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------Plane arbiter ----------------------\n");
+    dumpPrintf("  + %s, %u frames, %u grant changes, %d replans\n",
+               mEnabled ? "enabled" : "disabled",
+               mFrames, mGrantChanges,
+               android_atomic_acquire_load(&mReplans));
+    for (int p = 0; p < POOL_NUM; p++) {
+        dumpPrintf("  + %-8s %d planes, granted", sPoolNames[p], mCapacity[p]);
+        for (int disp = 0; disp < DISPLAY_MAX; disp++)
+            dumpPrintf(" %d", mGrants[p][disp]);
+        dumpPrintf("\n");
+    }
+    for (int i = 0; i < mDemandCount; i++) {
+        struct demand& d = mDemands[i];
+        dumpPrintf("  + demand %d: display %d %-8s %7u pixels %2u fps%s%s%s\n",
+                   i, d.disp, sPoolNames[d.pool], d.pixels, d.fps,
+                   (d.planes > 1) ? " split" : "",
+                   d.isProtected ? " protected" : "",
+                   d.incumbent ? " incumbent" : "");
+    }
+    dumpPrintf("  + GPU composition saved %llu Kpixel/s, missed %llu Kpixel/s\n",
+               mSavedPixels / 1000, mLostPixels / 1000);
+
+    *cur_len = mDumpLen;
+    return true;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_PLANE_ARBITER_H__
+#define __INTEL_PLANE_ARBITER_H__
+
+#include <stdint.h>
+#include <hardware/hwcomposer.h>
+#include <IntelHWComposerDump.h>
+
+/**
+ * Class: cross display plane arbiter
+ * Collects the overlay and sprite plane demands of all displays before any
+ * display takes a plane, then grants planes by how much GLES composition
+ * each demand saves: visible pixels times the rate the layer content
+ * changes at. Protected layers are always served first. A demand that was
+ * served on the last frame is favoured by HYSTERESIS_PERCENT so planes do
+ * not bounce between displays with similar demands. Grants only bound what
+ * the other displays may take, planes no display asked for stay free for
+ * whoever gets to them first, as before.
+ */
+class IntelPlaneArbiter : public IntelHWComposerDump {
+public:
+    enum {
+        POOL_OVERLAY = 0,
+        POOL_SPRITE,
+        POOL_NUM,
+    };
+    enum {
+        DISPLAY_MAX = 3,
+        LAYER_MAX = 16,
+        DEMAND_MAX = 16,
+        HYSTERESIS_PERCENT = 150,
+        // frames a display missing a granted plane replans for
+        REPLAN_MAX = 3,
+    };
+public:
+    IntelPlaneArbiter();
+    void setCapacity(int pool, int count);
+    // starts collecting the demands of a new frame
+    void begin();
+    // planes is what the layer takes, 2 for a split video
+    void addDemand(int disp, int pool, int index,
+                   hwc_layer_1_t *layer, uint32_t refresh, int planes = 1);
+    void arbitrate();
+    // number of planes from @pool @disp may hold, -1 if not bounded
+    int getLimit(int disp, int pool) const;
+    // @disp could not get a plane it was granted
+    void onStarved(int disp);
+    // whether @disp has to attach its planes again
+    bool takeReplan(int disp);
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    struct demand {
+        int disp;
+        int pool;
+        uint32_t pixels;
+        uint32_t fps;
+        int planes;
+        bool isProtected;
+        bool incumbent;
+        uint64_t score;
+    };
+    struct history {
+        buffer_handle_t handle;
+        // share of frames the content changed in, 8 bit fraction
+        uint32_t rate;
+    };
+    void sortDemands(bool weighted);
+    uint64_t getWeightedScore(const struct demand& d) const;
+private:
+    bool mEnabled;
+    bool mActive;
+    int mCapacity[POOL_NUM];
+    struct demand mDemands[DEMAND_MAX];
+    int mDemandCount;
+    struct history mHistory[DISPLAY_MAX][LAYER_MAX];
+    int mGrants[POOL_NUM][DISPLAY_MAX];
+    int mReplanBudget[DISPLAY_MAX];
+    bool mStarved[DISPLAY_MAX];
+    bool mReplan[DISPLAY_MAX];
+    // statistics
+    uint32_t mFrames;
+    uint32_t mGrantChanges;
+    volatile int32_t mReplans;
+    uint64_t mSavedPixels;
+    uint64_t mLostPixels;
+};
+
+#endif /*__INTEL_PLANE_ARBITER_H__*/
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <pthread.h>
+#include <cutils/log.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <IntelHWComposerCfg.h>
+#include <IntelDisplayDevice.h>
+#include <IntelPrepareScheduler.h>
+
+static pthread_key_t sTicketKey;
+static pthread_once_t sTicketKeyOnce = PTHREAD_ONCE_INIT;
+
+static void createTicketKey()
+{
+    pthread_key_create(&sTicketKey, NULL);
+}
+
+IntelPrepareScheduler::Worker::Worker(IntelPrepareScheduler *scheduler)
+    : mScheduler(scheduler), mDevice(0), mList(0), mIndex(0), mPending(false)
+{
+
+}
+
+void IntelPrepareScheduler::Worker::post(IntelDisplayDevice *device,
+                                         hwc_display_contents_1_t *list,
+                                         int index)
+{
+    android::Mutex::Autolock _l(mLock);
+    mDevice = device;
+    mList = list;
+    mIndex = index;
+    mPending = true;
+    mCondition.signal();
+}
+
+bool IntelPrepareScheduler::Worker::threadLoop()
+{
+    struct ticket t;
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mLock);
+        while (!mPending)
+            mCondition.wait(mLock);
+        mPending = false;
+        if (exitPending())
+            return false;
+        t.scheduler = mScheduler;
+        t.index = mIndex;
+    }
+
+    pthread_setspecific(sTicketKey, &t);
+    mDevice->prepare(mList);
+    pthread_setspecific(sTicketKey, NULL);
+
+    mScheduler->finish(t.index);
+    return true;
+}
+
+IntelPrepareScheduler::IntelPrepareScheduler()
+    : mFinished(0), mParallel(false),
+      mSerialFrames(0), mParallelFrames(0), mYields(0),
+      mSerialTime(0), mParallelTime(0)
+{
+    ALOGV("Prepare scheduler created");
+}
+
+IntelPrepareScheduler::~IntelPrepareScheduler()
+{
+    // workers sleep waiting for a post, wake them up to exit
+    for (int i = 0; i < WORKER_MAX; i++) {
+        if (mWorkers[i] == 0)
+            continue;
+        mWorkers[i]->requestExit();
+        mWorkers[i]->post(0, 0, 0);
+        mWorkers[i]->join();
+    }
+}
+
+bool IntelPrepareScheduler::initialize()
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    pthread_once(&sTicketKeyOnce, createTicketKey);
+
+    property_get("hwcomposer.prepare.parallel", value, "1");
+    if (!atoi(value)) {
+        ALOGD_IF(ALLOW_HWC_PRINT, "%s: parallel prepare disabled\n", __func__);
+        return true;
+    }
+
+    for (int i = 0; i < WORKER_MAX; i++) {
+        mWorkers[i] = new Worker(this);
+        if (mWorkers[i]->run("HWC Prepare Worker",
+                             android::PRIORITY_URGENT_DISPLAY) !=
+            android::NO_ERROR) {
+            ALOGE("%s: failed to start prepare worker %d\n", __func__, i);
+            return false;
+        }
+    }
+
+    mParallel = true;
+    return true;
+}
+
+void IntelPrepareScheduler::waitTurn()
+{
+    struct ticket *t;
+
+    pthread_once(&sTicketKeyOnce, createTicketKey);
+    t = (struct ticket*)pthread_getspecific(sTicketKey);
+    if (t)
+        t->scheduler->waitForEarlier(t->index);
+}
+
+void IntelPrepareScheduler::waitForEarlier(int index)
+{
+    int32_t earlier = (1 << index) - 1;
+
+    if ((android_atomic_acquire_load(&mFinished) & earlier) == earlier)
+        return;
+
+    android::Mutex::Autolock _l(mLock);
+    mYields++;
+    while ((mFinished & earlier) != earlier)
+        mCondition.wait(mLock);
+}
+
+void IntelPrepareScheduler::finish(int index)
+{
+    android::Mutex::Autolock _l(mLock);
+    android_atomic_or(1 << index, &mFinished);
+    mCondition.broadcast();
+}
+
+void IntelPrepareScheduler::prepareSerial(IntelDisplayDevice **devices,
+                                          hwc_display_contents_1_t **lists,
+                                          int count)
+{
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    for (int i = 0; i < count; i++)
+        devices[i]->prepare(lists[i]);
+
+    mSerialTime += systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    mSerialFrames++;
+}
+
+void IntelPrepareScheduler::prepare(IntelDisplayDevice **devices,
+                                    hwc_display_contents_1_t **lists,
+                                    int count)
+{
+    int32_t all = (1 << count) - 1;
+    nsecs_t start;
+
+    // nothing to overlap with a single display
+    if (!mParallel || count < 2 || count > WORKER_MAX + 1) {
+        prepareSerial(devices, lists, count);
+        return;
+    }
+
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    android_atomic_release_store(0, &mFinished);
+
+    for (int i = 1; i < count; i++)
+        mWorkers[i - 1]->post(devices[i], lists[i], i);
+
+    // first ticket never waits, no need to hand it a ticket
+    devices[0]->prepare(lists[0]);
+    finish(0);
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mLock);
+        while ((mFinished & all) != all)
+            mCondition.wait(mLock);
+    }
+
+    mParallelTime += systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    mParallelFrames++;
+}
+
+bool IntelPrepareScheduler::dump(char *buff, int buff_len, int *cur_len)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------Prepare ----------------------------\n");
+    dumpPrintf("  + parallel prepare %s, %u workers waited their turn\n",
+               mParallel ? "enabled" : "disabled", mYields);
+    dumpPrintf("  + serial %u frames, avg %lld us\n", mSerialFrames,
+               mSerialFrames ? mSerialTime / mSerialFrames / 1000 : 0LL);
+    dumpPrintf("  + parallel %u frames, avg %lld us\n", mParallelFrames,
+               mParallelFrames ? mParallelTime / mParallelFrames / 1000 : 0LL);
+
+    *cur_len = mDumpLen;
+    return true;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_PREPARE_SCHEDULER_H__
+#define __INTEL_PREPARE_SCHEDULER_H__
+
+#include <hardware/hwcomposer.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <IntelHWComposerDump.h>
+
+class IntelDisplayDevice;
+
+/**
+ * Class: display prepare scheduler
+ * Runs the prepare of each display on its own thread. Every display gets
+ * a ticket in the order the displays used to be prepared in, and shared
+ * state (display planes, buffer mappings) is only touched by a ticket once
+ * all earlier tickets are done, see waitTurn(). Work that does not touch
+ * shared state, e.g. layer analysis, overlaps, while plane assignment comes
+ * out exactly as it would in a serial prepare.
+ */
+class IntelPrepareScheduler : public IntelHWComposerDump {
+public:
+    enum {
+        WORKER_MAX = 2,
+    };
+public:
+    IntelPrepareScheduler();
+    ~IntelPrepareScheduler();
+    bool initialize();
+    // prepares @count displays, @devices[0] on the calling thread
+    void prepare(IntelDisplayDevice **devices,
+                 hwc_display_contents_1_t **lists, int count);
+    // blocks a prepare worker until all earlier displays were prepared,
+    // returns at once when not called from a prepare worker
+    static void waitTurn();
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    class Worker : public android::Thread {
+    public:
+        Worker(IntelPrepareScheduler *scheduler);
+        void post(IntelDisplayDevice *device,
+                  hwc_display_contents_1_t *list, int index);
+    private:
+        virtual bool threadLoop();
+    private:
+        IntelPrepareScheduler *mScheduler;
+        android::Mutex mLock;
+        android::Condition mCondition;
+        IntelDisplayDevice *mDevice;
+        hwc_display_contents_1_t *mList;
+        int mIndex;
+        bool mPending;
+    };
+    struct ticket {
+        IntelPrepareScheduler *scheduler;
+        int index;
+    };
+    void waitForEarlier(int index);
+    void finish(int index);
+    void prepareSerial(IntelDisplayDevice **devices,
+                       hwc_display_contents_1_t **lists, int count);
+private:
+    mutable android::Mutex mLock;
+    android::Condition mCondition;
+    volatile int32_t mFinished;
+    android::sp<Worker> mWorkers[WORKER_MAX];
+    bool mParallel;
+    // statistics
+    uint32_t mSerialFrames;
+    uint32_t mParallelFrames;
+    uint32_t mYields;
+    nsecs_t mSerialTime;
+    nsecs_t mParallelTime;
+};
+
+#endif /*__INTEL_PREPARE_SCHEDULER_H__*/
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <IntelHWComposerCfg.h>
+#include "IntelHWComposer.h"
+#include "IntelRefreshRateGovernor.h"
+
+// UI must be quiet this long before leaving the native rate
+static const nsecs_t ACTIVITY_HOLD = 2000000000LL;
+// video frame rate must be stable this long before following it
+static const nsecs_t VIDEO_HOLD = 1000000000LL;
+// minimum time between a switch and the next lowering
+static const nsecs_t MIN_DWELL = 1000000000LL;
+
+IntelRefreshRateGovernor::IntelRefreshRateGovernor(IntelHWComposer *hwc) :
+    mComposer(hwc), mCurrentRate(REFRESH_RATE_NATIVE), mVideoFps(0),
+    mVideoSince(0), mLastSwitch(0), mSupported(true), mBlanked(false),
+    mSwitching(false), mSwitchCount(0)
+{
+    ALOGV("Refresh rate governor created");
+    mLastActivity = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+IntelRefreshRateGovernor::~IntelRefreshRateGovernor()
+{
+
+}
+
+int IntelRefreshRateGovernor::getVideoRefreshRate(int fps)
+{
+    // lowest panel rate which is a multiple of the content rate
+    switch (fps) {
+    case 23:
+    case 24:
+        return 48;
+    case 25:
+        return 50;
+    default:
+        return REFRESH_RATE_NATIVE;
+    }
+}
+
+void IntelRefreshRateGovernor::notifyActivity()
+{
+    android::Mutex::Autolock _l(mLock);
+    mLastActivity = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    // raising is never delayed
+    if (mCurrentRate != REFRESH_RATE_NATIVE)
+        mCondition.broadcast();
+}
+
+void IntelRefreshRateGovernor::setVideoFrameRate(int fps)
+{
+    android::Mutex::Autolock _l(mLock);
+    if (fps == mVideoFps)
+        return;
+
+    ALOGD_IF(ALLOW_HWC_PRINT, "%s: video %d fps\n", __func__, fps);
+    mVideoFps = fps;
+    mVideoSince = systemTime(SYSTEM_TIME_MONOTONIC);
+    mCondition.broadcast();
+}
+
+void IntelRefreshRateGovernor::setBlanked(bool blanked)
+{
+    android::Mutex::Autolock _l(mLock);
+    if (blanked == mBlanked)
+        return;
+
+    ALOGD_IF(ALLOW_HWC_PRINT, "%s: %s\n", __func__,
+             blanked ? "blanked" : "unblanked");
+    mBlanked = blanked;
+
+    if (blanked) {
+        while (mSwitching)
+            mCondition.wait(mLock);
+        return;
+    }
+
+    // screen just came on, go back to the native rate right away
+    mLastActivity = systemTime(SYSTEM_TIME_MONOTONIC);
+    mCondition.broadcast();
+}
+
+void IntelRefreshRateGovernor::stop()
+{
+    requestExit();
+    {
+        android::Mutex::Autolock _l(mLock);
+        mCondition.broadcast();
+    }
+    requestExitAndWait();
+}
+
+int IntelRefreshRateGovernor::getRefreshRate() const
+{
+    android::Mutex::Autolock _l(mLock);
+    return mCurrentRate;
+}
+
+int IntelRefreshRateGovernor::getTargetRate_l(nsecs_t now, nsecs_t& wakeup)
+{
+    int target;
+
+    wakeup = 0;
+
+    if (now - mLastActivity < ACTIVITY_HOLD) {
+        target = REFRESH_RATE_NATIVE;
+        wakeup = mLastActivity + ACTIVITY_HOLD;
+    } else if (mVideoFps) {
+        target = getVideoRefreshRate(mVideoFps);
+        if (now - mVideoSince < VIDEO_HOLD) {
+            target = REFRESH_RATE_NATIVE;
+            wakeup = mVideoSince + VIDEO_HOLD;
+        }
+    } else
+        target = REFRESH_RATE_IDLE;
+
+    // hysteresis, don't lower again right after a switch
+    if (target < mCurrentRate && now - mLastSwitch < MIN_DWELL) {
+        target = mCurrentRate;
+        wakeup = mLastSwitch + MIN_DWELL;
+    }
+
+    return target;
+}
+
+bool IntelRefreshRateGovernor::threadLoop()
+{
+    nsecs_t now, wakeup;
+    int rate;
+
+    { // scope for lock
+        android::Mutex::Autolock _l(mLock);
+
+        if (exitPending())
+            return false;
+
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+        rate = getTargetRate_l(now, wakeup);
+
+        if (mBlanked || !mSupported || rate == mCurrentRate) {
+            if (!mBlanked && mSupported && wakeup > now)
+                mCondition.waitRelative(mLock, wakeup - now);
+            else
+                mCondition.wait(mLock);
+            return true;
+        }
+        mSwitching = true;
+    }
+
+    // mode setting happens outside of the lock, HWC takes its own lock
+    bool ret = mComposer->setRefreshRate(rate);
+
+    android::Mutex::Autolock _l(mLock);
+    mSwitching = false;
+    mCondition.broadcast();
+    if (!ret) {
+        ALOGW("%s: panel refused %dHz, governor disabled\n", __func__, rate);
+        mSupported = false;
+        return true;
+    }
+
+    ALOGD_IF(ALLOW_HWC_PRINT, "%s: refresh rate %d -> %d\n",
+             __func__, mCurrentRate, rate);
+    mCurrentRate = rate;
+    mLastSwitch = now;
+    mSwitchCount++;
+    return true;
+}
+
+bool IntelRefreshRateGovernor::dump(char *buff, int buff_len, int *cur_len)
+{
+    android::Mutex::Autolock _l(mLock);
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------Refresh rate governor -------------\n");
+    dumpPrintf("  + rate %dHz, video %d fps, switches %u%s%s\n",
+               mCurrentRate, mVideoFps, mSwitchCount,
+               mSupported ? "" : " (unsupported)",
+               mBlanked ? " (blanked)" : "");
+
+    *cur_len = mDumpLen;
+    return true;
+}
+
+android::status_t IntelRefreshRateGovernor::readyToRun()
+{
+    return android::NO_ERROR;
+}
+
+void IntelRefreshRateGovernor::onFirstRef()
+{
+    ALOGV("Refresh rate governor onFirstRef");
+    run("HWC Refresh Rate Governor", android::PRIORITY_DISPLAY);
+}
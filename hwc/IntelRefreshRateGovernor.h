@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_REFRESH_RATE_GOVERNOR_H__
+#define __INTEL_REFRESH_RATE_GOVERNOR_H__
+
+#include <utils/threads.h>
+#include <IntelHWComposerDump.h>
+
+class IntelHWComposer;
+
+/**
+ * Class: MIPI refresh rate governor
+ * Lowers the panel refresh rate to a multiple of the playing video's
+ * frame rate (48Hz for 24fps, 50Hz for 25fps) or to an idle rate when the
+ * UI has been static for a while, and goes back to the native rate as
+ * soon as the UI is active again. Rates are only lowered after the
+ * condition has held for a while and never twice within a short period,
+ * so the panel does not flap between rates.
+ */
+class IntelRefreshRateGovernor : public android::Thread,
+                                 public IntelHWComposerDump
+{
+public:
+    enum {
+        REFRESH_RATE_NATIVE = 60,
+        REFRESH_RATE_IDLE = 40,
+    };
+public:
+    IntelRefreshRateGovernor(IntelHWComposer *hwc);
+    virtual ~IntelRefreshRateGovernor();
+    // UI content changed or vsync was requested again (touch, animation)
+    void notifyActivity();
+    // frame rate of the playing video, 0 if no video is playing
+    void setVideoFrameRate(int fps);
+    // no mode setting while the panel is blanked, waits for a switch
+    // in flight to finish
+    void setBlanked(bool blanked);
+    int getRefreshRate() const;
+    void stop();
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    virtual bool threadLoop();
+    virtual android::status_t readyToRun();
+    virtual void onFirstRef();
+private:
+    int getTargetRate_l(nsecs_t now, nsecs_t& wakeup);
+    static int getVideoRefreshRate(int fps);
+private:
+    mutable android::Mutex mLock;
+    android::Condition mCondition;
+    IntelHWComposer *mComposer;
+    int mCurrentRate;
+    int mVideoFps;
+    nsecs_t mVideoSince;
+    nsecs_t mLastActivity;
+    nsecs_t mLastSwitch;
+    bool mSupported;
+    bool mBlanked;
+    bool mSwitching;
+    uint32_t mSwitchCount;
+};
+
+#endif /*__INTEL_REFRESH_RATE_GOVERNOR_H__*/
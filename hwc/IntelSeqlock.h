@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_SEQLOCK_H__
+#define __INTEL_SEQLOCK_H__
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cutils/atomic.h>
+#include <cutils/atomic-inline.h>
+
+/*
+ * Sequence lock for state shared between processes through ashmem.
+ * Readers never block: they copy the state and retry if a writer ran
+ * meanwhile, so a reader that dies can't hold anybody up. Writers are
+ * rare and serialized by a process-shared robust mutex where the C
+ * library supports it. Elsewhere (bionic) they take turns through the
+ * owner tid, which also lets a writer dying inside its section be found
+ * and recovered by the next writer or a reader.
+ */
+#if defined(__GLIBC__)
+#define INTEL_SEQLOCK_ROBUST 1
+#endif
+
+/* failed read attempts before a reader checks the writer is alive */
+#define INTEL_SEQLOCK_SPINS 100
+
+typedef struct {
+    /* odd while a writer is inside its section */
+    volatile int32_t sequence;
+    /* tid of the writer inside its section, 0 if none */
+    volatile int32_t owner;
+    pthread_mutex_t writer;
+} intel_seqlock_t;
+
+static inline int32_t intel_seqlock_tid()
+{
+    return (int32_t)syscall(__NR_gettid);
+}
+
+// the owner may live in another process, only a missing task is dead
+static inline bool intel_seqlock_owner_dead(int32_t owner)
+{
+    return owner && kill(owner, 0) < 0 && errno == ESRCH;
+}
+
+static inline bool intel_seqlock_init(intel_seqlock_t *sl)
+{
+    pthread_mutexattr_t attr;
+    bool ret = false;
+
+    sl->sequence = 0;
+    sl->owner = 0;
+
+    if (pthread_mutexattr_init(&attr))
+        return false;
+
+    if (pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED))
+        goto out;
+
+#ifdef INTEL_SEQLOCK_ROBUST
+    if (pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST))
+        goto out;
+#endif
+
+    ret = !pthread_mutex_init(&sl->writer, &attr);
+out:
+    pthread_mutexattr_destroy(&attr);
+    return ret;
+}
+
+static inline void intel_seqlock_destroy(intel_seqlock_t *sl)
+{
+    pthread_mutex_destroy(&sl->writer);
+}
+
+static inline void intel_seqlock_write_lock(intel_seqlock_t *sl)
+{
+    int32_t tid = intel_seqlock_tid();
+    bool dead = false;
+
+#ifdef INTEL_SEQLOCK_ROBUST
+    if (pthread_mutex_lock(&sl->writer) == EOWNERDEAD) {
+        pthread_mutex_consistent(&sl->writer);
+        dead = true;
+    }
+    android_atomic_release_store(tid, &sl->owner);
+#else
+    for (;;) {
+        int32_t owner = android_atomic_acquire_load(&sl->owner);
+
+        if (!owner) {
+            if (!android_atomic_cmpxchg(0, tid, &sl->owner))
+                break;
+            continue;
+        }
+        if (intel_seqlock_owner_dead(owner) &&
+            !android_atomic_cmpxchg(owner, tid, &sl->owner)) {
+            dead = true;
+            break;
+        }
+        sched_yield();
+    }
+#endif
+
+    // the previous writer died in its section, close it
+    if (dead && (sl->sequence & 1))
+        android_atomic_inc(&sl->sequence);
+
+    // odd, readers retry from here on
+    android_atomic_inc(&sl->sequence);
+}
+
+static inline void intel_seqlock_write_unlock(intel_seqlock_t *sl)
+{
+    android_atomic_inc(&sl->sequence);
+    android_atomic_release_store(0, &sl->owner);
+#ifdef INTEL_SEQLOCK_ROBUST
+    pthread_mutex_unlock(&sl->writer);
+#endif
+}
+
+static inline int32_t intel_seqlock_read_begin(intel_seqlock_t *sl)
+{
+    int32_t seq;
+    int spins = 0;
+
+    while ((seq = android_atomic_acquire_load(&sl->sequence)) & 1) {
+        if (++spins < INTEL_SEQLOCK_SPINS) {
+            sched_yield();
+            continue;
+        }
+
+        // a descheduled writer is waited for without blocking, a dead
+        // one is recovered
+        if (intel_seqlock_owner_dead(android_atomic_acquire_load(&sl->owner))) {
+            intel_seqlock_write_lock(sl);
+            intel_seqlock_write_unlock(sl);
+        }
+        sched_yield();
+        spins = 0;
+    }
+
+    return seq;
+}
+
+// true if the state read since intel_seqlock_read_begin() may be torn
+static inline bool intel_seqlock_read_retry(intel_seqlock_t *sl, int32_t seq)
+{
+    android_memory_barrier();
+    return sl->sequence != seq;
+}
+
+#endif /*__INTEL_SEQLOCK_H__*/
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <IntelUEventDispatcher.h>
+#include <IntelHWComposerCfg.h>
+#include <cutils/log.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/filter.h>
+
+enum {
+    UEVENT_FILTER_MAX_INSNS = 64,
+    UEVENT_RCVBUF_SIZE = 64 * 1024,
+};
+
+static int classifyKey(const char *key, int keyLen)
+{
+    if (keyLen >= 7 && !strncmp(key, "HOTPLUG", 7))
+        return UEVENT_TYPE_HOTPLUG;
+    if (keyLen == 5 && !strncmp(key, "VSYNC", 5))
+        return UEVENT_TYPE_VSYNC;
+    if (keyLen >= 4 && !strncmp(key, "HDCP", 4))
+        return UEVENT_TYPE_HDCP;
+    if (keyLen >= 4 && !strncmp(key, "DPST", 4))
+        return UEVENT_TYPE_DPST;
+    return UEVENT_TYPE_UNKNOWN;
+}
+
+// @msg must have room for a terminating NUL at msg[len]
+bool IntelUEvent::parse(char *msg, int len)
+{
+    mHeader = 0;
+    mLength = 0;
+    mType = UEVENT_TYPE_UNKNOWN;
+    mKeyCount = 0;
+
+    if (!msg || len <= 0)
+        return false;
+
+    msg[len] = '\0';
+
+    // socket filter already did this check, but it may not be attached
+    if (strcmp(msg, INTEL_DRM_UEVENT_DEVPATH))
+        return false;
+
+    mHeader = msg;
+    mLength = len;
+
+    int pos = strlen(msg) + 1;
+    while (pos < len && mKeyCount < UEVENT_MAX_KEYS) {
+        const char *entry = msg + pos;
+        int entryLen = strlen(entry);
+        const char *sep = (const char*)memchr(entry, '=', entryLen);
+
+        if (sep) {
+            mKeys[mKeyCount].key = entry;
+            mKeys[mKeyCount].keyLen = sep - entry;
+            mKeys[mKeyCount].value = sep + 1;
+            if (mType == UEVENT_TYPE_UNKNOWN)
+                mType = classifyKey(entry, sep - entry);
+            mKeyCount++;
+        }
+
+        pos += entryLen + 1;
+    }
+
+    return true;
+}
+
+const char* IntelUEvent::getValue(const char *key) const
+{
+    if (!key)
+        return 0;
+
+    int keyLen = strlen(key);
+    for (int i = 0; i < mKeyCount; i++) {
+        if (mKeys[i].keyLen == keyLen &&
+            !strncmp(mKeys[i].key, key, keyLen))
+            return mKeys[i].value;
+    }
+
+    return 0;
+}
+
+IntelUEventDispatcher::IntelUEventDispatcher()
+    : mFd(-1), mFiltered(false),
+      mReceived(0), mDispatched(0), mDropped(0)
+{
+    memset(mHandlers, 0, sizeof(mHandlers));
+}
+
+IntelUEventDispatcher::~IntelUEventDispatcher()
+{
+    close();
+}
+
+// Build a classic BPF program which accepts a message only if it starts
+// with the DRM device header (including its terminating NUL), so that
+// USB, power supply and block device events never wake us up.
+bool IntelUEventDispatcher::attachFilter()
+{
+    struct sock_filter insns[UEVENT_FILTER_MAX_INSNS];
+    struct sock_fprog prog;
+    const unsigned char *path = (const unsigned char*)INTEL_DRM_UEVENT_DEVPATH;
+    int len = strlen(INTEL_DRM_UEVENT_DEVPATH) + 1;
+    int rem = len % 4;
+    int compares = (len / 4) + ((rem >= 2) ? 1 : 0) + (rem % 2);
+    int total = compares * 2 + 2;
+    int count = 0;
+    int offset = 0;
+
+    if (total > UEVENT_FILTER_MAX_INSNS) {
+        ALOGE("%s: filter too long %d\n", __func__, total);
+        return false;
+    }
+
+    while (offset < len) {
+        int remain = len - offset;
+        uint32_t value;
+        int size;
+
+        if (remain >= 4) {
+            size = BPF_W;
+            value = (path[offset] << 24) | (path[offset + 1] << 16) |
+                    (path[offset + 2] << 8) | path[offset + 3];
+        } else if (remain >= 2) {
+            size = BPF_H;
+            value = (path[offset] << 8) | path[offset + 1];
+        } else {
+            size = BPF_B;
+            value = path[offset];
+        }
+
+        struct sock_filter load = BPF_STMT(BPF_LD | size | BPF_ABS, (uint32_t)offset);
+        insns[count++] = load;
+        // on mismatch jump to the reject statement at the end
+        struct sock_filter cmp = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                                          value, 0, (uint8_t)(total - 2 - count));
+        insns[count++] = cmp;
+
+        offset += (size == BPF_W) ? 4 : ((size == BPF_H) ? 2 : 1);
+    }
+
+    struct sock_filter accept = BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    struct sock_filter reject = BPF_STMT(BPF_RET | BPF_K, 0);
+    insns[count++] = accept;
+    insns[count++] = reject;
+
+    prog.len = count;
+    prog.filter = insns;
+
+    if (setsockopt(mFd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+        ALOGW("%s: failed to attach uevent filter, %s\n",
+              __func__, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool IntelUEventDispatcher::open()
+{
+    struct sockaddr_nl addr;
+    int sz = UEVENT_RCVBUF_SIZE;
+
+    if (mFd >= 0)
+        return true;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_pid = pthread_self() | getpid();
+    addr.nl_groups = 0xffffffff;
+
+    mFd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    if (mFd < 0) {
+        ALOGE("%s: failed to open uevent socket\n", __func__);
+        return false;
+    }
+
+    setsockopt(mFd, SOL_SOCKET, SO_RCVBUFFORCE, &sz, sizeof(sz));
+
+    // attach the filter before bind so no unfiltered event is queued
+    mFiltered = attachFilter();
+
+    if (bind(mFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ALOGE("%s: failed to bind uevent socket\n", __func__);
+        ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    ALOGD_IF(ALLOW_MONITOR_PRINT, "%s: uevent socket %d, filtered %d\n",
+             __func__, mFd, mFiltered);
+    return true;
+}
+
+void IntelUEventDispatcher::close()
+{
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+    mFiltered = false;
+}
+
+bool IntelUEventDispatcher::registerHandler(int type, IntelUEventHandler *handler)
+{
+    if (type < 0 || type >= UEVENT_TYPE_NUM)
+        return false;
+
+    mHandlers[type] = handler;
+    return true;
+}
+
+void IntelUEventDispatcher::unregisterHandler(int type)
+{
+    if (type < 0 || type >= UEVENT_TYPE_NUM)
+        return;
+
+    mHandlers[type] = 0;
+}
+
+bool IntelUEventDispatcher::dispatch()
+{
+    IntelUEvent event;
+
+    if (mFd < 0)
+        return false;
+
+    // leave one byte for the terminating NUL
+    int count = recv(mFd, mMessage, UEVENT_MSG_LEN - 1, MSG_DONTWAIT);
+    if (count <= 0)
+        return false;
+
+    mReceived++;
+
+    if (!event.parse(mMessage, count)) {
+        mDropped++;
+        return true;
+    }
+
+    int type = event.getType();
+    IntelUEventHandler *handler =
+        (type != UEVENT_TYPE_UNKNOWN) ? mHandlers[type] : 0;
+    if (!handler) {
+        ALOGV("%s: no handler for uevent type %d\n", __func__, type);
+        mDropped++;
+        return true;
+    }
+
+    mDispatched++;
+    handler->handleUEvent(event);
+    return true;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_UEVENT_DISPATCHER_H__
+#define __INTEL_UEVENT_DISPATCHER_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// DRM device which emits display uevents (hotplug, vsync, HDCP, DPST)
+#define INTEL_DRM_UEVENT_DEVPATH \
+    "change@/devices/pci0000:00/0000:00:02.0/drm/card0"
+
+enum {
+    UEVENT_TYPE_UNKNOWN = -1,
+    UEVENT_TYPE_HOTPLUG = 0,
+    UEVENT_TYPE_VSYNC,
+    UEVENT_TYPE_HDCP,
+    UEVENT_TYPE_DPST,
+    UEVENT_TYPE_NUM,
+};
+
+/**
+ * Class: parsed view of a single kernel uevent message.
+ * Keys and values point into the dispatcher's receive buffer, so an
+ * event is only valid inside the handler it was passed to.
+ */
+class IntelUEvent {
+public:
+    enum {
+        UEVENT_MAX_KEYS = 32,
+    };
+private:
+    const char *mHeader;
+    int mLength;
+    int mType;
+    int mKeyCount;
+    struct {
+        const char *key;
+        int keyLen;
+        const char *value;
+    } mKeys[UEVENT_MAX_KEYS];
+public:
+    IntelUEvent() : mHeader(0), mLength(0),
+                    mType(UEVENT_TYPE_UNKNOWN), mKeyCount(0) {}
+    bool parse(char *msg, int len);
+    const char* getHeader() const { return mHeader; }
+    int getLength() const { return mLength; }
+    int getType() const { return mType; }
+    int getKeyCount() const { return mKeyCount; }
+    const char* getValue(const char *key) const;
+    bool hasKey(const char *key) const { return getValue(key) != 0; }
+};
+
+class IntelUEventHandler {
+public:
+    virtual ~IntelUEventHandler() {}
+    virtual bool handleUEvent(const IntelUEvent& event) = 0;
+};
+
+/**
+ * Class: kernel uevent dispatcher.
+ * Opens a NETLINK_KOBJECT_UEVENT socket with a socket filter attached so
+ * that only events of the DRM device are ever delivered to user space,
+ * parses each message once and routes it to the handler registered for
+ * its event type.
+ */
+class IntelUEventDispatcher {
+public:
+    enum {
+        UEVENT_MSG_LEN = 4096,
+    };
+private:
+    int mFd;
+    bool mFiltered;
+    IntelUEventHandler *mHandlers[UEVENT_TYPE_NUM];
+    char mMessage[UEVENT_MSG_LEN];
+    // statistics
+    uint32_t mReceived;
+    uint32_t mDispatched;
+    uint32_t mDropped;
+private:
+    bool attachFilter();
+public:
+    IntelUEventDispatcher();
+    ~IntelUEventDispatcher();
+    bool open();
+    void close();
+    int getFd() const { return mFd; }
+    bool isFiltered() const { return mFiltered; }
+    bool registerHandler(int type, IntelUEventHandler *handler);
+    void unregisterHandler(int type);
+    // receive and dispatch one pending message
+    bool dispatch();
+    uint32_t getReceivedCount() const { return mReceived; }
+    uint32_t getDispatchedCount() const { return mDispatched; }
+    uint32_t getDroppedCount() const { return mDropped; }
+};
+
+#endif /* __INTEL_UEVENT_DISPATCHER_H__ */
@@ -43,10 +43,6 @@
  *
  */
 #include <poll.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <sys/queue.h>
-#include <linux/netlink.h>
 #include "IntelHWComposer.h"
 #include "IntelVsyncEventHandler.h"
 
@@ -62,38 +58,6 @@ IntelVsyncEventHandler::~IntelVsyncEventHandler()
 
 }
 
-void IntelVsyncEventHandler::handleVsyncEvent(const char *msg, int msgLen)
-{
-    uint64_t ts = 0;
-    int pipe = 0;
-    const char *vsync_msg, *pipe_msg;
-
-    if (strcmp(msg, "change@/devices/pci0000:00/0000:00:02.0/drm/card0"))
-        return;
-    msg += strlen(msg) + 1;
-
-    vsync_msg = pipe_msg = 0;
-
-    do {
-        if (!strncmp(msg, "VSYNC=", strlen("VSYNC=")))
-            vsync_msg = msg;
-        else if (!strncmp(msg, "PIPE=", strlen("PIPE=")))
-            pipe_msg = msg;
-        if (vsync_msg && pipe_msg)
-            break;
-        msg += strlen(msg) + 1;
-    } while (*msg);
-
-    // report vsync event
-    if (vsync_msg && pipe_msg) {
-        ts = strtoull(vsync_msg + strlen("VSYNC="), NULL, 0);
-        pipe = strtol(pipe_msg + strlen("PIPE="), NULL, 0);
-
-        ALOGV("%s: vsync timestamp %lld, pipe %d\n", __func__, ts, pipe);
-        mComposer->vsync(ts, pipe);
-    }
-}
-
 void IntelVsyncEventHandler::setActiveVsyncs(uint32_t activeVsyncs)
 {
     android::Mutex::Autolock _l(mLock);
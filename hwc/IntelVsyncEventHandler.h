@@ -55,9 +55,6 @@ class IntelHWComposer;
 
 class IntelVsyncEventHandler : public android::Thread
 {
-    enum {
-        UEVENT_MSG_LEN = 4096,
-    };
     enum {
 	    VSYNC_SRC_MIPI = 0,
 	    VSYNC_SRC_HDMI,
@@ -72,8 +69,6 @@ private:
     virtual bool threadLoop();
     virtual android::status_t readyToRun();
     virtual void onFirstRef();
-private:
-    virtual void handleVsyncEvent(const char *msg, int msgLen);
 private:
     mutable android::Mutex mLock;
     android::Condition mCondition;
@@ -81,8 +76,6 @@ private:
     int mDrmFd;
     mutable nsecs_t mNextFakeVSync;
     nsecs_t mRefreshPeriod;
-    char mUeventMessage[UEVENT_MSG_LEN];
-    int mUeventFd;
     uint32_t mActiveVsyncs;
 };
 
@@ -54,21 +54,27 @@ IntelWsbm::IntelWsbm(int drmFD)
 {
     ALOGV("%s: creating a new wsbm object...\n", __func__);
     mDrmFD = drmFD;
+    mInitialized = false;
 }
 
 IntelWsbm::~IntelWsbm()
 {
-    pvrWsbmTakedown();
+    if (mInitialized)
+        pvrWsbmTakedown();
 }
 
 bool IntelWsbm::initialize()
 {
+    if (mInitialized)
+        return true;
+
     int ret = pvrWsbmInitialize(mDrmFD);
     if(ret) {
         ALOGE("%s: wsbm initialize failed\n", __FUNCTION__);
         return false;
     }
 
+    mInitialized = true;
     return true;
 }
 
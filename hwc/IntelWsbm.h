@@ -55,6 +55,8 @@ class IntelWsbm
 {
 private:
     int mDrmFD;
+    // holds a reference on the process wide wsbm pool
+    bool mInitialized;
 public:
     IntelWsbm(int drmFD);
     ~IntelWsbm();
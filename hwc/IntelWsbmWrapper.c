@@ -43,6 +43,7 @@
  *
  */
 
+#include <pthread.h>
 #include <wsbm_pool.h>
 #include <wsbm_driver.h>
 #include <wsbm_manager.h>
@@ -55,6 +56,15 @@
 
 struct _WsbmBufferPool * mainPool = NULL;
 
+/*
+ * wsbm and mainPool are process wide, while every IntelWsbm object
+ * initializes and takes them down. The first object sets them up, the
+ * last one tears them down, so objects created later (e.g. during
+ * prepare) don't replace the pool under the others.
+ */
+static pthread_mutex_t wsbmLock = PTHREAD_MUTEX_INITIALIZER;
+static int wsbmUsers = 0;
+
 struct PVRWsbmValidateNode
 {
 struct  _ValidateNode base;
@@ -128,11 +138,19 @@ int pvrWsbmInitialize(int drmFD)
         return drmFD;
     }
 
+    pthread_mutex_lock(&wsbmLock);
+    if (wsbmUsers) {
+        wsbmUsers++;
+        pthread_mutex_unlock(&wsbmLock);
+        return 0;
+    }
+
     /*init wsbm*/
     ret = wsbmInit(wsbmNullThreadFuncs(), &vNodeFuncs);
     if (ret) {
         ALOGE("%s: WSBM init failed with error code %d\n",
              __func__, ret);
+        pthread_mutex_unlock(&wsbmLock);
         return ret;
     }
 
@@ -160,10 +178,13 @@ int pvrWsbmInitialize(int drmFD)
     ALOGV("%s: PVRWsbm initialized successfully. mainPool %p\n",
          __func__, mainPool);
 
+    wsbmUsers = 1;
+    pthread_mutex_unlock(&wsbmLock);
     return 0;
 
 out:
     wsbmTakedown();
+    pthread_mutex_unlock(&wsbmLock);
     return ret;
 }
 
@@ -171,8 +192,13 @@ void pvrWsbmTakedown()
 {
     ALOGV("%s: Takedown wsbm...\n", __func__);
 
-    wsbmPoolTakeDown(mainPool);
-    wsbmTakedown();
+    pthread_mutex_lock(&wsbmLock);
+    if (wsbmUsers && --wsbmUsers == 0) {
+        wsbmPoolTakeDown(mainPool);
+        mainPool = NULL;
+        wsbmTakedown();
+    }
+    pthread_mutex_unlock(&wsbmLock);
 }
 
 int pvrWsbmAllocateTTMBuffer(uint32_t size, uint32_t align, void ** buf)
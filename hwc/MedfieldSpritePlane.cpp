@@ -222,6 +222,10 @@ bool MedfieldSpritePlane::setDataBuffer(uint32_t handle, uint32_t flags, IMG_nat
                 mDataBuffers[mNextBuffer].buffer) {
             ALOGD_IF(ALLOW_SPRITE_PRINT,
                     "%s: releasing buffer %d...\n", __func__, mNextBuffer);
+            if (mDataBuffers[mNextBuffer].buffer)
+                IntelMemoryTracker::getInstance().remove(
+                    IntelMemoryTracker::MEM_GTT_MAPPING,
+                    mDataBuffers[mNextBuffer].buffer->getSize());
             mBufferManager->unmap(mDataBuffers[mNextBuffer].buffer);
             mDataBuffers[mNextBuffer].ui64Stamp = 0;
             mDataBuffers[mNextBuffer].handle = 0;
@@ -231,9 +235,12 @@ bool MedfieldSpritePlane::setDataBuffer(uint32_t handle, uint32_t flags, IMG_nat
         buffer = mBufferManager->map(handle);
         if (!buffer) {
             ALOGE("%s: failed to map handle %d\n", __func__, handle);
+            IntelMemoryTracker::getInstance().notifyPressure();
             disable();
             return false;
         }
+        IntelMemoryTracker::getInstance().add(
+            IntelMemoryTracker::MEM_GTT_MAPPING, buffer->getSize());
 
         mDataBuffers[mNextBuffer].ui64Stamp = ui64Stamp;
         mDataBuffers[mNextBuffer].handle = handle;
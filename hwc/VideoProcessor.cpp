@@ -0,0 +1,927 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Authors:
+ *    Li Zeng <li.zeng@intel.com>
+ *    Jian Sun <jianx.sun@intel.com>
+ */
+
+
+#include <cutils/log.h>
+#include <VideoProcessor.h>
+#include <IntelMemoryTracker.h>
+
+using namespace android;
+
+#define CHECK_VA_STATUS_RETURN(FUNC) \
+if (vaStatus != VA_STATUS_SUCCESS) {\
+    ALOGE(FUNC" failed. vaStatus = %#x", vaStatus);\
+    return false;\
+}
+
+#define CHECK_VA_STATUS_BREAK(FUNC) \
+if (vaStatus != VA_STATUS_SUCCESS) {\
+    ALOGE(FUNC" failed. vaStatus = %#x", vaStatus);\
+    break;\
+}
+
+// With this display value, VA will hook VED driver insead of VSP driver for buffer rotation
+#define DISPLAYVALUE  0x56454450
+
+VaVppBackend::VaVppBackend()
+    : mVaInitialized(false),
+      mVaDpy(0),
+      mVaCfg(0),
+      mVaCtx(0),
+      mVaBufFilter(0),
+      mVaBufDeinterlace(0),
+      mDisplay(DISPLAYVALUE)
+{
+}
+
+VaVppBackend::~VaVppBackend()
+{
+    close();
+}
+
+bool VaVppBackend::open()
+{
+    VAStatus vaStatus;
+    VAEntrypoint *entryPoint;
+    VAConfigAttrib attribDummy;
+    int numEntryPoints;
+    bool supportVideoProcessing = false;
+    int majorVer = 0, minorVer = 0;
+
+    // VA will hold a copy of the param pointer, so local varialbe doesn't work
+    mVaDpy = vaGetDisplay(&mDisplay);
+    if (NULL == mVaDpy) {
+        ALOGE("failed to get VADisplay");
+        return false;
+    }
+
+    vaStatus = vaInitialize(mVaDpy, &majorVer, &minorVer);
+    CHECK_VA_STATUS_RETURN("vaInitialize");
+    mVaInitialized = true;
+
+    numEntryPoints = vaMaxNumEntrypoints(mVaDpy);
+
+    if (numEntryPoints <= 0) {
+        ALOGE("numEntryPoints value is invalid");
+        return false;
+    }
+
+    entryPoint = (VAEntrypoint*)malloc(sizeof(VAEntrypoint) * numEntryPoints);
+    if (NULL == entryPoint) {
+        ALOGE("failed to malloc memory for entryPoint");
+        return false;
+    }
+
+    vaStatus = vaQueryConfigEntrypoints(mVaDpy,
+                                        VAProfileNone,
+                                        entryPoint,
+                                        &numEntryPoints);
+    if (vaStatus != VA_STATUS_SUCCESS) {
+        ALOGE("vaQueryConfigEntrypoints failed. vaStatus = %#x", vaStatus);
+        free(entryPoint);
+        return false;
+    }
+
+    for (int i = 0; i < numEntryPoints; i++)
+        if (entryPoint[i] == VAEntrypointVideoProc)
+            supportVideoProcessing = true;
+
+    free(entryPoint);
+    entryPoint = NULL;
+
+    if (!supportVideoProcessing) {
+        ALOGE("VAEntrypointVideoProc is not supported");
+        return false;
+    }
+
+    vaStatus = vaCreateConfig(mVaDpy,
+                              VAProfileNone,
+                              VAEntrypointVideoProc,
+                              &attribDummy,
+                              0,
+                              &mVaCfg);
+    CHECK_VA_STATUS_RETURN("vaCreateConfig");
+
+    return true;
+}
+
+void VaVppBackend::close()
+{
+    if (0 != mVaBufFilter)
+        vaDestroyBuffer(mVaDpy, mVaBufFilter);
+    if (0 != mVaBufDeinterlace)
+        vaDestroyBuffer(mVaDpy, mVaBufDeinterlace);
+    if (0 != mVaCfg)
+        vaDestroyConfig(mVaDpy,mVaCfg);
+    if (0 != mVaCtx)
+        vaDestroyContext(mVaDpy, mVaCtx);
+    if (mVaInitialized)
+        vaTerminate(mVaDpy);
+
+    // reset VA variable
+    mVaInitialized = false;
+    mVaDpy = 0;
+    mVaCfg = 0;
+    mVaCtx = 0;
+    mVaBufFilter = 0;
+    mVaBufDeinterlace = 0;
+}
+
+uint32_t VaVppBackend::createSurface(const VppSurface& surface)
+{
+    VAStatus vaStatus;
+    VASurfaceAttributeTPI attribTpi;
+    VASurfaceAttributeTPI *vaSurfaceAttrib = &attribTpi;
+    unsigned long buffers;
+    VASurfaceID id = 0;
+    int bufferHeight = (surface.height + 0x1f) & ~0x1f;
+    int format;
+
+    memset(vaSurfaceAttrib, 0, sizeof(*vaSurfaceAttrib));
+    vaSurfaceAttrib->count = 1;
+    vaSurfaceAttrib->width = surface.width;
+    vaSurfaceAttrib->height = surface.height;
+    vaSurfaceAttrib->pixel_format = surface.fourcc;
+    vaSurfaceAttrib->type = surface.memory == VPP_MEMORY_GRALLOC ?
+                            VAExternalMemoryAndroidGrallocBuffer :
+                            VAExternalMemoryKernelDRMBufffer;
+    vaSurfaceAttrib->tiling = surface.tiling;
+    vaSurfaceAttrib->luma_offset = 0;
+
+    if (surface.fourcc == VA_FOURCC_NV12) {
+        format = VA_RT_FORMAT_YUV420;
+        vaSurfaceAttrib->size = (surface.stride * bufferHeight * 3) / 2;
+        vaSurfaceAttrib->chroma_v_offset = surface.stride * bufferHeight;
+        vaSurfaceAttrib->luma_stride = vaSurfaceAttrib->chroma_u_stride
+                                     = vaSurfaceAttrib->chroma_v_stride
+                                     = surface.stride;
+        vaSurfaceAttrib->chroma_u_offset = vaSurfaceAttrib->chroma_v_offset;
+    } else {
+        // stride is in pixels for packed RGB
+        format = VA_RT_FORMAT_RGB32;
+        vaSurfaceAttrib->size = surface.stride * 4 * surface.height;
+        vaSurfaceAttrib->luma_stride = surface.stride * 4;
+    }
+
+    buffers = surface.handle;
+    vaSurfaceAttrib->buffers = &buffers;
+
+    vaStatus = vaCreateSurfacesWithAttribute(mVaDpy,
+                                             surface.cropWidth,
+                                             surface.cropHeight,
+                                             format,
+                                             1,
+                                             &id,
+                                             vaSurfaceAttrib);
+    if (vaStatus != VA_STATUS_SUCCESS) {
+        ALOGE("vaCreateSurfacesWithAttribute failed. vaStatus = %#x", vaStatus);
+        return 0;
+    }
+
+    return id;
+}
+
+void VaVppBackend::destroySurface(uint32_t surface)
+{
+    VASurfaceID id = surface;
+    VAStatus vaStatus;
+
+    if (!surface)
+        return;
+
+    vaStatus = vaDestroySurfaces(mVaDpy, &id, 1);
+    if (vaStatus != VA_STATUS_SUCCESS)
+        ALOGD("vaDestroySurfaces failed, vaStatus = %d", vaStatus);
+}
+
+bool VaVppBackend::createContext(uint32_t target, int width, int height,
+                                 VppCaps& caps)
+{
+    VAStatus vaStatus;
+    VASurfaceID id = target;
+
+    vaStatus = vaCreateContext(mVaDpy,
+                               mVaCfg,
+                               width,
+                               height,
+                               0,
+                               &id,
+                               1,
+                               &mVaCtx);
+    CHECK_VA_STATUS_RETURN("vaCreateContext");
+
+    return createFilters(caps);
+}
+
+bool VaVppBackend::createFilters(VppCaps& caps)
+{
+    VAStatus vaStatus;
+    VAProcFilterType filters[VAProcFilterCount];
+    unsigned int numFilters = VAProcFilterCount;
+    bool supportVideoProcFilter = false;
+    bool supportDeinterlacing = false;
+
+    memset(&caps, 0, sizeof(caps));
+
+    vaStatus = vaQueryVideoProcFilters(mVaDpy, mVaCtx, filters, &numFilters);
+    CHECK_VA_STATUS_RETURN("vaQueryVideoProcFilters");
+
+    for (unsigned int j = 0; j < numFilters; j++) {
+        if (filters[j] == VAProcFilterNone)
+            supportVideoProcFilter = true;
+        else if (filters[j] == VAProcFilterDeinterlacing)
+            supportDeinterlacing = true;
+    }
+
+    if (!supportVideoProcFilter) {
+        ALOGE("VAProcFilterNone is not supported");
+        return false;
+    }
+
+    VAProcFilterParameterBuffer filter;
+    filter.type = VAProcFilterNone;
+    filter.value = 0;
+
+    vaStatus = vaCreateBuffer(mVaDpy,
+                              mVaCtx,
+                              VAProcFilterParameterBufferType,
+                              sizeof(filter),
+                              1,
+                              &filter,
+                              &mVaBufFilter);
+    CHECK_VA_STATUS_RETURN("vaCreateBuffer");
+
+    VAProcPipelineCaps pipelineCaps;
+    unsigned int numCaps = 1;
+    vaStatus = vaQueryVideoProcPipelineCaps(mVaDpy,
+                                            mVaCtx,
+                                            &mVaBufFilter,
+                                            numCaps,
+                                            &pipelineCaps);
+    CHECK_VA_STATUS_RETURN("vaQueryVideoProcPipelineCaps");
+
+    caps.rotations = pipelineCaps.rotation_flags;
+
+    if (!supportDeinterlacing)
+        return true;
+
+    // bob is what the overlay does by itself, only take the better ones
+    VAProcFilterCapDeinterlacing deinterlaceCaps[VAProcDeinterlacingCount];
+    unsigned int numDeinterlaceCaps = VAProcDeinterlacingCount;
+    VAProcDeinterlacingType algorithm = VAProcDeinterlacingNone;
+
+    vaStatus = vaQueryVideoProcFilterCaps(mVaDpy,
+                                          mVaCtx,
+                                          VAProcFilterDeinterlacing,
+                                          deinterlaceCaps,
+                                          &numDeinterlaceCaps);
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return true;
+
+    for (unsigned int j = 0; j < numDeinterlaceCaps; j++) {
+        if (deinterlaceCaps[j].type == VAProcDeinterlacingMotionCompensated)
+            algorithm = VAProcDeinterlacingMotionCompensated;
+        else if (deinterlaceCaps[j].type == VAProcDeinterlacingMotionAdaptive &&
+                 algorithm == VAProcDeinterlacingNone)
+            algorithm = VAProcDeinterlacingMotionAdaptive;
+    }
+
+    if (algorithm == VAProcDeinterlacingNone)
+        return true;
+
+    VAProcFilterParameterBufferDeinterlacing deinterlace;
+    memset(&deinterlace, 0, sizeof(deinterlace));
+    deinterlace.type = VAProcFilterDeinterlacing;
+    deinterlace.algorithm = algorithm;
+
+    vaStatus = vaCreateBuffer(mVaDpy,
+                              mVaCtx,
+                              VAProcFilterParameterBufferType,
+                              sizeof(deinterlace),
+                              1,
+                              &deinterlace,
+                              &mVaBufDeinterlace);
+    if (vaStatus != VA_STATUS_SUCCESS) {
+        mVaBufDeinterlace = 0;
+        return true;
+    }
+
+    vaStatus = vaQueryVideoProcPipelineCaps(mVaDpy,
+                                            mVaCtx,
+                                            &mVaBufDeinterlace,
+                                            numCaps,
+                                            &pipelineCaps);
+    if (vaStatus != VA_STATUS_SUCCESS) {
+        vaDestroyBuffer(mVaDpy, mVaBufDeinterlace);
+        mVaBufDeinterlace = 0;
+        return true;
+    }
+
+    caps.deinterlace = true;
+    caps.forwardReferences = pipelineCaps.num_forward_references;
+    return true;
+}
+
+bool VaVppBackend::render(const VppPass& pass)
+{
+    VAStatus vaStatus;
+    VASurfaceID reference = pass.reference;
+    VARectangle sourceRegion, targetRegion;
+
+    if (pass.deinterlace && !mVaBufDeinterlace)
+        return false;
+
+    do {
+        vaStatus = vaBeginPicture(mVaDpy, mVaCtx, pass.target);
+        CHECK_VA_STATUS_BREAK("vaBeginPicture");
+
+        VABufferID pipelineBuf;
+        void *p;
+        VAProcPipelineParameterBuffer *pipelineParam;
+        vaStatus = vaCreateBuffer(mVaDpy,
+                                  mVaCtx,
+                                  VAProcPipelineParameterBufferType,
+                                  sizeof(*pipelineParam),
+                                  1,
+                                  NULL,
+                                  &pipelineBuf);
+        CHECK_VA_STATUS_BREAK("vaCreateBuffer");
+
+        vaStatus = vaMapBuffer(mVaDpy, pipelineBuf, &p);
+        CHECK_VA_STATUS_BREAK("vaMapBuffer");
+
+        pipelineParam = (VAProcPipelineParameterBuffer*)p;
+        memset(pipelineParam, 0, sizeof(*pipelineParam));
+        pipelineParam->surface = pass.source;
+        if (pass.sourceRegion.width) {
+            sourceRegion.x = pass.sourceRegion.x;
+            sourceRegion.y = pass.sourceRegion.y;
+            sourceRegion.width = pass.sourceRegion.width;
+            sourceRegion.height = pass.sourceRegion.height;
+            pipelineParam->surface_region = &sourceRegion;
+        }
+        if (pass.targetRegion.width) {
+            targetRegion.x = pass.targetRegion.x;
+            targetRegion.y = pass.targetRegion.y;
+            targetRegion.width = pass.targetRegion.width;
+            targetRegion.height = pass.targetRegion.height;
+            pipelineParam->output_region = &targetRegion;
+        }
+        pipelineParam->rotation_state = pass.rotation;
+        if (pass.deinterlace) {
+            pipelineParam->filters = &mVaBufDeinterlace;
+            if (reference) {
+                pipelineParam->forward_references = &reference;
+                pipelineParam->num_forward_references = 1;
+            }
+        } else
+            pipelineParam->filters = &mVaBufFilter;
+        pipelineParam->num_filters = 1;
+        vaStatus = vaUnmapBuffer(mVaDpy, pipelineBuf);
+        CHECK_VA_STATUS_BREAK("vaUnmapBuffer");
+
+        vaStatus = vaRenderPicture(mVaDpy, mVaCtx, &pipelineBuf, 1);
+        CHECK_VA_STATUS_BREAK("vaRenderPicture");
+
+        vaStatus = vaEndPicture(mVaDpy, mVaCtx);
+        CHECK_VA_STATUS_BREAK("vaEndPicture");
+
+        vaStatus = vaSyncSurface(mVaDpy, pass.target);
+        CHECK_VA_STATUS_BREAK("vaSyncSurface");
+    } while (0);
+
+    return vaStatus == VA_STATUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+VideoProcessor::VideoProcessor(IntelWsbm* wsbm, VppBackend *backend)
+    : mWsbm(wsbm),
+      mBackend(backend),
+      mStarted(false),
+      mContextReady(false),
+      mReferenceBuf(NULL),
+      mWidth(0),
+      mHeight(0),
+      mTransform(0),
+      mTargetWidth(0),
+      mTargetHeight(0),
+      mTargetStride(0),
+      mTargetIndex(0),
+      mPasses(0),
+      mFailed(0),
+      mRestarts(0),
+      mPassTime(0)
+{
+    for (int i = 0; i < MAX_SURFACE_NUM; i++) {
+        mKhandles[i] = 0;
+        mTargets[i] = 0;
+        mDrmBuf[i] = NULL;
+        mDrmBufSize[i] = 0;
+    }
+    memset(&mCaps, 0, sizeof(mCaps));
+    memset(&mReference, 0, sizeof(mReference));
+    memset(mOps, 0, sizeof(mOps));
+}
+
+VideoProcessor::~VideoProcessor()
+{
+    deinitialize();
+    delete mBackend;
+}
+
+bool VideoProcessor::initialize()
+{
+    if (NULL == mWsbm)
+        return false;
+    if (!mBackend)
+        mBackend = new VaVppBackend();
+    return mBackend != NULL;
+}
+
+void VideoProcessor::deinitialize()
+{
+    Mutex::Autolock _l(mLock);
+    stop_l();
+}
+
+uint32_t VideoProcessor::getFourcc(int format)
+{
+    switch (format) {
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12_VED:
+    case HAL_PIXEL_FORMAT_INTEL_HWC_NV12_TILE:
+        return VA_FOURCC_NV12;
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+        return VA_FOURCC_RGBA;
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+        return VA_FOURCC_BGRA;
+    default:
+        return 0;
+    }
+}
+
+int VideoProcessor::transFromHalToVa(int transform)
+{
+    if (transform == HAL_TRANSFORM_ROT_90)
+        return VA_ROTATION_90;
+    if (transform == HAL_TRANSFORM_ROT_180)
+        return VA_ROTATION_180;
+    if (transform == HAL_TRANSFORM_ROT_270)
+        return VA_ROTATION_270;
+    return 0;
+}
+
+int VideoProcessor::getStride(bool isTarget, int width)
+{
+    int stride = 0;
+    if (width <= 512)
+        stride = 512;
+    else if (width <= 1024)
+        stride = 1024;
+    else if (width <= 1280) {
+        stride = 1280;
+        if (isTarget)
+            stride = 2048;
+    } else if (width <= 2048)
+        stride = 2048;
+    else if (width <= 4096)
+        stride = 4096;
+    else
+        stride = (width + 0x3f) & ~0x3f;
+    return stride;
+}
+
+uint32_t VideoProcessor::createWsbmBuffer(int width, int height, void **buf,
+                                          uint32_t *bufSize)
+{
+    int size = width * height * 3 / 2; // YUV420 NV12 format
+    int allignment = 16 * 2048; // tiling row stride aligned
+    bool ret = mWsbm->allocateTTMBuffer(size, allignment, buf);
+
+    if (ret == false) {
+        ALOGE("failed to allocate TTM buffer");
+        IntelMemoryTracker::getInstance().notifyPressure();
+        return 0;
+    }
+
+    *bufSize = size;
+    IntelMemoryTracker::getInstance().add(IntelMemoryTracker::MEM_ROTATION, size);
+    return mWsbm->getKBufHandle(*buf);
+}
+
+uint32_t VideoProcessor::getBufferBytes() const
+{
+    Mutex::Autolock _l(mLock);
+    uint32_t bytes = 0;
+
+    for (int i = 0; i < MAX_SURFACE_NUM; i++)
+        bytes += mDrmBufSize[i];
+    return bytes;
+}
+
+bool VideoProcessor::canDeinterlace() const
+{
+    Mutex::Autolock _l(mLock);
+    // known once the first pass created the context
+    return mContextReady && mCaps.deinterlace;
+}
+
+bool VideoProcessor::createTarget_l(int width, int height)
+{
+    VppSurface target;
+    int bufferHeight = (height + 0x1f) & ~0x1f;
+    int stride = getStride(true, width);
+
+    uint32_t khandle = createWsbmBuffer(stride, bufferHeight,
+                                        &mDrmBuf[mTargetIndex],
+                                        &mDrmBufSize[mTargetIndex]);
+    if (khandle == 0) {
+        ALOGE("failed to create buffer by wsbm");
+        return false;
+    }
+    mKhandles[mTargetIndex] = khandle;
+
+    target.memory = VPP_MEMORY_KERNEL;
+    target.handle = khandle;
+    target.fourcc = VA_FOURCC_NV12;
+    target.width = width;
+    target.height = height;
+    target.stride = stride;
+    target.tiling = 0;
+    target.cropWidth = width;
+    target.cropHeight = height;
+
+    mTargets[mTargetIndex] = mBackend->createSurface(target);
+    if (!mTargets[mTargetIndex]) {
+        ALOGE("failed to create target surface with attribute");
+        return false;
+    }
+
+    mTargetWidth = width;
+    mTargetHeight = height;
+    mTargetStride = stride;
+    return true;
+}
+
+void VideoProcessor::freeTargets_l()
+{
+    bool ret;
+
+    for (int i = 0; i < MAX_SURFACE_NUM; i++) {
+        if (NULL != mDrmBuf[i]) {
+            ret = mWsbm->destroyTTMBuffer(mDrmBuf[i]);
+            if (!ret)
+                ALOGD("failed to free TTMBuffer");
+            IntelMemoryTracker::getInstance().remove(
+                IntelMemoryTracker::MEM_ROTATION, mDrmBufSize[i]);
+            mDrmBuf[i] = NULL;
+            mDrmBufSize[i] = 0;
+        }
+        mKhandles[i] = 0;
+    }
+
+    // remove wsbm buffer ref from VA
+    for (int j = 0; j < MAX_SURFACE_NUM; j++) {
+        mBackend->destroySurface(mTargets[j]);
+        mTargets[j] = 0;
+    }
+}
+
+void VideoProcessor::setReference_l(const VppSurface& source)
+{
+    void *buf = NULL;
+
+    if (mReferenceBuf && mReference.handle == source.handle)
+        return;
+
+    // only kernel buffers can be referenced here, others go without
+    if (source.memory != VPP_MEMORY_KERNEL ||
+        !mWsbm->wrapTTMBuffer(source.handle, &buf)) {
+        clearReference_l();
+        return;
+    }
+
+    clearReference_l();
+    mReference = source;
+    mReferenceBuf = buf;
+}
+
+void VideoProcessor::clearReference_l()
+{
+    if (mReferenceBuf)
+        mWsbm->unreferenceTTMBuffer(mReferenceBuf);
+    mReferenceBuf = NULL;
+    memset(&mReference, 0, sizeof(mReference));
+}
+
+bool VideoProcessor::start_l()
+{
+    if (mStarted)
+        return true;
+
+    if (!mBackend->open()) {
+        ALOGE("failed to open VPP backend");
+        mBackend->close();
+        return false;
+    }
+
+    mStarted = true;
+    return true;
+}
+
+bool VideoProcessor::createContext_l(uint32_t target, const VppRequest& request)
+{
+    if (mContextReady)
+        return true;
+
+    if (!mBackend->createContext(target,
+                                 request.source.width,
+                                 request.source.height,
+                                 mCaps)) {
+        ALOGE("failed to create VPP context");
+        return false;
+    }
+
+    mContextReady = true;
+    return true;
+}
+
+void VideoProcessor::stop_l()
+{
+    if (!mBackend)
+        return;
+
+    freeTargets_l();
+    clearReference_l();
+
+    if (mStarted)
+        mBackend->close();
+
+    mStarted = false;
+    mContextReady = false;
+    memset(&mCaps, 0, sizeof(mCaps));
+
+    mWidth = 0;
+    mHeight = 0;
+    mTargetWidth = 0;
+    mTargetHeight = 0;
+    mTargetStride = 0;
+    mTargetIndex = 0;
+}
+
+bool VideoProcessor::isConfigChanged_l(const VppRequest& request) const
+{
+    // check pool config
+    if (request.source.width == mWidth &&
+        request.source.height == mHeight &&
+        request.transform == mTransform &&
+        (!mTargetWidth ||
+         (request.width == mTargetWidth && request.height == mTargetHeight))) {
+        return false;
+    }
+
+    return true;
+}
+
+bool VideoProcessor::render_l(const VppRequest& request, uint32_t target,
+                              int targetWidth, int targetHeight, uint32_t& ops)
+{
+    VppPass pass;
+    nsecs_t start = systemTime();
+    bool ret = false;
+
+    memset(&pass, 0, sizeof(pass));
+    pass.target = target;
+    ops = 0;
+
+    pass.rotation = transFromHalToVa(request.transform);
+    if (pass.rotation) {
+        if (!(mCaps.rotations & (1 << pass.rotation))) {
+            ALOGE("VA_ROTATION_xxx: 0x%08x is not supported by the filter",
+                  pass.rotation);
+            return false;
+        }
+        ops |= VPP_OP_ROTATE;
+    }
+
+    if (request.crop.width) {
+        int width = request.crop.width;
+        int height = request.crop.height;
+
+        if (pass.rotation == VA_ROTATION_90 || pass.rotation == VA_ROTATION_270) {
+            width = request.crop.height;
+            height = request.crop.width;
+        }
+
+        pass.sourceRegion = request.crop;
+        pass.targetRegion.width = targetWidth;
+        pass.targetRegion.height = targetHeight;
+        if (width != targetWidth || height != targetHeight)
+            ops |= VPP_OP_SCALE;
+    }
+
+    if (request.source.fourcc != VA_FOURCC_NV12)
+        ops |= VPP_OP_CSC;
+
+    pass.source = mBackend->createSurface(request.source);
+    if (!pass.source) {
+        ALOGE("failed to create source surface with attribute");
+        return false;
+    }
+
+    if (request.deinterlace && mCaps.deinterlace) {
+        // the previous frame of the same stream helps motion adaptive ones
+        if (mReferenceBuf &&
+            mReference.handle != request.source.handle &&
+            mReference.width == request.source.width &&
+            mReference.height == request.source.height)
+            pass.reference = mBackend->createSurface(mReference);
+        pass.deinterlace = true;
+        ops |= VPP_OP_DEINTERLACE;
+    }
+
+    ret = mBackend->render(pass);
+
+    mBackend->destroySurface(pass.reference);
+    mBackend->destroySurface(pass.source);
+
+    // the decoder may recycle the source, it's held till the next pass
+    if (pass.deinterlace && mCaps.forwardReferences > 0)
+        setReference_l(request.source);
+
+    if (!ret)
+        return false;
+
+    mPasses++;
+    mPassTime += systemTime() - start;
+    if (ops & VPP_OP_SCALE)
+        mOps[STAT_SCALE]++;
+    if (ops & VPP_OP_ROTATE)
+        mOps[STAT_ROTATE]++;
+    if (ops & VPP_OP_CSC)
+        mOps[STAT_CSC]++;
+    if (ops & VPP_OP_DEINTERLACE)
+        mOps[STAT_DEINTERLACE]++;
+    return true;
+}
+
+bool VideoProcessor::process(const VppRequest& request, VppOutput& output)
+{
+    Mutex::Autolock _l(mLock);
+    bool ret = false;
+    uint32_t ops = 0;
+
+    if (!mBackend || !request.source.fourcc ||
+        request.source.width == 0 || request.source.height == 0 ||
+        request.width <= 0 || request.height <= 0) {
+        ALOGE("VPP request is not correct");
+        return false;
+    }
+
+    do {
+        if (isConfigChanged_l(request)) {
+            if (mStarted) {
+                ALOGD("VPP config changes, will re-start VA");
+                stop_l(); // need to re-initialize VA for new pool config
+                mRestarts++;
+            }
+
+            mTransform = request.transform;
+            mWidth = request.source.width;
+            mHeight = request.source.height;
+        }
+
+        if (!start_l())
+            break;
+
+        // start to create next target surface
+        if (!mTargets[mTargetIndex] &&
+            !createTarget_l(request.width, request.height))
+            break;
+
+        if (!createContext_l(mTargets[0] ? mTargets[0] : mTargets[mTargetIndex],
+                             request))
+            break;
+
+        ret = render_l(request, mTargets[mTargetIndex],
+                       request.width, request.height, ops);
+    } while (0);
+
+    if (!ret) {
+        mFailed++;
+        stop_l();
+        return false; // To not block in HWC, just abort instead of re-try
+    }
+
+    output.ops = ops;
+    output.khandle = mKhandles[mTargetIndex];
+    output.width = mTargetWidth;
+    output.height = mTargetHeight;
+    output.stride = mTargetStride;
+
+    mTargetIndex++;
+    if (mTargetIndex >= MAX_SURFACE_NUM)
+        mTargetIndex = 0;
+
+    return true;
+}
+
+bool VideoProcessor::process(const VppRequest& request, const VppSurface& target)
+{
+    Mutex::Autolock _l(mLock);
+    uint32_t surface;
+    uint32_t ops = 0;
+    bool ret = false;
+
+    if (!mBackend || !request.source.fourcc || !target.handle ||
+        request.source.width == 0 || request.source.height == 0) {
+        ALOGE("VPP request is not correct");
+        return false;
+    }
+
+    if (!start_l()) {
+        mFailed++;
+        return false;
+    }
+
+    surface = mBackend->createSurface(target);
+    if (!surface) {
+        ALOGE("failed to create target surface with attribute");
+        mFailed++;
+        return false;
+    }
+
+    // the context keeps referring to the surface it was created on, so
+    // that is a pooled one rather than a buffer the caller may free
+    if (!mContextReady &&
+        ((!mTargets[0] &&
+          !createTarget_l(target.cropWidth, target.cropHeight)) ||
+         !createContext_l(mTargets[0], request))) {
+        mBackend->destroySurface(surface);
+        mFailed++;
+        stop_l();
+        return false;
+    }
+
+    ret = render_l(request, surface, target.cropWidth, target.cropHeight, ops);
+
+    mBackend->destroySurface(surface);
+
+    if (!ret)
+        mFailed++;
+    return ret;
+}
+
+bool VideoProcessor::dump(char *buff, int buff_len, int *cur_len)
+{
+    Mutex::Autolock _l(mLock);
+    uint32_t bytes = 0;
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    for (int i = 0; i < MAX_SURFACE_NUM; i++)
+        bytes += mDrmBufSize[i];
+
+    dumpPrintf("-------------Video processing -------------\n");
+    dumpPrintf("  + %s, pool %dx%d stride %d, %u bytes, deinterlace %s\n",
+               mContextReady ? "started" : "stopped",
+               mTargetWidth, mTargetHeight, mTargetStride, bytes,
+               mCaps.deinterlace ? "yes" : "no");
+    dumpPrintf("  + passes %u (scale %u, rotate %u, csc %u, deinterlace %u)\n",
+               mPasses, mOps[STAT_SCALE], mOps[STAT_ROTATE],
+               mOps[STAT_CSC], mOps[STAT_DEINTERLACE]);
+    dumpPrintf("  + failed %u, restarts %u, avg pass %lld us\n",
+               mFailed, mRestarts,
+               mPasses ? mPassTime / mPasses / 1000 : 0LL);
+
+    *cur_len = mDumpLen;
+    return true;
+}
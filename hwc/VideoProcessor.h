@@ -0,0 +1,261 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Authors:
+ *    Li Zeng <li.zeng@intel.com>
+ *    Jian Sun <jianx.sun@intel.com>
+ */
+
+
+#ifndef __VIDEO_PROCESSOR_H__
+#define __VIDEO_PROCESSOR_H__
+
+#include <va/va.h>
+#include <sys/time.h>
+#include <va/va_tpi.h>
+#include <va/va_vpp.h>
+#include <IntelWsbm.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <va/va_android.h>
+#include <IntelBufferManager.h>
+#include <IntelHWComposerDump.h>
+
+#define Display unsigned int
+typedef void* VADisplay;
+typedef int VAStatus;
+
+/**
+ * Video processing (VPP)
+ * Scaling, rotation, RGB to NV12 conversion and deinterlacing of one
+ * layer are chained into a single pass of the VA video processing
+ * entrypoint, so layers the display planes can't take directly don't
+ * have to go through the 3D core. The pass either renders into one of
+ * the NV12 TTM buffers the engine pools for the overlay, or into a
+ * buffer owned by the caller.
+ */
+
+// operations done by a pass
+enum {
+    VPP_OP_SCALE        = 0x1,
+    VPP_OP_ROTATE       = 0x2,
+    VPP_OP_CSC          = 0x4,
+    VPP_OP_DEINTERLACE  = 0x8,
+};
+
+// how a surface's memory is referenced
+enum {
+    VPP_MEMORY_KERNEL = 0,      // TTM buffer by kernel handle
+    VPP_MEMORY_GRALLOC,         // gralloc buffer handle
+};
+
+typedef struct {
+    int memory;
+    uint32_t handle;
+    uint32_t fourcc;
+    // buffer size
+    int width;
+    int height;
+    int stride;
+    int tiling;
+    // size of the VA surface, the decoded area of video buffers
+    int cropWidth;
+    int cropHeight;
+} VppSurface;
+
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} VppRect;
+
+typedef struct {
+    VppSurface source;
+    // region of the source surface to process
+    VppRect crop;
+    // HAL_TRANSFORM_* applied on the way
+    int transform;
+    // output size after rotation. With an empty crop the visible source
+    // is rotated into the whole output without scaling
+    int width;
+    int height;
+    bool deinterlace;
+} VppRequest;
+
+typedef struct {
+    uint32_t ops;
+    uint32_t khandle;
+    int width;
+    int height;
+    int stride;
+} VppOutput;
+
+typedef struct {
+    // bit (1 << VA_ROTATION_*) for each supported rotation
+    uint32_t rotations;
+    bool deinterlace;
+    int forwardReferences;
+} VppCaps;
+
+// one pass from a backend surface to another, empty regions mean the
+// whole surface
+typedef struct {
+    uint32_t source;
+    uint32_t reference;
+    uint32_t target;
+    VppRect sourceRegion;
+    VppRect targetRegion;
+    int rotation;
+    bool deinterlace;
+} VppPass;
+
+/**
+ * Backend running the passes. Surfaces are ids only valid for the
+ * backend, 0 means none. The VA backend drives the hardware, others
+ * can stand in for it when the engine runs without one.
+ */
+class VppBackend {
+public:
+    virtual ~VppBackend() {}
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual uint32_t createSurface(const VppSurface& surface) = 0;
+    virtual void destroySurface(uint32_t surface) = 0;
+    // create the context on the first target, fills in @caps
+    virtual bool createContext(uint32_t target, int width, int height,
+                               VppCaps& caps) = 0;
+    virtual bool render(const VppPass& pass) = 0;
+};
+
+class VaVppBackend : public VppBackend {
+public:
+    VaVppBackend();
+    virtual ~VaVppBackend();
+
+    virtual bool open();
+    virtual void close();
+    virtual uint32_t createSurface(const VppSurface& surface);
+    virtual void destroySurface(uint32_t surface);
+    virtual bool createContext(uint32_t target, int width, int height,
+                               VppCaps& caps);
+    virtual bool render(const VppPass& pass);
+
+private:
+    bool createFilters(VppCaps& caps);
+
+private:
+    bool mVaInitialized;
+    VADisplay mVaDpy;
+    VAConfigID mVaCfg;
+    VAContextID mVaCtx;
+    VABufferID mVaBufFilter;
+    VABufferID mVaBufDeinterlace;
+    Display mDisplay;
+};
+
+class VideoProcessor : public IntelHWComposerDump {
+public:
+    // takes the ownership of @backend, a VA backend is used if NULL
+    VideoProcessor(IntelWsbm* wsbm, VppBackend *backend = 0);
+    ~VideoProcessor();
+
+    bool initialize();
+    void deinitialize();
+    // process into the next pooled NV12 buffer
+    bool process(const VppRequest& request, VppOutput& output);
+    // process into a buffer of the caller
+    bool process(const VppRequest& request, const VppSurface& target);
+    // can the deinterlacing be folded into a pass
+    bool canDeinterlace() const;
+    // bytes held by the pooled buffers
+    uint32_t getBufferBytes() const;
+    // VA fourcc of a HAL pixel format, 0 if not supported
+    static uint32_t getFourcc(int format);
+    // stride of the TTM buffers VA processes
+    static int getStride(bool isTarget, int width);
+    bool dump(char *buff, int buff_len, int *cur_len);
+
+private:
+    bool start_l();
+    bool createContext_l(uint32_t target, const VppRequest& request);
+    void stop_l();
+    bool isConfigChanged_l(const VppRequest& request) const;
+    bool createTarget_l(int width, int height);
+    void freeTargets_l();
+    void setReference_l(const VppSurface& source);
+    void clearReference_l();
+    bool render_l(const VppRequest& request, uint32_t target,
+                  int targetWidth, int targetHeight, uint32_t& ops);
+    uint32_t createWsbmBuffer(int width, int height, void **buf,
+                              uint32_t *bufSize);
+    static int transFromHalToVa(int transform);
+
+private:
+    enum {
+        MAX_SURFACE_NUM = 4
+    };
+    enum {
+        STAT_SCALE = 0,
+        STAT_ROTATE,
+        STAT_CSC,
+        STAT_DEINTERLACE,
+        STAT_NUM,
+    };
+
+    mutable android::Mutex mLock;
+    IntelWsbm* mWsbm;
+    VppBackend *mBackend;
+    bool mStarted;
+    // created on the first pooled target, which lives as long as it
+    bool mContextReady;
+    VppCaps mCaps;
+
+    // pool config
+    int mWidth;
+    int mHeight;
+    int mTransform;
+    int mTargetWidth;
+    int mTargetHeight;
+    int mTargetStride;
+
+    int mTargetIndex;
+    int mKhandles[MAX_SURFACE_NUM];
+    uint32_t mTargets[MAX_SURFACE_NUM];
+    void *mDrmBuf[MAX_SURFACE_NUM];
+    uint32_t mDrmBufSize[MAX_SURFACE_NUM];
+
+    // previous interlaced source, the reference of motion adaptive passes.
+    // A kernel reference keeps its buffer alive while it's held here
+    VppSurface mReference;
+    void *mReferenceBuf;
+
+    // statistics
+    uint32_t mPasses;
+    uint32_t mOps[STAT_NUM];
+    uint32_t mFailed;
+    uint32_t mRestarts;
+    nsecs_t mPassTime;
+};
+
+#endif /*__VIDEO_PROCESSOR_H__*/
@@ -0,0 +1,780 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <cutils/log.h>
+#include <cutils/native_handle.h>
+#include <utils/Errors.h>
+#include <ui/GraphicBufferMapper.h>
+#include <sync/sync.h>
+#include <sw_sync.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <IntelBufferManager.h>
+#include <IntelHWComposerCfg.h>
+#include <IntelMemoryTracker.h>
+#include <WidiCscPipeline.h>
+#include <VideoProcessor.h>
+
+using namespace android;
+
+static uint32_t getBufferBytes(const sp<GraphicBuffer>& buffer)
+{
+    // NV12
+    return buffer->getStride() * buffer->getHeight() * 3 / 2;
+}
+
+// the gralloc handle of a layer is only valid while SurfaceFlinger holds the
+// buffer, the conversion runs later and needs its own reference
+static sp<GraphicBuffer> referenceSource(buffer_handle_t handle)
+{
+    IMG_native_handle_t *src = (IMG_native_handle_t*)handle;
+    native_handle_t *clone;
+    int i;
+
+    clone = native_handle_create(handle->numFds, handle->numInts);
+    if (!clone)
+        return NULL;
+
+    for (i = 0; i < handle->numFds; i++) {
+        clone->data[i] = dup(handle->data[i]);
+        if (clone->data[i] < 0)
+            goto dup_err;
+    }
+    memcpy(clone->data + handle->numFds, handle->data + handle->numFds,
+           handle->numInts * sizeof(int));
+
+    if (GraphicBufferMapper::get().registerBuffer(clone) != NO_ERROR)
+        goto dup_err;
+
+    // the GraphicBuffer unregisters and closes the clone
+    return new GraphicBuffer(src->iWidth, src->iHeight, src->iFormat,
+                             src->usage, src->iStride, clone, true);
+dup_err:
+    clone->numFds = i;
+    native_handle_close(clone);
+    native_handle_delete(clone);
+    return NULL;
+}
+
+static void releaseBufferBytes(const List< sp<GraphicBuffer> >& buffers)
+{
+    uint32_t bytes = 0;
+
+    for (List< sp<GraphicBuffer> >::const_iterator it = buffers.begin();
+         it != buffers.end(); ++it)
+        bytes += getBufferBytes(*it);
+    IntelMemoryTracker::getInstance().remove(IntelMemoryTracker::MEM_WIDI_CSC,
+                                             bytes);
+}
+
+// RGB to BT.601 limited range YUV, 8 bit fixed point
+static inline uint8_t rgbToY(int r, int g, int b)
+{
+    return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uint8_t rgbToU(int r, int g, int b)
+{
+    return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline uint8_t rgbToV(int r, int g, int b)
+{
+    return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+static inline void unpackPixel(uint32_t p, bool bgr, int& r, int& g, int& b)
+{
+    r = bgr ? (p >> 16) & 0xff : p & 0xff;
+    g = (p >> 8) & 0xff;
+    b = bgr ? p & 0xff : (p >> 16) & 0xff;
+}
+
+#ifdef __SSE2__
+// luma of four 32bit pixels, as 32bit values without the +16 offset
+static inline __m128i lumaSum4(__m128i p, __m128i coeff)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), coeff);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), coeff);
+    // each pixel left two partial sums, add them up
+    __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi),
+                                 _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi),
+                                _MM_SHUFFLE(3, 1, 3, 1));
+    __m128i sum = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+}
+#endif
+
+static void convertLumaRow(const uint32_t *src, uint8_t *dst, int width, bool bgr)
+{
+    int x = 0;
+#ifdef __SSE2__
+    // per channel weights of two pixels in memory order, alpha ignored
+    const __m128i coeff = bgr ?
+        _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0) :
+        _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+    const __m128i offset = _mm_set1_epi16(16);
+
+    for (; x + 8 <= width; x += 8) {
+        __m128i y0 = lumaSum4(_mm_loadu_si128((const __m128i*)(src + x)), coeff);
+        __m128i y1 = lumaSum4(_mm_loadu_si128((const __m128i*)(src + x + 4)), coeff);
+        __m128i y = _mm_add_epi16(_mm_packs_epi32(y0, y1), offset);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(y, y));
+    }
+#endif
+    for (; x < width; x++) {
+        int r, g, b;
+        unpackPixel(src[x], bgr, r, g, b);
+        dst[x] = rgbToY(r, g, b);
+    }
+}
+
+// interleaved UV of a row, averaged over horizontal pixel pairs. An odd
+// width leaves the last pixel alone, it is converted without a partner.
+static void convertChromaRow(const uint32_t *src, uint8_t *dst, int width, bool bgr)
+{
+    int r, g, b;
+    int x = 0;
+
+    for (; x + 1 < width; x += 2) {
+        int r0, g0, b0, r1, g1, b1;
+        unpackPixel(src[x], bgr, r0, g0, b0);
+        unpackPixel(src[x + 1], bgr, r1, g1, b1);
+        r = (r0 + r1 + 1) >> 1;
+        g = (g0 + g1 + 1) >> 1;
+        b = (b0 + b1 + 1) >> 1;
+        dst[x] = rgbToU(r, g, b);
+        dst[x + 1] = rgbToV(r, g, b);
+    }
+    if (x < width) {
+        unpackPixel(src[x], bgr, r, g, b);
+        dst[x] = rgbToU(r, g, b);
+        dst[x + 1] = rgbToV(r, g, b);
+    }
+}
+
+WidiCscPipeline::HeldCscBuffer::HeldCscBuffer(const sp<WidiCscPipeline>& pipeline,
+                                              const sp<GraphicBuffer>& gb,
+                                              uint32_t generation)
+    : pipeline(pipeline),
+      buffer(gb),
+      generation(generation),
+      sentTime(0)
+{
+}
+
+WidiCscPipeline::HeldCscBuffer::~HeldCscBuffer()
+{
+    nsecs_t holdTime = sentTime ? systemTime() - sentTime : 0;
+    pipeline->returnBuffer(buffer, generation, holdTime);
+}
+
+WidiCscPipeline::WidiCscPipeline(IMG_gralloc_module_public_t *module,
+                                 WidiCscListener *listener)
+    : mGrallocModule(module),
+      mListener(listener),
+      mVideoProcessor(NULL),
+      mVppFailed(false),
+      mBusy(false),
+      mTimeline(-1),
+      mSequence(0),
+      mRetired(0),
+      mWidth(0),
+      mHeight(0),
+      mRefresh(60),
+      mGeneration(0),
+      mAllocated(0),
+      mPoolTarget(CSC_POOL_MIN + CSC_QUEUE_DEPTH),
+      mHoldTime(0),
+      mRowPixels(0),
+      mColumnMap(0),
+      mRowWidth(0),
+      mQueued(0),
+      mDroppedQueueFull(0),
+      mDroppedNoBuffer(0),
+      mDroppedFlush(0),
+      mFailed(0),
+      mFenceTimeouts(0),
+      mMaxQueued(0)
+{
+    memset(mConverted, 0, sizeof(mConverted));
+
+    mTimeline = sw_sync_timeline_create();
+    if (mTimeline < 0)
+        ALOGW("%s: no sync timeline, frames are converted synchronously",
+              __func__);
+}
+
+WidiCscPipeline::~WidiCscPipeline()
+{
+    // destroying the timeline signals the fences still out
+    if (mTimeline >= 0)
+        close(mTimeline);
+    releaseBufferBytes(mAvailable);
+    free(mRowPixels);
+    free(mColumnMap);
+}
+
+void WidiCscPipeline::setVideoProcessor(VideoProcessor *vpp)
+{
+    Mutex::Autolock _l(mLock);
+    mVideoProcessor = vpp;
+}
+
+void WidiCscPipeline::setOutputSize(uint32_t width, uint32_t height, uint32_t refresh)
+{
+    Mutex::Autolock _l(mLock);
+
+    if (refresh != mRefresh) {
+        mRefresh = refresh;
+        updatePoolTarget_l();
+    }
+
+    if (width == mWidth && height == mHeight)
+        return;
+
+    ALOGI("CSC buffers changing from %dx%d to %dx%d",
+          mWidth, mHeight, width, height);
+
+    // buffers still held by the encoder are freed when they come back
+    releaseBufferBytes(mAvailable);
+    mAvailable.clear();
+    mAllocated = 0;
+    mGeneration++;
+    mVppFailed = false;
+    mWidth = width;
+    mHeight = height;
+}
+
+sp<GraphicBuffer> WidiCscPipeline::dequeueBuffer()
+{
+    Mutex::Autolock _l(mLock);
+    sp<GraphicBuffer> buffer;
+
+    if (!mAvailable.empty()) {
+        buffer = *mAvailable.begin();
+        mAvailable.erase(mAvailable.begin());
+        return buffer;
+    }
+
+    if (mAllocated >= mPoolTarget) {
+        ALOGD_IF(ALLOW_WIDI_PRINT, "%s: out of CSC buffers, dropping frame", __func__);
+        mDroppedNoBuffer++;
+        return NULL;
+    }
+
+    buffer = new GraphicBuffer(mWidth, mHeight,
+                               OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar,
+                               GRALLOC_USAGE_HW_VIDEO_ENCODER |
+                               GRALLOC_USAGE_HW_RENDER |
+                               GRALLOC_USAGE_SW_WRITE_OFTEN);
+    if (buffer == NULL || buffer->initCheck() != NO_ERROR) {
+        ALOGE("%s: failed to allocate %dx%d CSC buffer", __func__, mWidth, mHeight);
+        IntelMemoryTracker::getInstance().notifyPressure();
+        return NULL;
+    }
+
+    IntelMemoryTracker::getInstance().add(IntelMemoryTracker::MEM_WIDI_CSC,
+                                          getBufferBytes(buffer));
+    mAllocated++;
+    return buffer;
+}
+
+void WidiCscPipeline::cancelBuffer(const sp<GraphicBuffer>& buffer)
+{
+    returnBuffer(buffer, mGeneration, 0);
+}
+
+uint32_t WidiCscPipeline::trim()
+{
+    Mutex::Autolock _l(mLock);
+    uint32_t freed = 0;
+
+    // buffers held by the encoder stay, the pool refills on demand
+    while (!mAvailable.empty()) {
+        freed += getBufferBytes(*mAvailable.begin());
+        mAvailable.erase(mAvailable.begin());
+        mAllocated--;
+    }
+
+    IntelMemoryTracker::getInstance().remove(IntelMemoryTracker::MEM_WIDI_CSC,
+                                             freed);
+    return freed;
+}
+
+void WidiCscPipeline::returnBuffer(const sp<GraphicBuffer>& buffer,
+                                   uint32_t generation, nsecs_t holdTime)
+{
+    Mutex::Autolock _l(mLock);
+
+    // allocated for an old output size
+    if (generation != mGeneration) {
+        IntelMemoryTracker::getInstance().remove(
+            IntelMemoryTracker::MEM_WIDI_CSC, getBufferBytes(buffer));
+        return;
+    }
+
+    if (holdTime > 0) {
+        mHoldTime = mHoldTime ? (mHoldTime * 7 + holdTime) / 8 : holdTime;
+        updatePoolTarget_l();
+    }
+
+    // shrink the pool when the encoder got faster
+    if (mAllocated > mPoolTarget) {
+        IntelMemoryTracker::getInstance().remove(
+            IntelMemoryTracker::MEM_WIDI_CSC, getBufferBytes(buffer));
+        mAllocated--;
+        return;
+    }
+
+    mAvailable.push_back(buffer);
+}
+
+void WidiCscPipeline::updatePoolTarget_l()
+{
+    nsecs_t period = 1000000000LL / (mRefresh ? mRefresh : 60);
+
+    // frames held by the encoder plus the frames waiting for conversion
+    int target = (int)((mHoldTime + period - 1) / period) + CSC_QUEUE_DEPTH;
+    if (target < CSC_POOL_MIN)
+        target = CSC_POOL_MIN;
+    else if (target > CSC_POOL_MAX)
+        target = CSC_POOL_MAX;
+
+    if (target != mPoolTarget) {
+        ALOGD_IF(ALLOW_WIDI_PRINT, "%s: %d CSC buffers, hold time %lld us",
+                 __func__, target, mHoldTime / 1000);
+        mPoolTarget = target;
+    }
+}
+
+void WidiCscPipeline::retireJobs_l(uint32_t seq)
+{
+    if ((int32_t)(seq - mRetired) <= 0)
+        return;
+
+    // jobs retire in queue order, dropped ones are covered by later ones
+    if (mTimeline >= 0)
+        sw_sync_timeline_inc(mTimeline, seq - mRetired);
+    mRetired = seq;
+    mIdleCondition.broadcast();
+}
+
+void WidiCscPipeline::dropJobs(const List<Job>& jobs)
+{
+    for (List<Job>::const_iterator it = jobs.begin(); it != jobs.end(); ++it) {
+        if (it->acquireFence >= 0)
+            close(it->acquireFence);
+    }
+}
+
+int WidiCscPipeline::queueFrame(buffer_handle_t source, int acquireFence,
+                                const hwc_rect_t& crop,
+                                const sp<GraphicBuffer>& buffer,
+                                const sp<IFrameListener>& frameListener,
+                                int64_t renderTimestamp)
+{
+    // released after unlocking, the held buffer goes back to the pool
+    List<Job> dropped;
+    Job job;
+    int releaseFence = -1;
+
+    job.source = referenceSource(source);
+    if (job.source == NULL) {
+        ALOGE("%s: failed to reference the source", __func__);
+        if (acquireFence >= 0)
+            close(acquireFence);
+        cancelBuffer(buffer);
+        return -1;
+    }
+    job.acquireFence = acquireFence;
+    job.srcX = crop.left;
+    job.srcY = crop.top;
+    job.srcWidth = crop.right - crop.left;
+    job.srcHeight = crop.bottom - crop.top;
+    job.frameListener = frameListener;
+    job.renderTimestamp = renderTimestamp;
+
+    { // scope for lock
+        Mutex::Autolock _l(mLock);
+        job.dest = new HeldCscBuffer(this, buffer, mGeneration);
+        job.seq = ++mSequence;
+
+        // a newer frame makes the oldest waiting one useless
+        if (mQueue.size() >= CSC_QUEUE_DEPTH) {
+            dropped.push_back(*mQueue.begin());
+            mQueue.erase(mQueue.begin());
+            mDroppedQueueFull++;
+        }
+
+        mQueue.push_back(job);
+        mQueued++;
+        if (mQueue.size() > mMaxQueued)
+            mMaxQueued = mQueue.size();
+        mCondition.signal();
+
+        if (mTimeline >= 0) {
+            releaseFence = sw_sync_fence_create(mTimeline, "widi-csc", job.seq);
+            if (releaseFence < 0)
+                ALOGW("%s: failed to create release fence", __func__);
+        }
+
+        // SurfaceFlinger can't be told when the source is free, keep it
+        if (releaseFence < 0) {
+            while ((int32_t)(job.seq - mRetired) > 0)
+                mIdleCondition.wait(mLock);
+        }
+    }
+
+    dropJobs(dropped);
+    return releaseFence;
+}
+
+void WidiCscPipeline::flush()
+{
+    List<Job> dropped;
+
+    { // scope for lock
+        Mutex::Autolock _l(mLock);
+        dropped = mQueue;
+        mQueue.clear();
+        mDroppedFlush += dropped.size();
+
+        while (mBusy)
+            mIdleCondition.wait(mLock);
+        retireJobs_l(mSequence);
+    }
+
+    dropJobs(dropped);
+}
+
+void WidiCscPipeline::stop()
+{
+    List<Job> dropped;
+
+    requestExit();
+    {
+        Mutex::Autolock _l(mLock);
+        mCondition.signal();
+    }
+    requestExitAndWait();
+
+    { // scope for lock
+        Mutex::Autolock _l(mLock);
+        dropped = mQueue;
+        mQueue.clear();
+        retireJobs_l(mSequence);
+    }
+
+    dropJobs(dropped);
+}
+
+int WidiCscPipeline::selectBackend(const Job& job, bool useVpp) const
+{
+    // video processing scales and converts without the 3D core
+    if (useVpp)
+        return CSC_BACKEND_VPP;
+
+    // the gralloc blitter only does 1:1 copies
+    if (job.srcWidth == (int)job.dest->buffer->getWidth() &&
+        job.srcHeight == (int)job.dest->buffer->getHeight())
+        return CSC_BACKEND_BLIT;
+
+    return CSC_BACKEND_CPU;
+}
+
+bool WidiCscPipeline::blitFrame(const Job& job)
+{
+    int err = mGrallocModule->Blit2(mGrallocModule,
+                                    job.source->handle, job.dest->buffer->handle,
+                                    job.srcWidth, job.srcHeight,
+                                    job.srcX, job.srcY);
+    if (err) {
+        ALOGE("%s: Blit2 failed, err = %d", __func__, err);
+        return false;
+    }
+
+    return true;
+}
+
+bool WidiCscPipeline::processFrame(const Job& job)
+{
+    IMG_native_handle_t *src = (IMG_native_handle_t*)job.source->handle;
+    sp<GraphicBuffer> dest = job.dest->buffer;
+    IMG_native_handle_t *dst = (IMG_native_handle_t*)dest->handle;
+    VppRequest request;
+    VppSurface target;
+
+    memset(&request, 0, sizeof(request));
+    request.source.memory = VPP_MEMORY_GRALLOC;
+    request.source.handle = (uint32_t)job.source->handle;
+    request.source.fourcc = VideoProcessor::getFourcc(src->iFormat);
+    request.source.width = src->iWidth;
+    request.source.height = src->iHeight;
+    request.source.stride = src->iStride;
+    request.source.cropWidth = src->iWidth;
+    request.source.cropHeight = src->iHeight;
+    request.crop.x = job.srcX;
+    request.crop.y = job.srcY;
+    request.crop.width = job.srcWidth;
+    request.crop.height = job.srcHeight;
+    request.width = dest->getWidth();
+    request.height = dest->getHeight();
+
+    if (!request.source.fourcc) {
+        ALOGE("%s: can't process format 0x%x", __func__, src->iFormat);
+        return false;
+    }
+
+    // same packed NV12 layout the CPU backend writes
+    memset(&target, 0, sizeof(target));
+    target.memory = VPP_MEMORY_GRALLOC;
+    target.handle = (uint32_t)dest->handle;
+    target.fourcc = VA_FOURCC_NV12;
+    target.width = dst->iWidth;
+    target.height = dst->iHeight;
+    target.stride = dst->iStride;
+    target.cropWidth = dest->getWidth();
+    target.cropHeight = dest->getHeight();
+
+    return mVideoProcessor->process(request, target);
+}
+
+bool WidiCscPipeline::ensureRowBuffers(int width)
+{
+    if (width <= mRowWidth)
+        return true;
+
+    free(mRowPixels);
+    free(mColumnMap);
+    mRowPixels = (uint32_t*)malloc(width * sizeof(uint32_t));
+    mColumnMap = (int*)malloc(width * sizeof(int));
+    if (!mRowPixels || !mColumnMap) {
+        ALOGE("%s: failed to allocate row buffers", __func__);
+        free(mRowPixels);
+        free(mColumnMap);
+        mRowPixels = 0;
+        mColumnMap = 0;
+        mRowWidth = 0;
+        return false;
+    }
+
+    mRowWidth = width;
+    return true;
+}
+
+bool WidiCscPipeline::convertFrame(const Job& job)
+{
+    IMG_native_handle_t *src = (IMG_native_handle_t*)job.source->handle;
+    sp<GraphicBuffer> dest = job.dest->buffer;
+    IMG_native_handle_t *dst = (IMG_native_handle_t*)dest->handle;
+    gralloc_module_t *gralloc = (gralloc_module_t*)mGrallocModule;
+    int dstWidth = dest->getWidth();
+    int dstHeight = dest->getHeight();
+    void *srcAddr = 0;
+    void *dstAddr = 0;
+    bool ret = false;
+    bool bgr;
+
+    switch (src->iFormat) {
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+        bgr = false;
+        break;
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+        bgr = true;
+        break;
+    default:
+        ALOGE("%s: can't scale format 0x%x", __func__, src->iFormat);
+        return false;
+    }
+
+    if (job.srcWidth <= 0 || job.srcHeight <= 0 ||
+        job.srcX < 0 || job.srcY < 0 ||
+        job.srcX + job.srcWidth > src->iWidth ||
+        job.srcY + job.srcHeight > src->iHeight) {
+        ALOGE("%s: invalid crop %d,%d %dx%d", __func__,
+              job.srcX, job.srcY, job.srcWidth, job.srcHeight);
+        return false;
+    }
+
+    if (!ensureRowBuffers(dstWidth))
+        return false;
+
+    if (gralloc->lock(gralloc, job.source->handle, GRALLOC_USAGE_SW_READ_OFTEN,
+                      job.srcX, job.srcY, job.srcWidth, job.srcHeight, &srcAddr)) {
+        ALOGE("%s: failed to lock source", __func__);
+        return false;
+    }
+
+    if (dest->lock(GRALLOC_USAGE_SW_WRITE_OFTEN, &dstAddr) != NO_ERROR) {
+        ALOGE("%s: failed to lock CSC buffer", __func__);
+        goto src_err;
+    }
+
+    {
+        const uint32_t *srcPixels = (const uint32_t*)srcAddr;
+        // packed NV12, the UV plane follows the full height luma plane
+        uint8_t *luma = (uint8_t*)dstAddr;
+        uint8_t *chroma = luma + dst->iStride * dst->iHeight;
+
+        // nearest neighbour sampling at the destination pixel centers
+        for (int x = 0; x < dstWidth; x++)
+            mColumnMap[x] = job.srcX +
+                (int)((int64_t)(2 * x + 1) * job.srcWidth / (2 * dstWidth));
+
+        for (int y = 0; y < dstHeight; y++) {
+            int sy = job.srcY +
+                (int)((int64_t)(2 * y + 1) * job.srcHeight / (2 * dstHeight));
+            const uint32_t *srcRow = srcPixels + sy * src->iStride;
+
+            for (int x = 0; x < dstWidth; x++)
+                mRowPixels[x] = srcRow[mColumnMap[x]];
+
+            convertLumaRow(mRowPixels, luma + y * dst->iStride, dstWidth, bgr);
+            if (!(y & 1))
+                convertChromaRow(mRowPixels, chroma + (y >> 1) * dst->iStride,
+                                 dstWidth, bgr);
+        }
+    }
+
+    dest->unlock();
+    ret = true;
+src_err:
+    gralloc->unlock(gralloc, job.source->handle);
+    return ret;
+}
+
+bool WidiCscPipeline::threadLoop()
+{
+    Job job;
+    int backend;
+    bool useVpp;
+    bool vppFailed = false;
+    bool fenceTimeout = false;
+    bool ret = false;
+
+    { // scope for lock
+        Mutex::Autolock _l(mLock);
+        while (mQueue.empty()) {
+            if (exitPending())
+                return false;
+            mCondition.wait(mLock);
+        }
+        job = *mQueue.begin();
+        mQueue.erase(mQueue.begin());
+        mBusy = true;
+        useVpp = mVideoProcessor && !mVppFailed;
+    }
+
+    // the source may still be rendered
+    if (job.acquireFence >= 0) {
+        if (sync_wait(job.acquireFence, CSC_FENCE_TIMEOUT_MS) < 0) {
+            ALOGW("%s: source not ready, dropping frame", __func__);
+            fenceTimeout = true;
+        }
+        close(job.acquireFence);
+        job.acquireFence = -1;
+    }
+
+    backend = selectBackend(job, useVpp);
+    if (!fenceTimeout && backend == CSC_BACKEND_VPP) {
+        ret = processFrame(job);
+        if (!ret) {
+            ALOGW("%s: video processing failed, fall back", __func__);
+            vppFailed = true;
+            backend = selectBackend(job, false);
+        }
+    }
+    if (!ret && !fenceTimeout) {
+        if (backend == CSC_BACKEND_BLIT)
+            ret = blitFrame(job);
+        else
+            ret = convertFrame(job);
+    }
+
+    // the source is not read anymore, SurfaceFlinger may reuse it
+    job.source = NULL;
+
+    if (ret) {
+        job.dest->sentTime = systemTime();
+        mListener->onCscFrameReady((uint32_t)job.dest->buffer->handle,
+                                   job.dest, job.frameListener,
+                                   job.renderTimestamp);
+    }
+
+    { // scope for lock
+        Mutex::Autolock _l(mLock);
+        if (vppFailed)
+            mVppFailed = true;
+        if (ret)
+            mConverted[backend]++;
+        else if (fenceTimeout)
+            mFenceTimeouts++;
+        else
+            mFailed++;
+        mBusy = false;
+        retireJobs_l(job.seq);
+        mIdleCondition.broadcast();
+    }
+
+    return true;
+}
+
+bool WidiCscPipeline::dump(char *buff, int buff_len, int *cur_len)
+{
+    Mutex::Autolock _l(mLock);
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------WiDi CSC pipeline -------------\n");
+    dumpPrintf("  + output %dx%d@%d, buffers %d/%d (%d free), hold %lld us\n",
+               mWidth, mHeight, mRefresh, mAllocated, mPoolTarget,
+               (int)mAvailable.size(), mHoldTime / 1000);
+    dumpPrintf("  + queued %u (max depth %u), blit %u, cpu %u, vpp %u%s, failed %u\n",
+               mQueued, mMaxQueued, mConverted[CSC_BACKEND_BLIT],
+               mConverted[CSC_BACKEND_CPU], mConverted[CSC_BACKEND_VPP],
+               mVppFailed ? " (off)" : "", mFailed);
+    dumpPrintf("  + dropped: queue full %u, no buffer %u, flushed %u, fence timeout %u\n",
+               mDroppedQueueFull, mDroppedNoBuffer, mDroppedFlush,
+               mFenceTimeouts);
+
+    *cur_len = mDumpLen;
+    return true;
+}
+
+status_t WidiCscPipeline::readyToRun()
+{
+    return NO_ERROR;
+}
+
+void WidiCscPipeline::onFirstRef()
+{
+    run("WiDi CSC", PRIORITY_URGENT_DISPLAY);
+}
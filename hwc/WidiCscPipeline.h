@@ -0,0 +1,197 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __WIDI_CSC_PIPELINE_H__
+#define __WIDI_CSC_PIPELINE_H__
+
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <ui/GraphicBuffer.h>
+#include <hardware/hwcomposer.h>
+#include <hal_public.h>
+
+#include "IntelHWComposerDump.h"
+#include "IFrameServer.h"
+
+using namespace android;
+
+class VideoProcessor;
+
+/**
+ * Receives the frames converted by the CSC pipeline, on the CSC thread.
+ * heldBuffer must stay referenced until the encoder returns the frame.
+ */
+class WidiCscListener {
+public:
+    virtual ~WidiCscListener() {}
+    virtual void onCscFrameReady(uint32_t handle,
+                                 const android::sp<android::RefBase>& heldBuffer,
+                                 const android::sp<IFrameListener>& frameListener,
+                                 int64_t renderTimestamp) = 0;
+};
+
+/**
+ * Class: WiDi colorspace conversion pipeline
+ * Converts RGB frames to the NV12 buffers consumed by the WiDi encoder on
+ * its own thread, so the composition thread never waits for a blit.
+ * 1:1 frames are copied by the gralloc blitter, scaled frames go through a
+ * CPU scaler/converter. Frames waiting for the thread are kept in a short
+ * queue where the oldest frame is dropped when a newer one comes in.
+ * The NV12 buffer pool grows with the time the encoder holds the frames.
+ */
+class WidiCscPipeline : public android::Thread,
+                        public IntelHWComposerDump
+{
+public:
+    enum {
+        CSC_BACKEND_BLIT = 0,
+        CSC_BACKEND_CPU,
+        CSC_BACKEND_VPP,
+        CSC_BACKEND_NUM,
+    };
+    enum {
+        CSC_QUEUE_DEPTH = 2,
+        CSC_POOL_MIN = 2,
+        CSC_POOL_MAX = 8,
+        CSC_FENCE_TIMEOUT_MS = 1000,
+    };
+private:
+    // NV12 buffer owned by the encoder, goes back to the pool on release
+    struct HeldCscBuffer : public android::RefBase {
+        HeldCscBuffer(const android::sp<WidiCscPipeline>& pipeline,
+                      const android::sp<GraphicBuffer>& gb,
+                      uint32_t generation);
+        virtual ~HeldCscBuffer();
+        android::sp<WidiCscPipeline> pipeline;
+        android::sp<GraphicBuffer> buffer;
+        uint32_t generation;
+        nsecs_t sentTime;
+    };
+    struct Job {
+        // our own reference, SurfaceFlinger may drop the layer meanwhile
+        android::sp<GraphicBuffer> source;
+        // rendering of the source, closed once the job is retired
+        int acquireFence;
+        // release fences up to this point signal once the job is retired
+        uint32_t seq;
+        int srcX;
+        int srcY;
+        int srcWidth;
+        int srcHeight;
+        android::sp<HeldCscBuffer> dest;
+        android::sp<IFrameListener> frameListener;
+        int64_t renderTimestamp;
+    };
+public:
+    WidiCscPipeline(IMG_gralloc_module_public_t *module,
+                    WidiCscListener *listener);
+    virtual ~WidiCscPipeline();
+
+    // @vpp scales and converts in one pass from the next frame on, it has
+    // to outlive the pipeline
+    void setVideoProcessor(VideoProcessor *vpp);
+
+    // size of the NV12 frames and refresh rate of the sink
+    void setOutputSize(uint32_t width, uint32_t height, uint32_t refresh);
+    // free NV12 buffer, NULL if the encoder holds all of them
+    android::sp<GraphicBuffer> dequeueBuffer();
+    // give back a dequeued buffer which is not going to be queued
+    void cancelBuffer(const android::sp<GraphicBuffer>& buffer);
+    // convert the cropped source into a dequeued buffer once @acquireFence
+    // signals, the fence is closed by the pipeline. Returns a fence which
+    // signals when the source is not read anymore, -1 if the conversion
+    // already finished.
+    int queueFrame(buffer_handle_t source, int acquireFence,
+                   const hwc_rect_t& crop,
+                   const android::sp<GraphicBuffer>& buffer,
+                   const android::sp<IFrameListener>& frameListener,
+                   int64_t renderTimestamp);
+    // drop the queued frames and wait for the current conversion
+    void flush();
+    // free the pooled buffers the encoder doesn't hold, returns bytes
+    uint32_t trim();
+    void stop();
+    bool dump(char *buff, int buff_len, int *cur_len);
+private:
+    virtual bool threadLoop();
+    virtual android::status_t readyToRun();
+    virtual void onFirstRef();
+private:
+    void returnBuffer(const android::sp<GraphicBuffer>& buffer,
+                      uint32_t generation, nsecs_t holdTime);
+    void updatePoolTarget_l();
+    void retireJobs_l(uint32_t seq);
+    static void dropJobs(const android::List<Job>& jobs);
+    int selectBackend(const Job& job, bool useVpp) const;
+    bool blitFrame(const Job& job);
+    bool convertFrame(const Job& job);
+    bool processFrame(const Job& job);
+    bool ensureRowBuffers(int width);
+private:
+    IMG_gralloc_module_public_t *mGrallocModule;
+    WidiCscListener *mListener;
+    VideoProcessor *mVideoProcessor;
+    // video processing failed, not tried again till the output changes
+    bool mVppFailed;
+
+    mutable android::Mutex mLock;
+    android::Condition mCondition;
+    android::Condition mIdleCondition;
+    android::List<Job> mQueue;
+    bool mBusy;
+
+    // release fences of the sources, one point per queued frame. Without
+    // sync support queueFrame() waits for the conversion instead.
+    int mTimeline;
+    uint32_t mSequence;
+    uint32_t mRetired;
+
+    // buffer pool
+    android::List< android::sp<GraphicBuffer> > mAvailable;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mRefresh;
+    uint32_t mGeneration;
+    int mAllocated;
+    int mPoolTarget;
+    nsecs_t mHoldTime;
+
+    // CPU backend scratch, only used by the CSC thread
+    uint32_t *mRowPixels;
+    int *mColumnMap;
+    int mRowWidth;
+
+    // statistics
+    uint32_t mQueued;
+    uint32_t mConverted[CSC_BACKEND_NUM];
+    uint32_t mDroppedQueueFull;
+    uint32_t mDroppedNoBuffer;
+    uint32_t mDroppedFlush;
+    uint32_t mFailed;
+    uint32_t mFenceTimeouts;
+    uint32_t mMaxQueued;
+};
+
+#endif /*__WIDI_CSC_PIPELINE_H__*/
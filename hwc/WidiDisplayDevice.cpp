@@ -35,6 +35,7 @@
 #include <IntelDisplayDevice.h>
 #include <WidiDisplayDevice.h>
 #include <IntelHWComposerCfg.h>
+#include <IntelMemoryTracker.h>
 
 #ifndef LOGE
  #define LOGE ALOGE
@@ -46,28 +47,17 @@ WidiDisplayDevice::CachedBuffer::CachedBuffer(IntelBufferManager *gbm, IntelDisp
     : grallocBufferManager(gbm),
       displayBuffer(buffer)
 {
+    IntelMemoryTracker::getInstance().add(IntelMemoryTracker::MEM_GTT_MAPPING,
+                                          displayBuffer->getSize());
 }
 
 WidiDisplayDevice::CachedBuffer::~CachedBuffer()
 {
+    IntelMemoryTracker::getInstance().remove(IntelMemoryTracker::MEM_GTT_MAPPING,
+                                             displayBuffer->getSize());
     grallocBufferManager->unmap(displayBuffer);
 }
 
-WidiDisplayDevice::HeldCscBuffer::HeldCscBuffer(const sp<WidiDisplayDevice>& wdd, const sp<GraphicBuffer>& gb)
-    : wdd(wdd),
-      buffer(gb)
-{
-}
-
-WidiDisplayDevice::HeldCscBuffer::~HeldCscBuffer()
-{
-    Mutex::Autolock _l(wdd->mCscLock);
-    if (buffer->getWidth() == wdd->mCscWidth && buffer->getHeight() == wdd->mCscHeight)
-        wdd->mAvailableCscBuffers.push_back(buffer);
-    else
-        wdd->mCscBuffersToCreate++;
-}
-
 WidiDisplayDevice::HeldDecoderBuffer::HeldDecoderBuffer(const android::sp<CachedBuffer>& cachedBuffer)
     : cachedBuffer(cachedBuffer)
 {
@@ -92,7 +82,8 @@ WidiDisplayDevice::WidiDisplayDevice(IntelBufferManager *bm,
                                      mExtLastKhandle(0),
                                      mExtLastTimestamp(0),
                                      mGrallocModule(0),
-                                     mGrallocDevice(0)
+                                     mGrallocDevice(0),
+                                     mCscVppTried(false)
 {
     ALOGD_IF(ALLOW_WIDI_PRINT, "%s", __func__);
 
@@ -127,10 +118,6 @@ WidiDisplayDevice::WidiDisplayDevice(IntelBufferManager *bm,
     mCurrentConfig = mNextConfig;
     mLayerToSend = 0;
 
-    mCscBuffersToCreate = 4;
-    mCscWidth = 0;
-    mCscHeight = 0;
-
     memset(&mLastInputFrameInfo, 0, sizeof(mLastInputFrameInfo));
     memset(&mLastOutputFrameInfo, 0, sizeof(mLastOutputFrameInfo));
 
@@ -147,6 +134,14 @@ WidiDisplayDevice::WidiDisplayDevice(IntelBufferManager *bm,
         return;
     }
 
+    // video processing is set up with the first converted frame
+    mCscPipeline = new WidiCscPipeline(mGrallocModule, this);
+
+    IntelMemoryTracker::getInstance().registerTrimmable(
+        IntelMemoryTracker::MEM_WIDI_CSC, this);
+    IntelMemoryTracker::getInstance().registerTrimmable(
+        IntelMemoryTracker::MEM_GTT_MAPPING, this);
+
     mInitialized = true;
 
     {
@@ -168,6 +163,38 @@ init_err:
 WidiDisplayDevice::~WidiDisplayDevice()
 {
     ALOGI("%s", __func__);
+
+    IntelMemoryTracker::getInstance().unregisterTrimmable(this);
+
+    if (mCscPipeline != NULL)
+        mCscPipeline->stop();
+}
+
+uint32_t WidiDisplayDevice::trimMemory(int category)
+{
+    uint32_t freed = 0;
+
+    switch (category) {
+    case IntelMemoryTracker::MEM_WIDI_CSC:
+        if (mCscPipeline != NULL)
+            freed = mCscPipeline->trim();
+        break;
+    case IntelMemoryTracker::MEM_GTT_MAPPING:
+        // mappings still held by the WiDi stack stay until they come back
+        for (size_t i = mMappedBufferCache.size(); i-- > 0; ) {
+            sp<CachedBuffer> cachedBuffer = mMappedBufferCache.valueAt(i);
+            if (cachedBuffer->getStrongCount() > 2)
+                continue;
+            freed += cachedBuffer->displayBuffer->getSize();
+            mMappedBufferCache.removeItemsAt(i);
+        }
+        break;
+    default:
+        freed = IntelDisplayDevice::trimMemory(category);
+        break;
+    }
+
+    return freed;
 }
 
 sp<WidiDisplayDevice::CachedBuffer> WidiDisplayDevice::getMappedBuffer(uint32_t handle)
@@ -217,14 +244,10 @@ status_t WidiDisplayDevice::stop(bool isConnected) {
 
 status_t WidiDisplayDevice::notifyBufferReturned(int khandle) {
     ALOGD_IF(ALLOW_WIDI_PRINT, "%s khandle=%x", __func__, (uint32_t)khandle);
-    Mutex::Autolock _l(mHeldBuffersLock);
-    ssize_t index = mHeldBuffers.indexOfKey(khandle);
-    if (index == NAME_NOT_FOUND) {
+    // the buffer itself is released on the next prepare
+    if (!mHeldBuffers.release((uint32_t)khandle)) {
         LOGE("Couldn't find returned khandle %x", khandle);
     }
-    else {
-        mHeldBuffers.removeItemsAt(index, 1);
-    }
     return NO_ERROR;
 }
 
@@ -235,6 +258,21 @@ status_t WidiDisplayDevice::setResolution(const FrameProcessingPolicy& policy, s
     return NO_ERROR;
 }
 
+void WidiDisplayDevice::onCscFrameReady(uint32_t handle,
+                                        const sp<RefBase>& heldBuffer,
+                                        const sp<IFrameListener>& frameListener,
+                                        int64_t renderTimestamp)
+{
+    int slot = mHeldBuffers.add(handle, heldBuffer);
+    if (slot < 0) {
+        ALOGW("%s: too many frames held by the encoder, dropping frame", __func__);
+        return;
+    }
+    status_t result = frameListener->onFrameReady((int32_t)handle, HWC_HANDLE_TYPE_GRALLOC, renderTimestamp, -1);
+    if (result != OK)
+        mHeldBuffers.cancel(slot);
+}
+
 bool WidiDisplayDevice::prepare(hwc_display_contents_1_t *list)
 {
     ALOGD_IF(ALLOW_WIDI_PRINT, "%s", __func__);
@@ -246,6 +284,15 @@ bool WidiDisplayDevice::prepare(hwc_display_contents_1_t *list)
 
     mRenderTimestamp = systemTime();
 
+    // release the frames the encoder returned since the last prepare
+    mHeldBuffers.drain();
+
+    // the last frame was prepared but never committed
+    if (mCscBuffer != NULL) {
+        mCscPipeline->cancelBuffer(mCscBuffer);
+        mCscBuffer = NULL;
+    }
+
     {
         Mutex::Autolock _l(mConfigLock);
         mCurrentConfig = mNextConfig;
@@ -301,6 +348,7 @@ bool WidiDisplayDevice::prepare(hwc_display_contents_1_t *list)
             mExtLastKhandle = 0;
 
             mMappedBufferCache.clear();
+            mRateController.reset();
             mLastInputFrameInfo = frameInfo;
             mLastOutputFrameInfo = frameInfo;
         }
@@ -313,13 +361,23 @@ bool WidiDisplayDevice::prepare(hwc_display_contents_1_t *list)
         layer.compositionType = HWC_OVERLAY;
     }
 
-    sendToWidi(streamingLayer);
+    // unchanged content is only sent as an occasional refresh frame
+    if (mCurrentConfig.forceNotify)
+        mRateController.reset();
+    if (mRateController.checkFrame(list, mRenderTimestamp) == WidiRateController::FRAME_SKIP)
+        return true;
+
+    // a frame that didn't make it must not be skipped next time
+    if (!sendToWidi(streamingLayer))
+        mRateController.reset();
 
     return true;
 }
 
 bool WidiDisplayDevice::commit(hwc_display_contents_1_t *list,
                                     buffer_handle_t *bh,
+                                    int* acquireFenceFd,
+                                    int** releaseFenceFd,
                                     int &numBuffers)
 {
     ALOGD_IF(ALLOW_WIDI_PRINT, "%s", __func__);
@@ -329,17 +387,32 @@ bool WidiDisplayDevice::commit(hwc_display_contents_1_t *list,
         return false;
     }
 
+    if (mCscBuffer == NULL || !list || mLayerToSend >= list->numHwLayers)
+        return true;
+
+    // the CSC thread reads the layer after this returns, it waits for the
+    // rendering and hands SurfaceFlinger a fence for its own read
+    hwc_layer_1_t& layer = list->hwLayers[mLayerToSend];
+    int acquireFence = -1;
+    if (layer.acquireFenceFd >= 0)
+        acquireFence = dup(layer.acquireFenceFd);
+
+    layer.releaseFenceFd = mCscPipeline->queueFrame(layer.handle, acquireFence,
+                                                    mCscCrop, mCscBuffer,
+                                                    mCurrentConfig.frameListener,
+                                                    mRenderTimestamp);
+    mCscBuffer = NULL;
     return true;
 }
 
-void WidiDisplayDevice::sendToWidi(const hwc_layer_1_t& layer)
+bool WidiDisplayDevice::sendToWidi(const hwc_layer_1_t& layer)
 {
     IMG_native_handle_t* grallocHandle =
         (IMG_native_handle_t*)layer.handle;
 
     if (grallocHandle == NULL) {
         ALOGE("%s: layer has no handle set", __func__);
-        return;
+        return false;
     }
 
     uint32_t handle = (uint32_t)grallocHandle;
@@ -347,13 +420,14 @@ void WidiDisplayDevice::sendToWidi(const hwc_layer_1_t& layer)
     int64_t mediaTimestamp = -1;
 
     sp<RefBase> heldBuffer;
+    sp<GraphicBuffer> cscBuffer;
 
     FrameInfo inputFrameInfo;
     memset(&inputFrameInfo, 0, sizeof(inputFrameInfo));
     inputFrameInfo.frameType = HWC_FRAMETYPE_FRAME_BUFFER;
     inputFrameInfo.contentWidth = (uint32_t)(layer.sourceCropf.right - layer.sourceCropf.left);
     inputFrameInfo.contentHeight = (uint32_t)(layer.sourceCropf.bottom - layer.sourceCropf.top);
-    inputFrameInfo.contentFrameRateN = 60;
+    inputFrameInfo.contentFrameRateN = mRateController.getContentFrameRate();
     inputFrameInfo.contentFrameRateD = 1;
 
     FrameInfo outputFrameInfo;
@@ -367,11 +441,11 @@ void WidiDisplayDevice::sendToWidi(const hwc_layer_1_t& layer)
         intel_gralloc_payload_t *p;
         if ((payloadBuffer = getMappedBuffer(grallocHandle->fd[1])) == NULL) {
             ALOGE("%s: Failed to map display buffer", __func__);
-            return;
+            return false;
         }
         if ((p = (intel_gralloc_payload_t*)payloadBuffer->displayBuffer->getCpuAddr()) == NULL) {
             ALOGE("%s: Got null payload from display buffer", __func__);
-            return;
+            return false;
         }
         heldBuffer = new HeldDecoderBuffer(payloadBuffer);
 
@@ -439,7 +513,7 @@ void WidiDisplayDevice::sendToWidi(const hwc_layer_1_t& layer)
         }
         else {
             ALOGE("Couldn't get any khandle");
-            return;
+            return false;
         }
 
         if (outputFrameInfo.bufferFormat == 0 ||
@@ -450,65 +524,36 @@ void WidiDisplayDevice::sendToWidi(const hwc_layer_1_t& layer)
             outputFrameInfo.chromaUStride <= 0 || outputFrameInfo.chromaVStride <= 0)
         {
             ALOGI("Payload cleared or inconsistent info, not sending frame");
-            return;
+            return false;
         }
     }
-    else {
-        sp<GraphicBuffer> destBuffer;
-        {
-            Mutex::Autolock _l(mCscLock);
-            // Blit only support 1:1 so until we get upscale/downsacle ,source & destination will be of same size.
-            if ((layer.compositionType == HWC_FRAMEBUFFER_TARGET) &&
-                (mCurrentConfig.policy.scaledWidth != inputFrameInfo.contentWidth) ||
-                (mCurrentConfig.policy.scaledHeight != inputFrameInfo.contentHeight)) {
-                  return;
-                //mCurrentConfig.policy.scaledWidth = inputFrameInfo.contentWidth;
-                //mCurrentConfig.policy.scaledHeight = inputFrameInfo.contentHeight;
-            }
-
-            if (mCscWidth != mCurrentConfig.policy.scaledWidth || mCscHeight != mCurrentConfig.policy.scaledHeight) {
-                ALOGI("CSC buffers changing from %dx%d to %dx%d",
-                      mCscWidth, mCscHeight, mCurrentConfig.policy.scaledWidth, mCurrentConfig.policy.scaledHeight);
-                mAvailableCscBuffers.clear();
-                mCscWidth = mCurrentConfig.policy.scaledWidth;
-                mCscHeight = mCurrentConfig.policy.scaledHeight;
-                mCscBuffersToCreate = 4;
-            }
+    else if (mCurrentConfig.policy.scaledWidth != 0 && mCurrentConfig.policy.scaledHeight != 0) {
+        // no video processing if VA can't be set up, the blitter and
+        // the CPU still convert
+        if (!mCscVppTried) {
+            mCscVppTried = true;
+            if (initializeVideoProcessor())
+                mCscPipeline->setVideoProcessor(mVideoProcessor);
+        }
 
-            if (mAvailableCscBuffers.empty()) {
-                if (mCscBuffersToCreate <= 0) {
-                    ALOGW("%s: Out of CSC buffers, dropping frame", __func__);
-                    return;
-                }
-                mCscBuffersToCreate--;
-                sp<GraphicBuffer> graphicBuffer =
-                    new GraphicBuffer(mCurrentConfig.policy.scaledWidth, mCurrentConfig.policy.scaledHeight,
-                                      OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar,
-                                      GRALLOC_USAGE_HW_VIDEO_ENCODER | GRALLOC_USAGE_HW_RENDER);
-                mAvailableCscBuffers.push_back(graphicBuffer);
+        mCscPipeline->setOutputSize(mCurrentConfig.policy.scaledWidth,
+                                    mCurrentConfig.policy.scaledHeight,
+                                    mCurrentConfig.policy.refresh);
+        cscBuffer = mCscPipeline->dequeueBuffer();
+        if (cscBuffer == NULL)
+            return false;
 
-            }
-            destBuffer = *mAvailableCscBuffers.begin();
-            mAvailableCscBuffers.erase(mAvailableCscBuffers.begin());
-        }
-        heldBuffer = new HeldCscBuffer(this, destBuffer);
-        if (mGrallocModule->Blit2(mGrallocModule,
-                (buffer_handle_t)handle, destBuffer->handle,
-                mCurrentConfig.policy.scaledWidth, mCurrentConfig.policy.scaledHeight, 0, 0))
-        {
-            ALOGE("%s: Blit2 failed", __func__);
-            return;
-        }
-        grallocHandle = (IMG_native_handle_t*)destBuffer->handle;
+        // the frame itself is converted and sent by the CSC thread
+        grallocHandle = (IMG_native_handle_t*)cscBuffer->handle;
         handle = (uint32_t)grallocHandle;
 
         outputFrameInfo.contentWidth = mCurrentConfig.policy.scaledWidth;
         outputFrameInfo.contentHeight = mCurrentConfig.policy.scaledHeight;
         outputFrameInfo.bufferWidth = grallocHandle->iWidth;
         outputFrameInfo.bufferHeight = grallocHandle->iHeight;
-        outputFrameInfo.lumaUStride = grallocHandle->iWidth;
-        outputFrameInfo.chromaUStride = grallocHandle->iWidth;
-        outputFrameInfo.chromaVStride = grallocHandle->iWidth;
+        outputFrameInfo.lumaUStride = grallocHandle->iStride;
+        outputFrameInfo.chromaUStride = grallocHandle->iStride;
+        outputFrameInfo.chromaVStride = grallocHandle->iStride;
     }
 
     if (mCurrentConfig.forceNotify ||
@@ -520,11 +565,15 @@ void WidiDisplayDevice::sendToWidi(const hwc_layer_1_t& layer)
     }
 
     if (mCurrentConfig.policy.scaledWidth == 0 || mCurrentConfig.policy.scaledHeight == 0)
-        return;
+        return false;
 
     if (mCurrentConfig.forceNotify ||
         memcmp(&outputFrameInfo, &mLastOutputFrameInfo, sizeof(outputFrameInfo)) != 0)
     {
+        // frames converted for the old output must not follow the new info
+        if (cscBuffer != NULL)
+            mCscPipeline->flush();
+
         mCurrentConfig.typeChangeListener->bufferInfoChanged(outputFrameInfo);
         mLastOutputFrameInfo = outputFrameInfo;
 
@@ -535,22 +584,35 @@ void WidiDisplayDevice::sendToWidi(const hwc_layer_1_t& layer)
     if (handleType == HWC_HANDLE_TYPE_KBUF &&
         handle == mExtLastKhandle && mediaTimestamp == mExtLastTimestamp)
     {
-        return;
+        return false;
     }
 
-    {
-        Mutex::Autolock _l(mHeldBuffersLock);
-        mHeldBuffers.add(handle, heldBuffer);
+    if (cscBuffer != NULL) {
+        mCscCrop.left = (int)layer.sourceCropf.left;
+        mCscCrop.top = (int)layer.sourceCropf.top;
+        mCscCrop.right = (int)layer.sourceCropf.right;
+        mCscCrop.bottom = (int)layer.sourceCropf.bottom;
+        mCscBuffer = cscBuffer;
+        mRateController.frameSent(true, mRenderTimestamp);
+        return true;
+    }
+
+    int slot = mHeldBuffers.add(handle, heldBuffer);
+    if (slot < 0) {
+        ALOGW("%s: too many frames held by the encoder, dropping frame", __func__);
+        return false;
     }
     status_t result = mCurrentConfig.frameListener->onFrameReady((int32_t)handle, handleType, mRenderTimestamp, mediaTimestamp);
     if (result != OK) {
-        Mutex::Autolock _l(mHeldBuffersLock);
-        mHeldBuffers.removeItem(handle);
+        mHeldBuffers.cancel(slot);
+        return false;
     }
     if (handleType == HWC_HANDLE_TYPE_KBUF) {
         mExtLastKhandle = handle;
         mExtLastTimestamp = mediaTimestamp;
     }
+    mRateController.frameSent(false, mRenderTimestamp);
+    return true;
 }
 
 bool WidiDisplayDevice::dump(char *buff,
@@ -562,6 +624,13 @@ bool WidiDisplayDevice::dump(char *buff,
     mDumpBuflen = buff_len;
     mDumpLen = (int)(*cur_len);
 
+    mRateController.dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    mHeldBuffers.dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    if (mCscPipeline != NULL)
+        mCscPipeline->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+    if (mVideoProcessor)
+        mVideoProcessor->dump(mDumpBuf, mDumpBuflen, &mDumpLen);
+
     *cur_len = mDumpLen;
     return ret;
 }
@@ -36,10 +36,14 @@
 
 #include "IntelDisplayDevice.h"
 #include "IFrameServer.h"
+#include "WidiCscPipeline.h"
+#include "WidiHeldBufferTable.h"
+#include "WidiRateController.h"
 
 using namespace android;
 
-class WidiDisplayDevice : public IntelDisplayDevice, public BnFrameServer {
+class WidiDisplayDevice : public IntelDisplayDevice, public BnFrameServer,
+                          public WidiCscListener {
 protected:
     struct CachedBuffer : public android::RefBase {
         CachedBuffer(IntelBufferManager *gbm, IntelDisplayBuffer* buffer);
@@ -47,12 +51,6 @@ protected:
         IntelBufferManager* grallocBufferManager;
         IntelDisplayBuffer* displayBuffer;
     };
-    struct HeldCscBuffer : public android::RefBase {
-        HeldCscBuffer(const android::sp<WidiDisplayDevice>& wdd, const sp<GraphicBuffer>& gb);
-        virtual ~HeldCscBuffer();
-        android::sp<WidiDisplayDevice> wdd;
-        android::sp<GraphicBuffer> buffer;
-    };
     struct HeldDecoderBuffer : public android::RefBase {
         HeldDecoderBuffer(const android::sp<CachedBuffer>& cachedBuffer);
         virtual ~HeldDecoderBuffer();
@@ -77,24 +75,24 @@ protected:
     int64_t mRenderTimestamp;
 
     // colorspace conversion
-    android::Mutex mCscLock;
     IMG_gralloc_module_public_t* mGrallocModule;
     alloc_device_t* mGrallocDevice;
-    android::List< android::sp<GraphicBuffer> > mAvailableCscBuffers;
-    int mCscBuffersToCreate;
-    uint32_t mCscWidth;
-    uint32_t mCscHeight;
+    android::sp<WidiCscPipeline> mCscPipeline;
+    bool mCscVppTried;
+    // picked in prepare, queued in commit once the acquire fence is known
+    android::sp<GraphicBuffer> mCscBuffer;
+    hwc_rect_t mCscCrop;
 
     FrameInfo mLastInputFrameInfo;
     FrameInfo mLastOutputFrameInfo;
 
     android::KeyedVector<uint32_t, android::sp<CachedBuffer> > mMappedBufferCache;
-    android::Mutex mHeldBuffersLock;
-    android::KeyedVector<uint32_t, android::sp<android::RefBase> > mHeldBuffers;
+    WidiHeldBufferTable mHeldBuffers;
+    WidiRateController mRateController;
 
 private:
     android::sp<CachedBuffer> getMappedBuffer(uint32_t handle);
-    void sendToWidi(const hwc_layer_1_t& layer);
+    bool sendToWidi(const hwc_layer_1_t& layer);
 
 public:
     WidiDisplayDevice(IntelBufferManager *bm,
@@ -112,12 +110,20 @@ public:
     virtual android::status_t notifyBufferReturned(int index);
     virtual android::status_t setResolution(const FrameProcessingPolicy& policy, android::sp<IFrameListener> listener);
 
+    // WidiCscListener methods
+    virtual void onCscFrameReady(uint32_t handle,
+                                 const android::sp<android::RefBase>& heldBuffer,
+                                 const android::sp<IFrameListener>& frameListener,
+                                 int64_t renderTimestamp);
+
     virtual bool prepare(hwc_display_contents_1_t *list);
     virtual bool commit(hwc_display_contents_1_t *list,
-                        buffer_handle_t *bh, int &numBuffers);
+                        buffer_handle_t *bh, int* acquireFenceFd,
+                        int** releaseFenceFd, int &numBuffers);
     virtual bool dump(char *buff, int buff_len, int *cur_len);
 
     virtual void onHotplugEvent(bool hpd);
+    virtual uint32_t trimMemory(int category);
 
     virtual bool getDisplayConfig(uint32_t* configs, size_t* numConfigs);
     virtual bool getDisplayAttributes(uint32_t config,
@@ -0,0 +1,153 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <cutils/log.h>
+
+#include <IntelHWComposerCfg.h>
+#include <WidiHeldBufferTable.h>
+
+using namespace android;
+
+WidiHeldBufferTable::WidiHeldBufferTable()
+    : mReturnHead(0),
+      mReturnTail(0),
+      mHeld(0),
+      mPeakHeld(0),
+      mTableFull(0),
+      mUnknownReturns(0),
+      mReturned(0)
+{
+    for (int i = 0; i < HELD_BUFFER_SLOTS; i++) {
+        mSlots[i].state = SLOT_FREE;
+        mSlots[i].handle = 0;
+        mReturnRing[i] = 0;
+    }
+}
+
+WidiHeldBufferTable::~WidiHeldBufferTable()
+{
+}
+
+int WidiHeldBufferTable::add(uint32_t handle, const sp<RefBase>& buffer)
+{
+    for (int i = 0; i < HELD_BUFFER_SLOTS; i++) {
+        Slot& slot = mSlots[i];
+
+        if (android_atomic_acquire_load(&slot.state) != SLOT_FREE ||
+            android_atomic_cmpxchg(SLOT_FREE, SLOT_CLAIMED, &slot.state))
+            continue;
+
+        // the slot is ours until it is published as held
+        slot.buffer = buffer;
+        slot.handle = (int32_t)handle;
+        android_atomic_release_store(SLOT_HELD, &slot.state);
+
+        int32_t held = android_atomic_inc(&mHeld) + 1;
+        int32_t peak = android_atomic_acquire_load(&mPeakHeld);
+        while (held > peak && android_atomic_cmpxchg(peak, held, &mPeakHeld))
+            peak = android_atomic_acquire_load(&mPeakHeld);
+        return i;
+    }
+
+    android_atomic_inc(&mTableFull);
+    return -1;
+}
+
+void WidiHeldBufferTable::cancel(int slot)
+{
+    Slot& s = mSlots[slot];
+
+    // already returned, drain() will release it
+    if (android_atomic_cmpxchg(SLOT_HELD, SLOT_CLAIMED, &s.state))
+        return;
+
+    s.buffer.clear();
+    android_atomic_release_store(SLOT_FREE, &s.state);
+    android_atomic_dec(&mHeld);
+}
+
+bool WidiHeldBufferTable::release(uint32_t handle)
+{
+    for (int i = 0; i < HELD_BUFFER_SLOTS; i++) {
+        Slot& slot = mSlots[i];
+
+        if (android_atomic_acquire_load(&slot.state) != SLOT_HELD ||
+            slot.handle != (int32_t)handle ||
+            android_atomic_cmpxchg(SLOT_HELD, SLOT_RETURNED, &slot.state))
+            continue;
+
+        // every slot is in the ring at most once and an entry is cleared
+        // before its slot is freed, so the reserved entry is empty
+        int32_t head = android_atomic_inc(&mReturnHead);
+        android_atomic_release_store(i + 1,
+            &mReturnRing[head & (HELD_BUFFER_SLOTS - 1)]);
+        return true;
+    }
+
+    android_atomic_inc(&mUnknownReturns);
+    return false;
+}
+
+int WidiHeldBufferTable::drain()
+{
+    int count = 0;
+
+    for (;;) {
+        volatile int32_t *entry =
+            &mReturnRing[mReturnTail & (HELD_BUFFER_SLOTS - 1)];
+        int32_t index = android_atomic_acquire_load(entry);
+
+        // empty, or reserved by a thread which didn't publish yet
+        if (!index)
+            break;
+
+        Slot& slot = mSlots[index - 1];
+        *entry = 0;
+        slot.buffer.clear();
+        android_atomic_release_store(SLOT_FREE, &slot.state);
+        android_atomic_dec(&mHeld);
+        mReturnTail++;
+        count++;
+    }
+
+    mReturned += count;
+    return count;
+}
+
+bool WidiHeldBufferTable::dump(char *buff, int buff_len, int *cur_len)
+{
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------WiDi held buffers -------------\n");
+    dumpPrintf("  + held %d/%d (peak %d), returned %u\n",
+               android_atomic_acquire_load(&mHeld), HELD_BUFFER_SLOTS,
+               android_atomic_acquire_load(&mPeakHeld), mReturned);
+    dumpPrintf("  + dropped on full table %d, unknown returns %d\n",
+               android_atomic_acquire_load(&mTableFull),
+               android_atomic_acquire_load(&mUnknownReturns));
+
+    *cur_len = mDumpLen;
+    return true;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __WIDI_HELD_BUFFER_TABLE_H__
+#define __WIDI_HELD_BUFFER_TABLE_H__
+
+#include <utils/RefBase.h>
+#include <cutils/atomic.h>
+
+#include "IntelHWComposerDump.h"
+
+/**
+ * Class: WiDi held buffer table
+ * Keeps the frames sent to the WiDi encoder alive until they are returned.
+ * Frames are added from the composition or CSC thread and returned from
+ * binder threads without taking any lock: a slot is claimed with a
+ * compare-and-swap, and returned slots are handed over a multi-producer
+ * single-consumer ring to the composition thread, which drops the buffer
+ * references in drain(). Returning threads reserve a ring entry with an
+ * atomic increment and publish the slot into it, drain() stops at the
+ * first entry which is reserved but not published yet.
+ */
+class WidiHeldBufferTable : public IntelHWComposerDump {
+public:
+    enum {
+        // must be a power of two, it is also the return ring size
+        HELD_BUFFER_SLOTS = 16,
+    };
+private:
+    enum {
+        SLOT_FREE = 0,
+        SLOT_CLAIMED,
+        SLOT_HELD,
+        SLOT_RETURNED,
+    };
+    struct Slot {
+        volatile int32_t state;
+        volatile int32_t handle;
+        android::sp<android::RefBase> buffer;
+    };
+private:
+    Slot mSlots[HELD_BUFFER_SLOTS];
+
+    // return ring, entries hold the slot + 1 once published and 0 when
+    // empty. The head is shared by the returning threads, the tail is
+    // only used by the draining thread.
+    volatile int32_t mReturnRing[HELD_BUFFER_SLOTS];
+    volatile int32_t mReturnHead;
+    int32_t mReturnTail;
+
+    // statistics
+    volatile int32_t mHeld;
+    volatile int32_t mPeakHeld;
+    volatile int32_t mTableFull;
+    volatile int32_t mUnknownReturns;
+    uint32_t mReturned;
+public:
+    WidiHeldBufferTable();
+    ~WidiHeldBufferTable();
+
+    // slot of the held buffer, -1 if all slots are in use
+    int add(uint32_t handle, const android::sp<android::RefBase>& buffer);
+    // the encoder never got the buffer, release the slot right away
+    void cancel(int slot);
+    // the encoder is done with the buffer, false if it isn't held
+    bool release(uint32_t handle);
+    // drop the returned buffers, composition thread only
+    int drain();
+    bool dump(char *buff, int buff_len, int *cur_len);
+};
+
+#endif /*__WIDI_HELD_BUFFER_TABLE_H__*/
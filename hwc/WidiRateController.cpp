@@ -0,0 +1,234 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <string.h>
+
+#include <IntelHWComposerCfg.h>
+#include <WidiRateController.h>
+
+using namespace android;
+
+// measured rate must be stable this long before it is reported
+static const nsecs_t CONTENT_FPS_HOLD = 1000000000LL;
+// longer gaps are idle time, not a content frame rate
+static const nsecs_t MAX_FRAME_INTERVAL = 200000000LL;
+static const nsecs_t STATS_WINDOW = 1000000000LL;
+
+// content rates the encoder is told about
+static const uint32_t sContentFps[] = { 60, 50, 30, 25, 24, 15, 10 };
+
+WidiRateController::WidiRateController()
+    : mLastValid(false),
+      mLastSent(0),
+      mLastNewFrame(0),
+      mMinInterval(0),
+      mNewFrameInterval(0),
+      mContentFps(CONTENT_FPS_DEFAULT),
+      mCandidateFps(CONTENT_FPS_DEFAULT),
+      mCandidateSince(0),
+      mWindowStart(0),
+      mWindowSeen(0),
+      mWindowSent(0),
+      mWindowCsc(0),
+      mSeenFps(0),
+      mSentFps(0),
+      mCscFps(0),
+      mSkipped(0),
+      mRefreshed(0)
+{
+    char value[PROPERTY_VALUE_MAX];
+    int minFps;
+
+    property_get("hwcomposer.widi.min_fps", value, "5");
+    minFps = atoi(value);
+    if (minFps > 0)
+        mMinInterval = 1000000000LL / minFps;
+
+    ALOGD_IF(ALLOW_WIDI_PRINT, "%s: minimum %d fps", __func__, minFps);
+}
+
+WidiRateController::~WidiRateController()
+{
+}
+
+void WidiRateController::getLayerState(const hwc_layer_1_t& layer, LayerState& state)
+{
+    memset(&state, 0, sizeof(state));
+    state.handle = layer.handle;
+    state.compositionType = layer.compositionType;
+    state.transform = layer.transform;
+    state.blending = layer.blending;
+    state.planeAlpha = layer.planeAlpha;
+    state.sourceCrop = layer.sourceCropf;
+    state.displayFrame = layer.displayFrame;
+}
+
+bool WidiRateController::sameLayer(const LayerState& a, const LayerState& b)
+{
+    return a.handle == b.handle &&
+           a.compositionType == b.compositionType &&
+           a.transform == b.transform &&
+           a.blending == b.blending &&
+           a.planeAlpha == b.planeAlpha &&
+           !memcmp(&a.sourceCrop, &b.sourceCrop, sizeof(a.sourceCrop)) &&
+           !memcmp(&a.displayFrame, &b.displayFrame, sizeof(a.displayFrame));
+}
+
+uint32_t WidiRateController::quantizeFps(nsecs_t interval)
+{
+    uint32_t best = sContentFps[0];
+    nsecs_t bestError = -1;
+
+    for (size_t i = 0; i < sizeof(sContentFps) / sizeof(sContentFps[0]); i++) {
+        nsecs_t error = 1000000000LL / sContentFps[i] - interval;
+        if (error < 0)
+            error = -error;
+        if (bestError < 0 || error < bestError) {
+            best = sContentFps[i];
+            bestError = error;
+        }
+    }
+
+    return best;
+}
+
+void WidiRateController::updateContentFps_l(nsecs_t now)
+{
+    if (mLastNewFrame) {
+        nsecs_t interval = now - mLastNewFrame;
+        if (interval < MAX_FRAME_INTERVAL)
+            mNewFrameInterval = mNewFrameInterval ?
+                (mNewFrameInterval * 7 + interval) / 8 : interval;
+    }
+    mLastNewFrame = now;
+
+    if (!mNewFrameInterval)
+        return;
+
+    uint32_t fps = quantizeFps(mNewFrameInterval);
+    if (fps != mCandidateFps) {
+        mCandidateFps = fps;
+        mCandidateSince = now;
+    } else if (fps != mContentFps && now - mCandidateSince >= CONTENT_FPS_HOLD) {
+        ALOGD_IF(ALLOW_WIDI_PRINT, "%s: content %d fps", __func__, fps);
+        mContentFps = fps;
+    }
+}
+
+void WidiRateController::updateWindow_l(nsecs_t now)
+{
+    if (now - mWindowStart < STATS_WINDOW)
+        return;
+
+    // rates of the last window, zero after an idle period
+    bool idle = now - mWindowStart >= 2 * STATS_WINDOW;
+    mSeenFps = idle ? 0 : mWindowSeen;
+    mSentFps = idle ? 0 : mWindowSent;
+    mCscFps = idle ? 0 : mWindowCsc;
+    mWindowSeen = 0;
+    mWindowSent = 0;
+    mWindowCsc = 0;
+    mWindowStart = now;
+}
+
+int WidiRateController::checkFrame(hwc_display_contents_1_t *list, nsecs_t now)
+{
+    Mutex::Autolock _l(mLock);
+    size_t numLayers = list->numHwLayers - 1;
+    bool same = mLastValid &&
+                !(list->flags & HWC_GEOMETRY_CHANGED) &&
+                mLastLayers.size() == numLayers;
+
+    updateWindow_l(now);
+    mWindowSeen++;
+
+    // the framebuffer target is left out, it is redrawn from the layers
+    for (size_t i = 0; same && i < numLayers; i++) {
+        LayerState state;
+
+        getLayerState(list->hwLayers[i], state);
+        same = sameLayer(state, mLastLayers[i]);
+    }
+
+    if (same) {
+        if (mMinInterval && now - mLastSent >= mMinInterval) {
+            mRefreshed++;
+            return FRAME_REFRESH;
+        }
+        mSkipped++;
+        return FRAME_SKIP;
+    }
+
+    mLastLayers.clear();
+    for (size_t i = 0; i < numLayers; i++) {
+        LayerState state;
+
+        getLayerState(list->hwLayers[i], state);
+        mLastLayers.add(state);
+    }
+    mLastValid = true;
+
+    updateContentFps_l(now);
+    return FRAME_NEW;
+}
+
+void WidiRateController::frameSent(bool csc, nsecs_t now)
+{
+    Mutex::Autolock _l(mLock);
+    mLastSent = now;
+    mWindowSent++;
+    if (csc)
+        mWindowCsc++;
+}
+
+void WidiRateController::reset()
+{
+    Mutex::Autolock _l(mLock);
+    mLastValid = false;
+    mLastLayers.clear();
+}
+
+uint32_t WidiRateController::getContentFrameRate() const
+{
+    Mutex::Autolock _l(mLock);
+    return mContentFps;
+}
+
+bool WidiRateController::dump(char *buff, int buff_len, int *cur_len)
+{
+    Mutex::Autolock _l(mLock);
+
+    mDumpBuf = buff;
+    mDumpBuflen = buff_len;
+    mDumpLen = *cur_len;
+
+    dumpPrintf("-------------WiDi rate controller -------------\n");
+    dumpPrintf("  + content %d fps, composed %d fps, encoder %d fps, csc %d fps\n",
+               mContentFps, mSeenFps, mSentFps, mCscFps);
+    dumpPrintf("  + skipped %u, refreshed %u\n", mSkipped, mRefreshed);
+
+    *cur_len = mDumpLen;
+    return true;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __WIDI_RATE_CONTROLLER_H__
+#define __WIDI_RATE_CONTROLLER_H__
+
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <hardware/hwcomposer.h>
+
+#include "IntelHWComposerDump.h"
+
+/**
+ * Class: WiDi frame rate controller
+ * Decides which compositions are worth sending to the WiDi encoder.
+ * A composition whose layers have the same buffers and geometry as the
+ * last frame sent is skipped, except for a refresh frame at a minimum rate
+ * (hwcomposer.widi.min_fps, 0 for none). The rate at which the content
+ * really changes is measured and reported as the content frame rate once
+ * it has been stable for a while.
+ */
+class WidiRateController : public IntelHWComposerDump {
+public:
+    enum {
+        FRAME_SKIP = 0,
+        FRAME_NEW,
+        FRAME_REFRESH,
+    };
+    enum {
+        MIN_FPS_DEFAULT = 5,
+        CONTENT_FPS_DEFAULT = 60,
+    };
+private:
+    struct LayerState {
+        buffer_handle_t handle;
+        int32_t compositionType;
+        uint32_t transform;
+        int32_t blending;
+        uint8_t planeAlpha;
+        hwc_frect_t sourceCrop;
+        hwc_rect_t displayFrame;
+    };
+private:
+    mutable android::Mutex mLock;
+    android::Vector<LayerState> mLastLayers;
+    bool mLastValid;
+    nsecs_t mLastSent;
+    nsecs_t mLastNewFrame;
+    nsecs_t mMinInterval;
+
+    // content frame rate measurement
+    nsecs_t mNewFrameInterval;
+    uint32_t mContentFps;
+    uint32_t mCandidateFps;
+    nsecs_t mCandidateSince;
+
+    // statistics, per second over the last full window
+    nsecs_t mWindowStart;
+    uint32_t mWindowSeen;
+    uint32_t mWindowSent;
+    uint32_t mWindowCsc;
+    uint32_t mSeenFps;
+    uint32_t mSentFps;
+    uint32_t mCscFps;
+    uint32_t mSkipped;
+    uint32_t mRefreshed;
+private:
+    static void getLayerState(const hwc_layer_1_t& layer, LayerState& state);
+    static bool sameLayer(const LayerState& a, const LayerState& b);
+    static uint32_t quantizeFps(nsecs_t interval);
+    void updateContentFps_l(nsecs_t now);
+    void updateWindow_l(nsecs_t now);
+public:
+    WidiRateController();
+    ~WidiRateController();
+
+    // classify the composition, layers are remembered unless skipped
+    int checkFrame(hwc_display_contents_1_t *list, nsecs_t now);
+    // a frame went to the encoder, through the CSC or not
+    void frameSent(bool csc, nsecs_t now);
+    // forget the last frame, the next one is always sent
+    void reset();
+    uint32_t getContentFrameRate() const;
+    bool dump(char *buff, int buff_len, int *cur_len);
+};
+
+#endif /*__WIDI_RATE_CONTROLLER_H__*/
@@ -25,6 +25,7 @@
  *    Jackie Li <yaodong.li@intel.com>
  *
  */
+#include <string.h>
 #include <DisplayPlaneManager.h>
 #include <Log.h>
 
@@ -47,9 +48,11 @@ DisplayPlaneManager::DisplayPlaneManager()
       mReclaimedSpritePlanes(0),
       mReclaimedPrimaryPlanes(0),
       mReclaimedOverlayPlanes(0),
+      mValidityHits(0),
+      mValidityMisses(0),
       mInitialized(false)
 {
-
+    memset(mCapabilities, 0, sizeof(mCapabilities));
 }
 
 DisplayPlaneManager::~DisplayPlaneManager()
@@ -79,6 +82,18 @@ bool DisplayPlaneManager::initialize()
     // detect display plane usage. Hopefully throw DRM ioctl
     detect();
 
+    // plane types without planes accept nothing
+    if (!mSpritePlaneCount)
+        memset(&mCapabilities[IDisplayPlane::PLANE_SPRITE], 0,
+               sizeof(PlaneCapabilities));
+    if (!mPrimaryPlaneCount)
+        memset(&mCapabilities[IDisplayPlane::PLANE_PRIMARY], 0,
+               sizeof(PlaneCapabilities));
+    if (!mOverlayPlaneCount)
+        memset(&mCapabilities[IDisplayPlane::PLANE_OVERLAY], 0,
+               sizeof(PlaneCapabilities));
+    mValidityCache.clear();
+
     // allocate primary plane pool
     if (mPrimaryPlaneCount) {
         mPrimaryPlanes.setCapacity(mPrimaryPlaneCount);
@@ -182,6 +197,130 @@ IDisplayPlane* DisplayPlaneManager::allocPlane(int index, int type)
     return 0;
 }
 
+bool DisplayPlaneManager::getBufferInfo(uint32_t handle, uint32_t& format,
+                                        uint32_t& width, uint32_t& height,
+                                        uint32_t& stride)
+{
+    log.v("DisplayPlaneManager::getBufferInfo");
+    return false;
+}
+
+static uint32_t getBlendingCap(uint32_t blending)
+{
+    switch (blending) {
+    case HWC_BLENDING_NONE:
+        return PLANE_CAP_BLENDING_NONE;
+    case HWC_BLENDING_PREMULT:
+        return PLANE_CAP_BLENDING_PREMULT;
+    case HWC_BLENDING_COVERAGE:
+        return PLANE_CAP_BLENDING_COVERAGE;
+    default:
+        return 0;
+    }
+}
+
+bool DisplayPlaneManager::checkCapabilities(const PlaneCapabilities& caps,
+                                            uint32_t format,
+                                            uint32_t blending,
+                                            uint32_t scaleX,
+                                            uint32_t scaleY) const
+{
+    int i;
+
+    for (i = 0; i < caps.formatCount; i++) {
+        if (caps.formats[i] == format)
+            break;
+    }
+    if (i == caps.formatCount)
+        return false;
+
+    if (!(caps.blendingMask & blending))
+        return false;
+
+    if (caps.scaling) {
+        if (scaleX < caps.minScale || scaleY < caps.minScale)
+            return false;
+        if (caps.maxScale &&
+            (scaleX > caps.maxScale || scaleY > caps.maxScale))
+            return false;
+    }
+
+    return true;
+}
+
+bool DisplayPlaneManager::isValidLayer(int planeType, hwc_layer_1_t& layer)
+{
+    uint32_t format, width, height, stride;
+    uint32_t blending;
+    uint32_t scaleX = 0, scaleY = 0;
+    int srcW, srcH, dstW, dstH;
+    uint64_t key;
+    ssize_t index;
+    bool valid;
+
+    if (!initCheck() ||
+        planeType < IDisplayPlane::PLANE_SPRITE || planeType >= PLANE_TYPE_NUM)
+        return false;
+
+    const PlaneCapabilities& caps = mCapabilities[planeType];
+    if (!caps.formatCount)
+        return false;
+
+    if (!getBufferInfo((uint32_t)layer.handle, format, width, height, stride))
+        return false;
+
+    // buffer limits are plain compares, keep them out of the cache
+    if ((caps.maxWidth && width > caps.maxWidth) ||
+        (caps.maxHeight && height > caps.maxHeight) ||
+        (caps.maxStride && stride > caps.maxStride)) {
+        log.v("isValidLayer: plane type %d: buffer %dx%d stride %d too big",
+              planeType, width, height, stride);
+        return false;
+    }
+
+    srcW = layer.sourceCrop.right - layer.sourceCrop.left;
+    srcH = layer.sourceCrop.bottom - layer.sourceCrop.top;
+    dstW = layer.displayFrame.right - layer.displayFrame.left;
+    dstH = layer.displayFrame.bottom - layer.displayFrame.top;
+
+    if (!caps.scaling) {
+        if (srcW != dstW || srcH != dstH)
+            return false;
+    } else {
+        if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0)
+            return false;
+        scaleX = ((uint32_t)dstW << PLANE_SCALE_SHIFT) / srcW;
+        scaleY = ((uint32_t)dstH << PLANE_SCALE_SHIFT) / srcH;
+        if (scaleX > 0xfff)
+            scaleX = 0xfff;
+        if (scaleY > 0xfff)
+            scaleY = 0xfff;
+    }
+
+    blending = getBlendingCap(layer.blending);
+
+    key = ((uint64_t)format << 32) | (planeType << 28) | (blending << 24) |
+          (scaleX << 12) | scaleY;
+
+    index = mValidityCache.indexOfKey(key);
+    if (index >= 0) {
+        mValidityHits++;
+        return mValidityCache.valueAt(index);
+    }
+
+    valid = checkCapabilities(caps, format, blending, scaleX, scaleY);
+    log.v("isValidLayer: plane type %d: format 0x%x blending 0x%x "
+          "scale %d/%d: %s", planeType, format, layer.blending,
+          scaleX, scaleY, valid ? "valid" : "invalid");
+
+    if (mValidityCache.size() >= VALIDITY_CACHE_SIZE)
+        mValidityCache.clear();
+    mValidityCache.add(key, valid);
+    mValidityMisses++;
+
+    return valid;
+}
+
 int DisplayPlaneManager::getPlane(uint32_t& mask)
 {
     if (!mask)
@@ -596,6 +735,23 @@ void DisplayPlaneManager::dump(Dump& d)
              mPrimaryPlaneCount,
              mFreePrimaryPlanes,
              mReclaimedPrimaryPlanes);
+    d.append("------------+-------+----------+-----------\n");
+    d.append(" PLANE TYPE | FORMATS | BLENDING |  SCALE   |  MAX SIZE \n");
+    d.append("------------+---------+----------+----------+-----------\n");
+    for (int i = IDisplayPlane::PLANE_SPRITE; i < PLANE_TYPE_NUM; i++) {
+        const PlaneCapabilities& caps = mCapabilities[i];
+        d.append("     %6s |   %2d    |   0x%02x   | %3d-%-4d | %4dx%-4d\n",
+                 i == IDisplayPlane::PLANE_SPRITE ? "SPRITE" :
+                 i == IDisplayPlane::PLANE_OVERLAY ? "OVRLAY" : "PRIMRY",
+                 caps.formatCount,
+                 caps.blendingMask,
+                 caps.scaling ? caps.minScale : 1 << PLANE_SCALE_SHIFT,
+                 caps.scaling ? caps.maxScale : 1 << PLANE_SCALE_SHIFT,
+                 caps.maxWidth,
+                 caps.maxHeight);
+    }
+    d.append("validity cache: %d entries, %d hits, %d misses\n",
+             mValidityCache.size(), mValidityHits, mValidityMisses);
 }
 
 } // namespace intel
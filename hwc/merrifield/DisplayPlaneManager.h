@@ -30,6 +30,8 @@
 
 #include <Dump.h>
 #include <IDisplayPlane.h>
+#include <hardware/hwcomposer.h>
+#include <utils/KeyedVector.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -40,6 +42,10 @@ class DisplayPlaneManager {
         PLANE_ON_RECLAIMED_LIST = 1,
         PLANE_ON_FREE_LIST,
     };
+    enum {
+        PLANE_TYPE_NUM = IDisplayPlane::PLANE_PRIMARY + 1,
+        VALIDITY_CACHE_SIZE = 64,
+    };
 public:
     DisplayPlaneManager();
     virtual ~DisplayPlaneManager();
@@ -74,16 +80,25 @@ public:
     void reclaimPlane(IDisplayPlane& plane);
     void disableReclaimedPlanes();
 
+    // check a layer against the capabilities of a plane type
+    bool isValidLayer(int planeType, hwc_layer_1_t& layer);
+
     // dump interface
     void dump(Dump& d);
 protected:
     int getPlane(uint32_t& mask);
     int getPlane(uint32_t& mask, int index);
     void putPlane(int index, uint32_t& mask);
+    bool checkCapabilities(const PlaneCapabilities& caps, uint32_t format,
+                           uint32_t blending, uint32_t scaleX,
+                           uint32_t scaleY) const;
 
     // sub-classes need implement follow functions
     virtual void detect();
     virtual IDisplayPlane* allocPlane(int index, int type);
+    virtual bool getBufferInfo(uint32_t handle, uint32_t& format,
+                               uint32_t& width, uint32_t& height,
+                               uint32_t& stride);
 protected:
     int mSpritePlaneCount;
     int mPrimaryPlaneCount;
@@ -108,6 +123,13 @@ protected:
     uint32_t mReclaimedPrimaryPlanes;
     uint32_t mReclaimedOverlayPlanes;
 
+    // plane capabilities filled by detect(), indexed by plane type
+    PlaneCapabilities mCapabilities[PLANE_TYPE_NUM];
+    // memoized capability checks
+    KeyedVector<uint64_t, bool> mValidityCache;
+    uint32_t mValidityHits;
+    uint32_t mValidityMisses;
+
     bool mInitialized;
 };
 
@@ -30,6 +30,7 @@
 
 #include <Drm.h>
 #include <Log.h>
+#include <cutils/atomic.h>
 #include <cutils/log.h>
 
 namespace android {
@@ -50,6 +51,7 @@ Drm::Drm() : Singleton<Drm>()
 
     mDrmFd = fd;
     memset(&mOutputs, 0, sizeof(mOutputs));
+    mConnectedMask = 0;
 
     LOGD("Drm(): successfully. mDrmFd %d", fd);
 }
@@ -168,6 +170,13 @@ bool Drm::detect()
 
     drmModeFreeResources(resources);
 
+    int32_t connectedMask = 0;
+    for (int i = 0; i < OUTPUT_MAX; i++) {
+        if (mOutputs[i].connected)
+            connectedMask |= (1 << i);
+    }
+    android_atomic_release_store(connectedMask, &mConnectedMask);
+
     return true;
 }
 
@@ -255,14 +264,14 @@ struct Output* Drm::getOutput(int output)
 
 bool Drm::outputConnected(int output)
 {
-    Mutex::Autolock _l(mLock);
-
     if (output < 0 || output >= OUTPUT_MAX) {
         log.e("outputConnected(): invalid output %d", output);
         return false;
     }
 
-    return mOutputs[output].connected ? true : false;
+    // snapshot of the last detect(), no need to wait for an ioctl
+    return (android_atomic_acquire_load(&mConnectedMask) & (1 << output)) ?
+           true : false;
 }
 
 } // namespace intel
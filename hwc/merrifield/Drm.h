@@ -74,6 +74,8 @@ public:
 private:
     int mDrmFd;
     struct Output mOutputs[OUTPUT_MAX];
+    // bit per connected output, published by detect() for lock-free reads
+    volatile int32_t mConnectedMask;
     Mutex mLock;
 };
 
@@ -204,40 +204,16 @@ int HwcLayerList::HwcLayerVector::do_compare(const void* lhs,
     return l->getIndex() - r->getIndex();
 }
 //------------------------------------------------------------------------------
-bool HwcLayerList::check(IDisplayPlane& plane, hwc_layer_1_t& layer)
+bool HwcLayerList::check(int planeType, hwc_layer_1_t& layer)
 {
-    bool valid = false;
-
     // check layer flags
     if (layer.flags & HWC_SKIP_LAYER) {
-        log.v("plane type %d: (skip layer flag was set)", plane.getType());
-        goto check_out;
-    }
-
-    // check buffer format
-    valid = plane.isValidBuffer((uint32_t)layer.handle);
-    if (!valid) {
-        log.v("plane type %d: (bad buffer format)", plane.getType());
-        goto check_out;
-    }
-
-    // check layer blending
-    valid = plane.isValidBlending((uint32_t)layer.blending);
-    if (!valid) {
-        log.v("plane type %d: layer %d: (bad blending)", plane.getType());
-        goto check_out;
-    }
-
-    // check layer scaling
-    valid = plane.isValidScaling(layer.sourceCrop, layer.displayFrame);
-    if (!valid) {
-        log.v("plane type %d: layer %d: (bad scaling)", plane.getType());
-        goto check_out;
+        log.v("plane type %d: (skip layer flag was set)", planeType);
+        return false;
     }
 
-    // check visible region?
-check_out:
-    return valid;
+    // format, blending & scaling against the plane capability table
+    return mDisplayPlaneManager.isValidLayer(planeType, layer);
 }
 
 void HwcLayerList::setZOrder(bool& primaryAvailable)
@@ -316,7 +292,8 @@ void HwcLayerList::revisit()
     // 1) all the other layers have been set to OVERLAY layer.
     if ((mFBLayers.size() == 1)) {
         HwcLayer *hwcLayer = mFBLayers.itemAt(0);
-        if (check(*mPrimaryPlane, *(hwcLayer->getLayer()))) {
+        if (mPrimaryPlane &&
+            check(mPrimaryPlane->getType(), *(hwcLayer->getLayer()))) {
             log.v("primary check passed for primary layer");
             // attach primary to hwc layer
             hwcLayer->attachPlane(mPrimaryPlane);
@@ -361,6 +338,7 @@ void HwcLayerList::analyzeFrom(uint32_t index)
     int freeOverlayCount = 0;
     bool primaryAvailable = true;
     int supportExtendVideo = 0;
+    bool extConnected = false;
     IDisplayPlane *plane;
 
     if (!mList || index >= mLayerCount)
@@ -368,6 +346,8 @@ void HwcLayerList::analyzeFrom(uint32_t index)
 
     // load prop
     HwcConfig::getInstance().extendVideo(supportExtendVideo);
+    if (supportExtendVideo)
+        extConnected = Drm::getInstance().outputConnected(Drm::OUTPUT_HDMI);
 
     freeSpriteCount = mDisplayPlaneManager.getFreeSpriteCount();
     freeOverlayCount = mDisplayPlaneManager.getFreeOverlayCount();
@@ -403,10 +383,7 @@ void HwcLayerList::analyzeFrom(uint32_t index)
 
         // check whether the layer can be handled by sprite plane
         if (freeSpriteCount) {
-            plane = mDisplayPlaneManager.getDummySpritePlane();
-            if (!plane)
-                log.e("failed to get dummy sprite plane");
-            else if (check(*plane, *layer)) {
+            if (check(IDisplayPlane::PLANE_SPRITE, *layer)) {
                 log.v("sprite check passed for layer %d", i);
                 plane = mDisplayPlaneManager.getSpritePlane();
                 if (plane) {
@@ -420,10 +397,7 @@ void HwcLayerList::analyzeFrom(uint32_t index)
 
         // check whether the layer can be handled by overlay plane
         if (freeOverlayCount) {
-            plane = mDisplayPlaneManager.getDummyOverlayPlane();
-            if (!plane) {
-                log.e("failed to get dummy sprite plane");
-            } else if (check(*plane, *layer)) {
+            if (check(IDisplayPlane::PLANE_OVERLAY, *layer)) {
                 log.v("overlay check passed for layer %d", i);
                 plane = mDisplayPlaneManager.getOverlayPlane();
                 if (plane) {
@@ -435,8 +409,6 @@ void HwcLayerList::analyzeFrom(uint32_t index)
 
                 // check wheter we are supporting extend video mode
                 if (supportExtendVideo) {
-                    bool extConnected =
-                          Drm::getInstance().outputConnected(Drm::OUTPUT_HDMI);
                     if (extConnected && plane && !mDisplayIndex) {
                         hwcLayer->detachPlane();
                         mDisplayPlaneManager.putOverlayPlane(*plane);
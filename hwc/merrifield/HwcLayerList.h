@@ -89,7 +89,7 @@ public:
 protected:
     virtual void setZOrder(bool& primaryAvailable);
     virtual void revisit();
-    virtual bool check(IDisplayPlane& plane, hwc_layer_1_t& layer);
+    virtual bool check(int planeType, hwc_layer_1_t& layer);
     virtual void analyzeFrom(uint32_t index);
     virtual void analyze();
 private:
@@ -58,6 +58,31 @@ typedef struct {
     int primaryIndex;
 } ZOrderConfig;
 
+enum {
+    MAX_PLANE_FORMAT_COUNT = 8,
+    // scaling ratios are dst/src in 1/64 steps
+    PLANE_SCALE_SHIFT = 6,
+};
+
+enum {
+    PLANE_CAP_BLENDING_NONE = 1 << 0,
+    PLANE_CAP_BLENDING_PREMULT = 1 << 1,
+    PLANE_CAP_BLENDING_COVERAGE = 1 << 2,
+};
+
+// what a plane type accepts, limits of 0 mean no limit
+typedef struct {
+    uint32_t formats[MAX_PLANE_FORMAT_COUNT];
+    int formatCount;
+    uint32_t blendingMask;
+    bool scaling;
+    uint32_t minScale;
+    uint32_t maxScale;
+    uint32_t maxWidth;
+    uint32_t maxHeight;
+    uint32_t maxStride;
+} PlaneCapabilities;
+
 class IDisplayPlane {
 public:
     // transform
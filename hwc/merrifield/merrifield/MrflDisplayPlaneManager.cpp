@@ -30,6 +30,8 @@
 #include <MrflPrimaryPlane.h>
 #include <MrflSpritePlane.h>
 #include <MrflOverlayPlane.h>
+#include <MrflGrallocBuffer.h>
+#include <OverlayHW.h>
 
 namespace android {
 namespace intel {
@@ -61,6 +63,37 @@ void MrflDisplayPlaneManager::detect()
     mFreePrimaryPlanes = 0x7;
     // both overlay A & C
     mFreeOverlayPlanes = 0x1;
+
+    // primary planes scan out RGB without scaling
+    PlaneCapabilities *caps = &mCapabilities[IDisplayPlane::PLANE_PRIMARY];
+    caps->formats[0] = IDataBuffer::FORMAT_BGRA8888;
+    caps->formats[1] = IDataBuffer::FORMAT_BGRX8888;
+    caps->formats[2] = IDataBuffer::FORMAT_RGB565;
+    caps->formatCount = 3;
+    caps->blendingMask = PLANE_CAP_BLENDING_NONE | PLANE_CAP_BLENDING_PREMULT;
+    caps->scaling = false;
+
+    // sprite planes are the same hardware as primary planes
+    mCapabilities[IDisplayPlane::PLANE_SPRITE] = *caps;
+
+    // overlay takes YUV, no blending, down scaling is limited
+    caps = &mCapabilities[IDisplayPlane::PLANE_OVERLAY];
+    caps->formats[0] = IDataBuffer::FORMAT_YV12;
+    caps->formats[1] = IDataBuffer::FORMAT_I420;
+    caps->formats[2] = IDataBuffer::FORMAT_NV12_VED;
+    caps->formats[3] = IDataBuffer::FORMAT_YUY2;
+    caps->formats[4] = IDataBuffer::FORMAT_UYVY;
+    caps->formatCount = 5;
+    caps->blendingMask = PLANE_CAP_BLENDING_NONE;
+    caps->scaling = true;
+    // rounded up, a truncated bound lets 1/7.1 down scaling through
+    caps->minScale = ((1 << PLANE_SCALE_SHIFT) +
+                      INTEL_OVERLAY_MAX_SCALING_RATIO - 1) /
+                     INTEL_OVERLAY_MAX_SCALING_RATIO;
+    caps->maxScale = 0;
+    caps->maxWidth = INTEL_OVERLAY_MAX_WIDTH;
+    caps->maxHeight = INTEL_OVERLAY_MAX_HEIGHT;
+    caps->maxStride = INTEL_OVERLAY_MAX_STRIDE_PACKED;
 }
 
 IDisplayPlane* MrflDisplayPlaneManager::allocPlane(int index, int type)
@@ -84,6 +117,35 @@ IDisplayPlane* MrflDisplayPlaneManager::allocPlane(int index, int type)
     return plane;
 }
 
+bool MrflDisplayPlaneManager::getBufferInfo(uint32_t handle, uint32_t& format,
+                                            uint32_t& width, uint32_t& height,
+                                            uint32_t& stride)
+{
+    if (!handle)
+        return false;
+
+    MrflGrallocBuffer buff(handle);
+
+    format = buff.getFormat();
+    width = buff.getWidth();
+    height = buff.getHeight();
+
+    switch (format) {
+    case IDataBuffer::FORMAT_YV12:
+    case IDataBuffer::FORMAT_I420:
+    case IDataBuffer::FORMAT_NV12_VED:
+    case IDataBuffer::FORMAT_YUY2:
+    case IDataBuffer::FORMAT_UYVY:
+        stride = buff.getStride().yuv.yStride;
+        break;
+    default:
+        stride = buff.getStride().rgb.stride;
+        break;
+    }
+
+    return true;
+}
+
 } // namespace intel
 } // namespace android
 
@@ -40,6 +40,9 @@ public:
 protected:
     void detect();
     IDisplayPlane* allocPlane(int index, int type);
+    bool getBufferInfo(uint32_t handle, uint32_t& format,
+                       uint32_t& width, uint32_t& height,
+                       uint32_t& stride);
 };
 
 } // namespace intel
@@ -0,0 +1,61 @@
+# Host-only model checks of HWC helpers that don't need a device. Not
+# built by default, set INTEL_HWC_HOST_TESTS := true and run the
+# binaries from $(HOST_OUT_EXECUTABLES).
+
+LOCAL_PATH := $(call my-dir)
+
+# split overlay stripes against an unsplit scaler model, takes minutes
+include $(CLEAR_VARS)
+LOCAL_MODULE := hwc_overlay_stripe_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := overlay_stripe_test.c
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/include \
+    $(LOCAL_PATH)/../..
+LOCAL_LDLIBS := -lm
+include $(BUILD_HOST_EXECUTABLE)
+
+# video processor pool, targets and references on a CPU backend
+include $(CLEAR_VARS)
+LOCAL_MODULE := hwc_video_processor_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+    video_processor_test.cpp \
+    ../../VideoProcessor.cpp \
+    ../../IntelHWComposerDump.cpp
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/include \
+    $(LOCAL_PATH)/../..
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+# display stat thread on a fake register file
+include $(CLEAR_VARS)
+LOCAL_MODULE := hwc_display_stat_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+    display_stat_test.cpp \
+    ../../IntelDisplayStat.cpp \
+    ../../IntelHWComposerDump.cpp
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/include \
+    $(LOCAL_PATH)/../..
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+# parallel prepare against serial on replayed layer lists
+include $(CLEAR_VARS)
+LOCAL_MODULE := hwc_prepare_scheduler_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+    prepare_scheduler_test.cpp \
+    ../../IntelPrepareScheduler.cpp \
+    ../../IntelHWComposerDump.cpp
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/include \
+    $(LOCAL_PATH)/../..
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host model of the display stat thread. A fake register file serves
+ * the kernel accesses, optionally slowed down, to check that snapshots
+ * batch their reads into one access, that the first snapshot is taken
+ * without being asked for and without the register log, that a slow
+ * snapshot times out and is picked up by the next refresh, and that the
+ * thread stops on request.
+ * Exits non-zero on the first failed check.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <linux/psb_drm.h>
+#include <xf86drm.h>
+#include <IntelDisplayStat.h>
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+// no DRM on the host, only the fake register file answers
+int drmCommandWriteRead(int fd, unsigned long drmCommandIndex,
+                        void *data, unsigned long size)
+{
+    return -ENODEV;
+}
+
+class FakeRegisterFile : public IntelDisplayStat {
+public:
+    FakeRegisterFile()
+        : IntelDisplayStat(-1), submits(0), displayAll(0), vsyncReads(0),
+          delayMs(0) {}
+protected:
+    virtual int submit(struct drm_psb_register_rw_arg *arg) {
+        submits++;
+        if (arg->display_read_mask & REGRWBITS_DISPLAY_ALL)
+            displayAll++;
+        usleep(delayMs * 1000);
+        if (arg->display_read_mask & REGRWBITS_PIPEASTAT)
+            arg->display.pipestat_a = 0x80000202;
+        if (arg->display_read_mask & REGRWBITS_INT_MASK)
+            arg->display.int_mask = 0xfffeffff;
+        if (arg->display_read_mask & REGRWBITS_INT_ENABLE)
+            arg->display.int_enable = 0x10000;
+        return 0;
+    }
+    virtual int readVsync(struct drm_psb_vsync_set_arg *arg) {
+        vsyncReads++;
+        arg->vsync.vsync_count = 1234 + vsyncReads;
+        arg->vsync.timestamp = 5000000000ULL;
+        return 0;
+    }
+public:
+    volatile int submits;
+    volatile int displayAll;
+    volatile int vsyncReads;
+    volatile int delayMs;
+};
+
+int main(void)
+{
+    const nsecs_t ms = 1000000LL;
+    IntelDisplayStat::snapshot snap;
+    char buf[2048];
+    int len = 0;
+
+    android::sp<FakeRegisterFile> stat = new FakeRegisterFile();
+
+    // the first snapshot comes without a refresh
+    for (int i = 0; i < 100 && !stat->getSnapshot().time; i++)
+        usleep(1000);
+    snap = stat->getSnapshot();
+    CHECK(snap.time && snap.valid);
+    CHECK(stat->submits == 1 && stat->vsyncReads == 1);
+    CHECK(stat->displayAll == 0);
+
+    // all registers of a snapshot go in one access, the register log
+    // only when asked for
+    CHECK(stat->refresh(100 * ms, false));
+    CHECK(stat->submits == 2 && stat->displayAll == 0);
+    CHECK(stat->refresh(100 * ms, true));
+    CHECK(stat->submits == 3 && stat->displayAll == 1);
+    snap = stat->getSnapshot();
+    CHECK(snap.valid && snap.pipeAStat == 0x80000202 &&
+          snap.intMask == 0xfffeffff && snap.intEnable == 0x10000 &&
+          snap.vsyncCount == 1237);
+
+    // a slow access times out, the old snapshot stays until it's done
+    stat->delayMs = 50;
+    CHECK(!stat->refresh(10 * ms, false));
+    CHECK(stat->getSnapshot().vsyncCount == 1237);
+    CHECK(stat->refresh(200 * ms, false));
+    CHECK(stat->getSnapshot().vsyncCount >= 1238);
+
+    // the thread exits while waiting for a request
+    stat->delayMs = 0;
+    int submits = stat->submits;
+    stat->stop();
+    CHECK(!stat->refresh(10 * ms, false));
+    CHECK(stat->submits == submits);
+
+    stat->dump(buf, sizeof(buf), &len);
+    fputs(buf, stdout);
+    puts("ok");
+    return 0;
+}
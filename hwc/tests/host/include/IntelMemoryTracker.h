@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_MEMORY_TRACKER_H__
+#define __INTEL_MEMORY_TRACKER_H__
+
+/* host stand-in, only counts the bytes so a test can check the balance */
+#include <stdint.h>
+
+class IntelMemoryTracker {
+public:
+    enum {
+        MEM_OVERLAY_BACK_BUFFER = 0,
+        MEM_GTT_MAPPING,
+        MEM_ROTATION,
+        MEM_RGB_CONVERTER,
+        MEM_WIDI_CSC,
+        MEM_HDMI_FB,
+        MEM_CATEGORY_NUM,
+    };
+public:
+    static IntelMemoryTracker& getInstance() {
+        static IntelMemoryTracker instance;
+        return instance;
+    }
+    void add(int category, uint32_t bytes) { mBytes += bytes; }
+    void remove(int category, uint32_t bytes) { mBytes -= bytes; }
+    void notifyPressure() { mPressure++; }
+    int64_t getBytes() const { return mBytes; }
+private:
+    IntelMemoryTracker() : mBytes(0), mPressure(0) {}
+private:
+    int64_t mBytes;
+    int mPressure;
+};
+
+#endif /*__INTEL_MEMORY_TRACKER_H__*/
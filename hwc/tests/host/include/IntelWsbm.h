@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __INTEL_WSBM_H__
+#define __INTEL_WSBM_H__
+
+/*
+ * Host stand-in for the wsbm wrapper. TTM buffers are heap blocks named
+ * by made up kernel handles, and the counters let a test check that
+ * every allocation and reference is given back.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <map>
+
+class IntelWsbm
+{
+public:
+    struct Buffer {
+        void *mem;
+        uint32_t size;
+        int refs;
+    };
+public:
+    IntelWsbm() : allocs(0), frees(0), wraps(0), unrefs(0), mNext(0x100) {}
+    ~IntelWsbm() {}
+    bool initialize() { return true; }
+    bool allocateTTMBuffer(uint32_t size, uint32_t align, void **buf) {
+        Buffer *b = new Buffer;
+        b->mem = calloc(1, size);
+        b->size = size;
+        b->refs = 1;
+        mHandles[mNext++] = b;
+        *buf = b;
+        allocs++;
+        return true;
+    }
+    bool destroyTTMBuffer(void *buf) {
+        frees++;
+        return put((Buffer*)buf);
+    }
+    bool wrapTTMBuffer(uint32_t handle, void **buf) {
+        Buffer *b = find(handle);
+        if (!b)
+            return false;
+        b->refs++;
+        *buf = b;
+        wraps++;
+        return true;
+    }
+    bool unreferenceTTMBuffer(void *buf) {
+        unrefs++;
+        return put((Buffer*)buf);
+    }
+    uint32_t getKBufHandle(void *buf) {
+        std::map<uint32_t, Buffer*>::iterator it;
+        for (it = mHandles.begin(); it != mHandles.end(); ++it)
+            if (it->second == buf)
+                return it->first;
+        return 0;
+    }
+    // memory of a handle, NULL once its last reference is gone
+    uint8_t* getMemory(uint32_t handle) {
+        Buffer *b = find(handle);
+        return b ? (uint8_t*)b->mem : NULL;
+    }
+public:
+    int allocs;
+    int frees;
+    int wraps;
+    int unrefs;
+private:
+    Buffer* find(uint32_t handle) {
+        std::map<uint32_t, Buffer*>::iterator it = mHandles.find(handle);
+        return it == mHandles.end() ? NULL : it->second;
+    }
+    bool put(Buffer *b) {
+        if (--b->refs > 0)
+            return true;
+        mHandles.erase(getKBufHandle(b));
+        free(b->mem);
+        delete b;
+        return true;
+    }
+private:
+    uint32_t mNext;
+    std::map<uint32_t, Buffer*> mHandles;
+};
+
+#endif /*__INTEL_WSBM_H__*/
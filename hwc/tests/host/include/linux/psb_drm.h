@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __HOST_PSB_DRM_H__
+#define __HOST_PSB_DRM_H__
+
+/*
+ * Host stand-in for the parts of the psb DRM interface the display stat
+ * uses, the test serves the register accesses from a fake register file.
+ */
+#include <stdint.h>
+
+#define DRM_PSB_REGISTER_RW     0x06
+#define DRM_PSB_VSYNC_SET       0x1a
+
+#define REGRWBITS_PIPEASTAT     (1 << 0)
+#define REGRWBITS_INT_MASK      (1 << 1)
+#define REGRWBITS_INT_ENABLE    (1 << 2)
+#define REGRWBITS_DISPLAY_ALL   (1 << 3)
+
+#define GET_VSYNC_COUNT         (1 << 2)
+
+struct drm_psb_register_rw_arg {
+    uint32_t display_read_mask;
+    uint32_t display_write_mask;
+    struct {
+        uint32_t pipestat_a;
+        uint32_t int_mask;
+        uint32_t int_enable;
+    } display;
+};
+
+struct drm_psb_vsync_set_arg {
+    uint32_t vsync_operation_mask;
+    struct {
+        uint32_t pipe;
+        int vsync_pipe;
+        int vsync_count;
+        uint64_t timestamp;
+    } vsync;
+};
+
+#endif /*__HOST_PSB_DRM_H__*/
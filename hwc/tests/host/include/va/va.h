@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __HOST_VA_H__
+#define __HOST_VA_H__
+
+/*
+ * Host stand-in for the libva API the video processor uses. There is no
+ * VA driver on the host, the test defines the entry points to fail.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void* VADisplay;
+typedef int VAStatus;
+typedef unsigned int VAGenericID;
+typedef VAGenericID VAConfigID;
+typedef VAGenericID VAContextID;
+typedef VAGenericID VABufferID;
+typedef VAGenericID VASurfaceID;
+
+#define VA_STATUS_SUCCESS                   0x00000000
+#define VA_STATUS_ERROR_OPERATION_FAILED    0x00000001
+
+#define VA_RT_FORMAT_YUV420     0x00000001
+#define VA_RT_FORMAT_RGB32      0x00100000
+
+#define VA_FOURCC(ch0, ch1, ch2, ch3) \
+    ((unsigned long)(unsigned char)(ch0) | \
+     ((unsigned long)(unsigned char)(ch1) << 8) | \
+     ((unsigned long)(unsigned char)(ch2) << 16) | \
+     ((unsigned long)(unsigned char)(ch3) << 24))
+#define VA_FOURCC_NV12          0x3231564E
+#define VA_FOURCC_RGBA          0x41424752
+#define VA_FOURCC_BGRA          0x41524742
+
+#define VA_ROTATION_NONE        0x00000000
+#define VA_ROTATION_90          0x00000001
+#define VA_ROTATION_180         0x00000002
+#define VA_ROTATION_270         0x00000003
+
+typedef enum {
+    VAProfileNone = -1,
+} VAProfile;
+
+typedef enum {
+    VAEntrypointVLD = 1,
+    VAEntrypointVideoProc = 10,
+} VAEntrypoint;
+
+typedef struct {
+    int type;
+    unsigned int value;
+} VAConfigAttrib;
+
+typedef enum {
+    VAProcFilterParameterBufferType = 41,
+    VAProcPipelineParameterBufferType = 42,
+} VABufferType;
+
+typedef struct {
+    short x;
+    short y;
+    unsigned short width;
+    unsigned short height;
+} VARectangle;
+
+VADisplay vaGetDisplay(void *native_dpy);
+int vaMaxNumEntrypoints(VADisplay dpy);
+VAStatus vaInitialize(VADisplay dpy, int *major, int *minor);
+VAStatus vaTerminate(VADisplay dpy);
+VAStatus vaQueryConfigEntrypoints(VADisplay dpy, VAProfile profile,
+                                  VAEntrypoint *entrypoints, int *num);
+VAStatus vaCreateConfig(VADisplay dpy, VAProfile profile,
+                        VAEntrypoint entrypoint, VAConfigAttrib *attribs,
+                        int num, VAConfigID *config);
+VAStatus vaDestroyConfig(VADisplay dpy, VAConfigID config);
+VAStatus vaCreateContext(VADisplay dpy, VAConfigID config, int width,
+                         int height, int flag, VASurfaceID *targets,
+                         int num, VAContextID *context);
+VAStatus vaDestroyContext(VADisplay dpy, VAContextID context);
+VAStatus vaCreateBuffer(VADisplay dpy, VAContextID context,
+                        VABufferType type, unsigned int size,
+                        unsigned int num, void *data, VABufferID *buf);
+VAStatus vaDestroyBuffer(VADisplay dpy, VABufferID buf);
+VAStatus vaMapBuffer(VADisplay dpy, VABufferID buf, void **data);
+VAStatus vaUnmapBuffer(VADisplay dpy, VABufferID buf);
+VAStatus vaBeginPicture(VADisplay dpy, VAContextID context,
+                        VASurfaceID target);
+VAStatus vaRenderPicture(VADisplay dpy, VAContextID context,
+                         VABufferID *buffers, int num);
+VAStatus vaEndPicture(VADisplay dpy, VAContextID context);
+VAStatus vaSyncSurface(VADisplay dpy, VASurfaceID surface);
+VAStatus vaDestroySurfaces(VADisplay dpy, VASurfaceID *surfaces, int num);
+
+#endif /*__HOST_VA_H__*/
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __HOST_VA_VPP_H__
+#define __HOST_VA_VPP_H__
+
+/* host stand-in, the video processing filters and pipeline */
+#include <va/va.h>
+
+typedef enum {
+    VAProcFilterNone = 0,
+    VAProcFilterNoiseReduction,
+    VAProcFilterDeinterlacing,
+    VAProcFilterCount,
+} VAProcFilterType;
+
+typedef enum {
+    VAProcDeinterlacingNone = 0,
+    VAProcDeinterlacingBob,
+    VAProcDeinterlacingWeave,
+    VAProcDeinterlacingMotionAdaptive,
+    VAProcDeinterlacingMotionCompensated,
+    VAProcDeinterlacingCount,
+} VAProcDeinterlacingType;
+
+typedef struct {
+    VAProcFilterType type;
+    float value;
+} VAProcFilterParameterBuffer;
+
+typedef struct {
+    VAProcFilterType type;
+    VAProcDeinterlacingType algorithm;
+    unsigned int flags;
+} VAProcFilterParameterBufferDeinterlacing;
+
+typedef struct {
+    VAProcDeinterlacingType type;
+} VAProcFilterCapDeinterlacing;
+
+typedef struct {
+    unsigned int pipeline_flags;
+    unsigned int filter_flags;
+    unsigned int num_forward_references;
+    unsigned int num_backward_references;
+    unsigned int rotation_flags;
+} VAProcPipelineCaps;
+
+typedef struct {
+    VASurfaceID surface;
+    const VARectangle *surface_region;
+    unsigned int surface_color_standard;
+    const VARectangle *output_region;
+    unsigned int output_background_color;
+    unsigned int output_color_standard;
+    unsigned int pipeline_flags;
+    unsigned int filter_flags;
+    VABufferID *filters;
+    unsigned int num_filters;
+    VASurfaceID *forward_references;
+    unsigned int num_forward_references;
+    VASurfaceID *backward_references;
+    unsigned int num_backward_references;
+    unsigned int rotation_state;
+} VAProcPipelineParameterBuffer;
+
+VAStatus vaQueryVideoProcFilters(VADisplay dpy, VAContextID context,
+                                 VAProcFilterType *filters,
+                                 unsigned int *num);
+VAStatus vaQueryVideoProcFilterCaps(VADisplay dpy, VAContextID context,
+                                    VAProcFilterType type, void *caps,
+                                    unsigned int *num);
+VAStatus vaQueryVideoProcPipelineCaps(VADisplay dpy, VAContextID context,
+                                      VABufferID *filters,
+                                      unsigned int num,
+                                      VAProcPipelineCaps *caps);
+
+#endif /*__HOST_VA_VPP_H__*/
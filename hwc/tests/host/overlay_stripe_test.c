@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host model of the split overlay presentation in IntelOverlayHW.h.
+ *
+ * A polyphase scaler like the overlay's (5 tap Y, 3 tap UV, 17 phases,
+ * edge pixels replicated past the fetched span) scales the whole source,
+ * then each stripe the way intel_overlay_stripe_setup() programs it.
+ * Every stripe output pixel must match the unsplit output, for all even
+ * source widths that need a split and every window width within the
+ * overlay scaling ratio. Sources needsSplit() accepts must fit both
+ * stripes. Exits non-zero on the first kind of failure it counts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <IntelOverlayHW.h>
+
+#define SRC_MAX     (INTEL_OVERLAY_STRIPE_NUM * INTEL_OVERLAY_MAX_WIDTH)
+#define DST_MAX     2560
+
+static double sCoeffs[2][N_PHASES][MAX_TAPS];
+
+/* windowed sinc, normalized per phase like the coefficient tables */
+static void initCoeffs(int taps, double *coeffs, int phase)
+{
+    double sum = 0;
+    int i;
+
+    for (i = 0; i < taps; i++) {
+        double x = (i - (taps - 1) / 2) - phase / 16.0;
+        coeffs[i] = x == 0 ? 1 :
+            sin(M_PI * x) / (M_PI * x) * (0.54 + 0.46 * cos(M_PI * x / taps));
+        sum += coeffs[i];
+    }
+    for (i = 0; i < taps; i++)
+        coeffs[i] /= sum;
+}
+
+/* output pixel @k of a scaler fetching [@srcX, @srcX + @srcWidth) */
+static double scale(const double *src, int taps, int srcX, int srcWidth,
+                    int phase, int step, int k)
+{
+    long pos = (long)phase + (long)k * step;
+    int base = srcX + (int)(pos >> 12) - (taps - 1) / 2;
+    const double *coeffs = sCoeffs[taps == N_HORIZ_Y_TAPS]
+                                  [((pos & 0xfff) * 16 + 2048) >> 12];
+    double acc = 0;
+    int t, i;
+
+    for (t = 0; t < taps; t++) {
+        i = base + t;
+        if (i < srcX)
+            i = srcX;
+        if (i > srcX + srcWidth - 1)
+            i = srcX + srcWidth - 1;
+        acc += coeffs[t] * src[i];
+    }
+    return acc;
+}
+
+static int checkStripe(const double *y, const double *uv, int srcWidth,
+                       int step, const intel_overlay_stripe_t *s)
+{
+    int k;
+
+    for (k = 0; k < s->dstWidth; k++) {
+        int d = s->dstX + k;
+        if (scale(y, N_HORIZ_Y_TAPS, 0, srcWidth, 0, step, d) !=
+            scale(y, N_HORIZ_Y_TAPS, s->srcX, s->srcWidth,
+                  s->phaseY, step, k) ||
+            scale(uv, N_HORIZ_UV_TAPS, 0, srcWidth / 2, 0, step / 2, d) !=
+            scale(uv, N_HORIZ_UV_TAPS, s->srcX / 2, s->srcWidth / 2,
+                  s->phaseUV, step / 2, k))
+            return 0;
+    }
+
+    /* INIT_PHS holds 4 integer bits per component */
+    return (s->phaseY >> 12) <= 0xf && (s->phaseUV >> 12) <= 0xf;
+}
+
+int main(void)
+{
+    static double y[SRC_MAX], uv[SRC_MAX / 2];
+    intel_overlay_stripe_t s[INTEL_OVERLAY_STRIPE_NUM];
+    long cases = 0, mismatches = 0, rejected = 0;
+    int srcWidth, dstWidth, step, i, j;
+
+    for (i = 0; i < N_PHASES; i++) {
+        initCoeffs(N_HORIZ_Y_TAPS, sCoeffs[1][i], i);
+        initCoeffs(N_HORIZ_UV_TAPS, sCoeffs[0][i], i);
+    }
+
+    srand(1);
+    for (i = 0; i < SRC_MAX; i++)
+        y[i] = rand() % 256;
+    for (i = 0; i < SRC_MAX / 2; i++)
+        uv[i] = rand() % 256;
+
+    for (srcWidth = INTEL_OVERLAY_MAX_WIDTH; srcWidth < SRC_MAX;
+         srcWidth += 2) {
+        for (dstWidth = 2; dstWidth <= DST_MAX; dstWidth++) {
+            step = intel_overlay_xstep(srcWidth, dstWidth);
+            if ((step >> 12) > PVR_OVERLAY_MAX_SCALING_RATIO)
+                continue;
+
+            if (!intel_overlay_stripe_setup(0, srcWidth, dstWidth, step, &s[0]) ||
+                !intel_overlay_stripe_setup(1, srcWidth, dstWidth, step, &s[1])) {
+                if (srcWidth <= INTEL_OVERLAY_STRIPE_MAX_SRC_WIDTH) {
+                    if (rejected++ < 5)
+                        printf("rejected: src %d dst %d\n", srcWidth, dstWidth);
+                }
+                continue;
+            }
+
+            cases++;
+            if (s[0].dstWidth + s[1].dstWidth != dstWidth ||
+                s[1].dstX != s[0].dstWidth || (s[1].srcX & 1) ||
+                s[1].srcX + s[1].srcWidth != srcWidth) {
+                if (mismatches++ < 5)
+                    printf("bad geometry: src %d dst %d\n", srcWidth, dstWidth);
+                continue;
+            }
+
+            for (j = 0; j < INTEL_OVERLAY_STRIPE_NUM; j++) {
+                if (!checkStripe(y, uv, srcWidth, step, &s[j])) {
+                    if (mismatches++ < 5)
+                        printf("mismatch: src %d dst %d stripe %d\n",
+                               srcWidth, dstWidth, j);
+                    break;
+                }
+            }
+        }
+    }
+
+    printf("%ld splits, %ld mismatches, %ld rejected within %d pixels\n",
+           cases, mismatches, rejected, INTEL_OVERLAY_STRIPE_MAX_SRC_WIDTH);
+    return mismatches || rejected;
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host replay of the prepare scheduler. Fake displays prepare recorded
+ * layer lists: each analyzes its layers on its own, then claims planes
+ * from one shared pool after waitTurn(), the way the plane manager is
+ * reached from a real prepare. Every frame is replayed through a serial
+ * and a parallel scheduler, the planes and the order they were claimed
+ * in must come out the same, and the time per frame of both is printed.
+ * Exits non-zero on the first failed check.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <IntelDisplayDevice.h>
+#include <IntelPrepareScheduler.h>
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+enum {
+    DISPLAYS = 3,
+    LAYERS_MAX = 8,
+    OVERLAYS = 2,
+    SPRITES = 3,
+    SCENE_FRAMES = 60,
+    // analysis time per layer, overlaps between displays
+    ANALYZE_NS = 100000,
+    // planes claimed in one frame at most
+    CLAIMS_MAX = DISPLAYS * LAYERS_MAX,
+    PLANE_FB = -1,
+    PLANE_OVERLAY = 100,
+    PLANE_SPRITE = 200,
+};
+
+// recorded layer lists, one string per display, NULL if the display is
+// off: V video, S sprite candidate, F composed into the framebuffer
+static const char *sScenes[][DISPLAYS] = {
+    { "FSF", NULL, NULL },          // home screen
+    { "VFF", "VF", NULL },          // video, HDMI clone
+    { "VFSF", "V", "FF" },          // video, HDMI and WiDi
+    { "SSFF", "FS", "SF" },         // UI on all displays
+    { "VVF", "VV", "V" },           // more videos than overlays
+    { "FFFFFFFF", "SSSS", "S" },    // more candidates than sprites
+};
+
+// display planes shared by all displays, only safe in ticket order
+struct PlanePool {
+    int overlays;
+    int sprites;
+    // displays in the order they claimed a plane
+    int claims[CLAIMS_MAX];
+    int numClaims;
+};
+
+static PlanePool sPool;
+
+static void spin(nsecs_t ns)
+{
+    nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC) + ns;
+
+    while (systemTime(SYSTEM_TIME_MONOTONIC) < end)
+        ;
+}
+
+static int claimPlane(int display, char kind)
+{
+    int plane = PLANE_FB;
+
+    IntelPrepareScheduler::waitTurn();
+
+    if (kind == 'V' && sPool.overlays < OVERLAYS)
+        plane = PLANE_OVERLAY + sPool.overlays++;
+    else if (kind == 'S' && sPool.sprites < SPRITES)
+        plane = PLANE_SPRITE + sPool.sprites++;
+
+    if (plane != PLANE_FB && sPool.numClaims < CLAIMS_MAX)
+        sPool.claims[sPool.numClaims++] = display;
+    return plane;
+}
+
+class FakeDisplay : public IntelDisplayDevice {
+public:
+    FakeDisplay(int index) : mIndex(index), mKinds(0) {}
+    void setFrame(const char *kinds) { mKinds = kinds; }
+    virtual bool prepare(hwc_display_contents_1_t *hdc) {
+        if (!hdc || !mKinds)
+            return false;
+
+        // layer analysis touches nothing shared
+        spin(hdc->numHwLayers * ANALYZE_NS);
+
+        for (size_t i = 0; i < hdc->numHwLayers; i++) {
+            planes[i] = claimPlane(mIndex, mKinds[i]);
+            hdc->hwLayers[i].compositionType =
+                planes[i] == PLANE_FB ? HWC_FRAMEBUFFER : HWC_OVERLAY;
+        }
+        return true;
+    }
+public:
+    int planes[LAYERS_MAX];
+private:
+    int mIndex;
+    const char *mKinds;
+};
+
+// planes of one replayed frame
+struct FrameResult {
+    int planes[DISPLAYS][LAYERS_MAX];
+    int claims[CLAIMS_MAX];
+    int numClaims;
+};
+
+static hwc_display_contents_1_t *createList(const char *kinds)
+{
+    size_t count = strlen(kinds);
+    size_t size = sizeof(hwc_display_contents_1_t) +
+                  count * sizeof(hwc_layer_1_t);
+    hwc_display_contents_1_t *list = (hwc_display_contents_1_t *)malloc(size);
+
+    memset(list, 0, size);
+    list->numHwLayers = count;
+    return list;
+}
+
+static void replayFrame(IntelPrepareScheduler& scheduler, int scene,
+                        FrameResult& result)
+{
+    FakeDisplay *displays[DISPLAYS];
+    IntelDisplayDevice *devices[DISPLAYS];
+    hwc_display_contents_1_t *lists[DISPLAYS];
+    int i;
+
+    for (i = 0; i < DISPLAYS; i++) {
+        const char *kinds = sScenes[scene][i];
+        displays[i] = new FakeDisplay(i);
+        displays[i]->setFrame(kinds);
+        memset(displays[i]->planes, 0, sizeof(displays[i]->planes));
+        devices[i] = displays[i];
+        lists[i] = kinds ? createList(kinds) : NULL;
+    }
+
+    // planes are handed back between frames
+    memset(&sPool, 0, sizeof(sPool));
+
+    scheduler.prepare(devices, lists, DISPLAYS);
+
+    memcpy(result.claims, sPool.claims, sizeof(result.claims));
+    result.numClaims = sPool.numClaims;
+    for (i = 0; i < DISPLAYS; i++) {
+        memcpy(result.planes[i], displays[i]->planes,
+               sizeof(result.planes[i]));
+        free(lists[i]);
+        delete displays[i];
+    }
+}
+
+int main(void)
+{
+    const int scenes = sizeof(sScenes) / sizeof(sScenes[0]);
+    const int frames = scenes * SCENE_FRAMES;
+    // without initialize() every prepare is serial
+    IntelPrepareScheduler serial;
+    IntelPrepareScheduler parallel;
+    FrameResult *expected = new FrameResult[frames];
+    FrameResult result;
+    nsecs_t start, serialTime, parallelTime;
+    char buf[2048];
+    int len = 0;
+    int f, i;
+
+    CHECK(parallel.initialize());
+
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (f = 0; f < frames; f++)
+        replayFrame(serial, f / SCENE_FRAMES, expected[f]);
+    serialTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    // tickets claim planes in display order
+    for (f = 0; f < frames; f++)
+        for (i = 1; i < expected[f].numClaims; i++)
+            CHECK(expected[f].claims[i - 1] <= expected[f].claims[i]);
+
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (f = 0; f < frames; f++) {
+        replayFrame(parallel, f / SCENE_FRAMES, result);
+        CHECK(!memcmp(result.planes, expected[f].planes,
+                      sizeof(result.planes)));
+        CHECK(result.numClaims == expected[f].numClaims);
+        CHECK(!memcmp(result.claims, expected[f].claims,
+                      result.numClaims * sizeof(int)));
+    }
+    parallelTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    printf("%d frames, serial %lld us, parallel %lld us per frame\n",
+           frames, serialTime / frames / 1000, parallelTime / frames / 1000);
+
+    parallel.dump(buf, sizeof(buf), &len);
+    fputs(buf, stdout);
+    delete [] expected;
+    puts("ok");
+    return 0;
+}
@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2008-2012, Intel Corporation. All rights reserved.
+ *
+ * Redistribution.
+ * Redistribution and use in binary form, without modification, are
+ * permitted provided that the following conditions are met:
+ *  * Redistributions must reproduce the above copyright notice and
+ * the following disclaimer in the documentation and/or other materials
+ * provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its
+ * suppliers may be used to endorse or promote products derived from
+ * this software without specific  prior written permission.
+ *  * No reverse engineering, decompilation, or disassembly of this
+ * software is permitted.
+ *
+ * Limited patent license.
+ * Intel Corporation grants a world-wide, royalty-free, non-exclusive
+ * license under patents it now or hereafter owns or controls to make,
+ * have made, use, import, offer to sell and sell ("Utilize") this
+ * software, but solely to the extent that any such patent is necessary
+ * to Utilize the software alone, or in combination with an operating
+ * system licensed under an approved Open Source license as listed by
+ * the Open Source Initiative at http://opensource.org/licenses.
+ * The patent license shall not apply to any other combinations which
+ * include this software. No hardware per se is licensed hereunder.
+ *
+ * DISCLAIMER.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host model of the video processor. A CPU backend samples the source
+ * the way one VPP pass maps regions and rotations, so the engine's pool,
+ * target and reference handling can be checked without VA. The VA entry
+ * points are defined to fail, which the real backend must survive.
+ * Exits non-zero on the first failed check.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <VideoProcessor.h>
+#include <IntelMemoryTracker.h>
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+VADisplay vaGetDisplay(void *native_dpy) { return 0; }
+int vaMaxNumEntrypoints(VADisplay dpy) { return 0; }
+VAStatus vaInitialize(VADisplay dpy, int *major, int *minor)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaTerminate(VADisplay dpy) { return VA_STATUS_SUCCESS; }
+VAStatus vaQueryConfigEntrypoints(VADisplay dpy, VAProfile profile,
+                                  VAEntrypoint *entrypoints, int *num)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaCreateConfig(VADisplay dpy, VAProfile profile,
+                        VAEntrypoint entrypoint, VAConfigAttrib *attribs,
+                        int num, VAConfigID *config)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaDestroyConfig(VADisplay dpy, VAConfigID config)
+{
+    return VA_STATUS_SUCCESS;
+}
+VAStatus vaCreateContext(VADisplay dpy, VAConfigID config, int width,
+                         int height, int flag, VASurfaceID *targets,
+                         int num, VAContextID *context)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaDestroyContext(VADisplay dpy, VAContextID context)
+{
+    return VA_STATUS_SUCCESS;
+}
+VAStatus vaCreateBuffer(VADisplay dpy, VAContextID context,
+                        VABufferType type, unsigned int size,
+                        unsigned int num, void *data, VABufferID *buf)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaDestroyBuffer(VADisplay dpy, VABufferID buf)
+{
+    return VA_STATUS_SUCCESS;
+}
+VAStatus vaMapBuffer(VADisplay dpy, VABufferID buf, void **data)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaUnmapBuffer(VADisplay dpy, VABufferID buf)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaBeginPicture(VADisplay dpy, VAContextID context,
+                        VASurfaceID target)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaRenderPicture(VADisplay dpy, VAContextID context,
+                         VABufferID *buffers, int num)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaEndPicture(VADisplay dpy, VAContextID context)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaSyncSurface(VADisplay dpy, VASurfaceID surface)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaDestroySurfaces(VADisplay dpy, VASurfaceID *surfaces, int num)
+{
+    return VA_STATUS_SUCCESS;
+}
+VAStatus vaQueryVideoProcFilters(VADisplay dpy, VAContextID context,
+                                 VAProcFilterType *filters,
+                                 unsigned int *num)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaQueryVideoProcFilterCaps(VADisplay dpy, VAContextID context,
+                                    VAProcFilterType type, void *caps,
+                                    unsigned int *num)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaQueryVideoProcPipelineCaps(VADisplay dpy, VAContextID context,
+                                      VABufferID *filters,
+                                      unsigned int num,
+                                      VAProcPipelineCaps *caps)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+VAStatus vaCreateSurfacesWithAttribute(VADisplay dpy, int width,
+                                       int height, int format, int num,
+                                       VASurfaceID *surfaces,
+                                       VASurfaceAttributeTPI *attrib)
+{
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+
+static IntelWsbm *sWsbm;
+// memory of the gralloc handles the test hands out
+static std::map<uint32_t, uint8_t*> sGralloc;
+
+static uint8_t* getMemory(const VppSurface& s)
+{
+    if (s.memory == VPP_MEMORY_KERNEL)
+        return sWsbm->getMemory(s.handle);
+    return sGralloc.count(s.handle) ? sGralloc[s.handle] : NULL;
+}
+
+/*
+ * CPU backend, nearest sample of the NV12 luma plane (or the first byte
+ * of RGB pixels) from the source region into the rotated target region
+ */
+class MockBackend : public VppBackend {
+public:
+    MockBackend(bool deinterlace)
+        : mNext(1), mOpened(false), mDeinterlace(deinterlace),
+          contextSurface(0), live(0), failRender(0), references(0) {}
+    virtual bool open() { mOpened = true; return true; }
+    virtual void close() { mOpened = false; contextSurface = 0; }
+    virtual uint32_t createSurface(const VppSurface& surface) {
+        CHECK(mOpened && getMemory(surface));
+        mSurfaces[mNext] = surface;
+        live++;
+        return mNext++;
+    }
+    virtual void destroySurface(uint32_t surface) {
+        if (!surface)
+            return;
+        CHECK(mSurfaces.count(surface));
+        // VA keeps using the surface its context was created on, the
+        // context is unusable without it
+        if (surface == contextSurface)
+            contextSurface = 0;
+        mSurfaces.erase(surface);
+        live--;
+    }
+    virtual bool createContext(uint32_t target, int width, int height,
+                               VppCaps& caps) {
+        CHECK(mSurfaces.count(target));
+        contextSurface = target;
+        caps.rotations = 0xf;
+        caps.deinterlace = mDeinterlace;
+        caps.forwardReferences = 1;
+        return true;
+    }
+    virtual bool render(const VppPass& pass) {
+        CHECK(contextSurface && mSurfaces.count(contextSurface));
+        if (failRender) {
+            failRender--;
+            return false;
+        }
+        if (pass.reference) {
+            // the previous frame must still be there
+            CHECK(getMemory(mSurfaces[pass.reference]));
+            references++;
+        }
+
+        VppSurface& s = mSurfaces[pass.source];
+        VppSurface& t = mSurfaces[pass.target];
+        uint8_t *src = getMemory(s), *dst = getMemory(t);
+        int bpp = s.fourcc == VA_FOURCC_NV12 ? 1 : 4;
+        VppRect sr = pass.sourceRegion, tr = pass.targetRegion;
+        if (!sr.width) {
+            sr.width = s.cropWidth;
+            sr.height = s.cropHeight;
+        }
+        if (!tr.width) {
+            tr.width = t.cropWidth;
+            tr.height = t.cropHeight;
+        }
+        bool swap = pass.rotation == VA_ROTATION_90 ||
+                    pass.rotation == VA_ROTATION_270;
+        int rw = swap ? tr.height : tr.width;
+        int rh = swap ? tr.width : tr.height;
+
+        for (int y = 0; y < tr.height; y++) {
+            for (int x = 0; x < tr.width; x++) {
+                // position in the unrotated output
+                int u = x, v = y;
+                if (pass.rotation == VA_ROTATION_90) {
+                    u = y;
+                    v = tr.width - 1 - x;
+                } else if (pass.rotation == VA_ROTATION_180) {
+                    u = tr.width - 1 - x;
+                    v = tr.height - 1 - y;
+                } else if (pass.rotation == VA_ROTATION_270) {
+                    u = tr.height - 1 - y;
+                    v = x;
+                }
+                int sx = sr.x + (2 * u + 1) * sr.width / (2 * rw);
+                int sy = sr.y + (2 * v + 1) * sr.height / (2 * rh);
+                dst[(tr.y + y) * t.stride + tr.x + x] =
+                    src[sy * s.stride * bpp + sx * bpp];
+            }
+        }
+        return true;
+    }
+private:
+    std::map<uint32_t, VppSurface> mSurfaces;
+    uint32_t mNext;
+    bool mOpened;
+    bool mDeinterlace;
+public:
+    uint32_t contextSurface;
+    int live;
+    int failRender;
+    int references;
+};
+
+static VppRequest nv12Request(uint32_t handle, int width, int height,
+                              int stride)
+{
+    VppRequest r;
+    memset(&r, 0, sizeof(r));
+    r.source.memory = VPP_MEMORY_KERNEL;
+    r.source.handle = handle;
+    r.source.fourcc = VA_FOURCC_NV12;
+    r.source.width = width;
+    r.source.height = height;
+    r.source.stride = stride;
+    r.source.cropWidth = width;
+    r.source.cropHeight = height;
+    return r;
+}
+
+// a decoded frame in a TTM buffer the test owns, luma filled by @seed
+static uint32_t createFrame(void **buf, int stride, int width, int height,
+                            int seed)
+{
+    CHECK(sWsbm->allocateTTMBuffer(stride * height * 3 / 2, 0, buf));
+    uint32_t handle = sWsbm->getKBufHandle(*buf);
+    uint8_t *mem = sWsbm->getMemory(handle);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            mem[y * stride + x] = (uint8_t)((x / 16 + y / 16 * 7 + seed) & 0xff);
+    return handle;
+}
+
+int main(void)
+{
+    IntelWsbm wsbm;
+    IntelMemoryTracker& mem = IntelMemoryTracker::getInstance();
+    const int W = 1920, H = 1088, S = VideoProcessor::getStride(false, W);
+    VppOutput o;
+    void *frames[2];
+    uint32_t handles[5];
+    uint8_t *src, *t;
+
+    sWsbm = &wsbm;
+    uint32_t frame = createFrame(&frames[0], S, W, H, 0);
+    src = wsbm.getMemory(frame);
+
+    MockBackend *mock = new MockBackend(true);
+    VideoProcessor vp(&wsbm, mock);
+    CHECK(vp.initialize());
+
+    // rotation only, the whole buffer into a H x W target
+    VppRequest r = nv12Request(frame, W, H, S);
+    r.transform = HAL_TRANSFORM_ROT_90;
+    r.width = H;
+    r.height = W;
+    CHECK(vp.process(r, o));
+    CHECK(o.ops == VPP_OP_ROTATE && o.width == H && o.height == W &&
+          o.stride == 2048);
+    t = wsbm.getMemory(o.khandle);
+    // 90: out(x, y) = in(y, H - 1 - x)
+    for (int y = 0; y < W; y += 37)
+        for (int x = 0; x < H; x += 29)
+            CHECK(t[y * o.stride + x] == src[(H - 1 - x) * S + y]);
+
+    // four pooled buffers round robin
+    handles[0] = o.khandle;
+    for (int i = 1; i < 5; i++) {
+        CHECK(vp.process(r, o));
+        handles[i] = o.khandle;
+    }
+    CHECK(handles[4] == handles[0] && handles[1] != handles[0]);
+    CHECK(wsbm.allocs == 1 + 4);
+
+    // downscale over the overlay limit, rotated and deinterlaced
+    VppRequest d = nv12Request(frame, W, H, S);
+    d.transform = HAL_TRANSFORM_ROT_270;
+    d.crop.width = W;
+    d.crop.height = 1080;
+    d.width = 120;
+    d.height = 200;
+    d.deinterlace = true;
+    CHECK(vp.process(d, o));
+    CHECK(o.ops == (VPP_OP_SCALE | VPP_OP_ROTATE | VPP_OP_DEINTERLACE));
+    CHECK(o.width == 120 && o.height == 200);
+    // restarted for the new pool size
+    CHECK(wsbm.frees == 4);
+    t = wsbm.getMemory(o.khandle);
+    // 270: out(x, y) = in(W - 1 - y, x), scaled
+    for (int y = 0; y < 200; y++) {
+        for (int x = 0; x < 120; x++) {
+            int u = 200 - 1 - y, v = x;
+            int sx = (2 * u + 1) * W / (2 * 200);
+            int sy = (2 * v + 1) * 1080 / (2 * 120);
+            CHECK(t[y * o.stride + x] == src[sy * S + sx]);
+        }
+    }
+
+    // the decoder recycles the previous frame while it's the reference
+    CHECK(wsbm.wraps == 1);
+    d.source.handle = createFrame(&frames[1], S, W, H, 1);
+    CHECK(wsbm.destroyTTMBuffer(frames[0]));
+    CHECK(vp.process(d, o));
+    CHECK(mock->references == 1);
+    CHECK(wsbm.wraps == 2 && wsbm.unrefs == 1);
+    CHECK(wsbm.getMemory(frame) == NULL);
+
+    // caller owned target, CSC from RGB. The context outlives the target
+    vp.deinitialize();
+    CHECK(wsbm.unrefs == 2 && mock->live == 0);
+    uint8_t *rgb = (uint8_t*)calloc(1, 640 * 480 * 4);
+    uint8_t *yuv = (uint8_t*)calloc(1, 640 * 480 * 3 / 2);
+    sGralloc[9] = rgb;
+    sGralloc[10] = yuv;
+    for (int i = 0; i < 640 * 480; i++)
+        rgb[i * 4] = (uint8_t)i;
+    VppRequest c;
+    memset(&c, 0, sizeof(c));
+    c.source.memory = VPP_MEMORY_GRALLOC;
+    c.source.handle = 9;
+    c.source.fourcc = VideoProcessor::getFourcc(HAL_PIXEL_FORMAT_BGRA_8888);
+    c.source.width = c.source.cropWidth = 640;
+    c.source.height = c.source.cropHeight = 480;
+    c.source.stride = 640;
+    c.crop.width = 640;
+    c.crop.height = 480;
+    c.width = 640;
+    c.height = 480;
+    VppSurface tg;
+    memset(&tg, 0, sizeof(tg));
+    tg.memory = VPP_MEMORY_GRALLOC;
+    tg.handle = 10;
+    tg.fourcc = VA_FOURCC_NV12;
+    tg.width = tg.cropWidth = 640;
+    tg.height = tg.cropHeight = 480;
+    tg.stride = 640;
+    CHECK(vp.process(c, tg));
+    CHECK(mock->contextSurface && mock->live == 1);
+    CHECK(memcmp(yuv, rgb, 1) == 0 && yuv[640 * 479 + 639] == rgb[(640 * 480 - 1) * 4]);
+    sGralloc.erase(10);
+    free(yuv);
+    tg.handle = 11;
+    sGralloc[11] = yuv = (uint8_t*)calloc(1, 640 * 480 * 3 / 2);
+    CHECK(vp.process(c, tg));
+    CHECK(yuv[640 * 100 + 100] == rgb[(640 * 100 + 100) * 4]);
+
+    // a failed pass stops VA and frees the pool and the reference
+    mock->failRender = 1;
+    CHECK(!vp.process(d, o));
+    CHECK(vp.getBufferBytes() == 0 && mock->live == 0);
+    CHECK(wsbm.wraps == wsbm.unrefs);
+    CHECK(vp.process(d, o));
+
+    char buf[1024];
+    int len = 0;
+    vp.dump(buf, sizeof(buf), &len);
+    fputs(buf, stdout);
+
+    vp.deinitialize();
+    CHECK(mock->live == 0 && wsbm.wraps == wsbm.unrefs);
+    CHECK(wsbm.destroyTTMBuffer(frames[1]));
+    CHECK(wsbm.allocs == wsbm.frees && mem.getBytes() == 0);
+
+    // VA missing, the real backend fails cleanly
+    VideoProcessor va(&wsbm);
+    CHECK(va.initialize());
+    CHECK(!va.process(r, o) && wsbm.allocs == wsbm.frees);
+    CHECK(!va.process(c, tg));
+
+    free(rgb);
+    free(yuv);
+    puts("ok");
+    return 0;
+}
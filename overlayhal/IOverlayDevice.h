@@ -16,8 +16,10 @@
 #ifndef __I_OVERLAY_DEVICE_H__
 #define __I_OVERLAY_DEVICE_H__
 
-/*only one overlay data buffer for testing*/
-#define PVR_OVERLAY_BUFFER_NUM          1
+/*data buffer queue depth, default and limits*/
+#define PVR_OVERLAY_BUFFER_NUM          3
+#define PVR_OVERLAY_MIN_BUFFER_NUM      2
+#define PVR_OVERLAY_MAX_BUFFER_NUM      4
 #define PVR_OVERLAY_MAX_WIDTH           2048
 #define PVR_OVERLAY_MAX_HEIGHT          2048
 
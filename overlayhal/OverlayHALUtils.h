@@ -31,6 +31,7 @@ enum {
     MDFLD_OVERLAY_Y_STRIDE,
     MDFLD_OVERLAY_RESET,
     MDFLD_OVERLAY_HDMI_STATUS,
+    MDFLD_OVERLAY_BUFFER_COUNT,
 };
 
 /*HDMI status for MDFLD_OVERLAY_HDMI_STATUS parameter setting*/
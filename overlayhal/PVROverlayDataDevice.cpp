@@ -22,12 +22,41 @@
 #include <cutils/log.h>
 #include <cutils/atomic.h>
 #include <math.h>
+#include <time.h>
+
+static int64_t overlay_time_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*OVADD is written without waiting for vblank, the old buffer is scanned
+  out for up to a frame of the current mode*/
+#define OVERLAY_FLIP_SLACK_NS   500000LL
+
+/*mHasBuffer runs on CLOCK_MONOTONIC, deadline is an overlay_time_ns()*/
+static void overlay_cond_wait_until(pthread_cond_t *cond, pthread_mutex_t *lock,
+                                    int64_t deadline)
+{
+    struct timespec ts;
+
+    ts.tv_sec = deadline / 1000000000LL;
+    ts.tv_nsec = deadline % 1000000000LL;
+    pthread_cond_timedwait(cond, lock, &ts);
+}
 
 PVROverlayDataDevice::PVROverlayDataDevice()
 {
+    pthread_condattr_t attr;
+
     LOGV("%s: creating data device...\n", __func__);
     pthread_mutex_init(&mLock, NULL);
-    pthread_cond_init(&mHasBuffer, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mHasBuffer, &attr);
+    pthread_condattr_destroy(&attr);
 
     /*Allocate overlay control buffer*/
     memset(&mControlBlkBuffer, 0, sizeof(mControlBlkBuffer));
@@ -44,6 +73,24 @@ PVROverlayDataDevice::PVROverlayDataDevice()
     /*clean up external buffer*/
     memset(&mExternalBuffer, 0, sizeof(mExternalBuffer));
 
+    /*data buffers are allocated in initialize()*/
+    memset(mDataBuffers, 0, sizeof(mDataBuffers));
+    for (int i = 0; i < PVR_OVERLAY_MAX_BUFFER_NUM; i++) {
+        mBufferState[i] = BUFFER_FREE;
+        mBufferAllocated[i] = false;
+        mRetireTime[i] = 0;
+    }
+    mNumBuffers = 0;
+    mOnScreenBuffer = -1;
+    mDequeueCount = 0;
+    mDequeueWaits = 0;
+    mDequeueWaitNs = 0;
+    mMaxDequeueWaitNs = 0;
+
+    memset(&mPostState, 0, sizeof(mPostState));
+    mPostsFull = 0;
+    mPostsFast = 0;
+
     mControlBlock = (struct pvr_overlay_control_block_t *)mControlBlkBuffer.overlayCPUAddress;
 
     LOGV("%s: finish successfully. mControlBlock %p\n",
@@ -59,18 +106,31 @@ PVROverlayDataDevice::~PVROverlayDataDevice()
     /*reset overlay*/
     resetOverlay();
 
+    /*the last buffer is scanned out till the overlay went off*/
+    pthread_mutex_lock(&mLock);
+    for (;;) {
+        int64_t next = retireFlipped_l(overlay_time_ns());
+        if (!next)
+            break;
+        overlay_cond_wait_until(&mHasBuffer, &mLock, next);
+    }
+    pthread_mutex_unlock(&mLock);
+
     /*remove overlay control buffer and data buffers*/
     bool ret = PVROverlayHAL::Instance().destroyOverlayBuffer(&mControlBlkBuffer);
     if(ret == false)
         LOGE("%s: cannot destroy overlay control buffer %p\n",
             __func__, &mControlBlkBuffer);
 
-    for(int i=0; i<PVR_OVERLAY_BUFFER_NUM; i++) {
-        bool ret = PVROverlayHAL::Instance().destroyOverlayBuffer(&mDataBuffers[i]);
-        if(ret == false)
-            LOGE("%s: cannot destroy overlay data buffer %d\n",
-                __func__, i);
-    }
+    for(int i=0; i<PVR_OVERLAY_MAX_BUFFER_NUM; i++)
+        destroyDataBuffer(i);
+
+    LOGI("%s: %d dequeues, %d waited, average wait %lld us, max %lld us\n",
+         __func__, mDequeueCount, mDequeueWaits,
+         mDequeueWaits ? mDequeueWaitNs / mDequeueWaits / 1000 : 0,
+         mMaxDequeueWaitNs / 1000);
+    LOGI("%s: %d full register setups, %d offset-only posts\n",
+         __func__, mPostsFull, mPostsFast);
 
     /*
      * close shared context
@@ -127,8 +187,8 @@ bool PVROverlayDataDevice::initialize(struct pvr_overlay_handle_t * overlay)
             __func__);
     }
 
-    /*allocate data buffers*/
-    for(i=0; i<PVR_OVERLAY_BUFFER_NUM; i++) {
+    /*setup all slots, only the default queue depth is allocated now*/
+    for(i=0; i<PVR_OVERLAY_MAX_BUFFER_NUM; i++) {
         pvrOverlayBuffer = &mDataBuffers[i];
         pvrOverlayBuffer->width = overlay->width;
         pvrOverlayBuffer->height = overlay->height;
@@ -143,14 +203,16 @@ bool PVROverlayDataDevice::initialize(struct pvr_overlay_handle_t * overlay)
         pvrOverlayBuffer->overlayBuffer = NULL;
         pvrOverlayBuffer->overlayIndex = overlay->overlayIndex;
         pvrOverlayBuffer->gttAlign = 0;
+        mBufferState[i] = BUFFER_FREE;
+    }
 
-        /*request Overlay HAL to allocate overlay buffer. (lock free)*/
-        ret = PVROverlayHAL::Instance().allocateOverlayBuffer(pvrOverlayBuffer);
-        if(ret == false) {
-            LOGE("%s: allocate data buffer %d failed\n", __func__, i);
+    for(i=0; i<PVR_OVERLAY_BUFFER_NUM; i++) {
+        ret = allocateDataBuffer(i);
+        if(ret == false)
             goto mem_err;
-        }
     }
+    mNumBuffers = PVR_OVERLAY_BUFFER_NUM;
+    mOnScreenBuffer = -1;
 
     /*init external buffer*/
     mExternalBuffer.width = overlay->width;
@@ -169,10 +231,7 @@ bool PVROverlayDataDevice::initialize(struct pvr_overlay_handle_t * overlay)
     /*use overlay HAL data buffer by default*/
     mUsingExternalBuffer = false;
 
-    mOverlayIndex = pvrOverlayBuffer->overlayIndex;
-
-    /*update free buffer count*/
-    mNumFreeBuffers = PVR_OVERLAY_BUFFER_NUM;
+    mOverlayIndex = overlay->overlayIndex;
 
     /*reset overlay*/
     resetOverlay();
@@ -186,19 +245,13 @@ bool PVROverlayDataDevice::initialize(struct pvr_overlay_handle_t * overlay)
     this->unlock();
 
     LOGV("PVROverlayDataDevice::%s: initialized successfully(%s).\n",
-        __func__, pvrOverlayBuffer->overlayIndex ? "C" : "A");
+        __func__, mOverlayIndex ? "C" : "A");
 
     return true;
 mem_err:
     /*destroy buffers which have been allocated*/
-    for(j=i-1; j>=0; j--) {
-        pvrOverlayBuffer = &mDataBuffers[j];
-
-        bool ret = PVROverlayHAL::Instance().destroyOverlayBuffer(pvrOverlayBuffer);
-        if(ret == false) {
-            LOGE("%s: destroy data buffer %d failed\n", __func__, j);
-        }
-    }
+    for(j=i-1; j>=0; j--)
+        destroyDataBuffer(j);
 drm_err:
     /*TODO: destroy shared context*/
 
@@ -217,40 +270,82 @@ void PVROverlayDataDevice::unlock()
 
 }
 
-bool PVROverlayDataDevice::post(struct pvr_overlay_buffer_t * buffer)
+/**
+ * Program the overlay registers for a buffer. From frame to frame only
+ * the buffer offsets move, everything else is derived again when the
+ * format, size, stride, destination window or display mode changed.
+ * Returns true if the filter coefficients need to be reloaded.
+ */
+bool PVROverlayDataDevice::registerSetup(struct pvr_overlay_buffer_t * buf)
 {
-    if(!buffer) {
-        LOGE("%s: invalid buffer\n", __func__);
-        return false;
+    int x, y, w, h;
+    bool loadCoefficients;
+
+    /*pipe switching is flagged by the HDMI status event*/
+    if (PVROverlayHAL::Instance().drmModeChanged(&mControlBlkBuffer,
+                                                 mControlBlock))
+        mPostState.valid = false;
+
+    /*get dst position from HAL, keep the current one if unavailable*/
+    if (PVROverlayHAL::Instance().getPosition(mOverlayIndex,
+                                              &x, &y, &w, &h) < 0) {
+        x = dstX;
+        y = dstY;
+        w = dstWidth;
+        h = dstHeight;
     }
 
-    LOGV("%s: pBase %p\n", __func__, buffer->overlayCPUAddress);
-
-    uint32_t format = buffer->format;
-
-    this->lock();
-
-    /**
-     * Check whether we need do pipe switching
-     * FIXME: only do this when HDMI hotplug is detected.
-     */
-    PVROverlayHAL::Instance().drmModeChanged(&mControlBlkBuffer,
-                                            mControlBlock);
+    bufferOffsetSetup(buf);
+
+    if (mPostState.valid &&
+        mPostState.format == buf->format &&
+        mPostState.width == buf->width &&
+        mPostState.height == buf->height &&
+        mPostState.yStride == buf->yStride &&
+        mPostState.uvStride == buf->uvStride &&
+        mPostState.x == x && mPostState.y == y &&
+        mPostState.w == w && mPostState.h == h) {
+        sourceStrideSetup();
+        mPostsFast++;
+        return false;
+    }
 
-    formatOverlayBuffer(buffer);
-    bufferOffsetSetup(buffer);
-    coordinateSetup(buffer);
-    scalingSetup(buffer->width, buffer->height, dstWidth, dstHeight);
+    LOGV("%s: overlay geometry changed\n", __func__);
+
+    /*registers rewritten from scratch, make sure h/w picks up all*/
+    loadCoefficients = !mPostState.valid;
+
+    dstX = x;
+    dstY = y;
+    dstWidth = w;
+    dstHeight = h;
+
+    coordinateSetup(buf);
+    if (scalingSetup(buf->width, buf->height, dstWidth, dstHeight))
+        loadCoefficients = true;
+
+    mControlBlock->OSTRIDE = ((buf->yStride) & (~0x3f)) |
+                (((buf->uvStride) & (~0x3f)) << 16);
+    commandSetup(buf->format);
+
+    mPostState.format = buf->format;
+    mPostState.width = buf->width;
+    mPostState.height = buf->height;
+    mPostState.yStride = buf->yStride;
+    mPostState.uvStride = buf->uvStride;
+    mPostState.x = x;
+    mPostState.y = y;
+    mPostState.w = w;
+    mPostState.h = h;
+    mPostState.valid = true;
+    mPostsFull++;
+
+    return loadCoefficients;
+}
 
-    mControlBlock->OSTRIDE = ((buffer->yStride) & (~0x3f)) |
-                (((buffer->uvStride) & (~0x3f)) << 16);
+void PVROverlayDataDevice::commandSetup(uint32_t format)
+{
     mControlBlock->OCMD = 0x1;
-    mControlBlock->OCMD &= ~OVERLAY_PACKED_ORDER_MASK;
-    mControlBlock->OCMD &= ~OVERLAY_FORMAT_MASK;
-    mControlBlock->OCMD &= ~((0x1 << 1) | (0x3 << 2) | (0x1 << 5));
-    mControlBlock->OCMD &= ~(0x3 << 17);
-    mControlBlock->OCMD &= ~(0x1 << 19);
-    mControlBlock->OCMD |= ((0x1 << 0) | (0x0 << 1)) ;
 
     switch (format) {
     case OVERLAY_FORMAT_YCbYCr_420_I:       /*I420*/
@@ -260,18 +355,32 @@ bool PVROverlayDataDevice::post(struct pvr_overlay_buffer_t * buffer)
     case OVERLAY_FORMAT_YCbCr_420_SP:       /*NV12*/
         mControlBlock->OCMD |= OVERLAY_FORMAT_PLANAR_NV12_2;
         break;
-        case OVERLAY_FORMAT_YCbYCr_422_I:   /*YUY2*/
+    case OVERLAY_FORMAT_YCbYCr_422_I:       /*YUY2*/
         mControlBlock->OCMD |= OVERLAY_FORMAT_PACKED_YUV422;
         mControlBlock->OCMD |= OVERLAY_PACKED_ORDER_YUY2;
         break;
-        case OVERLAY_FORMAT_CbYCrY_422_I:   /*UYVY*/
+    case OVERLAY_FORMAT_CbYCrY_422_I:       /*UYVY*/
         mControlBlock->OCMD |= OVERLAY_FORMAT_PACKED_YUV422;
         mControlBlock->OCMD |= OVERLAY_PACKED_ORDER_UYVY;
-            break;
+        break;
     default:
         LOGE("%s: unsupported format %d\n", __func__, format);
     }
+}
 
+bool PVROverlayDataDevice::post(struct pvr_overlay_buffer_t * buffer)
+{
+    if(!buffer) {
+        LOGE("%s: invalid buffer\n", __func__);
+        return false;
+    }
+
+    LOGV("%s: pBase %p\n", __func__, buffer->overlayCPUAddress);
+
+    this->lock();
+
+    formatOverlayBuffer(buffer);
+    bool loadCoefficients = registerSetup(buffer);
 
     this->unlock();
 
@@ -279,7 +388,7 @@ bool PVROverlayDataDevice::post(struct pvr_overlay_buffer_t * buffer)
 
     bool ret = PVROverlayHAL::Instance().updateOverlay(&mControlBlkBuffer,
                             mControlBlock,
-                            true);
+                            loadCoefficients);
     if(ret == false) {
         LOGE("%s: post overlay failed\n", __func__);
         return false;
@@ -303,105 +412,191 @@ bool PVROverlayDataDevice::postExternal(uint32_t device, uint32_t handle)
     }
 
     struct pvr_overlay_buffer_t * buffer = &mExternalBuffer;
-    uint32_t format = buffer->format;
 
     this->lock();
 
-    /**
-     * Check whether we need do pipe switching
-     * FIXME: only do this when HDMI hotplug is detected.
-     */
-    PVROverlayHAL::Instance().drmModeChanged(&mControlBlkBuffer,
-                                            mControlBlock);
-
     /*mask data device to use external data buffer*/
     mUsingExternalBuffer = true;
 
-    bufferOffsetSetup(buffer);
-    coordinateSetup(buffer);
-    scalingSetup(buffer->width, buffer->height, dstWidth, dstHeight);
-
-    mControlBlock->OSTRIDE = ((buffer->yStride) & (~0x3f)) |
-                    (((buffer->uvStride) & (~0x3f)) << 16);
-
-    mControlBlock->OCMD = 0x1;
-    //mControlBlock->OCMD &= ~OVERLAY_PACKED_ORDER_MASK;
-    //mControlBlock->OCMD &= ~OVERLAY_FORMAT_MASK;
-    //mControlBlock->OCMD &= ~((0x1 << 1) | (0x3 << 2) | (0x1 << 5));
-    //mControlBlock->OCMD &= ~(0x3 << 17);
-    //mControlBlock->OCMD &= ~(0x1 << 19);
-    //mControlBlock->OCMD |= ((0x1 << 0) | (0x0 << 1));
-
-    switch (format) {
-    case OVERLAY_FORMAT_YCbYCr_420_I:           /*I420*/
-        //case OVERLAY_FORMAT_CbYCrY_420_I:     /*YV12*/
-        mControlBlock->OCMD |= OVERLAY_FORMAT_PLANAR_YUV420;
-        break;
-    case OVERLAY_FORMAT_YCbCr_420_SP:           /*NV12*/
-        mControlBlock->OCMD |= OVERLAY_FORMAT_PLANAR_NV12_2;
-        break;
-        case OVERLAY_FORMAT_YCbYCr_422_I:       /*YUY2*/
-        mControlBlock->OCMD |= OVERLAY_FORMAT_PACKED_YUV422;
-        mControlBlock->OCMD |= OVERLAY_PACKED_ORDER_YUY2;
-        break;
-        case OVERLAY_FORMAT_CbYCrY_422_I:       /*UYVY*/
-        mControlBlock->OCMD |= OVERLAY_FORMAT_PACKED_YUV422;
-        mControlBlock->OCMD |= OVERLAY_PACKED_ORDER_UYVY;
-        break;
-    default:
-        LOGE("%s: unsupported format %d\n", __func__, format);
-    }
+    bool loadCoefficients = registerSetup(buffer);
 
     this->unlock();
 
     LOGV("%s: posting buffer %p\n", __func__, buffer);
 
     ret = PVROverlayHAL::Instance().updateOverlay(&mControlBlkBuffer,
-                        mControlBlock, true);
+                        mControlBlock, loadCoefficients);
     if(ret == false) {
         LOGE("%s: post overlay failed\n", __func__);
         return false;
     }
 
+    /*our own data buffer is no longer scanned out*/
+    pthread_mutex_lock(&mLock);
+    replaceOnScreen_l(-1);
+    pthread_mutex_unlock(&mLock);
+
     LOGV("%s: overlay posted successfully\n", __func__);
 
     return true;
 }
 
+int PVROverlayDataDevice::bufferIndex(struct pvr_overlay_buffer_t * buffer)
+{
+    int index = buffer - mDataBuffers;
+
+    if (index < 0 || index >= PVR_OVERLAY_MAX_BUFFER_NUM ||
+        buffer != &mDataBuffers[index])
+        return -1;
+
+    return index;
+}
+
+bool PVROverlayDataDevice::allocateDataBuffer(int index)
+{
+    if (mBufferAllocated[index])
+        return true;
+
+    /*request Overlay HAL to allocate overlay buffer. (lock free)*/
+    bool ret = PVROverlayHAL::Instance().allocateOverlayBuffer(&mDataBuffers[index]);
+    if(ret == false) {
+        LOGE("%s: allocate data buffer %d failed\n", __func__, index);
+        return false;
+    }
+
+    mBufferAllocated[index] = true;
+    mBufferState[index] = BUFFER_FREE;
+    return true;
+}
+
+void PVROverlayDataDevice::destroyDataBuffer(int index)
+{
+    if (!mBufferAllocated[index])
+        return;
+
+    bool ret = PVROverlayHAL::Instance().destroyOverlayBuffer(&mDataBuffers[index]);
+    if(ret == false)
+        LOGE("%s: cannot destroy overlay data buffer %d\n", __func__, index);
+
+    mBufferAllocated[index] = false;
+    mBufferState[index] = BUFFER_FREE;
+}
+
+/*mLock held. slot goes back to the free list, or away if the queue shrank*/
+void PVROverlayDataDevice::retireBuffer_l(int index)
+{
+    mBufferState[index] = BUFFER_FREE;
+    mDataBuffers[index].vsyncState = PVR_OVERLAY_VSYNC_INIT;
+
+    if (index >= mNumBuffers)
+        destroyDataBuffer(index);
+
+    pthread_cond_signal(&mHasBuffer);
+}
+
+/*mLock held. the slot on screen keeps being scanned out till the vblank
+  after the new OVADD, it is only retired once that passed*/
+void PVROverlayDataDevice::replaceOnScreen_l(int index)
+{
+    int old = mOnScreenBuffer;
+
+    mOnScreenBuffer = index;
+    if (old < 0 || old == index)
+        return;
+
+    int64_t flip = PVROverlayHAL::Instance().getFramePeriodNs();
+    mBufferState[old] = BUFFER_FLIPPING;
+    mRetireTime[old] = overlay_time_ns() + flip + OVERLAY_FLIP_SLACK_NS;
+}
+
+/*mLock held. retires the flipped slots, returns the time the next one is
+  due or 0 if none is left*/
+int64_t PVROverlayDataDevice::retireFlipped_l(int64_t now)
+{
+    int64_t next = 0;
+
+    for (int i = 0; i < PVR_OVERLAY_MAX_BUFFER_NUM; i++) {
+        if (mBufferState[i] != BUFFER_FLIPPING)
+            continue;
+        if (now >= mRetireTime[i])
+            retireBuffer_l(i);
+        else if (!next || mRetireTime[i] < next)
+            next = mRetireTime[i];
+    }
+
+    return next;
+}
+
 struct pvr_overlay_buffer_t * PVROverlayDataDevice::getBuffer()
 {
+    int64_t start = 0;
+    int index = -1;
+
     LOGV("%s: getting buffer...\n", __func__);
 
     pthread_mutex_lock(&mLock);
 
-    if(mNumFreeBuffers <= 0) {
-        LOGV("%s: no free buffer. waiting...\n", __func__);
-        pthread_cond_wait(&mHasBuffer, &mLock);
-        LOGV("%s: free buffer avaliable.\n", __func__);
-    }
+    for (;;) {
+        int64_t now = overlay_time_ns();
+        int64_t next = retireFlipped_l(now);
 
-    mNumFreeBuffers--;
+        for (int i = 0; i < mNumBuffers; i++) {
+            if (mBufferAllocated[i] && mBufferState[i] == BUFFER_FREE) {
+                index = i;
+                break;
+            }
+        }
+        if (index >= 0)
+            break;
 
-    /*TODO: return the first free buffer*/
+        /*every slot is decoded into, queued, on screen or flipping*/
+        if (!start) {
+            LOGV("%s: no free buffer. waiting...\n", __func__);
+            start = now;
+        }
+        if (next)
+            overlay_cond_wait_until(&mHasBuffer, &mLock, next);
+        else
+            pthread_cond_wait(&mHasBuffer, &mLock);
+    }
+
+    mBufferState[index] = BUFFER_DEQUEUED;
+    mDequeueCount++;
+    if (start) {
+        int64_t wait = overlay_time_ns() - start;
+        mDequeueWaits++;
+        mDequeueWaitNs += wait;
+        if (wait > mMaxDequeueWaitNs)
+            mMaxDequeueWaitNs = wait;
+    }
 
     pthread_mutex_unlock(&mLock);
 
-    LOGV("%s: free buffer %p avaliable.\n", __func__, &mDataBuffers[0]);
+    LOGV("%s: free buffer %p avaliable.\n", __func__, &mDataBuffers[index]);
 
-    return &mDataBuffers[0];
+    return &mDataBuffers[index];
 }
 
+/*return a dequeued buffer without showing it*/
 bool PVROverlayDataDevice::putBuffer(struct pvr_overlay_buffer_t * buffer)
 {
     LOGV("%s: putting buffer ...\n", __func__);
 
-    pthread_mutex_lock(&mLock);
+    int index = bufferIndex(buffer);
+    if (index < 0) {
+        LOGE("%s: unknown buffer %p\n", __func__, buffer);
+        return false;
+    }
 
-    mNumFreeBuffers++;
+    pthread_mutex_lock(&mLock);
 
-    /*TODO: put the buffer to the right place*/
+    if (mBufferState[index] != BUFFER_DEQUEUED) {
+        LOGE("%s: buffer %d is not dequeued\n", __func__, index);
+        pthread_mutex_unlock(&mLock);
+        return false;
+    }
 
-    pthread_cond_signal(&mHasBuffer);
+    retireBuffer_l(index);
 
     pthread_mutex_unlock(&mLock);
 
@@ -410,6 +605,76 @@ bool PVROverlayDataDevice::putBuffer(struct pvr_overlay_buffer_t * buffer)
     return true;
 }
 
+/**
+ * post a dequeued buffer. It stays on screen until the next flip replaces
+ * it, the buffer it replaces goes back to the free list a frame later.
+ */
+bool PVROverlayDataDevice::queueBuffer(struct pvr_overlay_buffer_t * buffer)
+{
+    int index = bufferIndex(buffer);
+    if (index < 0) {
+        LOGE("%s: unknown buffer %p\n", __func__, buffer);
+        return false;
+    }
+
+    pthread_mutex_lock(&mLock);
+    if (mBufferState[index] != BUFFER_DEQUEUED) {
+        LOGE("%s: buffer %d is not dequeued\n", __func__, index);
+        pthread_mutex_unlock(&mLock);
+        return false;
+    }
+    mBufferState[index] = BUFFER_QUEUED;
+    pthread_mutex_unlock(&mLock);
+
+    bool ret = post(buffer);
+
+    pthread_mutex_lock(&mLock);
+    if (ret == false) {
+        retireBuffer_l(index);
+    } else {
+        mBufferState[index] = BUFFER_ON_SCREEN;
+        buffer->vsyncState = PVR_OVERLAY_VSYNC_PENDING;
+        replaceOnScreen_l(index);
+    }
+    pthread_mutex_unlock(&mLock);
+
+    return ret;
+}
+
+bool PVROverlayDataDevice::setBufferCount(int count)
+{
+    LOGV("%s: %d buffers\n", __func__, count);
+
+    if (count < PVR_OVERLAY_MIN_BUFFER_NUM ||
+        count > PVR_OVERLAY_MAX_BUFFER_NUM) {
+        LOGE("%s: invalid buffer count %d\n", __func__, count);
+        return false;
+    }
+
+    pthread_mutex_lock(&mLock);
+
+    /*grow, slots in use are kept until they retire*/
+    for (int i = mNumBuffers; i < count; i++) {
+        if (allocateDataBuffer(i) == false) {
+            count = i;
+            break;
+        }
+    }
+
+    /*shrink, free slots go now, the others once they retire*/
+    for (int i = count; i < mNumBuffers; i++) {
+        if (mBufferState[i] == BUFFER_FREE)
+            destroyDataBuffer(i);
+    }
+
+    mNumBuffers = count;
+    pthread_cond_broadcast(&mHasBuffer);
+
+    pthread_mutex_unlock(&mLock);
+
+    return count >= PVR_OVERLAY_MIN_BUFFER_NUM;
+}
+
 void PVROverlayDataDevice::signal()
 {
     LOGV("%s: signaling...\n", __func__);
@@ -522,9 +787,6 @@ uint32_t PVROverlayDataDevice::calculateSWidthSW(uint32_t offset, uint32_t width
 
 void PVROverlayDataDevice::coordinateSetup(struct pvr_overlay_buffer_t * buf)
 {
-    uint32_t swidthy = 0;
-    uint32_t swidthuv = 0;
-
     if(!buf) {
         LOGE("%s: invalid overlay buffer\n", __func__);
         return;
@@ -535,8 +797,6 @@ void PVROverlayDataDevice::coordinateSetup(struct pvr_overlay_buffer_t * buf)
     uint32_t format = buf->format;
     uint32_t width = buf->width;
     uint32_t height = buf->height;
-    uint32_t offsety = mControlBlock->OBUF_0Y;
-    uint32_t offsetu = mControlBlock->OBUF_0U;
 
     switch (format) {
     case OVERLAY_FORMAT_YCbYCr_420_I:       /*I420*/
@@ -558,15 +818,9 @@ void PVROverlayDataDevice::coordinateSetup(struct pvr_overlay_buffer_t * buf)
     }
 
     mControlBlock->SWIDTH = width | ((width / 2) << 16);
-    swidthy = calculateSWidthSW(offsety, width);
-    swidthuv = calculateSWidthSW(offsetu, width / 2);
-    mControlBlock->SWIDTHSW = (swidthy << 2) | (swidthuv << 18);
+    sourceStrideSetup();
     mControlBlock->SHEIGHT = height | ((height / 2) << 16);
 
-    /*get dst position from HAL*/
-    PVROverlayHAL::Instance().getPosition(mOverlayIndex,
-                        &dstX, &dstY, &dstWidth, &dstHeight);
-
     LOGV("pos (%d, %d), size (%dx%d)\n", dstX, dstY, dstWidth, dstHeight);
 
     mControlBlock->DWINPOS = (dstY << 16) | dstX;
@@ -575,6 +829,16 @@ void PVROverlayDataDevice::coordinateSetup(struct pvr_overlay_buffer_t * buf)
     LOGV("%s: finished\n", __func__);
 }
 
+/*SWIDTHSW counts 64 byte units touched, so it follows the buffer offsets*/
+void PVROverlayDataDevice::sourceStrideSetup()
+{
+    uint32_t width = mControlBlock->SWIDTH & 0xffff;
+    uint32_t swidthy = calculateSWidthSW(mControlBlock->OBUF_0Y, width);
+    uint32_t swidthuv = calculateSWidthSW(mControlBlock->OBUF_0U, width / 2);
+
+    mControlBlock->SWIDTHSW = (swidthy << 2) | (swidthuv << 18);
+}
+
 bool PVROverlayDataDevice::setCoeffRegs(double *coeff, int mantSize, coeffPtr pCoeff, int pos)
 {
     int maxVal, icoeff, res;
@@ -701,7 +965,7 @@ void PVROverlayDataDevice::updateCoeff(int taps,
     }
 }
 
-void PVROverlayDataDevice::scalingSetup(uint32_t srcWidth, uint32_t srcHeight,
+bool PVROverlayDataDevice::scalingSetup(uint32_t srcWidth, uint32_t srcHeight,
                     uint32_t dstWidth, uint32_t dstHeight)
 {
     int xscaleInt, xscaleFract, yscaleInt, yscaleFract;
@@ -746,13 +1010,13 @@ void PVROverlayDataDevice::scalingSetup(uint32_t srcWidth, uint32_t srcHeight,
     /* shouldn't get here */
     if (xscaleInt > 7) {
         LOGE("%s: xscaleInt > 7\n", __func__);
-        return;
+        return false;
     }
 
     /* shouldn't get here */
     if (xscaleIntUV > 7) {
         LOGE("%s: xscaleIntUV > 7\n", __func__);
-        return;
+        return false;
     }
 
     newval = (xscaleInt << 15) |
@@ -818,6 +1082,8 @@ void PVROverlayDataDevice::scalingSetup(uint32_t srcWidth, uint32_t srcHeight,
             }
         }
     }
+
+    return scaleChanged;
 }
 
 /**
@@ -1022,6 +1288,12 @@ void PVROverlayDataDevice::resetOverlay()
     controlBlockInit();
     PVROverlayHAL::Instance().updateOverlay(&mControlBlkBuffer,
                         mControlBlock, false);
+    mPostState.valid = false;
+
+    /*overlay goes off with the next vblank*/
+    pthread_mutex_lock(&mLock);
+    replaceOnScreen_l(-1);
+    pthread_mutex_unlock(&mLock);
 }
 
 void PVROverlayDataDevice::setDrmModeChanged(bool changed)
@@ -32,6 +32,16 @@
  * object.
  */
 class PVROverlayDataDevice : public overlay_data_device_t {
+private:
+    /*data buffer states*/
+    enum {
+        BUFFER_FREE = 0,
+        BUFFER_DEQUEUED,
+        BUFFER_QUEUED,
+        BUFFER_ON_SCREEN,
+        /*replaced, scanned out until the next vblank latches OVADD*/
+        BUFFER_FLIPPING,
+    };
 private:
     pthread_mutex_t mLock;
     pthread_cond_t mHasBuffer;
@@ -40,8 +50,21 @@ private:
     struct pvr_overlay_buffer_t mControlBlkBuffer;
 
     /*init following members during initializing*/
-    struct pvr_overlay_buffer_t mDataBuffers[PVR_OVERLAY_BUFFER_NUM];
-    int mNumFreeBuffers;
+    struct pvr_overlay_buffer_t mDataBuffers[PVR_OVERLAY_MAX_BUFFER_NUM];
+    int mBufferState[PVR_OVERLAY_MAX_BUFFER_NUM];
+    bool mBufferAllocated[PVR_OVERLAY_MAX_BUFFER_NUM];
+    /*queue depth, slots above it are freed once they retire*/
+    int mNumBuffers;
+    /*slot currently scanned out, -1 if none*/
+    int mOnScreenBuffer;
+    /*time a flipping slot is surely off screen*/
+    int64_t mRetireTime[PVR_OVERLAY_MAX_BUFFER_NUM];
+
+    /*dequeue statistics*/
+    uint32_t mDequeueCount;
+    uint32_t mDequeueWaits;
+    int64_t mDequeueWaitNs;
+    int64_t mMaxDequeueWaitNs;
 
     /*wrapped external buffer*/
     struct pvr_overlay_buffer_t mExternalBuffer;
@@ -55,6 +78,22 @@ private:
 
     /*TODO: add source crop later*/
 
+    /*geometry the overlay registers were last derived from*/
+    struct {
+        bool valid;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t yStride;
+        uint32_t uvStride;
+        int x;
+        int y;
+        int w;
+        int h;
+    } mPostState;
+    uint32_t mPostsFull;
+    uint32_t mPostsFast;
+
     /*Overlay binding to this data device*/
     uint32_t mOverlayIndex;
 private:
@@ -62,12 +101,21 @@ private:
     void bufferOffsetSetup(struct pvr_overlay_buffer_t * buf);
     uint32_t calculateSWidthSW(uint32_t offset, uint32_t width);
     void coordinateSetup(struct pvr_overlay_buffer_t * buf);
+    void sourceStrideSetup();
+    void commandSetup(uint32_t format);
+    bool registerSetup(struct pvr_overlay_buffer_t * buf);
     bool setCoeffRegs(double *coeff, int mantSize, coeffPtr pCoeff, int pos);
     void updateCoeff(int taps, double fCutoff, bool isHoriz, bool isY,
                     coeffPtr pCoeff);
-    void scalingSetup(uint32_t srcWidth, uint32_t srcHeight,
+    bool scalingSetup(uint32_t srcWidth, uint32_t srcHeight,
             uint32_t dstWidth, uint32_t dstHeight);
     bool formatOverlayBuffer(struct pvr_overlay_buffer_t * buffer);
+    int bufferIndex(struct pvr_overlay_buffer_t * buffer);
+    bool allocateDataBuffer(int index);
+    void destroyDataBuffer(int index);
+    void retireBuffer_l(int index);
+    void replaceOnScreen_l(int index);
+    int64_t retireFlipped_l(int64_t now);
 public:
     PVROverlayDataDevice();
     ~PVROverlayDataDevice();
@@ -78,6 +126,8 @@ public:
     bool postExternal(uint32_t device, uint32_t handle);
     struct pvr_overlay_buffer_t * getBuffer();
     bool putBuffer(struct pvr_overlay_buffer_t * buffer);
+    bool queueBuffer(struct pvr_overlay_buffer_t * buffer);
+    bool setBufferCount(int count);
     void signal();
     void waitBuffer();
     bool setCrop(uint32_t x, uint32_t y, uint32_t w, uint32_t h);
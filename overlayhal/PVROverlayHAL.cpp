@@ -38,6 +38,7 @@ PVROverlayHAL::PVROverlayHAL(){
     drmFD = -1;
     mDrmModeChanged = false;
     mVideoBridgeIoctl = 0;
+    memset(mCrtcId, 0, sizeof(mCrtcId));
 }
 
 PVROverlayHAL:: ~PVROverlayHAL() {
@@ -94,23 +95,12 @@ bool PVROverlayHAL::createSharedContext()
 
     /*init sharedContext*/
     memset(sharedContext, 0, size);
+    sharedContext->layout = PVR_OVERLAY_CONTEXT_LAYOUT;
     sharedContext->refCount = 1;
 
-    if (pthread_mutexattr_init(&sharedContext->attr)) {
-        LOGE("%s: Initialize overlay mutex attr failed\n", __func__);
-        goto mutexattr_init_err;
-    }
-
-    if (pthread_mutexattr_setpshared(&sharedContext->attr,
-                                     PTHREAD_PROCESS_SHARED)) {
-        LOGE("%s: set pshared error\n", __func__);
-        goto pshared_err;
-    }
-
-
-    if (pthread_mutex_init(&sharedContext->lock, &sharedContext->attr)) {
+    if (intel_seqlock_init(&sharedContext->seqlock) == false) {
         LOGE("%s: shared block lock init failed\n", __func__);
-        goto mutex_init_err;
+        goto lock_init_err;
     }
 
     mSharedContext = sharedContext;
@@ -122,10 +112,7 @@ bool PVROverlayHAL::createSharedContext()
     LOGV("%s: create succussfully fd %d\n", __func__, fd);
 
     return true;
-mutex_init_err:
-pshared_err:
-    pthread_mutexattr_destroy(&sharedContext->attr);
-mutexattr_init_err:
+lock_init_err:
     munmap(sharedContext, size);
     close(fd);
     this->unlock();
@@ -148,13 +135,7 @@ void PVROverlayHAL::destroySharedContext(bool closeFd)
         LOGV("%s: destroying mutex...\n", __func__);
 
         /*destroy it since only control device is using it*/
-        if (pthread_mutex_destroy(&mSharedContext->lock)) {
-            LOGE("%s: destroy share context lock failed\n", __func__);
-        }
-
-        if (pthread_mutexattr_destroy(&mSharedContext->attr)) {
-            LOGE("%s: destroy mutex attr failed\n", __func__);
-        }
+        intel_seqlock_destroy(&mSharedContext->seqlock);
     }
 
     if (munmap(mSharedContext, mSharedSize)) {
@@ -193,6 +174,15 @@ bool PVROverlayHAL::openSharedContext(int fd, int size)
         return false;
     }
 
+    /*created by a HAL built with another layout*/
+    if (size < (int)sizeof(IntelOverlayHALContext) ||
+        sharedContext->layout != PVR_OVERLAY_CONTEXT_LAYOUT) {
+        LOGE("%s: shared context layout mismatch\n", __func__);
+        munmap(sharedContext, size);
+        this->unlock();
+        return false;
+    }
+
     android_atomic_inc(&sharedContext->refCount);
 
     LOGV("%s: open successufully, shared context %p\n",
@@ -225,6 +215,11 @@ void PVROverlayHAL::unlock() {
     pthread_mutex_unlock(&mLock);
 }
 
+/**
+ * Shared context writers. Readers don't lock, they copy what they need
+ * between sharedContextReadBegin() and sharedContextReadRetry() and
+ * retry if a writer got in between.
+ */
 bool PVROverlayHAL::sharedContextLock()
 {
     LOGV("%s:shared context %p\n", __func__, mSharedContext);
@@ -234,7 +229,7 @@ bool PVROverlayHAL::sharedContextLock()
         return false;
     }
 
-    pthread_mutex_lock(&mSharedContext->lock);
+    intel_seqlock_write_lock(&mSharedContext->seqlock);
 
     return true;
 }
@@ -248,7 +243,23 @@ void PVROverlayHAL::sharedContextUnlock()
         return;
     }
 
-    pthread_mutex_unlock(&mSharedContext->lock);
+    intel_seqlock_write_unlock(&mSharedContext->seqlock);
+}
+
+bool PVROverlayHAL::sharedContextReadBegin(int32_t *seq)
+{
+    if (!mSharedContext) {
+        LOGE("%s: Invalid shared context\n", __func__);
+        return false;
+    }
+
+    *seq = intel_seqlock_read_begin(&mSharedContext->seqlock);
+    return true;
+}
+
+bool PVROverlayHAL::sharedContextReadRetry(int32_t seq)
+{
+    return intel_seqlock_read_retry(&mSharedContext->seqlock, seq);
 }
 
 void PVROverlayHAL::setPipe(int overlayIndex, int pipe)
@@ -269,22 +280,22 @@ void PVROverlayHAL::setPipe(int overlayIndex, int pipe)
 
 int PVROverlayHAL::getPipe(int overlayIndex, int *pipe)
 {
+    int32_t seq;
     int p;
 
     if(overlayIndex < 0 || overlayIndex > MDFLD_OVERLAY_MAX)
         return -EINVAL;
 
-    if (!sharedContextLock()) {
-        LOGE("%s: cannot lock shared context\n", __func__);
-        return -EINVAL;
-    }
-
-    p = mSharedContext->pipe[overlayIndex];
+    do {
+        if (!sharedContextReadBegin(&seq)) {
+            LOGE("%s: cannot read shared context\n", __func__);
+            return -EINVAL;
+        }
+        p = mSharedContext->pipe[overlayIndex];
+    } while (sharedContextReadRetry(seq));
 
     *pipe = p;
 
-    sharedContextUnlock();
-
     return 0;
 }
 
@@ -304,21 +315,22 @@ void PVROverlayHAL::setSize(int overlayIndex, uint32_t w, uint32_t h)
 
 int PVROverlayHAL::getSize(int overlayIndex, IntelOverlaySize *size)
 {
+    int32_t seq;
+
     if (overlayIndex < 0 || overlayIndex > MDFLD_OVERLAY_MAX)
         return -EINVAL;
 
     if (!size)
         return -EINVAL;
 
-    if (!sharedContextLock()) {
-        LOGE("%s: cannot lock shared context\n", __func__);
-        return -EINVAL;
-    }
-
-    size->width = mSharedContext->size[overlayIndex].width;
-    size->height = mSharedContext->size[overlayIndex].height;
-
-    sharedContextUnlock();
+    do {
+        if (!sharedContextReadBegin(&seq)) {
+            LOGE("%s: cannot read shared context\n", __func__);
+            return -EINVAL;
+        }
+        size->width = mSharedContext->size[overlayIndex].width;
+        size->height = mSharedContext->size[overlayIndex].height;
+    } while (sharedContextReadRetry(seq));
 
     return 0;
 }
@@ -962,34 +974,32 @@ void PVROverlayHAL::setOverlayUsage(int overlayIndex, int usage)
 
 int PVROverlayHAL::getOverlayPipe(int overlayIndex)
 {
+    int32_t seq;
     int pipe;
 
-    /*lock shared context*/
-    if (sharedContextLock() == false) {
-        LOGE("%s: lock shared context error\n", __func__);
-        return -EINVAL;
-    }
-
-    pipe = mSharedContext->pipe[overlayIndex];
-
-    sharedContextUnlock();
+    do {
+        if (sharedContextReadBegin(&seq) == false) {
+            LOGE("%s: read shared context error\n", __func__);
+            return -EINVAL;
+        }
+        pipe = mSharedContext->pipe[overlayIndex];
+    } while (sharedContextReadRetry(seq));
 
     return pipe;
 }
 
 int PVROverlayHAL::getOverlayUsage(int overlayIndex)
 {
+    int32_t seq;
     int usage;
 
-    /*lock shared context*/
-    if (sharedContextLock() == false) {
-        LOGE("%s: lock shared context error\n", __func__);
-        return -EINVAL;
-    }
-
-    usage = mSharedContext->usage[overlayIndex];
-
-    sharedContextUnlock();
+    do {
+        if (sharedContextReadBegin(&seq) == false) {
+            LOGE("%s: read shared context error\n", __func__);
+            return -EINVAL;
+        }
+        usage = mSharedContext->usage[overlayIndex];
+    } while (sharedContextReadRetry(seq));
 
     return usage;
 }
@@ -1018,57 +1028,64 @@ void PVROverlayHAL::setPosition(int overlayIndex, int x, int y,
 int PVROverlayHAL::getPosition(int overlayIndex, int *x, int *y,
                                int *w, int *h)
 {
-    IntelOverlayPosition *position;
+    IntelOverlayPosition position;
     IntelOverlayDisplayMode displayMode;
+    int hdisplay, vdisplay;
+    int32_t seq;
 
     if (!x || !y || !w || !h) {
         LOGE("%s: Invalid parameter\n", __func__);
         return -EINVAL;
     }
 
-    /*lock shared context*/
-    if (sharedContextLock() == false) {
-        LOGE("%s: lock shared context error\n", __func__);
-        return -EINVAL;
-    }
+    /*snapshot the position and the mode it's clipped against*/
+    do {
+        if (sharedContextReadBegin(&seq) == false) {
+            LOGE("%s: read shared context error\n", __func__);
+            return -EINVAL;
+        }
 
-    position = &mSharedContext->position[overlayIndex];
+        position = mSharedContext->position[overlayIndex];
+        displayMode = mSharedContext->modeInfo.displayMode;
 
-    displayMode = mSharedContext->modeInfo.displayMode;
+        /*display full screen size overlay when HDMI is connected*/
+        drmModeModeInfoPtr mode = (displayMode == MDFLD_OVERLAY_HDMI_CONNECTED) ?
+            &mSharedContext->modeInfo.modes[MDFLD_OUTPUT_HDMI] :
+            &mSharedContext->modeInfo.modes[MDFLD_OUTPUT_MIPI0];
+        hdisplay = mode->hdisplay;
+        vdisplay = mode->vdisplay;
+    } while (sharedContextReadRetry(seq));
 
-    /*display full screen size overlay when HDMI is connected*/
     if (displayMode == MDFLD_OVERLAY_HDMI_CONNECTED) {
-        drmModeModeInfoPtr hdmiMode =
-            &mSharedContext->modeInfo.modes[MDFLD_OUTPUT_HDMI];
         *x = 0;
         *y = 0;
-        *w = hdmiMode->hdisplay;
-        *h = hdmiMode->vdisplay;
+        *w = hdisplay;
+        *h = vdisplay;
     } else {
-        *x = position->x;
-        *y = position->y;
-        *w = position->width;
-        *h = position->height;
+        *x = position.x;
+        *y = position.y;
+        *w = position.width;
+        *h = position.height;
 
         /*check video position*/
-        drmModeModeInfoPtr mipiMode =
-            &mSharedContext->modeInfo.modes[MDFLD_OUTPUT_MIPI0];
         if (*x < 0)
             *x = 0;
         if (*y < 0)
             *y = 0;
-        if ((*x + *w) > mipiMode->hdisplay)
-            *w = mipiMode->hdisplay - *x;
-        if ((*y + *h) > mipiMode->vdisplay)
-            *h = mipiMode->vdisplay - *y;
+        if ((*x + *w) > hdisplay)
+            *w = hdisplay - *x;
+        if ((*y + *h) > vdisplay)
+            *h = vdisplay - *y;
     }
 
-    sharedContextUnlock();
-
     return 0;
 }
 
-void PVROverlayHAL::drmModeChanged(struct pvr_overlay_buffer_t * controlBuffer,
+/**
+ * switch the overlay pipe once a hotplug was flagged through
+ * setDrmModeChanged(), returns true if the display mode changed.
+ */
+bool PVROverlayHAL::drmModeChanged(struct pvr_overlay_buffer_t * controlBuffer,
                                    struct pvr_overlay_control_block_t * controlBlk)
 {
     IntelOverlayDisplayMode oldDisplayMode;
@@ -1076,9 +1093,10 @@ void PVROverlayHAL::drmModeChanged(struct pvr_overlay_buffer_t * controlBuffer,
     struct drm_psb_register_rw_arg arg;
     uint32_t overlayAPipe = 0;
     bool ret = true;
+    bool changed = false;
 
     if (!mDrmModeChanged)
-        return;
+        return false;
 
     if (!controlBlk || !controlBuffer) {
         LOGE("%s: invalid parameter\n", __func__);
@@ -1146,9 +1164,11 @@ void PVROverlayHAL::drmModeChanged(struct pvr_overlay_buffer_t * controlBuffer,
 
     /*enable overlay*/
     controlBlk->OCMD |= 0x1;
+    changed = true;
 
 mode_change_done:
     setDrmModeChanged(false);
+    return changed;
 }
 
 bool PVROverlayHAL::detectDrmModeInfo()
@@ -1202,6 +1222,11 @@ bool PVROverlayHAL::detectDrmModeInfo()
             outputIndex = MDFLD_OUTPUT_HDMI;
         }
 
+        if (outputIndex < 0) {
+            drmModeFreeConnector(connector);
+            continue;
+        }
+
         /*get & update connection status*/
         sharedContextLock();
 
@@ -1227,6 +1252,8 @@ bool PVROverlayHAL::detectDrmModeInfo()
             continue;
         }
 
+        mCrtcId[outputIndex] = crtc->crtc_id;
+
         /*get current mode*/
         sharedContextLock();
 
@@ -1287,20 +1314,49 @@ bool PVROverlayHAL::detectDrmModeInfo()
 IntelOverlayDisplayMode PVROverlayHAL::getOverlayDisplayMode()
 {
     IntelOverlayDisplayMode displayMode;
+    int32_t seq;
 
     LOGV("%s: getting overlay display mode...\n", __func__);
 
-    sharedContextLock();
-
-    displayMode = mSharedContext->modeInfo.displayMode;
-
-    sharedContextUnlock();
+    do {
+        if (sharedContextReadBegin(&seq) == false)
+            return MDFLD_OVERLAY_UNKNOWN;
+        displayMode = mSharedContext->modeInfo.displayMode;
+    } while (sharedContextReadRetry(seq));
 
     LOGV("%s: display mode %d\n", __func__, displayMode);
 
     return displayMode;
 }
 
+/**
+ * frame period of the output the overlay is shown on. the refresh rate of
+ * MIPI may be switched without a hotplug, the crtc is read back each time.
+ */
+int64_t PVROverlayHAL::getFramePeriodNs()
+{
+    IntelDCOutput output = MDFLD_OUTPUT_MIPI0;
+    uint32_t vrefresh = 0;
+
+    if (getOverlayDisplayMode() == MDFLD_OVERLAY_HDMI_CONNECTED)
+        output = MDFLD_OUTPUT_HDMI;
+
+    if (drmFD >= 0 && mCrtcId[output]) {
+        drmModeCrtcPtr crtc = drmModeGetCrtc(drmFD, mCrtcId[output]);
+        if (crtc) {
+            if (crtc->mode_valid)
+                vrefresh = crtc->mode.vrefresh;
+            drmModeFreeCrtc(crtc);
+        }
+    }
+
+    /*assume the slowest HDMI mode if the rate is unknown*/
+    if (!vrefresh)
+        vrefresh = 24;
+
+    return 1000000000LL / vrefresh;
+}
+
 void PVROverlayHAL::setDrmModeChanged(bool changed)
 {
     this->lock();
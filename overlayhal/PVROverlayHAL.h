@@ -17,6 +17,7 @@
 #define __PVR_OVERLAY_HAL_H__
 
 #include <IPVRWsbm.h>
+#include <IntelSeqlock.h>
 #include <psb_drm.h>
 #include <pthread.h>
 #include <pvr2d.h>
@@ -121,9 +122,13 @@ typedef struct intel_drm_mode_info {
     IntelOverlayDisplayMode displayMode;
 } IntelDrmModeInfo;
 
+/*bump when the shared context layout changes*/
+#define PVR_OVERLAY_CONTEXT_LAYOUT      2
+
 typedef struct intel_overlay_shared_context {
-    pthread_mutex_t lock;
-    pthread_mutexattr_t attr;
+    uint32_t layout;
+    /*lock free reads, writers serialized*/
+    intel_seqlock_t seqlock;
     volatile int32_t refCount;
     /*overlay-pipe mapping*/
     IntelDCPipe pipe[MDFLD_OVERLAY_MAX];
@@ -165,6 +170,9 @@ private:
 
     bool mDrmModeChanged;
     uint32_t mVideoBridgeIoctl;
+
+    /*crtc driving each output, found by detectDrmModeInfo()*/
+    uint32_t mCrtcId[MDFLD_OUTPUT_NUM];
 private:
     PVROverlayHAL();
     void lock();
@@ -176,6 +184,8 @@ private:
 
     bool sharedContextLock();
     void sharedContextUnlock();
+    bool sharedContextReadBegin(int32_t *seq);
+    bool sharedContextReadRetry(int32_t seq);
 
     uint32_t getBufferHandle(uint32_t device, uint32_t handle);
     bool  getVideoBridgeIoctl();
@@ -224,7 +234,8 @@ public:
     int getPosition(int overlayIndex, int *x, int *y, int *w, int *h);
     bool detectDrmModeInfo();
     IntelOverlayDisplayMode getOverlayDisplayMode();
-    void drmModeChanged(struct pvr_overlay_buffer_t * controlBuffer,
+    int64_t getFramePeriodNs();
+    bool drmModeChanged(struct pvr_overlay_buffer_t * controlBuffer,
                         struct pvr_overlay_control_block_t * controlBlk);
     void setDrmModeChanged(bool changed);
 };
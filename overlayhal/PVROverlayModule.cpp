@@ -190,6 +190,16 @@ int overlay_setParameter(struct overlay_data_device_t *dev,
             return -EINVAL;
         }
         pvrDataDevice->setDrmModeChanged(true);
+        break;
+    case MDFLD_OVERLAY_BUFFER_COUNT:
+        if (value < PVR_OVERLAY_MIN_BUFFER_NUM ||
+            value > PVR_OVERLAY_MAX_BUFFER_NUM) {
+            LOGE("%s: invalid buffer count %d\n", __func__, value);
+            return -EINVAL;
+        }
+        if (pvrDataDevice->setBufferCount(value) == false)
+            return -ENOMEM;
+        break;
     default:
         return -EINVAL;
     }
@@ -218,17 +228,10 @@ int overlay_queueBuffer(struct overlay_data_device_t *dev,
         return -EINVAL;
     }
 
-    /*post it*/
-    pvrDataDevice->post(pvrOverlayBuffer);
-
-    /*lock this device in order to upate the buffer list*/
-
-    /*check buffer vsync status*/
-    if(pvrOverlayBuffer->vsyncState == PVR_OVERLAY_VSYNC_DONE) {
-        pvrDataDevice->putBuffer(pvrOverlayBuffer);
-    } else {
-        pvrOverlayBuffer->vsyncState = PVR_OVERLAY_VSYNC_INIT;
-        pvrDataDevice->putBuffer(pvrOverlayBuffer);
+    /*post it, the buffer it replaces on screen becomes free*/
+    if (pvrDataDevice->queueBuffer(pvrOverlayBuffer) == false) {
+        LOGE("%s: failed to queue buffer %p\n", __func__, pvrOverlayBuffer);
+        return -EINVAL;
     }
 
     LOGV("%s: overlay queue buffer %p done.\n",